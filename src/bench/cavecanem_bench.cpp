@@ -0,0 +1,641 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmark of the plugins, without DDS. Each plugin is loaded from
+ * its shared library through its create_* factory, like plugin_manager
+ * does, and driven with a DynamicData sample of its type. Samples are
+ * handed to an in-memory host (cc_plugin_host::write_sample) that records
+ * the writes instead of sending them, so no participant or DataWriter is
+ * created.
+ *
+ *   cavecanem_bench [--ticks N] [--warmup N] [--dir DIR] [--procfs ROOT]
+ *                   [--builtin | --compare] [--manager [--rule EXPR ...]]
+ *                   [--zero-alloc [--allow-sigar]] [plugin ...]
+ *
+ * With --builtin the plugins are taken from those compiled into the
+ * benchmark (CMake option CAVECANEM_BUILTIN_PLUGINS) instead of their
+ * libraries, and --compare runs every plugin both ways.
+ *
+ * For each plugin it reports the time its library took to be opened and
+ * the plugin to be constructed, the time per tick and per sample, the samples,
+ * members and bytes written per tick, and the heap allocations and system
+ * calls made per tick. Allocations are counted by interposing malloc
+ * (glibc only). System calls are counted with the raw_syscalls:sys_enter
+ * tracepoint when perf allows it; otherwise only read/write-like calls are
+ * counted, from /proc/self/io.
+ *
+ * --procfs sets the procfs_root property of every plugin, so that proc,
+ * net_load and disk read a tree made by procfs_fixture instead of /proc.
+ *
+ * With --manager every sample also goes through what
+ * plugin_manager::write_sample() does besides the DataWriter write: the
+ * rules and anomaly detectors of inspect_sample() and the self telemetry.
+ * Each plugin gets a rule on its first numeric member that never fires,
+ * plus the --rule expressions (e.g. "cpu.cpu_user > 90") naming it, and
+ * the anomaly detectors of its configuration file.
+ *
+ * With --zero-alloc the benchmark fails (exit status 1) if any plugin
+ * allocates once warmed up. The ticks after the warmup are the steady
+ * state: a plugin may size its buffers during the first ticks, not after.
+ * Sigar allocates inside its own calls (lists, fopen() of procfs files):
+ * --allow-sigar exempts the plugins sampling through it, memory and
+ * proc_stat always, proc, net_load and disk unless --procfs makes them read
+ * procfs themselves. Their allocations are still reported.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+
+#include <ndds/osapi/osapi_library.h>
+#include <ndds/ndds_cpp.h>
+
+#include "plugin.hpp"
+#include "builtin_plugins.hpp"
+#include "xml_parser.hpp"
+#include "rule_engine.hpp"
+#include "anomaly_detector.hpp"
+#include "self_telemetry.hpp"
+
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR "."
+#endif
+
+using namespace std;
+
+/*
+ * Allocation counter
+ */
+static volatile unsigned long long allocations = 0;
+
+#if defined(__GLIBC__)
+static const bool allocations_counted = true;
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    void *malloc(size_t size)
+    {
+	__sync_add_and_fetch(&allocations, 1);
+	return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+	__sync_add_and_fetch(&allocations, 1);
+	return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+	__sync_add_and_fetch(&allocations, 1);
+	return __libc_realloc(ptr, size);
+    }
+}
+#else
+static const bool allocations_counted = false;
+#endif
+
+/*
+ * System call counter
+ */
+class syscall_counter {
+public:
+    syscall_counter() : fd_(-1)
+    {
+#ifdef __linux__
+	const char *paths[] = {
+	    "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+	    "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+	    NULL
+	};
+	for(int i = 0; paths[i] != NULL && fd_ < 0; i++) {
+	    FILE *file = fopen(paths[i], "r");
+	    if(file == NULL)
+		continue;
+	    unsigned long long id;
+	    if(fscanf(file, "%llu", &id) == 1) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_TRACEPOINT;
+		attr.config = id;
+		attr.sample_period = 1;
+		fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	    }
+	    fclose(file);
+	}
+#endif
+    }
+
+    ~syscall_counter()
+    {
+	if(fd_ >= 0)
+	    close(fd_);
+    }
+
+    const char *source() const
+    {
+	return fd_ >= 0 ? "syscalls" : "rw-syscalls";
+    }
+
+    unsigned long long read() const
+    {
+	unsigned long long count = 0;
+	if(fd_ >= 0) {
+	    if(::read(fd_, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	    return count;
+	}
+
+	//Fallback: read and write calls of the process (counts its own read)
+	FILE *file = fopen("/proc/self/io", "r");
+	if(file == NULL)
+	    return 0;
+	char line[128];
+	while(fgets(line, sizeof(line), file) != NULL) {
+	    unsigned long long value;
+	    if(sscanf(line, "syscr: %llu", &value) == 1 ||
+	       sscanf(line, "syscw: %llu", &value) == 1)
+		count += value;
+	}
+	fclose(file);
+	return count;
+    }
+
+private:
+    int fd_;
+};
+
+/*
+ * Plugins whose samples come from sigar calls allocating inside sigar,
+ * exempt from --zero-alloc with --allow-sigar (unless --procfs replaces
+ * those calls)
+ */
+static const struct {
+    const char *plugin;
+    bool procfs_replaces_sigar;
+} sigar_allocating[] = {
+    {"memory", false},
+    {"proc_stat", false},
+    {"proc", true},
+    {"net_load", true},
+    {"disk", true},
+    {NULL, false}
+};
+
+static bool allocations_exempt(const string &name, bool procfs)
+{
+    for(int i = 0; sigar_allocating[i].plugin != NULL; i++)
+	if(name == sigar_allocating[i].plugin)
+	    return !(procfs && sigar_allocating[i].procfs_replaces_sigar);
+    return false;
+}
+
+/*
+ * Per-sample work of plugin_manager besides the DataWriter write
+ */
+class manager_path {
+public:
+    manager_path()
+    {
+	//No participant: the telemetry is recorded, never published
+	telemetry_.initialize(NULL, NULL, "", "", 1);
+    }
+
+    //The plugin is bound to index 0, like the first one scheduled
+    static const size_t index = 0;
+
+    bool configure(const string &plugin_name,
+		   const cc_plugin_properties &properties,
+		   const vector<string> &extra_rules)
+    {
+	string error;
+	if(!anomalies_.configure(plugin_name, properties.anomaly_detectors, error)) {
+	    cerr << plugin_name << ": anomaly detectors: " << error << endl;
+	    return false;
+	}
+
+	vector<string> expressions;
+	const DDS_TypeCode *type = properties.type_code;
+	DDS_ExceptionCode_t ex;
+	DDS_UnsignedLong count = type->member_count(ex);
+	for(DDS_UnsignedLong i = 0; i < count && expressions.empty(); i++) {
+	    switch(type->member_type(i, ex)->kind(ex)) {
+	    case DDS_TK_SHORT: case DDS_TK_USHORT:
+	    case DDS_TK_LONG: case DDS_TK_ULONG:
+	    case DDS_TK_LONGLONG: case DDS_TK_ULONGLONG:
+	    case DDS_TK_FLOAT: case DDS_TK_DOUBLE:
+		if(!type->is_member_key(i, ex))
+		    expressions.push_back(plugin_name + "." + type->member_name(i, ex) +
+					  " > 1e300");
+		break;
+	    default:
+		break;
+	    }
+	}
+	for(size_t i = 0; i < extra_rules.size(); i++)
+	    if(extra_rules[i].compare(0, plugin_name.size() + 1, plugin_name + ".") == 0)
+		expressions.push_back(extra_rules[i]);
+
+	for(size_t i = 0; i < expressions.size(); i++) {
+	    char name[32];
+	    snprintf(name, sizeof(name), "bench_%u", (unsigned) i);
+	    if(!rules_.add_rule(name, 1, expressions[i], error)) {
+		cerr << plugin_name << ": rule " << expressions[i] << ": " << error << endl;
+		return false;
+	    }
+	}
+	rules_.bind_plugin(index, plugin_name);
+	anomalies_.bind_plugin(index, plugin_name);
+	telemetry_.bind_plugin(index, plugin_name);
+	return true;
+    }
+
+    /**
+     * @brief Inspects a sample, like plugin_manager::inspect_sample(), and
+     * records its write. Returns the number of alerts fired.
+     */
+    size_t write(const DDS_DynamicData &data, long long bytes)
+    {
+	long long start = self_telemetry::now_ns();
+	fired_.clear();
+	if(rules_.has_rules(index))
+	    rules_.evaluate(index, data, start / 1e9, fired_);
+	if(anomalies_.has_detectors(index))
+	    anomalies_.evaluate(index, data, fired_);
+	telemetry_.record_write(index, self_telemetry::now_ns() - start, bytes, true);
+	return fired_.size();
+    }
+
+    void end_run(long long elapsed_ns)
+    {
+	telemetry_.record_run(index, elapsed_ns, 0);
+    }
+
+private:
+    rule_engine rules_;
+    anomaly_detector anomalies_;
+    self_telemetry telemetry_;
+    vector<cc_alert> fired_;
+};
+
+/*
+ * In-memory host: stands in for plugin_manager and its DataWriters
+ */
+class recording_host : public cc_plugin_host {
+public:
+    recording_host(manager_path *manager) : manager_(manager) { reset(); }
+
+    void reset()
+    {
+	writes = 0;
+	members = 0;
+	bytes = 0;
+	alerts = 0;
+    }
+
+    bool raise_alert(const string &plugin_name, const cc_alert &alert)
+    {
+	alerts++;
+	return true;
+    }
+
+    bool write_sample(const string &plugin_name,
+		      DDSDynamicDataWriter *writer,
+		      DDS_DynamicData *data)
+    {
+	DDS_DynamicDataInfo info;
+	long long size = 0;
+	writes++;
+	if(data->get_info(info) == DDS_RETCODE_OK) {
+	    members += info.member_count;
+	    size = info.stored_size;
+	    bytes += size;
+	}
+	if(manager_ != NULL)
+	    alerts += manager_->write(*data, size);
+
+	if(first_fields.empty()) {
+	    //Field set of the first sample, to check that the plugin fills it
+	    const DDS_TypeCode *type = data->get_type();
+	    DDS_ExceptionCode_t ex;
+	    DDS_UnsignedLong count = type->member_count(ex);
+	    for(DDS_UnsignedLong i = 0; i < count; i++) {
+		const char *name = type->member_name(i, ex);
+		if(data->member_exists(name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED)) {
+		    if(!first_fields.empty())
+			first_fields += ",";
+		    first_fields += name;
+		}
+	    }
+	}
+	return true;
+    }
+
+    unsigned long long writes;
+    unsigned long long members;
+    unsigned long long bytes;
+    unsigned long long alerts;
+    string first_fields;
+
+private:
+    manager_path *manager_;
+};
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Starts a tick, as the plugin manager does every publishing period.
+ */
+static void next_tick(cc_tick &tick)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    tick.sequence++;
+    tick.timestamp_ns = (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage()
+{
+    cerr << "usage: cavecanem_bench [--ticks N] [--warmup N] [--dir DIR] [--procfs ROOT] [--fields]" << endl
+	 << "                       [--builtin | --compare] [--manager [--rule EXPR ...]]" << endl
+	 << "                       [--zero-alloc [--allow-sigar]] [plugin ...]" << endl;
+}
+
+/**
+ * @brief Loads, runs and unloads one plugin, printing its figures.
+ *
+ * @param builtin Whether to take the plugin compiled into the benchmark
+ * rather than opening its library.
+ * @param manager Whether samples go through the per-sample work of the
+ * plugin manager too, with the given extra rules.
+ * @param allocated Set to whether the plugin allocated after the warmup.
+ *
+ * @return False if the plugin could not be loaded.
+ */
+static bool bench_plugin(const string &dir, const string &name,
+			 const string &procfs_root, bool builtin,
+			 bool manager, const vector<string> &rules,
+			 int warmup, int ticks, bool show_fields,
+			 syscall_counter &syscalls, bool &allocated)
+{
+    allocated = false;
+    string plugin_dir = dir + "/src/plugins/" + name + "/";
+    if(!XML_parser::get_singleton()->parse_plugin_configuration_file(plugin_dir + name + ".xml"))
+	return false;
+    cc_plugin_properties properties = XML_parser::get_singleton()->get_plugin_properties(name);
+    if(properties.type_code == NULL) {
+	cerr << name << ": no type definition" << endl;
+	return false;
+    }
+    if(!procfs_root.empty())
+	properties.plugin_config["procfs_root"] = procfs_root;
+
+    long long load_start = now_ns();
+    void *library = NULL;
+    cc_create_plugin_t *create_fnc;
+    if(builtin) {
+	create_fnc = find_builtin_plugin(properties.create_function);
+	if(create_fnc == NULL) {
+	    cerr << name << ": not compiled in" << endl;
+	    return false;
+	}
+    }
+    else {
+	library = RTIOsapiLibrary_open((plugin_dir + properties.dll).c_str(),
+				       RTI_OSAPI_LIBRARY_RTLD_NOW);
+	if(library == NULL) {
+	    cerr << name << ": cannot open " << plugin_dir + properties.dll << endl;
+	    return false;
+	}
+	create_fnc = (cc_create_plugin_t *)
+	    RTIOsapiLibrary_getSymbolAddress(library, properties.create_function.c_str());
+	if(create_fnc == NULL) {
+	    cerr << name << ": no " << properties.create_function << " in the library" << endl;
+	    RTIOsapiLibrary_close(library);
+	    return false;
+	}
+    }
+
+    cc_plugin *plugin = NULL;
+    try {
+	plugin = create_fnc(name, properties.plugin_config);
+    } catch(exception &e) {
+	cerr << name << ": " << e.what() << endl;
+    }
+    if(plugin == NULL) {
+	if(library != NULL)
+	    RTIOsapiLibrary_close(library);
+	return false;
+    }
+    long long load_elapsed = now_ns() - load_start;
+
+    manager_path path;
+    if(manager && !path.configure(name, properties, rules)) {
+	plugin->destroy_plugin();
+	if(library != NULL)
+	    RTIOsapiLibrary_close(library);
+	return false;
+    }
+    recording_host host(manager ? &path : NULL);
+    plugin->set_host(&host, name);
+    DDS_DynamicData data(properties.type_code, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+
+    //No DataWriter: every write goes through host.write_sample()
+    cc_tick tick;
+    tick.sequence = 0;
+    for(int i = 0; i < warmup; i++) {
+	long long run_start = now_ns();
+	next_tick(tick);
+	plugin->set_tick(tick);
+	plugin->generate_and_publish_information(NULL, &data);
+	if(manager)
+	    path.end_run(now_ns() - run_start);
+    }
+    host.reset();
+
+    //The /proc/self/io fallback of the syscall counter allocates: keep it out
+    unsigned long long syscalls_before = syscalls.read();
+    unsigned long long allocations_before = allocations;
+    long long start = now_ns();
+    for(int i = 0; i < ticks; i++) {
+	long long run_start = now_ns();
+	next_tick(tick);
+	plugin->set_tick(tick);
+	plugin->generate_and_publish_information(NULL, &data);
+	if(manager)
+	    path.end_run(now_ns() - run_start);
+    }
+    long long elapsed = now_ns() - start;
+    unsigned long long allocations_made = allocations - allocations_before;
+    unsigned long long syscalls_made = syscalls.read() - syscalls_before;
+    allocated = allocations_made > 0;
+
+    char allocations_text[32];
+    if(allocations_counted)
+	snprintf(allocations_text, sizeof(allocations_text), "%10.1f",
+		 (double) allocations_made / ticks);
+    else
+	snprintf(allocations_text, sizeof(allocations_text), "%10s", "n/a");
+
+    printf("%-12s %-8s %10.1f %12.0f %12.0f %10.1f %10.1f %10.0f %s %10.1f\n",
+	   name.c_str(),
+	   builtin ? "builtin" : "library",
+	   load_elapsed / 1000.0,
+	   (double) elapsed / ticks,
+	   host.writes ? (double) elapsed / host.writes : 0.0,
+	   (double) host.writes / ticks,
+	   host.writes ? (double) host.members / host.writes : 0.0,
+	   host.writes ? (double) host.bytes / host.writes : 0.0,
+	   allocations_text,
+	   (double) syscalls_made / ticks);
+    if(show_fields)
+	printf("%-12s fields: %s\n", "", host.first_fields.c_str());
+    if(host.alerts > 0)
+	printf("%-12s %llu alerts raised\n", "", host.alerts);
+
+    plugin->destroy_plugin();
+    if(library != NULL)
+	RTIOsapiLibrary_close(library);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int ticks = 1000;
+    int warmup = 10;
+    bool show_fields = false;
+    bool library = true;
+    bool builtin = false;
+    bool zero_alloc = false;
+    bool allow_sigar = false;
+    bool manager = false;
+    vector<string> rules;
+    string dir(CAVECANEM_DIR);
+    string procfs_root;
+    vector<string> plugins;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--ticks" && i + 1 < argc)
+	    ticks = atoi(argv[++i]);
+	else if(arg == "--warmup" && i + 1 < argc)
+	    warmup = atoi(argv[++i]);
+	else if(arg == "--dir" && i + 1 < argc)
+	    dir = argv[++i];
+	else if(arg == "--procfs" && i + 1 < argc)
+	    procfs_root = argv[++i];
+	else if(arg == "--fields")
+	    show_fields = true;
+	else if(arg == "--builtin") {
+	    library = false;
+	    builtin = true;
+	}
+	else if(arg == "--compare")
+	    library = builtin = true;
+	else if(arg == "--zero-alloc")
+	    zero_alloc = true;
+	else if(arg == "--allow-sigar")
+	    allow_sigar = true;
+	else if(arg == "--manager")
+	    manager = true;
+	else if(arg == "--rule" && i + 1 < argc) {
+	    manager = true;
+	    rules.push_back(argv[++i]);
+	}
+	else if(arg[0] == '-') {
+	    usage();
+	    return 2;
+	}
+	else
+	    plugins.push_back(arg);
+    }
+    if(ticks <= 0) {
+	usage();
+	return 2;
+    }
+    if(builtin && !builtin_plugins_enabled()) {
+	cerr << "cavecanem_bench was built without CAVECANEM_BUILTIN_PLUGINS" << endl;
+	return 2;
+    }
+    if(zero_alloc && !allocations_counted) {
+	cerr << "cavecanem_bench cannot count allocations on this platform" << endl;
+	return 2;
+    }
+
+    if(plugins.empty()) {
+	const char *defaults[] = {"cpu", "memory", "disk", "net_load", "proc",
+				  "proc_stat", "host_info", NULL};
+	for(int i = 0; defaults[i] != NULL; i++)
+	    plugins.push_back(defaults[i]);
+    }
+
+    syscall_counter syscalls;
+    printf("%-12s %-8s %10s %12s %12s %10s %10s %10s %10s %10s\n",
+	   "plugin", "loader", "load us", "ns/tick", "ns/sample", "samples", "members", "bytes",
+	   "allocs", syscalls.source());
+
+    int failed = 0;
+    bool allocated;
+    for(size_t i = 0; i < plugins.size(); i++) {
+	bool exempt = allow_sigar && allocations_exempt(plugins[i], !procfs_root.empty());
+	for(int pass = 0; pass < 2; pass++) {
+	    bool use_builtin = (pass == 1);
+	    if(use_builtin ? !builtin : !library)
+		continue;
+	    const char *loader = use_builtin ? " (builtin)" : "";
+	    if(!bench_plugin(dir, plugins[i], procfs_root, use_builtin, manager, rules,
+			     warmup, ticks, show_fields, syscalls, allocated)) {
+		cerr << plugins[i] << ": not benchmarked" << loader << endl;
+		failed++;
+	    }
+	    else if(zero_alloc && allocated && exempt) {
+		cerr << plugins[i] << ": allocates inside sigar, exempt" << loader << endl;
+	    }
+	    else if(zero_alloc && allocated) {
+		cerr << plugins[i] << ": allocates in steady state" << loader << endl;
+		failed++;
+	    }
+	}
+    }
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,594 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Regression checks of the agent components that can be driven without a
+ * DDS participant. Every check prints "ok" or what went wrong.
+ *
+ *   cavecanem_check [check ...]
+ *
+ * With no arguments all the checks are run. The exit status is 1 when any
+ * of them fails.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <ndds/ndds_cpp.h>
+
+#include "plugin.hpp"
+#include "egress_shaper.hpp"
+#include "burst_mode.hpp"
+#include "config_cache.hpp"
+#include "plugin_reaper.hpp"
+#include "self_telemetry.hpp"
+
+using namespace std;
+
+/**
+ * @brief Type of the samples the checks write: a key and a sequence number.
+ */
+static DDS_TypeCode *create_check_type_code()
+{
+    DDS_TypeCodeFactory *factory = DDS_TypeCodeFactory::get_instance();
+    DDS_ExceptionCode_t ex;
+    DDS_StructMemberSeq members;
+
+    DDS_TypeCode *type_code = factory->create_struct_tc("cavecanem_check", members, ex);
+    if(ex != DDS_NO_EXCEPTION_CODE)
+	return NULL;
+    type_code->add_member("id", DDS_TYPECODE_MEMBER_ID_INVALID,
+			  factory->get_primitive_tc(DDS_TK_LONG),
+			  DDS_TYPECODE_KEY_MEMBER, ex);
+    type_code->add_member("seq", DDS_TYPECODE_MEMBER_ID_INVALID,
+			  factory->get_primitive_tc(DDS_TK_LONGLONG),
+			  DDS_TYPECODE_NONKEY_MEMBER, ex);
+    if(ex != DDS_NO_EXCEPTION_CODE) {
+	factory->delete_tc(type_code, ex);
+	return NULL;
+    }
+    return type_code;
+}
+
+/*
+ * egress: samples keep their source timestamp across the growth of the
+ * queue of their plugin (the ring starts at 16 samples), and come back
+ * with the index the plugin is bound to.
+ */
+static bool check_egress(string &error)
+{
+    const int queued = 40;
+    const size_t bound = 3;
+    DDS_TypeCode *type_code = create_check_type_code();
+    if(type_code == NULL) {
+	error = "cannot create the typecode";
+	return false;
+    }
+
+    bool passed = true;
+    {
+	egress_shaper shaper;
+	shaper.configure(0, 0, 1000, 0, queued, 1);
+	//A limit high enough not to hold anything back, so that it is queued
+	shaper.add_plugin("check", NULL, type_code, 1e9, 0, 0);
+	shaper.bind_plugin(bound, "check");
+
+	DDS_DynamicData data(type_code, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+	data.set_long("id", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, 1);
+	for(int i = 0; i < queued; i++) {
+	    data.set_longlong("seq", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, i);
+	    shaper.enqueue(bound, data, 1, 1000 + i);
+	}
+
+	string plugin_name;
+	size_t plugin_index;
+	DDSDynamicDataWriter *writer;
+	long long waited_ns;
+	unsigned long long timestamp;
+	int released = 0;
+	DDS_DynamicData *sample;
+	while((sample = shaper.next(2, plugin_name, plugin_index, writer,
+				    waited_ns, timestamp)) != NULL) {
+	    DDS_LongLong seq = -1;
+	    sample->get_longlong(seq, "seq", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	    if(seq != released || timestamp != (unsigned long long) (1000 + released) ||
+	       plugin_index != bound) {
+		ostringstream message;
+		message << "sample " << released << " released as " << seq
+			<< " with timestamp " << timestamp << " for index " << plugin_index;
+		error = message.str();
+		passed = false;
+		break;
+	    }
+	    released++;
+	}
+	if(passed && released != queued) {
+	    ostringstream message;
+	    message << released << " samples released out of " << queued;
+	    error = message.str();
+	    passed = false;
+	}
+    }
+
+    DDS_ExceptionCode_t ex;
+    DDS_TypeCodeFactory::get_instance()->delete_tc(type_code, ex);
+    return passed;
+}
+
+/*
+ * unload: destroying a plugin, as plugin_manager::unload_plugin() does,
+ * runs the destructor of its class, which closes what it holds.
+ */
+class descriptor_plugin : public cc_plugin {
+public:
+    descriptor_plugin() : fd_(open("/dev/null", O_RDONLY)) {}
+    ~descriptor_plugin()
+    {
+	if(fd_ >= 0)
+	    close(fd_);
+    }
+
+    std::string plugin_class()
+    {
+	return "descriptor";
+    }
+
+    bool generate_and_publish_information(DDSDynamicDataWriter *writer,
+					  DDS_DynamicData *data)
+    {
+	return true;
+    }
+
+    int wakeup_descriptor()
+    {
+	return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+static bool check_unload(string &error)
+{
+    cc_plugin *plugin = new descriptor_plugin();
+    int fd = plugin->wakeup_descriptor();
+    if(fd < 0) {
+	error = string("cannot open /dev/null: ") + strerror(errno);
+	delete plugin;
+	return false;
+    }
+
+    plugin->destroy_plugin();
+    if(fcntl(fd, F_GETFD) != -1 || errno != EBADF) {
+	ostringstream message;
+	message << "descriptor " << fd << " still open after destroy_plugin()";
+	error = message.str();
+	close(fd);
+	return false;
+    }
+    return true;
+}
+
+/*
+ * reaper: a plugin whose destructor takes long is torn down while the loop
+ * goes on, so that a plugin due meanwhile still runs on time.
+ */
+class slow_plugin : public cc_plugin {
+public:
+    slow_plugin(int *destroyed) : destroyed_(destroyed) {}
+    ~slow_plugin()
+    {
+	usleep(300000);
+	__sync_fetch_and_add(destroyed_, 1);
+    }
+
+    std::string plugin_class()
+    {
+	return "slow";
+    }
+
+    bool generate_and_publish_information(DDSDynamicDataWriter *writer,
+					  DDS_DynamicData *data)
+    {
+	return true;
+    }
+
+private:
+    int *destroyed_;
+};
+
+static bool check_reaper(string &error)
+{
+    const long long ms = 1000000LL;
+    int destroyed = 0;
+    ostringstream message;
+
+    plugin_reaper reaper;
+    reaper_job job;
+    job.plugin_name = "slow";
+    job.participant = NULL;
+    job.publisher = NULL;
+    job.writer = NULL;
+    job.data = NULL;
+    job.type_support = NULL;
+    job.plugin = new slow_plugin(&destroyed);
+    job.library = NULL;
+
+    //What serve_until() does: the plugin is handed over, then the loop
+    //sleeps until the next plugin is due
+    long long start = self_telemetry::now_ns();
+    long long due = start + 20 * ms;
+    reaper.hand_over(job);
+    long long handed = self_telemetry::now_ns();
+    while(self_telemetry::now_ns() < due)
+	usleep(1000);
+    long long late = self_telemetry::now_ns() - due;
+    bool overlapped = __sync_fetch_and_add(&destroyed, 0) == 0;
+
+    if(handed - start > 5 * ms)
+	message << "handing the plugin over took " << (handed - start) / 1e6 << " ms; ";
+    if(late > 10 * ms)
+	message << "the due plugin ran " << late / 1e6 << " ms late; ";
+    if(!overlapped)
+	message << "the plugin was destroyed before the due plugin ran; ";
+
+    //The reaper tells when it is done through its descriptor
+    struct pollfd pfd;
+    pfd.fd = reaper.descriptor();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if(pfd.fd < 0 || poll(&pfd, 1, 2000) != 1)
+	message << "the reaper did not report the teardown; ";
+    vector<reaper_job> jobs;
+    reaper.finished(jobs);
+    if(jobs.size() != 1 || jobs[0].plugin_name != "slow")
+	message << jobs.size() << " plugins torn down; ";
+    else if(jobs[0].done_ns - jobs[0].handed_ns < 300 * ms)
+	message << "teardown took " << (jobs[0].done_ns - jobs[0].handed_ns) / 1e6 << " ms; ";
+    if(__sync_fetch_and_add(&destroyed, 0) != 1)
+	message << "the plugin was not destroyed; ";
+
+    error = message.str();
+    return error.empty();
+}
+
+/*
+ * burst: a trigger overlapping the burst of a plugin reports the plugin
+ * again when it makes its period shorter, and only then.
+ */
+static bool check_burst(string &error)
+{
+    const long long second = 1000000000LL;
+    list<string> cpu;
+    cpu.push_back("cpu");
+    list<string> cpu_disk(cpu);
+    cpu_disk.push_back("disk");
+
+    burst_mode bursts;
+    bursts.add_trigger("slow", "", 1, 1000, 10, cpu);
+    bursts.add_trigger("fast", "", 1, 100, 10, cpu_disk);
+    bursts.add_trigger("medium", "", 1, 500, 10, cpu);
+    const size_t cpu_index = 0, disk_index = 1;
+    bursts.bind_plugin(cpu_index, "cpu");
+
+    cc_alert alert;
+    alert.severity = 2;
+    vector<string> started;
+    ostringstream message;
+
+    alert.rule = "slow";
+    bursts.trigger("check", alert, 0, started);
+    if(started.size() != 1 || started[0] != "cpu")
+	message << "first trigger started " << started.size() << " plugins; ";
+
+    alert.rule = "fast";
+    bursts.trigger("check", alert, 1 * second, started);
+    if(started.size() != 2 || started[0] != "cpu" || started[1] != "disk")
+	message << "shorter overlapping trigger started " << started.size() << " plugins; ";
+    if(bursts.period_ns(cpu_index) != 100000000LL)
+	message << "cpu runs every " << bursts.period_ns(cpu_index) << " ns; ";
+    bursts.bind_plugin(disk_index, "disk");
+    if(bursts.period_ns(disk_index) != 100000000LL)
+	message << "disk, bound in burst, runs every " << bursts.period_ns(disk_index) << " ns; ";
+
+    alert.rule = "medium";
+    bursts.trigger("check", alert, 2 * second, started);
+    if(!started.empty() || bursts.period_ns(cpu_index) != 100000000LL)
+	message << "longer overlapping trigger changed the period of cpu; ";
+
+    vector<string> ended;
+    bursts.expire(12 * second, ended);
+    if(ended.size() != 2 || bursts.active())
+	message << ended.size() << " bursts ended after the windows; ";
+    if(bursts.period_ns(cpu_index) != 0 || bursts.period_ns(disk_index) != 0)
+	message << "periods still fast after the windows; ";
+
+    error = message.str();
+    return error.empty();
+}
+
+/*
+ * config_cache: every general and plugin property written to the cache is
+ * read back as it was.
+ */
+template<class T>
+static void compare(ostringstream &message, const char *field,
+		    const T &stored, const T &loaded)
+{
+    if(!(stored == loaded))
+	message << field << " changed; ";
+}
+
+static bool check_config_cache(string &error)
+{
+    char source[] = "/tmp/cavecanem_check.XXXXXX";
+    int fd = mkstemp(source);
+    if(fd < 0 || write(fd, "<cavecanem/>", 12) != 12) {
+	error = string("cannot write a configuration file: ") + strerror(errno);
+	if(fd >= 0) {
+	    close(fd);
+	    unlink(source);
+	}
+	return false;
+    }
+    close(fd);
+    string cache = string(source) + ".cache";
+
+    cc_general_properties general;
+    general.publishing_period = 7;
+    general.self_telemetry_period = 30;
+    general.domain_id = 12;
+    general.qos_file = "qos.xml";
+    general.qos_library = "library";
+    general.qos_profile = "profile";
+    general.alert_qos_profile = "alerts";
+    general.sink.kind = "mmap";
+    general.sink.path = "/var/tmp/sink";
+    general.sink.size_kb = 512;
+    general.latest_values.name = "/latest";
+    general.latest_values.slots = 64;
+    general.latest_values.slot_size = 256;
+    general.latest_values.expire_sec = 90;
+    general.spool.dir = "/var/tmp/spool";
+    general.spool.size_mb = 16;
+    general.spool.drain_per_sec = 200;
+    general.egress.enabled = true;
+    general.egress.samples_per_sec = 1000.5;
+    general.egress.bytes_per_sec = 65536;
+    general.egress.burst_ms = 250;
+    general.egress.spread = 0.75;
+    general.egress.max_queue = 128;
+    cc_egress_limit limit;
+    limit.plugin = "cpu";
+    limit.samples_per_sec = 10;
+    limit.bytes_per_sec = 2048;
+    limit.spread = 0.5;
+    general.egress.limits.push_back(limit);
+    general.cpu_budget.percent = 2.5;
+    general.cpu_budget.window_sec = 60;
+    general.cpu_budget.max_stretch = 4;
+    general.control_socket = "/run/cavecanem.sock";
+    general.startup_threads = 3;
+    general.latency_probe = true;
+    general.plugin_list_map["plugins"].push_back("cpu");
+    cc_rule_definition rule;
+    rule.name = "busy";
+    rule.severity = 3;
+    rule.expression = "cpu.usage > 90";
+    general.rules.push_back(rule);
+    cc_burst_definition burst;
+    burst.alert = "busy";
+    burst.source = "cpu";
+    burst.severity = 2;
+    burst.period_ms = 100;
+    burst.duration_sec = 20;
+    burst.plugins.push_back("cpu");
+    general.bursts.push_back(burst);
+
+    map<string, cc_plugin_properties> plugins;
+    cc_plugin_properties &plugin = plugins["cpu"];
+    plugin.dll = "libcpu.so";
+    plugin.create_function = "create_cpu";
+    plugin.publishing_period = 5;
+    plugin.qos_profile = "cpu_profile";
+    plugin.qos_library = "cpu_library";
+    plugin.topic_name = "cpu_topic";
+    plugin.plugin_config["interval"] = "1";
+    cc_anomaly_definition detector;
+    detector.member = "usage";
+    detector.method = "ewma";
+    detector.alpha = 0.25;
+    detector.window = 30;
+    detector.threshold = 3.5;
+    detector.warmup = 10;
+    detector.severity = 2;
+    plugin.anomaly_detectors.push_back(detector);
+    plugin.datawriter_qos = NULL;
+    plugin.type_code = create_check_type_code();
+    if(plugin.type_code == NULL) {
+	unlink(source);
+	error = "cannot create the typecode";
+	return false;
+    }
+
+    ostringstream message;
+    cc_general_properties loaded_general;
+    map<string, cc_plugin_properties> loaded_plugins;
+    vector<string> sources(1, source);
+    string store_error;
+    if(!store_config_cache(cache, sources, general, plugins, store_error))
+	message << "not written: " << store_error;
+    else if(!load_config_cache(cache, source, loaded_general, loaded_plugins))
+	message << "not read back";
+    else if(loaded_plugins.size() != 1 || loaded_plugins.count("cpu") == 0)
+	message << loaded_plugins.size() << " plugins read back";
+    else {
+	const cc_general_properties &g = loaded_general;
+	compare(message, "publishing_period", general.publishing_period, g.publishing_period);
+	compare(message, "self_telemetry_period", general.self_telemetry_period, g.self_telemetry_period);
+	compare(message, "domain_id", general.domain_id, g.domain_id);
+	compare(message, "qos_file", general.qos_file, g.qos_file);
+	compare(message, "qos_library", general.qos_library, g.qos_library);
+	compare(message, "qos_profile", general.qos_profile, g.qos_profile);
+	compare(message, "alert_qos_profile", general.alert_qos_profile, g.alert_qos_profile);
+	compare(message, "sink.kind", general.sink.kind, g.sink.kind);
+	compare(message, "sink.path", general.sink.path, g.sink.path);
+	compare(message, "sink.size_kb", general.sink.size_kb, g.sink.size_kb);
+	compare(message, "latest_values.name", general.latest_values.name, g.latest_values.name);
+	compare(message, "latest_values.slots", general.latest_values.slots, g.latest_values.slots);
+	compare(message, "latest_values.slot_size", general.latest_values.slot_size, g.latest_values.slot_size);
+	compare(message, "latest_values.expire_sec", general.latest_values.expire_sec, g.latest_values.expire_sec);
+	compare(message, "spool.dir", general.spool.dir, g.spool.dir);
+	compare(message, "spool.size_mb", general.spool.size_mb, g.spool.size_mb);
+	compare(message, "spool.drain_per_sec", general.spool.drain_per_sec, g.spool.drain_per_sec);
+	compare(message, "egress.enabled", general.egress.enabled, g.egress.enabled);
+	compare(message, "egress.samples_per_sec", general.egress.samples_per_sec, g.egress.samples_per_sec);
+	compare(message, "egress.bytes_per_sec", general.egress.bytes_per_sec, g.egress.bytes_per_sec);
+	compare(message, "egress.burst_ms", general.egress.burst_ms, g.egress.burst_ms);
+	compare(message, "egress.spread", general.egress.spread, g.egress.spread);
+	compare(message, "egress.max_queue", general.egress.max_queue, g.egress.max_queue);
+	if(g.egress.limits.size() != 1)
+	    message << "egress.limits changed; ";
+	else {
+	    const cc_egress_limit &l = g.egress.limits.front();
+	    compare(message, "egress.limits.plugin", limit.plugin, l.plugin);
+	    compare(message, "egress.limits.samples_per_sec", limit.samples_per_sec, l.samples_per_sec);
+	    compare(message, "egress.limits.bytes_per_sec", limit.bytes_per_sec, l.bytes_per_sec);
+	    compare(message, "egress.limits.spread", limit.spread, l.spread);
+	}
+	compare(message, "cpu_budget.percent", general.cpu_budget.percent, g.cpu_budget.percent);
+	compare(message, "cpu_budget.window_sec", general.cpu_budget.window_sec, g.cpu_budget.window_sec);
+	compare(message, "cpu_budget.max_stretch", general.cpu_budget.max_stretch, g.cpu_budget.max_stretch);
+	compare(message, "control_socket", general.control_socket, g.control_socket);
+	compare(message, "startup_threads", general.startup_threads, g.startup_threads);
+	compare(message, "latency_probe", general.latency_probe, g.latency_probe);
+	compare(message, "plugin_list_map", general.plugin_list_map, g.plugin_list_map);
+	if(g.rules.size() != 1)
+	    message << "rules changed; ";
+	else {
+	    const cc_rule_definition &r = g.rules.front();
+	    compare(message, "rules.name", rule.name, r.name);
+	    compare(message, "rules.severity", rule.severity, r.severity);
+	    compare(message, "rules.expression", rule.expression, r.expression);
+	}
+	if(g.bursts.size() != 1)
+	    message << "bursts changed; ";
+	else {
+	    const cc_burst_definition &b = g.bursts.front();
+	    compare(message, "bursts.alert", burst.alert, b.alert);
+	    compare(message, "bursts.source", burst.source, b.source);
+	    compare(message, "bursts.severity", burst.severity, b.severity);
+	    compare(message, "bursts.period_ms", burst.period_ms, b.period_ms);
+	    compare(message, "bursts.duration_sec", burst.duration_sec, b.duration_sec);
+	    compare(message, "bursts.plugins", burst.plugins, b.plugins);
+	}
+
+	const cc_plugin_properties &p = loaded_plugins["cpu"];
+	compare(message, "dll", plugin.dll, p.dll);
+	compare(message, "create_function", plugin.create_function, p.create_function);
+	compare(message, "plugin publishing_period", plugin.publishing_period, p.publishing_period);
+	compare(message, "plugin qos_profile", plugin.qos_profile, p.qos_profile);
+	compare(message, "plugin qos_library", plugin.qos_library, p.qos_library);
+	compare(message, "topic_name", plugin.topic_name, p.topic_name);
+	compare(message, "plugin_config", plugin.plugin_config, p.plugin_config);
+	if(p.anomaly_detectors.size() != 1)
+	    message << "anomaly_detectors changed; ";
+	else {
+	    const cc_anomaly_definition &d = p.anomaly_detectors.front();
+	    compare(message, "detector member", detector.member, d.member);
+	    compare(message, "detector method", detector.method, d.method);
+	    compare(message, "detector alpha", detector.alpha, d.alpha);
+	    compare(message, "detector window", detector.window, d.window);
+	    compare(message, "detector threshold", detector.threshold, d.threshold);
+	    compare(message, "detector warmup", detector.warmup, d.warmup);
+	    compare(message, "detector severity", detector.severity, d.severity);
+	}
+	if(p.datawriter_qos != NULL)
+	    message << "datawriter_qos changed; ";
+	DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+	if(p.type_code == NULL || !plugin.type_code->equal(p.type_code, ex) ||
+	   ex != DDS_NO_EXCEPTION_CODE)
+	    message << "type_code changed; ";
+	if(p.type_code != NULL)
+	    DDS_TypeCodeFactory::get_instance()->delete_tc(p.type_code, ex);
+    }
+
+    DDS_ExceptionCode_t ex;
+    DDS_TypeCodeFactory::get_instance()->delete_tc(plugin.type_code, ex);
+    unlink(cache.c_str());
+    unlink(source);
+    error = message.str();
+    return error.empty();
+}
+
+struct check {
+    const char *name;
+    bool (*run)(string &error);
+};
+
+static const check checks[] = {
+    {"egress", check_egress},
+    {"unload", check_unload},
+    {"reaper", check_reaper},
+    {"burst", check_burst},
+    {"config_cache", check_config_cache}
+};
+
+int main(int argc, char *argv[])
+{
+    const size_t count = sizeof(checks) / sizeof(checks[0]);
+    vector<const check *> selected;
+    for(int i = 1; i < argc; i++) {
+	size_t k = 0;
+	while(k < count && strcmp(checks[k].name, argv[i]) != 0)
+	    k++;
+	if(k == count) {
+	    cerr << "unknown check " << argv[i] << "; available:";
+	    for(k = 0; k < count; k++)
+		cerr << " " << checks[k].name;
+	    cerr << endl;
+	    return 2;
+	}
+	selected.push_back(&checks[k]);
+    }
+    if(selected.empty())
+	for(size_t k = 0; k < count; k++)
+	    selected.push_back(&checks[k]);
+
+    int failed = 0;
+    for(size_t i = 0; i < selected.size(); i++) {
+	string error;
+	bool passed = selected[i]->run(error);
+	cout << selected[i]->name << ": " << (passed ? "ok" : error) << endl;
+	if(!passed)
+	    failed++;
+    }
+    return failed > 0 ? 1 : 0;
+}
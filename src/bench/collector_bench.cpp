@@ -0,0 +1,221 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmark of the ingestion path of cavecanem_collector (the
+ * queues, workers and latest-state tables of ingest_pipeline), without
+ * DDS. Producer threads stand for the ingest threads: they shard synthetic
+ * samples of a fleet by hostname and hand them to the workers, which keep
+ * the latest sample of every instance.
+ *
+ *   collector_bench [--producers N] [--workers N] [--hosts N] [--instances N]
+ *                   [--topics N] [--payload BYTES] [--seconds SEC]
+ *                   [--queue SLOTS] [--target SAMPLES_PER_SEC]
+ *
+ * The exit status is 1 when the measured rate is below the target
+ * (1M samples/s by default). End to end, with DDS, run cavecanem_collector
+ * against cavecanem_loadgen --rate 0 (or cavecanem_replay --max): the
+ * collector prints the rate it ingests every interval.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <time.h>
+#include <pthread.h>
+
+#include "ingest_pipeline.hpp"
+
+using namespace std;
+
+static volatile bool quit = false;
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @class bench_producer
+ * A producer thread and the fleet it publishes.
+ */
+struct bench_producer {
+    pthread_t thread;
+    ingest_pipeline *pipeline;
+    size_t index;
+    vector<unsigned long long> host_hashes;
+    size_t instances;
+    size_t topics;
+    vector<char> payload;
+    unsigned long long published;
+};
+
+static void *produce(void *arg)
+{
+    bench_producer &self = *(bench_producer *) arg;
+    ingest_pipeline &pipeline = *self.pipeline;
+    long long source_ns = ingest_pipeline::realtime_ns();
+    unsigned long long published = 0;
+
+    while(!quit) {
+	long long reception_ns = ingest_pipeline::realtime_ns();
+	for(size_t h = 0; h < self.host_hashes.size() && !quit; h++) {
+	    unsigned long long host_hash = self.host_hashes[h];
+	    size_t worker = pipeline.worker_of(host_hash);
+	    for(size_t t = 0; t < self.topics; t++)
+		for(size_t i = 0; i < self.instances; i++) {
+		    collected_sample *sample = pipeline.claim(self.index, worker);
+		    if(sample == NULL)
+			break;
+		    sample->topic = t;
+		    sample->key = (host_hash ^ (i * 0x9E3779B97F4A7C15ULL)) | 1;
+		    sample->host_hash = host_hash;
+		    sample->source_ns = source_ns;
+		    sample->reception_ns = reception_ns;
+		    sample->payload.assign(self.payload.begin(), self.payload.end());
+		    pipeline.publish(self.index, worker);
+		    published++;
+		}
+	}
+	source_ns += 1000000000LL;
+    }
+    self.published = published;
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t producers = 2;
+    size_t workers = 4;
+    size_t hosts = 10000;
+    size_t instances = 8;
+    size_t topics = 7;
+    size_t payload = 300;
+    double seconds = 5;
+    size_t queue = 4096;
+    double target = 1000000.0;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--producers" && i + 1 < argc)
+	    producers = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--workers" && i + 1 < argc)
+	    workers = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--hosts" && i + 1 < argc)
+	    hosts = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--instances" && i + 1 < argc)
+	    instances = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--topics" && i + 1 < argc)
+	    topics = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--payload" && i + 1 < argc)
+	    payload = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--seconds" && i + 1 < argc)
+	    seconds = atof(argv[++i]);
+	else if(arg == "--queue" && i + 1 < argc)
+	    queue = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--target" && i + 1 < argc)
+	    target = atof(argv[++i]);
+	else {
+	    cerr << "usage: " << argv[0]
+		 << " [--producers N] [--workers N] [--hosts N] [--instances N]" << endl
+		 << "       [--topics N] [--payload BYTES] [--seconds SEC]" << endl
+		 << "       [--queue SLOTS] [--target SAMPLES_PER_SEC]" << endl;
+	    return 2;
+	}
+    }
+    if(producers == 0 || workers == 0 || hosts < producers || instances == 0 || topics == 0) {
+	cerr << "invalid arguments" << endl;
+	return 2;
+    }
+
+    ingest_pipeline pipeline(producers, workers, topics, queue);
+    if(!pipeline.start(0))
+	return 2;
+
+    vector<bench_producer> pool(producers);
+    for(size_t p = 0; p < producers; p++) {
+	pool[p].pipeline = &pipeline;
+	pool[p].index = p;
+	pool[p].instances = instances;
+	pool[p].topics = topics;
+	pool[p].payload.assign(payload, 'x');
+	pool[p].published = 0;
+    }
+    for(size_t h = 0; h < hosts; h++) {
+	char hostname[32];
+	snprintf(hostname, sizeof(hostname), "loadgen-%06u", (unsigned) h + 1);
+	pool[h % producers].host_hashes.push_back(ingest_pipeline::hash_hostname(hostname));
+    }
+
+    double start = now_sec();
+    for(size_t p = 0; p < producers; p++)
+	if(pthread_create(&pool[p].thread, NULL, produce, &pool[p]) != 0) {
+	    cerr << "cannot create producer " << p << endl;
+	    return 2;
+	}
+
+    //Let the tables fill before measuring
+    struct timespec warmup = {1, 0};
+    nanosleep(&warmup, NULL);
+    unsigned long long first = pipeline.processed();
+    double measure_start = now_sec();
+    struct timespec pause = {0, 0};
+    pause.tv_sec = (time_t) seconds;
+    pause.tv_nsec = (long) ((seconds - pause.tv_sec) * 1e9);
+    nanosleep(&pause, NULL);
+    unsigned long long last = pipeline.processed();
+    double elapsed = now_sec() - measure_start;
+
+    quit = true;
+    for(size_t p = 0; p < producers; p++)
+	pthread_join(pool[p].thread, NULL);
+    pipeline.stop();
+
+    unsigned long long published = 0;
+    for(size_t p = 0; p < producers; p++)
+	published += pool[p].published;
+    size_t stored = 0;
+    for(size_t t = 0; t < topics; t++)
+	stored += pipeline.instances(t);
+
+    double rate = (last - first) / elapsed;
+    printf("producers=%u workers=%u hosts=%u instances=%u payload=%u "
+	   "rate=%.0f samples/s (%.1f ns/sample) stalls=%llu stored=%u/%u\n",
+	   (unsigned) producers, (unsigned) workers, (unsigned) hosts,
+	   (unsigned) (instances * topics), (unsigned) payload,
+	   rate, 1e9 / (rate > 0 ? rate : 1), pipeline.stalls(),
+	   (unsigned) stored, (unsigned) (hosts * instances * topics));
+
+    if(pipeline.processed() != published) {
+	cerr << "published " << published << " samples, stored " << pipeline.processed() << endl;
+	return 1;
+    }
+    if(rate < target) {
+	printf("below target of %.0f samples/s (%.1f s in total)\n", target, now_sec() - start);
+	return 1;
+    }
+    return 0;
+}
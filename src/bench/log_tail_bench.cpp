@@ -0,0 +1,166 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmark of the log_tail ingestion path (file_tailer and
+ * log_parser), without DDS. It writes a synthetic log, follows it from the
+ * beginning and parses every line, reporting lines per second on one core.
+ *
+ *   log_tail_bench [--lines N] [--parser raw|csv|kv|regex] [--target LINES_PER_SEC]
+ *
+ * The exit status is 1 when the measured rate is below the target
+ * (1M lines/s by default).
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <map>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "file_tailer.hpp"
+#include "log_parser.hpp"
+
+using namespace std;
+
+class counting_handler : public tail_handler {
+public:
+    counting_handler(log_parser *parser) : parser_(parser), lines_(0), fields_count_(0) {}
+
+    void begin_file(const tailed_file &file) {}
+    void line(const tailed_file &file, const char *line, size_t len, off_t offset)
+    {
+	fields_count_ += parser_->parse(line, len, fields_);
+	lines_++;
+    }
+    void end_file(const tailed_file &file) {}
+
+    log_parser *parser_;
+    vector<log_field> fields_;
+    unsigned long long lines_;
+    unsigned long long fields_count_;
+};
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void write_line(FILE *file, const string &parser, unsigned long i)
+{
+    if(parser == "csv")
+	fprintf(file, "%lu,2013-05-01T10:00:%02lu,sshd,\"Accepted publickey for user%lu\",10.0.%lu.%lu\n",
+		i, i % 60, i % 100, (i / 256) % 256, i % 256);
+    else if(parser == "regex")
+	fprintf(file, "May  1 10:00:%02lu host sshd[%lu]: Accepted publickey for user%lu from 10.0.%lu.%lu\n",
+		i % 60, 1000 + i % 30000, i % 100, (i / 256) % 256, i % 256);
+    else
+	fprintf(file, "type=SYSCALL msg=audit(1367402400.%03lu:%lu): arch=c000003e syscall=59 success=yes "
+		"exit=0 pid=%lu uid=0 comm=\"bash\" exe=\"/bin/bash\"\n",
+		i % 1000, i, 1000 + i % 30000);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long lines = 2000000;
+    string kind = "kv";
+    double target = 1000000.0;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--lines" && i + 1 < argc)
+	    lines = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--parser" && i + 1 < argc)
+	    kind = argv[++i];
+	else if(arg == "--target" && i + 1 < argc)
+	    target = atof(argv[++i]);
+	else {
+	    cerr << "usage: " << argv[0]
+		 << " [--lines N] [--parser raw|csv|kv|regex] [--target LINES_PER_SEC]" << endl;
+	    return 2;
+	}
+    }
+
+    map<string, string> options;
+    if(kind == "csv")
+	options["fields"] = "id,time,program,message,address";
+    else if(kind == "regex") {
+	options["pattern"] = "^([A-Z][a-z]{2} +[0-9]+ [0-9:]+) ([^ ]+) ([^:[]+)(\\[([0-9]+)\\])?: (.*)$";
+	options["fields"] = "time,host,program,,pid,message";
+    }
+
+    string error;
+    log_parser *parser = log_parser::create(kind, options, error);
+    if(parser == NULL) {
+	cerr << error << endl;
+	return 2;
+    }
+
+    char dir[] = "/tmp/log_tail_bench.XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+	perror("mkdtemp");
+	return 2;
+    }
+    string path = string(dir) + "/bench.log";
+
+    FILE *file = fopen(path.c_str(), "w");
+    if(file == NULL) {
+	perror("fopen");
+	return 2;
+    }
+    for(unsigned long i = 0; i < lines; i++)
+	write_line(file, kind, i);
+    fclose(file);
+
+    file_tailer tailer;
+    tailer.add_glob(string(dir) + "/*.log", 0);
+    tailer.start(false);
+
+    counting_handler handler(parser);
+    double start = now_sec();
+    tailer.drain_events();
+    tailer.read_all(handler);
+    double elapsed = now_sec() - start;
+
+    double rate = handler.lines_ / elapsed;
+    printf("parser=%s lines=%llu fields=%llu elapsed=%.3fs rate=%.0f lines/s (%.1f ns/line)\n",
+	   kind.c_str(), handler.lines_, handler.fields_count_, elapsed, rate,
+	   elapsed * 1e9 / (handler.lines_ ? handler.lines_ : 1));
+
+    unlink(path.c_str());
+    rmdir(dir);
+    delete parser;
+
+    if(handler.lines_ != lines) {
+	cerr << "expected " << lines << " lines, read " << handler.lines_ << endl;
+	return 1;
+    }
+    if(rate < target) {
+	printf("below target of %.0f lines/s\n", target);
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generator of synthetic procfs trees, to measure the collection cost of
+ * the proc, net_load and disk plugins at sizes that are hard to reproduce
+ * on a real host. It writes
+ *
+ *   DIR/proc/stat                       boot time and cpu lines
+ *   DIR/proc/[pid]/{stat,statm,status,cmdline}
+ *   DIR/proc/net/dev                    lo plus eth0..ethN-2
+ *   DIR/proc/mounts                     pseudo file systems plus N ext4
+ *   DIR/sys/class/net/[if]/{mtu,address,flags}
+ *   DIR/mnt/volN                        mount directories (for statvfs)
+ *
+ * The content only depends on the options (the mounts file also holds the
+ * absolute path of DIR), so trees made with the same options are identical. Point the plugins to it with their procfs_root
+ * property, or with the --procfs option of cavecanem_bench:
+ *
+ *   procfs_fixture [--processes N] [--interfaces N] [--mounts N] [--seed S] DIR
+ *   cavecanem_bench --procfs DIR/proc proc net_load disk
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace std;
+
+static const char *process_names[] = {
+    "systemd", "kthreadd", "kworker/0:1", "sshd", "bash", "nginx", "postgres",
+    "java", "python3", "rsyslogd", "cron", "dbus-daemon", "containerd-shim",
+    "node", "redis-server", "(sd-pam)", "agetty", "chronyd", NULL
+};
+
+/**
+ * @brief Deterministic pseudo-random numbers (64-bit LCG), so that trees do
+ * not depend on the C library.
+ */
+class fixture_random {
+public:
+    fixture_random(unsigned long long seed) : state_(seed * 2862933555777941757ULL + 3037000493ULL) {}
+
+    unsigned long next(unsigned long bound)
+    {
+	state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+	return bound ? (unsigned long) ((state_ >> 33) % bound) : 0;
+    }
+
+private:
+    unsigned long long state_;
+};
+
+static bool make_dir(const string &path)
+{
+    if(mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+	cerr << "procfs_fixture: cannot create " << path << ": " << strerror(errno) << endl;
+	return false;
+    }
+    return true;
+}
+
+static bool write_file(const string &path, const char *content, size_t length)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if(file == NULL) {
+	cerr << "procfs_fixture: cannot write " << path << ": " << strerror(errno) << endl;
+	return false;
+    }
+    bool ok = fwrite(content, 1, length, file) == length;
+    return fclose(file) == 0 && ok;
+}
+
+static bool write_file(const string &path, const string &content)
+{
+    return write_file(path, content.data(), content.size());
+}
+
+/**
+ * @brief Writes the stat, statm, status and cmdline files of a process, with
+ * the layout of a 3.x kernel.
+ */
+static bool write_process(const string &proc_dir, unsigned long pid,
+			  fixture_random &random)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/%lu", pid);
+    string dir = proc_dir + path;
+    if(!make_dir(dir))
+	return false;
+
+    int kind = random.next(100);
+    const char *name = process_names[random.next(sizeof(process_names) / sizeof(process_names[0]) - 1)];
+    bool kernel = kind < 20;
+    if(kernel)
+	name = "kworker/0:1";
+    unsigned long ppid = pid == 1 ? 0 : (kernel ? 2 : 1 + random.next(pid - 1));
+    char state = "SSSSSSSRDZ"[random.next(10)];
+    unsigned int uid = kernel ? 0 : (kind < 50 ? 0 : 1000 + random.next(50));
+    unsigned int gid = uid;
+    unsigned long threads = kernel ? 1 : 1 + random.next(64);
+    unsigned long long vsize = kernel ? 0 : (4ULL + random.next(4096)) << 20;
+    unsigned long rss = kernel ? 0 : 64 + random.next(vsize >> 14);
+    unsigned long share = rss / 4;
+    unsigned long utime = random.next(1000000);
+    unsigned long stime = random.next(200000);
+    unsigned long starttime = random.next(100000000);
+    int processor = random.next(64);
+    int nice = kind < 90 ? 0 : (int) random.next(40) - 20;
+
+    char buffer[2048];
+    int length = snprintf(buffer, sizeof(buffer),
+			  "%lu (%s) %c %lu %lu %lu 0 -1 %u %lu 0 %lu 0 %lu %lu 0 0 %d %d %lu 0 %lu %llu %lu "
+			  "18446744073709551615 4194304 4238788 140736466511168 0 0 0 0 "
+			  "4096 16387 0 0 0 17 %d 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+			  pid, name, state, ppid, pid, pid, kernel ? 2129984u : 4202752u,
+			  random.next(1000000), random.next(100), utime, stime,
+			  20 + nice, nice, threads, starttime, vsize, rss, processor);
+    if(!write_file(dir + "/stat", buffer, length))
+	return false;
+
+    length = snprintf(buffer, sizeof(buffer), "%llu %lu %lu 1 0 %lu 0\n",
+		      vsize >> 12, rss, share, rss / 2);
+    if(!write_file(dir + "/statm", buffer, length))
+	return false;
+
+    length = snprintf(buffer, sizeof(buffer),
+		      "Name:\t%s\nState:\t%c\nTgid:\t%lu\nNgid:\t0\nPid:\t%lu\nPPid:\t%lu\n"
+		      "TracerPid:\t0\nUid:\t%u\t%u\t%u\t%u\nGid:\t%u\t%u\t%u\t%u\n"
+		      "FDSize:\t64\nGroups:\t%u\nVmPeak:\t%llu kB\nVmSize:\t%llu kB\n"
+		      "VmLck:\t0 kB\nVmPin:\t0 kB\nVmHWM:\t%lu kB\nVmRSS:\t%lu kB\n"
+		      "VmData:\t%llu kB\nVmStk:\t136 kB\nVmExe:\t44 kB\nVmLib:\t2116 kB\n"
+		      "VmPTE:\t60 kB\nVmSwap:\t0 kB\nThreads:\t%lu\nSigQ:\t0/63432\n"
+		      "SigPnd:\t0000000000000000\nShdPnd:\t0000000000000000\n"
+		      "SigBlk:\t0000000000000000\nSigIgn:\t0000000000001000\n"
+		      "SigCgt:\t0000000180004002\nCapInh:\t0000000000000000\n"
+		      "CapPrm:\t0000000000000000\nCapEff:\t0000000000000000\n"
+		      "CapBnd:\t0000001fffffffff\nCpus_allowed:\tffffffff,ffffffff\n"
+		      "Cpus_allowed_list:\t0-63\nMems_allowed:\t00000000,00000001\n"
+		      "Mems_allowed_list:\t0\nvoluntary_ctxt_switches:\t%lu\n"
+		      "nonvoluntary_ctxt_switches:\t%lu\n",
+		      name, state, pid, pid, ppid, uid, uid, uid, uid, gid, gid, gid, gid,
+		      gid, vsize >> 10, vsize >> 10, rss * 4, rss * 4, vsize >> 11,
+		      threads, random.next(100000), random.next(1000));
+    if(!write_file(dir + "/status", buffer, length))
+	return false;
+
+    //Kernel threads have an empty command line
+    length = 0;
+    if(!kernel)
+	length = snprintf(buffer, sizeof(buffer), "/usr/bin/%s%c--config%c/etc/%s/%lu.conf%c",
+			  name, 0, 0, name, pid, 0);
+    return write_file(dir + "/cmdline", buffer, length);
+}
+
+static bool write_interfaces(const string &root, unsigned long interfaces,
+			     fixture_random &random)
+{
+    string dev = "Inter-|   Receive                                                |  Transmit\n"
+	" face |bytes    packets errs drop fifo frame compressed multicast|"
+	"bytes    packets errs drop fifo colls carrier compressed\n";
+
+    if(!make_dir(root + "/sys") || !make_dir(root + "/sys/class") ||
+       !make_dir(root + "/sys/class/net"))
+	return false;
+
+    for(unsigned long i = 0; i < interfaces; i++) {
+	char name[32];
+	if(i == 0)
+	    strcpy(name, "lo");
+	else
+	    snprintf(name, sizeof(name), "eth%lu", i - 1);
+
+	unsigned long long rx_packets = random.next(1000000000);
+	unsigned long long tx_packets = random.next(1000000000);
+	char line[512];
+	snprintf(line, sizeof(line),
+		 "%6s: %llu %llu %lu %lu 0 0 0 %lu %llu %llu %lu %lu 0 %lu 0 0\n",
+		 name, rx_packets * 800, rx_packets, random.next(10), random.next(100),
+		 random.next(1000), tx_packets * 600, tx_packets, random.next(10),
+		 random.next(100), random.next(5));
+	dev += line;
+
+	string dir = root + "/sys/class/net/" + name;
+	if(!make_dir(dir))
+	    return false;
+	char value[64];
+	int length;
+	length = snprintf(value, sizeof(value), "%d\n", i == 0 ? 65536 : 1500);
+	if(!write_file(dir + "/mtu", value, length))
+	    return false;
+	length = snprintf(value, sizeof(value), "0x%x\n", i == 0 ? 0x9 : 0x1003);
+	if(!write_file(dir + "/flags", value, length))
+	    return false;
+	if(i == 0)
+	    length = snprintf(value, sizeof(value), "00:00:00:00:00:00\n");
+	else
+	    length = snprintf(value, sizeof(value), "52:54:00:%02lx:%02lx:%02lx\n",
+			      (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+	if(!write_file(dir + "/address", value, length))
+	    return false;
+    }
+
+    return write_file(root + "/proc/net/dev", dev);
+}
+
+/**
+ * @brief Escapes blanks and backslashes of a path as the kernel does in
+ * the mounts file.
+ */
+static string mount_escape(const string &path)
+{
+    string escaped;
+    for(size_t i = 0; i < path.size(); i++) {
+	if(path[i] == ' ' || path[i] == '\t' || path[i] == '\n' || path[i] == '\\') {
+	    char octal[8];
+	    snprintf(octal, sizeof(octal), "\\%03o", (unsigned char) path[i]);
+	    escaped += octal;
+	}
+	else {
+	    escaped += path[i];
+	}
+    }
+    return escaped;
+}
+
+static bool write_mounts(const string &root, unsigned long mounts)
+{
+    string escaped_root = mount_escape(root);
+
+    string content =
+	"sysfs /sys sysfs rw,nosuid,nodev,noexec,relatime 0 0\n"
+	"proc /proc proc rw,nosuid,nodev,noexec,relatime 0 0\n"
+	"udev /dev devtmpfs rw,relatime,size=8192k,mode=755 0 0\n"
+	"tmpfs /run tmpfs rw,nosuid,noexec,relatime,size=1638400k,mode=755 0 0\n"
+	"cgroup /sys/fs/cgroup/cpu cgroup rw,nosuid,nodev,noexec,relatime,cpu 0 0\n";
+
+    if(!make_dir(root + "/mnt"))
+	return false;
+
+    for(unsigned long i = 0; i < mounts; i++) {
+	char name[32];
+	snprintf(name, sizeof(name), "/mnt/vol%lu", i);
+	if(!make_dir(root + name))
+	    return false;
+
+	//Every tenth mount is remote
+	char line[PATH_MAX + 128];
+	if(i % 10 == 9)
+	    snprintf(line, sizeof(line), "nas:/export/vol%lu %s%s nfs4 rw,relatime,vers=4.0 0 0\n",
+		     i, escaped_root.c_str(), name);
+	else
+	    snprintf(line, sizeof(line), "/dev/sd%c%lu %s%s ext4 rw,relatime,data=ordered 0 0\n",
+		     (char) ('a' + (i / 15) % 26), 1 + i % 15, escaped_root.c_str(), name);
+	content += line;
+    }
+
+    return write_file(root + "/proc/mounts", content);
+}
+
+static void usage()
+{
+    cerr << "usage: procfs_fixture [--processes N] [--interfaces N] [--mounts N] [--seed S] DIR" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long processes = 1000;
+    unsigned long interfaces = 4;
+    unsigned long mounts = 8;
+    unsigned long long seed = 1;
+    string dir;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--processes" && i + 1 < argc)
+	    processes = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--interfaces" && i + 1 < argc)
+	    interfaces = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--mounts" && i + 1 < argc)
+	    mounts = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--seed" && i + 1 < argc)
+	    seed = strtoull(argv[++i], NULL, 10);
+	else if(arg[0] == '-' || !dir.empty()) {
+	    usage();
+	    return 2;
+	}
+	else
+	    dir = arg;
+    }
+    if(dir.empty() || interfaces == 0) {
+	usage();
+	return 2;
+    }
+
+    //Mount directories are written as absolute paths
+    if(!make_dir(dir))
+	return 1;
+    char resolved[PATH_MAX];
+    if(realpath(dir.c_str(), resolved) == NULL) {
+	cerr << "procfs_fixture: " << dir << ": " << strerror(errno) << endl;
+	return 1;
+    }
+    string root(resolved);
+    string proc_dir = root + "/proc";
+    if(!make_dir(proc_dir) || !make_dir(proc_dir + "/net"))
+	return 1;
+
+    char stat[512];
+    int length = snprintf(stat, sizeof(stat),
+			  "cpu  %llu 0 %llu %llu 0 0 0 0 0 0\n"
+			  "intr 0\nctxt 0\nbtime 1367402400\n"
+			  "processes %lu\nprocs_running 1\nprocs_blocked 0\n",
+			  seed * 1000, seed * 500, seed * 100000, processes);
+    if(!write_file(proc_dir + "/stat", stat, length))
+	return 1;
+
+    fixture_random random(seed);
+    for(unsigned long pid = 1; pid <= processes; pid++)
+	if(!write_process(proc_dir, pid, random))
+	    return 1;
+
+    if(!write_interfaces(root, interfaces, random) || !write_mounts(root, mounts))
+	return 1;
+
+    printf("%s: %lu processes, %lu interfaces, %lu mounts\n",
+	   proc_dir.c_str(), processes, interfaces, mounts);
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmark of signature_matcher. It builds a set of synthetic
+ * signatures (three literals for every regex, like a typical rule set) and
+ * matches synthetic syslog lines against them, a few of which hit.
+ *
+ *   signature_matcher_bench [--signatures N] [--lines N] [--file SIGNATURES]
+ *                           [--target LINES_PER_SEC]
+ *
+ *   signature_matcher_bench --verify [--rounds N]
+ *
+ * With --file the signatures are loaded from a signature file instead. The
+ * exit status is 1 when the measured rate is below the target (1M lines/s by
+ * default).
+ *
+ * With --verify the Aho-Corasick automaton is checked instead: random sets
+ * of short mixed-case patterns, single bytes included, are matched against
+ * random texts and every hit compared with a naive case-insensitive search.
+ * Small sets go through the anchor prefilter and large ones through the
+ * byte pair prefilter. The exit status is 1 on any difference.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <time.h>
+
+#include "signature_matcher.hpp"
+#include "aho_corasick.hpp"
+
+using namespace std;
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool hit_less(const ac_hit &a, const ac_hit &b)
+{
+    return a.end != b.end ? a.end < b.end : a.pattern < b.pattern;
+}
+
+static bool hit_equal(const ac_hit &a, const ac_hit &b)
+{
+    return a.end == b.end && a.pattern == b.pattern;
+}
+
+static char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/**
+ * @brief Every case-insensitive occurrence of the patterns in a text.
+ */
+static void naive_scan(const vector<string> &patterns, const string &text,
+		       vector<ac_hit> &hits)
+{
+    hits.clear();
+    for(size_t i = 0; i < patterns.size(); i++) {
+	const string &pattern = patterns[i];
+	for(size_t start = 0; start + pattern.size() <= text.size(); start++) {
+	    size_t k = 0;
+	    while(k < pattern.size() && fold(text[start + k]) == fold(pattern[k]))
+		k++;
+	    if(k == pattern.size()) {
+		ac_hit hit;
+		hit.pattern = (unsigned int) i;
+		hit.end = start + k;
+		hits.push_back(hit);
+	    }
+	}
+    }
+}
+
+/**
+ * @brief Cross-checks aho_corasick against naive_scan().
+ *
+ * Even rounds use a few patterns (anchor prefilter), odd rounds hundreds
+ * (byte pair prefilter). Patterns are 1 to 5 bytes long over an alphabet of
+ * both cases, digits and punctuation, and every text is scanned as a whole.
+ *
+ * @return The number of texts whose hits differ; -1 if either prefilter was
+ * never exercised.
+ */
+static long verify(unsigned long rounds)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJ_-:01 #@";
+    const size_t letters = sizeof(alphabet) - 1;
+    long differences = 0;
+    unsigned long anchor_rounds = 0;
+    unsigned long pair_rounds = 0;
+    vector<ac_hit> expected;
+    vector<ac_hit> found;
+
+    srand(1);
+    for(unsigned long round = 0; round < rounds; round++) {
+	aho_corasick automaton;
+	vector<string> patterns;
+	size_t count = round % 2 ? 400 : 5;
+	for(size_t i = 0; i < count; i++) {
+	    string pattern;
+	    size_t length = 1 + rand() % 5;
+	    for(size_t j = 0; j < length; j++)
+		pattern += alphabet[rand() % letters];
+	    patterns.push_back(pattern);
+	    automaton.add_pattern(pattern);
+	}
+	automaton.compile();
+	if(automaton.pair_prefilter_enabled())
+	    pair_rounds++;
+	else if(automaton.prefilter_enabled())
+	    anchor_rounds++;
+
+	for(int t = 0; t < 200; t++) {
+	    string text;
+	    size_t length = rand() % 40;
+	    for(size_t j = 0; j < length; j++)
+		text += alphabet[rand() % letters];
+
+	    naive_scan(patterns, text, expected);
+	    found.clear();
+	    automaton.scan(text.data(), text.size(), found);
+	    sort(expected.begin(), expected.end(), hit_less);
+	    sort(found.begin(), found.end(), hit_less);
+	    bool same = expected.size() == found.size() &&
+		equal(expected.begin(), expected.end(), found.begin(), hit_equal);
+	    if(!same || (!expected.empty() && !automaton.may_match(text.data(), text.size()))) {
+		if(differences == 0)
+		    cerr << "round " << round << ": \"" << text << "\" has "
+			 << expected.size() << " hits, found " << found.size() << endl;
+		differences++;
+	    }
+	}
+    }
+
+    printf("rounds=%lu anchor=%lu pair=%lu differences=%ld\n",
+	   rounds, anchor_rounds, pair_rounds, differences);
+    if(rounds >= 2 && (anchor_rounds == 0 || pair_rounds == 0))
+	return -1;
+    return differences;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long signatures = 3000;
+    unsigned long lines = 1000000;
+    string file;
+    double target = 1000000.0;
+    bool verifying = false;
+    unsigned long rounds = 300;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--signatures" && i + 1 < argc)
+	    signatures = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--lines" && i + 1 < argc)
+	    lines = strtoul(argv[++i], NULL, 10);
+	else if(arg == "--file" && i + 1 < argc)
+	    file = argv[++i];
+	else if(arg == "--target" && i + 1 < argc)
+	    target = atof(argv[++i]);
+	else if(arg == "--verify")
+	    verifying = true;
+	else if(arg == "--rounds" && i + 1 < argc)
+	    rounds = strtoul(argv[++i], NULL, 10);
+	else {
+	    cerr << "usage: " << argv[0] << " [--signatures N] [--lines N]"
+		 << " [--file SIGNATURES] [--target LINES_PER_SEC]" << endl
+		 << "       " << argv[0] << " --verify [--rounds N]" << endl;
+	    return 2;
+	}
+    }
+
+    if(verifying)
+	return verify(rounds) == 0 ? 0 : 1;
+
+    signature_matcher matcher;
+    string error;
+    char buffer[256];
+
+    if(!file.empty()) {
+	if(!matcher.load_file(file, error)) {
+	    cerr << error << endl;
+	    return 2;
+	}
+    }
+    else {
+	for(unsigned long i = 0; i < signatures; i++) {
+	    bool ok;
+	    if(i % 4 == 3) {
+		snprintf(buffer, sizeof(buffer), "exploit-%lu [0-9]+ attempt from [0-9.]+", i);
+		ok = matcher.add(buffer, 2, "re", buffer, error);
+	    }
+	    else {
+		snprintf(buffer, sizeof(buffer), "malware_%lu_payload", i * 7919);
+		ok = matcher.add(buffer, 1, i % 2 ? "ilit" : "lit", buffer, error);
+	    }
+	    if(!ok) {
+		cerr << error << endl;
+		return 2;
+	    }
+	}
+    }
+
+    double start = now_sec();
+    matcher.compile();
+    double compile_time = now_sec() - start;
+
+    //A pool of distinct lines, replayed until the requested count
+    vector<string> pool;
+    for(unsigned long i = 0; i < 65536; i++) {
+	snprintf(buffer, sizeof(buffer),
+		 "May  1 10:%02lu:%02lu host sshd[%lu]: Accepted publickey for user%lu from 10.0.%lu.%lu port %lu ssh2",
+		 (i / 60) % 60, i % 60, 1000 + i, i % 100, (i / 256) % 256, i % 256, 1024 + i % 60000);
+	pool.push_back(buffer);
+    }
+    pool[100] = "May  1 10:00:00 host app[1]: found malware_7919_payload in /tmp";
+    pool[200] = "May  1 10:00:00 host app[1]: exploit-3 1234 attempt from 10.0.0.1";
+
+    vector<signature_hit> hits;
+    unsigned long long matched = 0;
+    unsigned long long bytes = 0;
+    start = now_sec();
+    for(unsigned long i = 0; i < lines; i++) {
+	const string &line = pool[i & 65535];
+	matched += matcher.match(line.data(), line.size(), hits);
+	bytes += line.size();
+    }
+    double elapsed = now_sec() - start;
+
+    double rate = lines / elapsed;
+    printf("signatures=%lu unanchored=%lu compile=%.3fs lines=%lu hits=%llu "
+	   "elapsed=%.3fs rate=%.0f lines/s (%.0f MB/s)\n",
+	   (unsigned long) matcher.size(), (unsigned long) matcher.unanchored_count(),
+	   compile_time, lines, matched, elapsed, rate, bytes / elapsed / 1e6);
+
+    if(rate < target) {
+	printf("below target of %.0f lines/s\n", target);
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,471 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Fleet collector: subscribes to the topics of the plugins and keeps the
+ * latest sample of every instance (host, process, disk...) of each topic.
+ *
+ *   cavecanem_collector [--workers N] [--ingest N] [--queue SLOTS]
+ *                       [--expire SEC] [--interval SEC] [--duration SEC]
+ *                       [--domain ID] [--config FILE] [PLUGIN...]
+ *
+ * The topics and types are those of the plugins of the general
+ * configuration file (or only of the given plugins), read from their XML
+ * files like the agent does, and the DataReaders are created in its domain
+ * with the QoS profile of each plugin.
+ *
+ * --ingest threads (2 by default) take the samples of every DataReader,
+ * encode them (see sample_codec) and hand them, sharded by the hash of their
+ * hostname, to --workers threads (4 by default) through lock-free
+ * single-producer single-consumer queues of --queue slots (see
+ * ingest_pipeline). Workers keep a latest-state table per topic, keyed by
+ * instance, and drop the instances not received for --expire seconds (60
+ * by default; 0 keeps them).
+ *
+ * Every --interval seconds (10 by default) the collector prints the samples
+ * it ingested per second, the instances of each topic, and how many times
+ * the ingest threads waited on a full queue. It stops after --duration
+ * seconds (0: on SIGINT), printing the totals, so it doubles as the
+ * end-to-end throughput benchmark when driven by cavecanem_loadgen or
+ * cavecanem_replay (collector_bench measures the pipeline alone).
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <algorithm>
+
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ndds/ndds_cpp.h>
+
+#include "ingest_pipeline.hpp"
+#include "sample_codec.hpp"
+#include "xml_parser.hpp"
+
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR "."
+#endif
+
+//Samples taken from a DataReader at once
+#define COLLECTOR_TAKE_BATCH 256
+//Pause of the ingest threads when no DataReader had samples
+#define COLLECTOR_IDLE_NS 500000L
+#define COLLECTOR_MAX_HOSTNAME_LENGTH 255
+
+using namespace std;
+
+static volatile bool quit = false;
+
+static void signal_handler(int signal)
+{
+    quit = true;
+}
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ns(long long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR && !quit)
+	;
+}
+
+static long long time_ns(const DDS_Time_t &time)
+{
+    return (long long) time.sec * 1000000000LL + time.nanosec;
+}
+
+/**
+ * @class collector_topic
+ * A topic being collected: its type and DataReader.
+ */
+struct collector_topic {
+    string name;
+    DDS_TypeCode *type;
+    DDSDynamicDataTypeSupport *type_support;
+    DDSDynamicDataReader *reader;
+};
+
+/**
+ * @class ingest_thread
+ * An ingest thread: takes the samples of the DataReaders and hands them to
+ * the workers.
+ */
+struct ingest_thread {
+    pthread_t thread;
+    size_t index;
+    ingest_pipeline *pipeline;
+    vector<collector_topic> *topics;
+    volatile unsigned long long taken;
+    volatile unsigned long long failed; //samples that could not be encoded
+
+    sample_encoder encoder;
+    vector<char> payload;
+    vector<char> hostname;
+    DDS_DynamicDataSeq data_seq;
+    DDS_SampleInfoSeq info_seq;
+};
+
+/**
+ * @brief Folds the key hash of an instance into the key of its entry.
+ */
+static unsigned long long instance_key(const DDS_InstanceHandle_t &handle,
+				       unsigned long long host_hash)
+{
+    if(!handle.isValid)
+	return host_hash | 1;
+    unsigned long long high = 0;
+    unsigned long long low = 0;
+    memcpy(&high, handle.keyHash.value, 8);
+    memcpy(&low, handle.keyHash.value + 8, 8);
+    unsigned long long key = high ^ (low * 0x9E3779B97F4A7C15ULL);
+    return key != 0 ? key : 1;
+}
+
+/**
+ * @brief Takes the samples of a DataReader and hands them to the workers.
+ *
+ * @return Number of samples taken.
+ */
+static size_t ingest_topic(ingest_thread &self, size_t topic_index)
+{
+    collector_topic &topic = (*self.topics)[topic_index];
+    if(topic.reader->take(self.data_seq, self.info_seq, COLLECTOR_TAKE_BATCH,
+			  DDS_ANY_SAMPLE_STATE, DDS_ANY_VIEW_STATE,
+			  DDS_ANY_INSTANCE_STATE) != DDS_RETCODE_OK)
+	return 0;
+
+    size_t taken = 0;
+    for(DDS_Long i = 0; i < self.data_seq.length(); i++) {
+	const DDS_SampleInfo &info = self.info_seq[i];
+	if(!info.valid_data)
+	    continue;
+	DDS_DynamicData &data = self.data_seq[i];
+	taken++;
+
+	char *hostname = &self.hostname[0];
+	DDS_UnsignedLong size = self.hostname.size();
+	if(data.get_string(hostname, &size, "hostname",
+			   DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK)
+	    hostname[0] = '\0';
+
+	self.payload.clear();
+	if(!self.encoder.encode(data, self.payload)) {
+	    self.failed = self.failed + 1;
+	    continue;
+	}
+
+	unsigned long long host_hash = ingest_pipeline::hash_hostname(hostname);
+	size_t worker = self.pipeline->worker_of(host_hash);
+	collected_sample *sample = self.pipeline->claim(self.index, worker);
+	if(sample == NULL)
+	    break;
+	sample->topic = topic_index;
+	sample->key = instance_key(info.instance_handle, host_hash);
+	sample->host_hash = host_hash;
+	sample->source_ns = time_ns(info.source_timestamp);
+	sample->reception_ns = time_ns(info.reception_timestamp);
+	//The slot is left with the buffer of the previous sample
+	sample->payload.swap(self.payload);
+	self.pipeline->publish(self.index, worker);
+    }
+    topic.reader->return_loan(self.data_seq, self.info_seq);
+    return taken;
+}
+
+/**
+ * @brief Body of the ingest threads: polls every DataReader, each thread
+ * starting from a different one, and pauses when none had samples.
+ * Several threads may take from the same DataReader; the latest-state
+ * tables keep the newest sample of an instance whatever order its samples
+ * are stored in.
+ */
+static void *ingest(void *arg)
+{
+    ingest_thread &self = *(ingest_thread *) arg;
+    size_t count = self.topics->size();
+    while(!quit) {
+	size_t taken = 0;
+	for(size_t i = 0; i < count; i++)
+	    taken += ingest_topic(self, (self.index + i) % count);
+	self.taken = self.taken + taken;
+	if(taken == 0)
+	    sleep_ns(COLLECTOR_IDLE_NS);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates the participant and subscriber, like the plugin manager
+ * creates its participant and publisher.
+ */
+static bool create_participant(int domain_id, const cc_general_properties &general,
+			       DDSDomainParticipant *&participant, DDSSubscriber *&subscriber)
+{
+    DDS_DomainParticipantFactoryQos factory_qos;
+    DDSTheParticipantFactory->get_qos(factory_qos);
+    factory_qos.profile.url_profile.ensure_length(1,1);
+    factory_qos.profile.url_profile[0] = DDS_String_dup(general.qos_file.c_str());
+    DDSTheParticipantFactory->set_qos(factory_qos);
+
+    subscriber = NULL;
+    if(general.qos_profile == "default") {
+	participant = DDSTheParticipantFactory->
+	    create_participant(domain_id, DDS_PARTICIPANT_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+	if(participant != NULL)
+	    subscriber = participant->create_subscriber(DDS_SUBSCRIBER_QOS_DEFAULT,
+							NULL, DDS_STATUS_MASK_NONE);
+    }
+    else {
+	participant = DDSTheParticipantFactory->
+	    create_participant_with_profile(domain_id, general.qos_library.c_str(),
+					    general.qos_profile.c_str(),
+					    NULL, DDS_STATUS_MASK_NONE);
+	if(participant != NULL)
+	    subscriber = participant->
+		create_subscriber_with_profile(general.qos_library.c_str(),
+					       general.qos_profile.c_str(),
+					       NULL, DDS_STATUS_MASK_NONE);
+    }
+
+    if(participant == NULL || subscriber == NULL) {
+	cerr << "cannot create the DDS participant and subscriber" << endl;
+	return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Creates the topic and DataReader of a plugin, with the QoS of the
+ * plugin.
+ */
+static bool create_reader(DDSDomainParticipant *participant, DDSSubscriber *subscriber,
+			  const cc_plugin_properties &properties, collector_topic &topic)
+{
+    topic.type_support = new DDSDynamicDataTypeSupport(topic.type,
+						       DDS_DYNAMIC_DATA_TYPE_PROPERTY_DEFAULT);
+    const char *type_name = topic.type_support->get_type_name();
+    DDSTopic *dds_topic = NULL;
+    DDSDataReader *reader = NULL;
+    if(topic.type_support->register_type(participant, type_name) == DDS_RETCODE_OK)
+	dds_topic = participant->create_topic(topic.name.c_str(), type_name,
+					      DDS_TOPIC_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+    if(dds_topic != NULL) {
+	if(properties.qos_profile == "default")
+	    reader = subscriber->create_datareader(dds_topic, DDS_DATAREADER_QOS_DEFAULT,
+						   NULL, DDS_STATUS_MASK_NONE);
+	else
+	    reader = subscriber->create_datareader_with_profile(dds_topic,
+								properties.qos_library.c_str(),
+								properties.qos_profile.c_str(),
+								NULL, DDS_STATUS_MASK_NONE);
+    }
+    topic.reader = reader != NULL ? DDSDynamicDataReader::narrow(reader) : NULL;
+    if(topic.reader == NULL) {
+	cerr << topic.name << ": cannot create the topic and DataReader" << endl;
+	return false;
+    }
+    return true;
+}
+
+
+static void usage()
+{
+    cerr << "Usage: cavecanem_collector [--workers N] [--ingest N] [--queue SLOTS]" << endl
+	 << "                           [--expire SEC] [--interval SEC] [--duration SEC]" << endl
+	 << "                           [--domain ID] [--config FILE] [PLUGIN...]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string cfg_file(string(CAVECANEM_DIR) + "/config/cavecanem.xml");
+    int domain_id = -1;
+    int workers = 4;
+    int ingest_threads = 2;
+    int queue = 4096;
+    double expire = 60;
+    double interval = 10;
+    double duration = 0;
+    vector<string> only;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--workers" && i + 1 < argc)
+	    workers = atoi(argv[++i]);
+	else if(arg == "--ingest" && i + 1 < argc)
+	    ingest_threads = atoi(argv[++i]);
+	else if(arg == "--queue" && i + 1 < argc)
+	    queue = atoi(argv[++i]);
+	else if(arg == "--expire" && i + 1 < argc)
+	    expire = atof(argv[++i]);
+	else if(arg == "--interval" && i + 1 < argc)
+	    interval = atof(argv[++i]);
+	else if(arg == "--duration" && i + 1 < argc)
+	    duration = atof(argv[++i]);
+	else if(arg == "--domain" && i + 1 < argc)
+	    domain_id = atoi(argv[++i]);
+	else if(arg == "--config" && i + 1 < argc)
+	    cfg_file = argv[++i];
+	else if(arg[0] == '-') {
+	    usage();
+	    return 2;
+	}
+	else
+	    only.push_back(arg);
+    }
+    if(workers <= 0 || ingest_threads <= 0 || queue <= 0 || expire < 0 ||
+       interval <= 0 || duration < 0) {
+	usage();
+	return 2;
+    }
+
+    XML_parser *parser = XML_parser::get_singleton();
+    if(!parser->parse_general_configuration_file(cfg_file)) {
+	cerr << "cannot parse " << cfg_file << endl;
+	return 1;
+    }
+    cc_general_properties general = parser->get_general_properties();
+
+    DDSDomainParticipant *participant;
+    DDSSubscriber *subscriber;
+    if(!create_participant(domain_id >= 0 ? domain_id : general.domain_id, general,
+			   participant, subscriber))
+	return 1;
+
+    //The topics of the plugins (once each, when plugins share a topic)
+    vector<collector_topic> topics;
+    for(map<string, list<string> >::iterator it = general.plugin_list_map.begin();
+	it != general.plugin_list_map.end(); ++it)
+	for(list<string>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+	    if(!only.empty() && find(only.begin(), only.end(), *it2) == only.end())
+		continue;
+	    string file = string(CAVECANEM_DIR) + "/" + it->first + "/" + *it2 + "/" + *it2 + ".xml";
+	    if(!parser->parse_plugin_configuration_file(file)) {
+		cerr << "cannot parse " << file << endl;
+		continue;
+	    }
+	    cc_plugin_properties properties = parser->get_plugin_properties(*it2);
+	    if(properties.type_code == NULL)
+		continue;
+	    bool known = false;
+	    for(size_t i = 0; i < topics.size(); i++)
+		known = known || topics[i].name == properties.topic_name;
+	    if(known)
+		continue;
+
+	    collector_topic topic;
+	    topic.name = properties.topic_name;
+	    topic.type = properties.type_code;
+	    if(create_reader(participant, subscriber, properties, topic))
+		topics.push_back(topic);
+	}
+    if(topics.empty()) {
+	cerr << "no topic to collect" << endl;
+	return 1;
+    }
+
+    ingest_pipeline pipeline(ingest_threads, workers, topics.size(), queue);
+    if(!pipeline.start((long long) (expire * 1e9)))
+	return 1;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    vector<ingest_thread> pool(ingest_threads);
+    int started = 0;
+    for(int i = 0; i < ingest_threads; i++) {
+	ingest_thread &thread = pool[i];
+	thread.index = i;
+	thread.pipeline = &pipeline;
+	thread.topics = &topics;
+	thread.taken = 0;
+	thread.failed = 0;
+	thread.hostname.resize(COLLECTOR_MAX_HOSTNAME_LENGTH + 1);
+    }
+    for(; started < ingest_threads; started++)
+	if(pthread_create(&pool[started].thread, NULL, ingest, &pool[started]) != 0) {
+	    cerr << "cannot create ingest thread " << started << endl;
+	    quit = true;
+	    break;
+	}
+
+    printf("collecting %u topics with %d ingest threads and %d workers\n",
+	   (unsigned) topics.size(), ingest_threads, workers);
+
+    long long start = now_ns();
+    long long last = start;
+    unsigned long long last_processed = 0;
+    while(!quit) {
+	sleep_ns((long long) (interval * 1e9));
+	long long now = now_ns();
+	unsigned long long processed = pipeline.processed();
+	printf("%8.1f s %12.0f samples/s, stalls %llu, stale %llu, expired %llu\n",
+	       (now - start) / 1e9, (processed - last_processed) * 1e9 / (now - last),
+	       pipeline.stalls(), pipeline.stale(), pipeline.expired());
+	for(size_t i = 0; i < topics.size(); i++)
+	    printf("    %-24s %10u instances\n", topics[i].name.c_str(),
+		   (unsigned) pipeline.instances(i));
+	fflush(stdout);
+	last_processed = processed;
+	last = now;
+	if(duration > 0 && now - start >= duration * 1e9)
+	    quit = true;
+    }
+
+    quit = true;
+    for(int i = 0; i < started; i++)
+	pthread_join(pool[i].thread, NULL);
+    pipeline.stop();
+    double elapsed = (now_ns() - start) / 1e9;
+
+    unsigned long long taken = 0;
+    unsigned long long failed = 0;
+    for(int i = 0; i < started; i++) {
+	taken += pool[i].taken;
+	failed += pool[i].failed;
+    }
+    printf("%llu samples taken in %.3f s (%.0f/s), %llu stored",
+	   taken, elapsed, elapsed > 0 ? taken / elapsed : 0.0, pipeline.processed());
+    if(failed > 0)
+	printf(", %llu not encoded", failed);
+    printf("\n");
+
+    participant->delete_contained_entities();
+    DDSTheParticipantFactory->delete_participant(participant);
+    for(size_t i = 0; i < topics.size(); i++)
+	delete topics[i].type_support;
+    return 0;
+}
@@ -0,0 +1,307 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <time.h>
+#include <sched.h>
+
+#include "ingest_pipeline.hpp"
+
+using namespace std;
+
+//Counters of different producers are kept on different cache lines
+#define STALLS_STRIDE 8
+//Items a worker takes from a queue before looking at the next one
+#define WORKER_BATCH 256
+//Period of the housekeeping of the workers (expiry, published sizes)
+#define HOUSEKEEPING_PERIOD_NS 100000000LL
+//Idle time after which a worker sleeps instead of yielding
+#define WORKER_SPIN_NS 1000000LL
+#define WORKER_SLEEP_NS 200000L
+
+static long long monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Hashes a hostname (FNV-1a) to pick its worker.
+ */
+unsigned long long ingest_pipeline::hash_hostname(const char *hostname)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for(const unsigned char *p = (const unsigned char *) hostname; *p != '\0'; p++) {
+	hash ^= *p;
+	hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns the wall-clock time in nanoseconds since the epoch, the
+ * clock of the reception timestamps.
+ */
+long long ingest_pipeline::realtime_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Constructor of the ingest_pipeline class.
+ *
+ * @param producers Number of ingest threads.
+ * @param workers Number of worker threads.
+ * @param topics Number of topics (tables per worker).
+ * @param queue_capacity Slots of every queue (rounded up to a power of two).
+ */
+ingest_pipeline::ingest_pipeline(size_t producers,
+				 size_t workers,
+				 size_t topics,
+				 size_t queue_capacity)
+    : stalls_(producers * STALLS_STRIDE, 0),
+      stopping_(false),
+      expire_ns_(0)
+{
+    for(size_t i = 0; i < workers; i++) {
+	pipeline_worker *worker = new pipeline_worker;
+	worker->pipeline = this;
+	worker->running = false;
+	for(size_t j = 0; j < producers; j++)
+	    worker->queues.push_back(new spsc_queue<collected_sample>(queue_capacity));
+	worker->tables.resize(topics);
+	worker->processed = 0;
+	worker->stale = 0;
+	worker->expired = 0;
+	worker->sizes.resize(topics, 0);
+	workers_.push_back(worker);
+    }
+}
+
+/**
+ * @brief Destructor of the ingest_pipeline class: stops the workers if
+ * they are running.
+ */
+ingest_pipeline::~ingest_pipeline()
+{
+    stop();
+    for(size_t i = 0; i < workers_.size(); i++) {
+	for(size_t j = 0; j < workers_[i]->queues.size(); j++)
+	    delete workers_[i]->queues[j];
+	delete workers_[i];
+    }
+}
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param expire_ns Instances not received for this long are dropped (0:
+ * never).
+ *
+ * @return False if a thread could not be created (the others are stopped).
+ */
+bool ingest_pipeline::start(long long expire_ns)
+{
+    expire_ns_ = expire_ns;
+    stopping_ = false;
+    for(size_t i = 0; i < workers_.size(); i++) {
+	if(pthread_create(&workers_[i]->thread, NULL, run_worker, workers_[i]) != 0) {
+	    cerr << "cannot create worker thread " << i << endl;
+	    stop();
+	    return false;
+	}
+	workers_[i]->running = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Stops the workers once they have stored what is queued. The
+ * producers must have stopped publishing.
+ */
+void ingest_pipeline::stop()
+{
+    stopping_ = true;
+    for(size_t i = 0; i < workers_.size(); i++)
+	if(workers_[i]->running) {
+	    pthread_join(workers_[i]->thread, NULL);
+	    workers_[i]->running = false;
+	}
+}
+
+/**
+ * @brief Producer: returns the next slot of the queue to a worker, waiting
+ * while it is full.
+ *
+ * @param producer Index of the calling ingest thread.
+ * @param worker Worker the sample is for (see worker_of()).
+ *
+ * @return The slot, to be filled and handed over with publish(), or NULL if
+ * the pipeline is stopping.
+ */
+collected_sample *ingest_pipeline::claim(size_t producer, size_t worker)
+{
+    spsc_queue<collected_sample> &queue = *workers_[worker]->queues[producer];
+    collected_sample *slot = queue.claim();
+    while(slot == NULL) {
+	if(stopping_)
+	    return NULL;
+	stalls_[producer * STALLS_STRIDE]++;
+	sched_yield();
+	slot = queue.claim();
+    }
+    return slot;
+}
+
+/**
+ * @brief Producer: hands the slot returned by claim() to its worker.
+ */
+void ingest_pipeline::publish(size_t producer, size_t worker)
+{
+    workers_[worker]->queues[producer]->publish();
+}
+
+void *ingest_pipeline::run_worker(void *arg)
+{
+    pipeline_worker *worker = (pipeline_worker *) arg;
+    worker->pipeline->work(*worker);
+    return NULL;
+}
+
+/**
+ * @brief Body of the workers: stores the samples of their queues, taking
+ * a batch from each queue in turn, until the pipeline stops and the queues
+ * are empty. Idle workers yield, and sleep once idle for a while.
+ */
+void ingest_pipeline::work(pipeline_worker &worker)
+{
+    long long next_housekeeping = monotonic_ns() + HOUSEKEEPING_PERIOD_NS;
+    long long idle_since = 0;
+    unsigned long long stale = 0;
+
+    for(;;) {
+	bool stopping = stopping_;
+	size_t taken = 0;
+	for(size_t i = 0; i < worker.queues.size(); i++) {
+	    spsc_queue<collected_sample> &queue = *worker.queues[i];
+	    collected_sample *sample;
+	    size_t batch = 0;
+	    while(batch < WORKER_BATCH && (sample = queue.front()) != NULL) {
+		if(!worker.tables[sample->topic].store(*sample))
+		    stale++;
+		queue.pop();
+		batch++;
+	    }
+	    taken += batch;
+	}
+	if(taken > 0) {
+	    worker.processed = worker.processed + taken;
+	    worker.stale = stale;
+	}
+
+	if(taken == 0 && stopping)
+	    break;
+
+	long long now = monotonic_ns();
+	if(now >= next_housekeeping) {
+	    housekeeping(worker, realtime_ns());
+	    next_housekeeping = now + HOUSEKEEPING_PERIOD_NS;
+	}
+
+	if(taken > 0) {
+	    idle_since = 0;
+	}
+	else if(idle_since == 0) {
+	    idle_since = now;
+	    sched_yield();
+	}
+	else if(now - idle_since < WORKER_SPIN_NS) {
+	    sched_yield();
+	}
+	else {
+	    struct timespec pause = {0, WORKER_SLEEP_NS};
+	    nanosleep(&pause, NULL);
+	}
+    }
+    housekeeping(worker, realtime_ns());
+}
+
+/**
+ * @brief Drops the instances of a worker that expired and publishes the
+ * sizes of its tables.
+ */
+void ingest_pipeline::housekeeping(pipeline_worker &worker, long long now_ns)
+{
+    for(size_t i = 0; i < worker.tables.size(); i++) {
+	if(expire_ns_ > 0)
+	    worker.expired = worker.expired + worker.tables[i].expire(now_ns - expire_ns_);
+	worker.sizes[i] = worker.tables[i].size();
+    }
+}
+
+unsigned long long ingest_pipeline::processed() const
+{
+    unsigned long long total = 0;
+    for(size_t i = 0; i < workers_.size(); i++)
+	total += workers_[i]->processed;
+    return total;
+}
+
+unsigned long long ingest_pipeline::stale() const
+{
+    unsigned long long total = 0;
+    for(size_t i = 0; i < workers_.size(); i++)
+	total += workers_[i]->stale;
+    return total;
+}
+
+unsigned long long ingest_pipeline::expired() const
+{
+    unsigned long long total = 0;
+    for(size_t i = 0; i < workers_.size(); i++)
+	total += workers_[i]->expired;
+    return total;
+}
+
+/**
+ * @brief Returns how many times the producers found a queue full.
+ */
+unsigned long long ingest_pipeline::stalls() const
+{
+    unsigned long long total = 0;
+    for(size_t i = 0; i < stalls_.size(); i += STALLS_STRIDE)
+	total += stalls_[i];
+    return total;
+}
+
+/**
+ * @brief Returns the instances of a topic, as of the last housekeeping of
+ * the workers.
+ */
+size_t ingest_pipeline::instances(size_t topic) const
+{
+    size_t total = 0;
+    for(size_t i = 0; i < workers_.size(); i++)
+	total += workers_[i]->sizes[topic];
+    return total;
+}
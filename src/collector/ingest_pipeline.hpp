@@ -0,0 +1,111 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INGEST_PIPELINE_HPP
+#define INGEST_PIPELINE_HPP
+
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+
+#include "latest_table.hpp"
+#include "spsc_queue.hpp"
+
+/**
+ * @class ingest_pipeline
+ * Moves collected samples from the ingest threads (producers) to the
+ * worker threads that keep the latest-state tables. Samples are sharded by
+ * the hash of their hostname, so all the instances of a host are kept by
+ * the same worker. Every producer has a single-producer single-consumer
+ * queue to every worker, so no queue has more than one writer or reader
+ * and no lock is taken on the way.
+ *
+ * Each worker owns one latest_table per topic; the table of a topic is the
+ * union of the tables of the workers. Instances not updated for the expiry
+ * time are dropped by their worker.
+ */
+class ingest_pipeline {
+public:
+    ingest_pipeline(size_t producers,
+		    size_t workers,
+		    size_t topics,
+		    size_t queue_capacity);
+    ~ingest_pipeline();
+
+    bool start(long long expire_ns);
+    void stop();
+
+    size_t worker_of(unsigned long long host_hash) const
+    {
+	return (size_t) (host_hash % workers_.size());
+    }
+
+    collected_sample *claim(size_t producer, size_t worker);
+    void publish(size_t producer, size_t worker);
+
+    size_t workers() const
+    {
+	return workers_.size();
+    }
+
+    unsigned long long processed() const;
+    unsigned long long stale() const;
+    unsigned long long expired() const;
+    unsigned long long stalls() const;
+    size_t instances(size_t topic) const;
+
+    //Only while the workers are stopped
+    const latest_table &table(size_t worker, size_t topic) const
+    {
+	return workers_[worker]->tables[topic];
+    }
+
+    static unsigned long long hash_hostname(const char *hostname);
+    static long long realtime_ns();
+
+private:
+    /**
+     * @class pipeline_worker
+     * A worker thread: its queues (one per producer), its tables (one per
+     * topic) and its counters, read by other threads while it runs.
+     */
+    struct pipeline_worker {
+	ingest_pipeline *pipeline;
+	pthread_t thread;
+	bool running;
+	std::vector<spsc_queue<collected_sample> *> queues;
+	std::vector<latest_table> tables;
+	volatile unsigned long long processed;
+	volatile unsigned long long stale;
+	volatile unsigned long long expired;
+	std::vector<size_t> sizes; //sizes of the tables, as last published
+    };
+
+    static void *run_worker(void *arg);
+    void work(pipeline_worker &worker);
+    void housekeeping(pipeline_worker &worker, long long now_ns);
+
+    std::vector<pipeline_worker *> workers_;
+    std::vector<unsigned long long> stalls_; //by producer, padded
+    volatile bool stopping_;
+    long long expire_ns_;
+};
+
+#endif //INGEST_PIPELINE_HPP
@@ -0,0 +1,180 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latest_table.hpp"
+
+using namespace std;
+
+//Initial number of slots (a power of two) and largest share in use
+#define LATEST_TABLE_INITIAL_SLOTS 1024
+#define LATEST_TABLE_MAX_LOAD_PERCENT 70
+
+latest_table::latest_table()
+    : entries_(LATEST_TABLE_INITIAL_SLOTS),
+      mask_(LATEST_TABLE_INITIAL_SLOTS - 1),
+      size_(0)
+{
+    for(size_t i = 0; i < entries_.size(); i++)
+	entries_[i].key = 0;
+}
+
+/**
+ * @brief Returns the home slot of a key, mixing its bits first so that keys
+ * differing only in their high bits spread too.
+ */
+size_t latest_table::slot_of(unsigned long long key) const
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t) key & mask_;
+}
+
+/**
+ * @brief Stores a sample as the latest state of its instance, unless the
+ * entry already holds a newer one (samples of an instance can be taken by
+ * different ingest threads, so they may arrive out of order).
+ *
+ * The payload of the sample is swapped with the one of the entry: the
+ * sample is left with the previous buffer, to be reused.
+ * @param sample The sample; its key must not be 0.
+ *
+ * @return False if the sample was older than the stored one.
+ */
+bool latest_table::store(collected_sample &sample)
+{
+    if((size_ + 1) * 100 > entries_.size() * LATEST_TABLE_MAX_LOAD_PERCENT)
+	grow();
+
+    size_t slot = slot_of(sample.key);
+    while(entries_[slot].key != 0 && entries_[slot].key != sample.key)
+	slot = (slot + 1) & mask_;
+
+    latest_entry &entry = entries_[slot];
+    if(entry.key == 0) {
+	entry.key = sample.key;
+	entry.updates = 0;
+	size_++;
+    }
+    else if(sample.source_ns < entry.source_ns) {
+	return false;
+    }
+
+    entry.host_hash = sample.host_hash;
+    entry.source_ns = sample.source_ns;
+    entry.reception_ns = sample.reception_ns;
+    entry.updates++;
+    entry.payload.swap(sample.payload);
+    return true;
+}
+
+/**
+ * @brief Returns the entry of an instance, or NULL if it is not stored.
+ */
+const latest_entry *latest_table::find(unsigned long long key) const
+{
+    if(key == 0)
+	return NULL;
+    for(size_t slot = slot_of(key); entries_[slot].key != 0; slot = (slot + 1) & mask_)
+	if(entries_[slot].key == key)
+	    return &entries_[slot];
+    return NULL;
+}
+
+/**
+ * @brief Doubles the slots, moving the entries (and their buffers) over.
+ */
+void latest_table::grow()
+{
+    vector<latest_entry> old(entries_.size() * 2);
+    old.swap(entries_);
+    mask_ = entries_.size() - 1;
+    for(size_t i = 0; i < entries_.size(); i++)
+	entries_[i].key = 0;
+
+    for(size_t i = 0; i < old.size(); i++) {
+	if(old[i].key == 0)
+	    continue;
+	size_t slot = slot_of(old[i].key);
+	while(entries_[slot].key != 0)
+	    slot = (slot + 1) & mask_;
+	latest_entry &entry = entries_[slot];
+	entry.key = old[i].key;
+	entry.host_hash = old[i].host_hash;
+	entry.source_ns = old[i].source_ns;
+	entry.reception_ns = old[i].reception_ns;
+	entry.updates = old[i].updates;
+	entry.payload.swap(old[i].payload);
+    }
+}
+
+/**
+ * @brief Frees a slot, moving back the entries of its probe sequence so
+ * that no tombstone is needed.
+ */
+void latest_table::erase(size_t slot)
+{
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask_;
+    while(entries_[next].key != 0) {
+	size_t home = slot_of(entries_[next].key);
+	//Move the entry into the hole if its home is not between the hole
+	//and its slot (cyclically)
+	if(((next - home) & mask_) >= ((next - hole) & mask_)) {
+	    latest_entry &from = entries_[next];
+	    latest_entry &to = entries_[hole];
+	    to.key = from.key;
+	    to.host_hash = from.host_hash;
+	    to.source_ns = from.source_ns;
+	    to.reception_ns = from.reception_ns;
+	    to.updates = from.updates;
+	    to.payload.swap(from.payload);
+	    hole = next;
+	}
+	next = (next + 1) & mask_;
+    }
+    entries_[hole].key = 0;
+    entries_[hole].payload.clear();
+    size_--;
+}
+
+/**
+ * @brief Drops the instances received last before a time (processes that
+ * exited, hosts that went away).
+ *
+ * @param older_than_ns Reception time (nanoseconds since the epoch).
+ *
+ * @return Number of instances dropped.
+ */
+size_t latest_table::expire(long long older_than_ns)
+{
+    size_t dropped = 0;
+    size_t slot = 0;
+    while(slot < entries_.size()) {
+	if(entries_[slot].key != 0 && entries_[slot].reception_ns < older_than_ns) {
+	    erase(slot);
+	    dropped++;
+	    //An entry may have moved into the slot: look at it again
+	    continue;
+	}
+	slot++;
+    }
+    return dropped;
+}
@@ -0,0 +1,91 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATEST_TABLE_HPP
+#define LATEST_TABLE_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @class collected_sample
+ * A sample on its way from an ingest thread to a worker: the instance it
+ * belongs to, its timestamps and its encoded contents (see sample_codec).
+ */
+struct collected_sample {
+    unsigned int topic;
+    unsigned long long key;        //instance (hash of its key members)
+    unsigned long long host_hash;  //hostname, which picks the worker
+    long long source_ns;
+    long long reception_ns;
+    std::vector<char> payload;
+};
+
+/**
+ * @class latest_entry
+ * Latest state of an instance.
+ */
+struct latest_entry {
+    unsigned long long key;        //0: free
+    unsigned long long host_hash;
+    long long source_ns;
+    long long reception_ns;
+    unsigned long long updates;
+    std::vector<char> payload;
+};
+
+/**
+ * @class latest_table
+ * Latest sample of every instance of a topic, in an open-addressing hash
+ * table (linear probing, backward-shift deletion) keyed by the instance
+ * hash. Storing a sample swaps its payload with the one of the entry, so
+ * buffers circulate between the queue slots and the table instead of being
+ * allocated for every sample. Not thread-safe: each worker owns its tables.
+ */
+class latest_table {
+public:
+    latest_table();
+
+    bool store(collected_sample &sample);
+    const latest_entry *find(unsigned long long key) const;
+    size_t expire(long long older_than_ns);
+
+    size_t size() const
+    {
+	return size_;
+    }
+
+    //Entries in slot order, free ones included (key 0)
+    const std::vector<latest_entry> &entries() const
+    {
+	return entries_;
+    }
+
+private:
+    size_t slot_of(unsigned long long key) const;
+    void grow();
+    void erase(size_t slot);
+
+    std::vector<latest_entry> entries_;
+    size_t mask_;
+    size_t size_;
+};
+
+#endif //LATEST_TABLE_HPP
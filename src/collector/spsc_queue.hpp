@@ -0,0 +1,123 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <cstddef>
+#include <vector>
+
+//Keeps the indexes of the producer and the consumer on cache lines of
+//their own
+#define SPSC_QUEUE_CACHE_LINE 64
+
+/**
+ * @class spsc_queue
+ * Bounded lock-free queue between exactly one producer thread and one
+ * consumer thread. Slots are preallocated and reused: the producer fills
+ * the slot returned by claim() in place and hands it over with publish(),
+ * the consumer reads (or swaps out) the slot returned by front() and gives
+ * it back with pop(). Each side writes only its own index; the other one's
+ * is read again only when the cached copy says the queue is full (or
+ * empty), so the cache lines bounce once per batch rather than per item.
+ */
+template <class T>
+class spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity)
+	: head_(0), tail_cache_(0), tail_(0), head_cache_(0)
+    {
+	size_t size = 2;
+	while(size < capacity)
+	    size <<= 1;
+	slots_.resize(size);
+	mask_ = size - 1;
+    }
+
+    size_t capacity() const
+    {
+	return slots_.size();
+    }
+
+    /**
+     * @brief Producer: returns the next free slot, or NULL if the queue is
+     * full.
+     */
+    T *claim()
+    {
+	if(head_ - tail_cache_ > mask_) {
+	    tail_cache_ = tail_;
+	    if(head_ - tail_cache_ > mask_)
+		return NULL;
+	}
+	return &slots_[head_ & mask_];
+    }
+
+    /**
+     * @brief Producer: hands the slot returned by claim() to the consumer.
+     */
+    void publish()
+    {
+	__sync_synchronize(); //The slot is written before it is published
+	head_ = head_ + 1;
+    }
+
+    /**
+     * @brief Consumer: returns the oldest published slot, or NULL if the
+     * queue is empty.
+     */
+    T *front()
+    {
+	if(tail_ == head_cache_) {
+	    head_cache_ = head_;
+	    if(tail_ == head_cache_)
+		return NULL;
+	    __sync_synchronize(); //The slot is read after it is published
+	}
+	return &slots_[tail_ & mask_];
+    }
+
+    /**
+     * @brief Consumer: gives the slot returned by front() back to the
+     * producer.
+     */
+    void pop()
+    {
+	__sync_synchronize(); //The slot is read before it is reused
+	tail_ = tail_ + 1;
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    char pad0_[SPSC_QUEUE_CACHE_LINE];
+
+    //Producer side
+    volatile size_t head_;
+    size_t tail_cache_;
+    char pad1_[SPSC_QUEUE_CACHE_LINE];
+
+    //Consumer side
+    volatile size_t tail_;
+    size_t head_cache_;
+    char pad2_[SPSC_QUEUE_CACHE_LINE];
+};
+
+#endif //SPSC_QUEUE_HPP
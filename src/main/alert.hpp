@@ -0,0 +1,68 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALERT_HPP
+#define ALERT_HPP
+
+#include <string>
+#include <ndds/ndds_cpp.h>
+
+#include "plugin.hpp"
+
+#define ALERT_TOPIC_NAME "cavecanem_alert"
+
+//Bounds of the cavecanem_alert type
+#define ALERT_MAX_HOSTNAME_LENGTH 50
+#define ALERT_MAX_PLUGIN_LENGTH 64
+#define ALERT_MAX_RULE_LENGTH 128
+#define ALERT_MAX_MESSAGE_LENGTH 256
+#define ALERT_MAX_SUBJECT_LENGTH 1024
+
+/**
+ * @class alert_publisher
+ * Owns the <code>cavecanem_alert</code> topic, on which the agent publishes
+ * the alerts raised by its plugins. Unlike plugin topics, its type is not
+ * defined in XML but built programmatically, since it is part of the agent.
+ */
+class alert_publisher {
+public:
+    alert_publisher();
+    ~alert_publisher();
+
+    bool initialize(DDSDomainParticipant *participant,
+		    DDSPublisher *publisher,
+		    std::string qos_library,
+		    std::string qos_profile);
+
+    bool publish(const std::string &plugin_name, const cc_alert &alert);
+
+    static DDS_TypeCode *create_type_code();
+
+private:
+    std::string bounded(const std::string &value, size_t max_length);
+
+    DDS_TypeCode *type_code_;
+    DDSDynamicDataTypeSupport *type_support_;
+    DDSDynamicDataWriter *writer_;
+    DDS_DynamicData *data_;
+    std::string hostname_;
+};
+
+#endif //ALERT_HPP
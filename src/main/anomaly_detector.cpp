@@ -0,0 +1,491 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ANOMALY_DETECTOR_SSE2
+#endif
+
+#include "anomaly_detector.hpp"
+#include "dynamic_data_utils.hpp"
+
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+//Floor of the EWMA standard deviation, so that series which have been
+//constant so far do not score infinite on their first change
+#define ANOMALY_MIN_STDDEV_RATIO 0.01
+#define ANOMALY_MIN_STDDEV 1e-9
+
+//An active anomaly is cleared when its score falls below this fraction of
+//the threshold
+#define ANOMALY_CLEAR_RATIO 0.5
+
+//0.6745 is the 0.75 quantile of the standard normal: it makes the MAD of
+//normal data comparable to its standard deviation
+#define ANOMALY_MAD_SCALE 0.6745
+
+using namespace std;
+
+anomaly_detector::anomaly_detector()
+{
+}
+
+/**
+ * @brief Sets the detectors of a plugin.
+ *
+ * Fills in the defaults of each method: ewma uses alpha 0.1, threshold 4
+ * and a warmup of 2/alpha samples; mad uses a window of 60 samples,
+ * threshold 3.5 and a warmup of half the window. The members themselves
+ * are resolved against the type of the first sample.
+ * @param plugin_name Name of the plugin.
+ * @param detectors Detectors of the plugin configuration file.
+ * @param error Set to a description of the problem when false is returned.
+ *
+ * @return False if a detector is invalid.
+ */
+bool anomaly_detector::configure(const string &plugin_name,
+				 const list<cc_anomaly_definition> &detectors,
+				 string &error)
+{
+    if(detectors.empty())
+	return true;
+
+    plugin_series plugin;
+    plugin.wildcard = -1;
+    plugin.resolved = false;
+    plugin.ewma_count = 0;
+    plugin.ring_size = 0;
+    plugin.tick = 0;
+
+    for(list<cc_anomaly_definition>::const_iterator it = detectors.begin();
+	it != detectors.end(); ++it) {
+	detector_settings settings;
+	settings.member = it->member;
+	settings.severity = it->severity;
+
+	if(it->method == "ewma") {
+	    settings.mad = false;
+	    settings.alpha = it->alpha < 0 ? 0.1 : it->alpha;
+	    settings.window = 0;
+	    settings.threshold = it->threshold < 0 ? 4.0 : it->threshold;
+	    settings.warmup = it->warmup < 0 ? (int) ceil(2.0 / settings.alpha) : it->warmup;
+	    if(settings.alpha <= 0 || settings.alpha > 1) {
+		error = "detector " + it->member + ": alpha must be in (0, 1]";
+		return false;
+	    }
+	}
+	else if(it->method == "mad") {
+	    settings.mad = true;
+	    settings.alpha = 0;
+	    settings.window = it->window < 0 ? 60 : it->window;
+	    settings.threshold = it->threshold < 0 ? 3.5 : it->threshold;
+	    settings.warmup = it->warmup < 0 ? settings.window / 2 : it->warmup;
+	    if(settings.window < 3) {
+		error = "detector " + it->member + ": window must be at least 3 samples";
+		return false;
+	    }
+	}
+	else {
+	    error = "detector " + it->member + ": unknown method '" + it->method +
+		"' (expected ewma or mad)";
+	    return false;
+	}
+
+	if(settings.member.empty()) {
+	    error = "detector without member";
+	    return false;
+	}
+	for(size_t i = 0; i < plugin.detectors.size(); i++) {
+	    if(plugin.detectors[i].member == settings.member) {
+		error = "member " + settings.member + " has more than one detector";
+		return false;
+	    }
+	}
+
+	if(settings.member == "*")
+	    plugin.wildcard = plugin.detectors.size();
+	plugin.detectors.push_back(settings);
+    }
+
+    plugins_[plugin_name] = plugin;
+    return true;
+}
+
+/**
+ * @brief Removes the detectors of a plugin, and the baselines they learnt.
+ */
+void anomaly_detector::remove_plugin(const string &plugin_name)
+{
+    map<string, plugin_series>::iterator it = plugins_.find(plugin_name);
+    if(it == plugins_.end())
+	return;
+    for(size_t i = 0; i < bound_.size(); i++)
+	if(bound_[i] == &it->second)
+	    bound_[i] = NULL;
+    plugins_.erase(it);
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its detectors, if it has any, so that its samples are evaluated
+ * without looking its name up.
+ */
+void anomaly_detector::bind_plugin(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    map<string, plugin_series>::iterator it = plugins_.find(plugin_name);
+    bound_[index] = (it != plugins_.end()) ? &it->second : NULL;
+}
+
+/**
+ * @brief Updates the baselines of a plugin with the sample it is about to
+ * publish.
+ *
+ * @param plugin_index Index the plugin is bound to (see bind_plugin()).
+ * @param data The sample.
+ * @param alerts Alerts raised or cleared by the sample are appended here.
+ */
+void anomaly_detector::evaluate(size_t plugin_index,
+				const DDS_DynamicData &data,
+				vector<cc_alert> &alerts)
+{
+    if(!has_detectors(plugin_index))
+	return;
+    plugin_series &plugin = *bound_[plugin_index];
+
+    if(!plugin.resolved)
+	resolve(plugin, data);
+    size_t members = plugin.members.size();
+    if(members == 0)
+	return;
+
+    plugin.key.clear();
+    for(size_t i = 0; i < plugin.keys.size(); i++) {
+	if(!get_member_as_string(data, plugin.keys[i].c_str(), plugin.key_kinds[i],
+				 plugin.buffer, plugin.key_value))
+	    plugin.key_value.clear();
+	if(i > 0)
+	    plugin.key += ' ';
+	plugin.key += plugin.keys[i];
+	plugin.key += '=';
+	plugin.key += plugin.key_value;
+    }
+
+    size_t index = instance(plugin);
+    size_t base = index * members;
+
+    for(size_t j = 0; j < members; j++) {
+	if(!get_numeric_member(data, plugin.members[j].c_str(), plugin.kinds[j],
+			       plugin.value[base + j]))
+	    plugin.value[base + j] = NAN;
+    }
+
+    update_ewma(plugin, base);
+    update_mad(plugin, base, index * plugin.ring_size);
+
+    for(size_t j = 0; j < members; j++) {
+	size_t slot = base + j;
+	if(plugin.count[slot] <= plugin.warmup[j])
+	    continue;
+
+	double threshold = plugin.threshold[j];
+	double clear_threshold = threshold * ANOMALY_CLEAR_RATIO;
+	bool raise = !plugin.active[slot] &&
+	    plugin.square_score[slot] >= threshold * threshold;
+	bool clear = plugin.active[slot] &&
+	    plugin.square_score[slot] < clear_threshold * clear_threshold;
+	if(!raise && !clear)
+	    continue;
+
+	const detector_settings &settings = plugin.detectors[plugin.detector_of[j]];
+	char text[256];
+	cc_alert alert;
+	alert.rule = "anomaly." + plugin.members[j];
+	alert.subject = plugin.key;
+
+	if(raise) {
+	    alert.severity = settings.severity;
+	    snprintf(text, sizeof(text), "%s=%g deviates from its %s baseline %g (score %.1f)",
+		     plugin.members[j].c_str(), plugin.value[slot],
+		     settings.mad ? "median" : "mean", plugin.baseline[slot],
+		     sqrt(plugin.square_score[slot]));
+	}
+	else {
+	    alert.severity = 0;
+	    snprintf(text, sizeof(text), "%s=%g is back to its baseline %g",
+		     plugin.members[j].c_str(), plugin.value[slot], plugin.baseline[slot]);
+	}
+	alert.message = text;
+	plugin.active[slot] = raise;
+	alerts.push_back(alert);
+    }
+}
+
+/**
+ * @brief Binds the detectors of a plugin to the members of its type.
+ *
+ * Explicit detectors apply to their member; the "*" detector applies to the
+ * rest of the numeric members except the key members and the timestamp.
+ */
+void anomaly_detector::resolve(plugin_series &plugin, const DDS_DynamicData &data)
+{
+    const DDS_TypeCode *type = data.get_type();
+    DDS_ExceptionCode_t ex;
+    vector<string> names;
+    vector<int> kinds;
+    vector<int> detector_of;
+    vector<bool> used(plugin.detectors.size(), false);
+
+    DDS_UnsignedLong count = type->member_count(ex);
+    for(DDS_UnsignedLong i = 0; i < count; i++) {
+	string name = type->member_name(i, ex);
+	int kind = type->member_type(i, ex)->kind(ex);
+	if(type->is_member_key(i, ex)) {
+	    plugin.keys.push_back(name);
+	    plugin.key_kinds.push_back(kind);
+	    continue;
+	}
+
+	int detector = -1;
+	for(size_t d = 0; d < plugin.detectors.size(); d++)
+	    if(plugin.detectors[d].member == name)
+		detector = d;
+	if(detector >= 0) {
+	    used[detector] = true;
+	    if(!is_numeric_kind(kind)) {
+		cerr << "anomaly detector: member " << name << " of "
+		     << type->name(ex) << " is not numeric" << endl;
+		continue;
+	    }
+	}
+	else if(plugin.wildcard >= 0 && is_numeric_kind(kind) &&
+		name != "ts" && name != "tick") {
+	    detector = plugin.wildcard;
+	}
+	else {
+	    continue;
+	}
+
+	names.push_back(name);
+	kinds.push_back(kind);
+	detector_of.push_back(detector);
+    }
+
+    for(size_t d = 0; d < plugin.detectors.size(); d++)
+	if(!used[d] && (int) d != plugin.wildcard)
+	    cerr << "anomaly detector: " << plugin.detectors[d].member
+		 << " is not a member of " << type->name(ex) << endl;
+
+    //EWMA members first, so that update_ewma() runs over a contiguous range
+    for(int pass = 0; pass < 2; pass++) {
+	for(size_t j = 0; j < names.size(); j++) {
+	    const detector_settings &settings = plugin.detectors[detector_of[j]];
+	    if(settings.mad != (pass == 1))
+		continue;
+	    plugin.members.push_back(names[j]);
+	    plugin.kinds.push_back(kinds[j]);
+	    plugin.detector_of.push_back(detector_of[j]);
+	    plugin.alpha.push_back(settings.alpha);
+	    plugin.threshold.push_back(settings.threshold);
+	    plugin.warmup.push_back(settings.warmup);
+	    if(settings.mad) {
+		plugin.ring_offset.push_back(plugin.ring_size);
+		plugin.ring_size += settings.window;
+	    }
+	    else {
+		plugin.ewma_count++;
+	    }
+	}
+    }
+
+    plugin.resolved = true;
+}
+
+/**
+ * @brief Returns the index of the instance of the current key, creating it
+ * (or recycling the least recently seen one) if needed.
+ */
+size_t anomaly_detector::instance(plugin_series &plugin)
+{
+    plugin.tick++;
+    map<string, size_t>::iterator it = plugin.instances.find(plugin.key);
+    if(it != plugin.instances.end()) {
+	plugin.last_tick[it->second] = plugin.tick;
+	return it->second;
+    }
+
+    size_t members = plugin.members.size();
+    size_t index;
+    if(plugin.instances.size() < ANOMALY_MAX_INSTANCES) {
+	index = plugin.instances.size();
+	plugin.last_tick.push_back(0);
+	plugin.instance_keys.push_back("");
+	plugin.value.resize((index + 1) * members);
+	plugin.mean.resize((index + 1) * members);
+	plugin.var.resize((index + 1) * members);
+	plugin.baseline.resize((index + 1) * members);
+	plugin.count.resize((index + 1) * members);
+	plugin.square_score.resize((index + 1) * members);
+	plugin.active.resize((index + 1) * members);
+	plugin.ring.resize((index + 1) * plugin.ring_size);
+    }
+    else {
+	index = min_element(plugin.last_tick.begin(), plugin.last_tick.end()) -
+	    plugin.last_tick.begin();
+	plugin.instances.erase(plugin.instance_keys[index]);
+    }
+
+    size_t base = index * members;
+    fill(plugin.mean.begin() + base, plugin.mean.begin() + base + members, 0.0);
+    fill(plugin.var.begin() + base, plugin.var.begin() + base + members, 0.0);
+    fill(plugin.baseline.begin() + base, plugin.baseline.begin() + base + members, 0.0);
+    fill(plugin.count.begin() + base, plugin.count.begin() + base + members, 0.0);
+    fill(plugin.square_score.begin() + base, plugin.square_score.begin() + base + members, 0.0);
+    fill(plugin.active.begin() + base, plugin.active.begin() + base + members, 0);
+
+    plugin.instances[plugin.key] = index;
+    plugin.instance_keys[index] = plugin.key;
+    plugin.last_tick[index] = plugin.tick;
+    return index;
+}
+
+/**
+ * @brief Scores and updates all the EWMA series of an instance.
+ *
+ * Missing values and first samples are handled with selects instead of
+ * branches, and scores are kept squared to avoid square roots, so with
+ * SSE2 two series are updated per instruction. Each value is scored
+ * against the baseline before being added to it.
+ */
+void anomaly_detector::update_ewma(plugin_series &plugin, size_t base)
+{
+    size_t n = plugin.ewma_count;
+    if(n == 0)
+	return;
+
+    const double *value = &plugin.value[base];
+    const double *alpha = &plugin.alpha[0];
+    double *mean = &plugin.mean[base];
+    double *var = &plugin.var[base];
+    double *baseline = &plugin.baseline[base];
+    double *count = &plugin.count[base];
+    double *square_score = &plugin.square_score[base];
+
+    size_t j = 0;
+    const double min_var = ANOMALY_MIN_STDDEV * ANOMALY_MIN_STDDEV;
+
+#ifdef ANOMALY_DETECTOR_SSE2
+    //Two series per iteration; selects are done with and/andnot/or masks
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d ratio = _mm_set1_pd(ANOMALY_MIN_STDDEV_RATIO);
+    const __m128d epsilon = _mm_set1_pd(min_var);
+    for(; j + 2 <= n; j += 2) {
+	__m128d x = _mm_loadu_pd(value + j);
+	__m128d m = _mm_loadu_pd(mean + j);
+	__m128d v = _mm_loadu_pd(var + j);
+	__m128d a = _mm_loadu_pd(alpha + j);
+	__m128d c = _mm_loadu_pd(count + j);
+
+	__m128d valid = _mm_cmpeq_pd(x, x);
+	__m128d seen = _mm_cmpgt_pd(c, zero);
+	__m128d sample = _mm_or_pd(_mm_and_pd(valid, x), _mm_andnot_pd(valid, m));
+	__m128d delta = _mm_and_pd(seen, _mm_sub_pd(sample, m));
+	__m128d delta2 = _mm_mul_pd(delta, delta);
+	__m128d floor = _mm_mul_pd(ratio, m);
+
+	_mm_storeu_pd(square_score + j,
+		      _mm_div_pd(delta2, _mm_add_pd(_mm_add_pd(v, _mm_mul_pd(floor, floor)), epsilon)));
+	_mm_storeu_pd(baseline + j, m);
+	_mm_storeu_pd(mean + j, _mm_or_pd(_mm_and_pd(seen, _mm_add_pd(m, _mm_mul_pd(a, delta))),
+					  _mm_andnot_pd(seen, sample)));
+	_mm_storeu_pd(var + j, _mm_mul_pd(_mm_sub_pd(one, a),
+					  _mm_add_pd(v, _mm_mul_pd(a, delta2))));
+	_mm_storeu_pd(count + j, _mm_add_pd(c, _mm_and_pd(valid, one)));
+    }
+#endif
+
+    for(; j < n; j++) {
+	double x = value[j];
+	double m = mean[j];
+	bool valid = (x == x);
+	bool seen = (count[j] > 0);
+	double sample = valid ? x : m;
+	double delta = seen ? sample - m : 0.0;
+	double floor = ANOMALY_MIN_STDDEV_RATIO * m;
+	square_score[j] = delta * delta / (var[j] + floor * floor + min_var);
+	baseline[j] = m;
+	mean[j] = seen ? m + alpha[j] * delta : sample;
+	var[j] = (1.0 - alpha[j]) * (var[j] + alpha[j] * delta * delta);
+	count[j] += valid ? 1.0 : 0.0;
+    }
+}
+
+/**
+ * @brief Scores and updates all the MAD series of an instance.
+ *
+ * The median and the MAD of the window are recomputed for every sample with
+ * two partial sorts of a scratch copy. A series whose window has no
+ * spread (MAD 0) scores 0.
+ */
+void anomaly_detector::update_mad(plugin_series &plugin, size_t base, size_t ring_base)
+{
+    for(size_t j = plugin.ewma_count; j < plugin.members.size(); j++) {
+	size_t slot = base + j;
+	size_t window = plugin.detectors[plugin.detector_of[j]].window;
+	double *ring = &plugin.ring[ring_base + plugin.ring_offset[j - plugin.ewma_count]];
+	double x = plugin.value[slot];
+
+	plugin.square_score[slot] = 0;
+	if(x != x)
+	    continue;
+
+	size_t filled = min((size_t) plugin.count[slot], window);
+	if(filled >= 3) {
+	    vector<double> &sorted = plugin.sorted;
+	    sorted.assign(ring, ring + filled);
+	    size_t middle = filled / 2;
+	    nth_element(sorted.begin(), sorted.begin() + middle, sorted.end());
+	    double median = sorted[middle];
+	    for(size_t k = 0; k < filled; k++)
+		sorted[k] = fabs(sorted[k] - median);
+	    nth_element(sorted.begin(), sorted.begin() + middle, sorted.end());
+	    double mad = sorted[middle];
+
+	    plugin.baseline[slot] = median;
+	    if(mad > 0) {
+		double score = ANOMALY_MAD_SCALE * (x - median) / mad;
+		plugin.square_score[slot] = score * score;
+	    }
+	}
+
+	ring[(size_t) plugin.count[slot] % window] = x;
+	plugin.count[slot] += 1;
+    }
+}
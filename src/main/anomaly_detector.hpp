@@ -0,0 +1,137 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANOMALY_DETECTOR_HPP
+#define ANOMALY_DETECTOR_HPP
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <ndds/ndds_cpp.h>
+
+#include "plugin.hpp"
+#include "xml_parser.hpp"
+
+//Instances (keys) tracked per plugin; the least recently seen one is
+//recycled when a new instance appears and the table is full
+#define ANOMALY_MAX_INSTANCES 1024
+
+/**
+ * @class anomaly_detector
+ * Keeps an online baseline of the numeric members of the plugin topics and
+ * raises an alert when a value deviates from it, as configured in the
+ * <code>anomaly_detection</code> section of each plugin file.
+ *
+ * Two methods are available for each member:
+ *   - ewma: exponentially weighted mean and variance, scored as
+ *     |x - mean| / stddev.
+ *   - mad: median and median absolute deviation of the last
+ *     <code>window</code> values, scored as 0.6745 |x - median| / MAD
+ *     (the robust z-score).
+ *
+ * The state of all the series of a plugin lives in structure-of-arrays
+ * buffers (one array per statistic, one slot per instance and member), so
+ * that each sample updates all its EWMA series in a single branch-free SIMD
+ * pass. An alert is raised once when the score of a
+ * series crosses its threshold and cleared when it falls below half of it.
+ */
+class anomaly_detector {
+public:
+    anomaly_detector();
+
+    bool configure(const std::string &plugin_name,
+		   const std::list<cc_anomaly_definition> &detectors,
+		   std::string &error);
+    void remove_plugin(const std::string &plugin_name);
+    void bind_plugin(size_t index, const std::string &plugin_name);
+
+    bool has_detectors(size_t index) const
+    {
+	return index < bound_.size() && bound_[index] != NULL;
+    }
+
+    void evaluate(size_t plugin_index,
+		  const DDS_DynamicData &data,
+		  std::vector<cc_alert> &alerts);
+
+private:
+    struct detector_settings {
+	std::string member;
+	bool mad;
+	double alpha;
+	int window;
+	double threshold;
+	int warmup;
+	int severity;
+    };
+
+    struct plugin_series {
+	std::vector<detector_settings> detectors;
+	int wildcard;                        //detector for "*", or -1
+	bool resolved;
+
+	//Members and keys of the topic, resolved from the first sample
+	std::vector<std::string> keys;
+	std::vector<int> key_kinds;
+	std::vector<std::string> members;    //ewma members first, then mad ones
+	std::vector<int> kinds;
+	std::vector<int> detector_of;        //member -> detector
+	size_t ewma_count;
+	std::vector<size_t> ring_offset;     //mad member -> offset in the ring block
+	size_t ring_size;                    //ring values per instance
+
+	//Per member settings, laid out like the per instance arrays
+	std::vector<double> alpha;
+	std::vector<double> threshold;
+	std::vector<double> warmup;
+
+	//Per instance state: instance i owns [i * members, (i + 1) * members)
+	std::map<std::string, size_t> instances;
+	std::vector<unsigned long> last_tick;
+	unsigned long tick;
+	std::vector<double> value;
+	std::vector<double> mean;            //ewma only
+	std::vector<double> var;             //ewma only
+	std::vector<double> baseline;        //mean or median the last value was scored against
+	std::vector<double> count;
+	std::vector<double> square_score;    //scores are compared squared
+	std::vector<char> active;
+	std::vector<double> ring;            //instance i owns [i * ring_size, (i + 1) * ring_size)
+
+	std::vector<std::string> instance_keys;
+
+	//Scratch buffers reused between samples
+	std::string key;                     //"name=value ..." of the key members
+	std::string key_value;
+	std::vector<char> buffer;
+	std::vector<double> sorted;
+    };
+
+    void resolve(plugin_series &plugin, const DDS_DynamicData &data);
+    size_t instance(plugin_series &plugin);
+    void update_ewma(plugin_series &plugin, size_t base);
+    void update_mad(plugin_series &plugin, size_t base, size_t ring_base);
+
+    std::map<std::string, plugin_series> plugins_;
+    std::vector<plugin_series *> bound_;   //plugin index -> series, NULL if unbound
+};
+
+#endif //ANOMALY_DETECTOR_HPP
@@ -0,0 +1,87 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "builtin_plugins.hpp"
+
+using namespace std;
+
+#ifdef CAVECANEM_BUILTIN_PLUGINS
+//Defined by the headers of the plugins, compiled along with the agent
+extern "C" {
+    cc_create_plugin_t create_cpu;
+    cc_create_plugin_t create_disk;
+    cc_create_plugin_t create_memory;
+    cc_create_plugin_t create_net_load;
+    cc_create_plugin_t create_proc;
+    cc_create_plugin_t create_host_info;
+    cc_create_plugin_t create_proc_stat;
+}
+#endif
+
+/**
+ * @class builtin_plugin
+ * Create function of a plugin compiled into the agent, by name.
+ */
+struct builtin_plugin {
+    const char *create_function;
+    cc_create_plugin_t *create;
+};
+
+static const builtin_plugin builtin_plugins[] = {
+#ifdef CAVECANEM_BUILTIN_PLUGINS
+    {"create_cpu", create_cpu},
+    {"create_disk", create_disk},
+    {"create_memory", create_memory},
+    {"create_net_load", create_net_load},
+    {"create_proc", create_proc},
+    {"create_host_info", create_host_info},
+    {"create_proc_stat", create_proc_stat},
+#endif
+    {NULL, NULL}
+};
+
+
+/**
+ * @brief Finds a plugin compiled into the agent.
+ *
+ * @param create_function Name of the create function of the plugin, as
+ * given in its configuration file.
+ *
+ * @return The create function, or NULL if the plugin has to be opened from
+ * its library.
+ */
+cc_create_plugin_t *find_builtin_plugin(const string &create_function)
+{
+    for(int i = 0; builtin_plugins[i].create_function != NULL; i++)
+	if(create_function == builtin_plugins[i].create_function)
+	    return builtin_plugins[i].create;
+    return NULL;
+}
+
+
+/**
+ * @brief Tells whether the agent was built with builtin plugins.
+ */
+bool builtin_plugins_enabled()
+{
+    return builtin_plugins[0].create_function != NULL;
+}
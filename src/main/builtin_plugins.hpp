@@ -0,0 +1,38 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILTIN_PLUGINS_HPP
+#define BUILTIN_PLUGINS_HPP
+
+#include <string>
+
+#include "plugin.hpp"
+
+/*
+ * Plugins compiled into the agent (CMake option CAVECANEM_BUILTIN_PLUGINS)
+ * instead of being opened from their shared libraries. The configuration
+ * of a builtin plugin is the same; its create function is looked up here
+ * first, and its dll is only opened if it is not found.
+ */
+
+cc_create_plugin_t *find_builtin_plugin(const std::string &create_function);
+bool builtin_plugins_enabled();
+
+#endif //BUILTIN_PLUGINS_HPP
@@ -0,0 +1,163 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <algorithm>
+
+#include "burst_mode.hpp"
+
+using namespace std;
+
+burst_mode::burst_mode()
+{
+}
+
+/**
+ * @brief Adds a trigger.
+ *
+ * @param alert Rule or signature of the alerts; empty for any.
+ * @param source Plugin raising the alerts; empty for any.
+ * @param severity Minimum severity of the alerts (cleared alerts, of
+ * severity 0, never match).
+ * @param period_ms Period of the plugins during the burst.
+ * @param duration_sec Duration of the burst.
+ * @param plugins Plugins switched to the fast period.
+ */
+void burst_mode::add_trigger(const string &alert,
+			     const string &source,
+			     int severity,
+			     int period_ms,
+			     int duration_sec,
+			     const list<string> &plugins)
+{
+    burst_trigger trigger;
+    trigger.alert = alert;
+    trigger.source = source;
+    trigger.severity = severity > 1 ? severity : 1;
+    trigger.period_ns = (period_ms > 0 ? period_ms : 1) * 1000000LL;
+    trigger.duration_ns = (duration_sec > 0 ? duration_sec : 1) * 1000000000LL;
+    trigger.plugins = plugins;
+    trigger.until_ns = 0;
+    triggers_.push_back(trigger);
+}
+
+/**
+ * @brief Starts the bursts of the triggers matching an alert.
+ *
+ * @param plugin_name Plugin the alert was raised for.
+ * @param alert The alert.
+ * @param now_ns Current time, as returned by self_telemetry::now_ns().
+ * @param started Filled with the plugins whose period changed: switched to
+ * a fast period, or to a faster one by a trigger overlapping the burst they
+ * are in (they should run right away).
+ *
+ * @return True if the period of some plugin changed.
+ */
+bool burst_mode::trigger(const string &plugin_name,
+			 const cc_alert &alert,
+			 long long now_ns,
+			 vector<string> &started)
+{
+    started.clear();
+    for(size_t i = 0; i < triggers_.size(); i++) {
+	burst_trigger &trigger = triggers_[i];
+	if(alert.severity < trigger.severity ||
+	   (!trigger.alert.empty() && trigger.alert != alert.rule) ||
+	   (!trigger.source.empty() && trigger.source != plugin_name) ||
+	   trigger.until_ns > now_ns)
+	    continue;
+
+	trigger.until_ns = now_ns + trigger.duration_ns;
+	cerr << "Burst (" << alert.rule << " from " << plugin_name << "): "
+	     << trigger.period_ns / 1000000 << " ms for "
+	     << trigger.duration_ns / 1000000000LL << " s" << endl;
+
+	for(list<string>::iterator it = trigger.plugins.begin(); it != trigger.plugins.end(); ++it) {
+	    map<string, active_burst>::iterator active = active_.find(*it);
+	    if(active == active_.end()) {
+		active_burst burst;
+		burst.period_ns = trigger.period_ns;
+		burst.until_ns = trigger.until_ns;
+		active_[*it] = burst;
+		set_fast(*it, burst.period_ns);
+		started.push_back(*it);
+		continue;
+	    }
+	    if(trigger.period_ns < active->second.period_ns) {
+		active->second.period_ns = trigger.period_ns;
+		set_fast(*it, trigger.period_ns);
+		if(find(started.begin(), started.end(), *it) == started.end())
+		    started.push_back(*it);
+	    }
+	    if(trigger.until_ns > active->second.until_ns)
+		active->second.until_ns = trigger.until_ns;
+	}
+    }
+    return !started.empty();
+}
+
+/**
+ * @brief Ends the bursts whose window is over.
+ *
+ * @param ended Filled with the plugins going back to their period.
+ */
+void burst_mode::expire(long long now_ns, vector<string> &ended)
+{
+    ended.clear();
+    for(map<string, active_burst>::iterator it = active_.begin(); it != active_.end(); ) {
+	if(it->second.until_ns > now_ns) {
+	    ++it;
+	    continue;
+	}
+	ended.push_back(it->first);
+	set_fast(it->first, 0);
+	active_.erase(it++);
+    }
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its name, so that its period is found without looking the name up.
+ * A name previously bound to the same index is unbound.
+ */
+void burst_mode::bind_plugin(size_t index, const string &plugin_name)
+{
+    for(map<string, size_t>::iterator it = indexes_.begin(); it != indexes_.end(); ) {
+	if(it->second == index && it->first != plugin_name)
+	    indexes_.erase(it++);
+	else
+	    ++it;
+    }
+    indexes_[plugin_name] = index;
+    if(index >= fast_ns_.size())
+	fast_ns_.resize(index + 1, 0);
+    map<string, active_burst>::const_iterator active = active_.find(plugin_name);
+    fast_ns_[index] = (active != active_.end()) ? active->second.period_ns : 0;
+}
+
+/**
+ * @brief Updates the burst period of a plugin, if it is bound.
+ */
+void burst_mode::set_fast(const string &plugin_name, long long period_ns)
+{
+    map<string, size_t>::const_iterator it = indexes_.find(plugin_name);
+    if(it != indexes_.end())
+	fast_ns_[it->second] = period_ns;
+}
@@ -0,0 +1,104 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BURST_MODE_HPP
+#define BURST_MODE_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <list>
+
+#include "plugin.hpp"
+
+/**
+ * @class burst_mode
+ * Switches plugins to a fast period for a while when an incident is
+ * detected. A trigger matches the alerts of a rule (or signature), of a
+ * plugin, or of at least some severity; when one of them is raised the
+ * plugins of the trigger run every <code>period_ms</code> for
+ * <code>duration_sec</code>, and then go back to their period. A trigger
+ * does not fire again while its window lasts, so a burst is always
+ * bounded.
+ */
+class burst_mode {
+public:
+    burst_mode();
+
+    void add_trigger(const std::string &alert,
+		     const std::string &source,
+		     int severity,
+		     int period_ms,
+		     int duration_sec,
+		     const std::list<std::string> &plugins);
+
+    bool enabled() const
+    {
+	return !triggers_.empty();
+    }
+
+    bool active() const
+    {
+	return !active_.empty();
+    }
+
+    bool trigger(const std::string &plugin_name,
+		 const cc_alert &alert,
+		 long long now_ns,
+		 std::vector<std::string> &started);
+    void expire(long long now_ns, std::vector<std::string> &ended);
+    void bind_plugin(size_t index, const std::string &plugin_name);
+
+    /**
+     * @brief Returns the period of a plugin in burst, or 0 if it is not in
+     * one (or not bound).
+     *
+     * @param index Index the plugin is bound to (see bind_plugin()).
+     */
+    long long period_ns(size_t index) const
+    {
+	return index < fast_ns_.size() ? fast_ns_[index] : 0;
+    }
+
+private:
+    struct burst_trigger {
+	std::string alert;
+	std::string source;
+	int severity;
+	long long period_ns;
+	long long duration_ns;
+	std::list<std::string> plugins;
+	long long until_ns;
+    };
+
+    struct active_burst {
+	long long period_ns;
+	long long until_ns;
+    };
+
+    void set_fast(const std::string &plugin_name, long long period_ns);
+
+    std::vector<burst_trigger> triggers_;
+    std::map<std::string, active_burst> active_;
+    std::map<std::string, size_t> indexes_;    //Bound plugins
+    std::vector<long long> fast_ns_;           //plugin index -> burst period, 0 if none
+};
+
+#endif //BURST_MODE_HPP
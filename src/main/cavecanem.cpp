@@ -36,6 +36,7 @@ using namespace std;
 
 void signal_handler(int signal);
 bool quit_signal = false;
+bool reload_signal = false;
 
 int main(int argc, char *argv[])
 {
@@ -45,10 +46,22 @@ int main(int argc, char *argv[])
     //This is the default configuration file
     
     plugin_manager *manager;
+    string record_file;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--record" && i + 1 < argc) {
+	    record_file = argv[++i];
+	}
+	else {
+	    cerr << "Usage: " << argv[0] << " [--record FILE]" << endl;
+	    return -1;
+	}
+    }
     
     //Associate signals to the signal handler
 #ifndef RTI_WIN32
-    signal(SIGHUP,  signal_handler); //Terminal is closed
+    signal(SIGHUP,  signal_handler); //Reload the configuration
     signal(SIGQUIT, signal_handler); //Quit    
 #endif
     signal(SIGTERM, signal_handler); //Terminate
@@ -63,10 +76,19 @@ int main(int argc, char *argv[])
 	return -1;
     }
 
+    if(!record_file.empty() && !manager->record_samples(record_file)) {
+	delete(manager);
+	return -1;
+    }
+
     cout << "Starting Cave Canem Publisher..." << endl;
 
     //We publish information and terminate in case of receiving a quit signal
     while(!quit_signal) {
+	if(reload_signal) {
+	    reload_signal = false;
+	    manager->reload();
+	}
         manager->publish_plugins_information();
     }
     
@@ -79,11 +101,20 @@ int main(int argc, char *argv[])
  * @brief Receives OS signals and orders the main() function to quit.
  * 
  * Sets the <code>quit_signal</code> global variable to true to stop the publishing loop.
+ * SIGHUP sets <code>reload_signal</code> instead, so that the configuration is reloaded
+ * (see plugin_manager::reload()).
  * @param signal Number of the signal.
  */
 void signal_handler(int signal)
 {
     cerr << "Received (Signal " << signal << "), ...";
+#ifndef RTI_WIN32
+    if(signal == SIGHUP) {
+	cerr << " Reloading configuration" << endl;
+	reload_signal = true;
+	return;
+    }
+#endif
     cerr << " Terminating program" << endl;
     quit_signal = true;
 }
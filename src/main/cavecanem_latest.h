@@ -0,0 +1,361 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Layout of the "latest values" shared-memory region of Cave Canem, and a
+ * reader for local consumers written in C (or C++).
+ *
+ * The agent keeps in a POSIX shared-memory object (e.g. /dev/shm/cavecanem_latest)
+ * the last sample published for every instance (plugin and key members) of
+ * every plugin. Each row is written under a seqlock, so readers in other
+ * processes read it without locks and, once the region is mapped, without
+ * system calls:
+ *
+ *   cc_latest_region region;
+ *   cc_latest_row row;
+ *   double idle;
+ *   if(cc_latest_open(&region, "/cavecanem_latest") == 0) {
+ *       if(cc_latest_read(&region, "cpu", "hostname=node1", &row) == 0 &&
+ *          cc_latest_get_double(&region, &row, "cpu_idle", &idle) == 0)
+ *           printf("%f\n", idle);
+ *       cc_latest_close(&region);
+ *   }
+ *
+ * Keys are the key members of the plugin type as "name=value" pairs joined
+ * by spaces, in the order of the type (e.g. "hostname=node1 pid=42 name=sshd").
+ * Values are encoded as in the agent's file sink: members in type order,
+ * little-endian, strings as a 4-byte length and the characters. The layout
+ * of every plugin is given in its stream entry as "name:k;name:k;..." with
+ * one kind letter per member (b boolean, o octet, c char, h short,
+ * H unsigned short, l long or enum, L unsigned long, q long long,
+ * Q unsigned long long, f float, d double, s string, x anything else).
+ *
+ * Rows are placed by open addressing on the FNV-1a hash of "plugin\0key".
+ * Rows not updated for a while are turned into tombstones by the agent.
+ */
+
+#ifndef CAVECANEM_LATEST_H
+#define CAVECANEM_LATEST_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define CC_LATEST_MAGIC "CCLATEST"
+#define CC_LATEST_VERSION 1
+#define CC_LATEST_MAX_STREAMS 64
+#define CC_LATEST_NAME_LENGTH 64
+#define CC_LATEST_LAYOUT_LENGTH 960
+#define CC_LATEST_MAX_SLOT_SIZE 4096
+#define CC_LATEST_MAX_TRIES 1000000
+
+#define CC_LATEST_SLOT_EMPTY 0
+#define CC_LATEST_SLOT_USED 1
+#define CC_LATEST_SLOT_TOMBSTONE 2
+
+typedef struct cc_latest_stream {
+    char plugin[CC_LATEST_NAME_LENGTH];
+    char layout[CC_LATEST_LAYOUT_LENGTH];
+} cc_latest_stream;
+
+typedef struct cc_latest_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slot_count;
+    uint32_t slot_size;             /* Bytes per slot, slot header included */
+    volatile uint32_t stream_count;
+    uint32_t reserved;
+    volatile uint64_t dropped;      /* Rows not stored: table full or too large */
+    cc_latest_stream streams[CC_LATEST_MAX_STREAMS];
+} cc_latest_header;
+
+typedef struct cc_latest_slot {
+    volatile uint32_t seq;          /* Odd while the row is being written */
+    uint16_t state;
+    uint16_t stream;
+    uint32_t key_length;
+    uint32_t data_length;
+    uint64_t timestamp_ns;          /* Publication time, since the epoch */
+    uint64_t hash;
+    /* Followed by the key and then the data */
+} cc_latest_slot;
+
+static inline uint64_t cc_latest_hash(const char *plugin, const char *key, size_t key_length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *p;
+    for(p = (const unsigned char *) plugin; *p != '\0'; p++)
+	hash = (hash ^ *p) * 1099511628211ULL;
+    hash = (hash ^ 0) * 1099511628211ULL;
+    for(p = (const unsigned char *) key; p < (const unsigned char *) key + key_length; p++)
+	hash = (hash ^ *p) * 1099511628211ULL;
+    return hash;
+}
+
+#ifndef CAVECANEM_LATEST_NO_READER
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct {
+    const cc_latest_header *header;
+    const char *slots;
+    size_t size;
+} cc_latest_region;
+
+/* Consistent copy of a row */
+typedef struct {
+    uint16_t stream;
+    uint32_t key_length;
+    uint32_t data_length;
+    uint64_t timestamp_ns;
+    char payload[CC_LATEST_MAX_SLOT_SIZE];
+} cc_latest_row;
+
+/* Maps the region read-only. Returns 0, or -1 if it is missing or invalid. */
+static inline int cc_latest_open(cc_latest_region *region, const char *name)
+{
+    struct stat st;
+    void *address;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0)
+	return -1;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cc_latest_header)) {
+	close(fd);
+	return -1;
+    }
+    address = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED)
+	return -1;
+
+    region->header = (const cc_latest_header *) address;
+    region->size = st.st_size;
+    if(memcmp(region->header->magic, CC_LATEST_MAGIC, 8) != 0 ||
+       region->header->version != CC_LATEST_VERSION ||
+       region->header->slot_size > CC_LATEST_MAX_SLOT_SIZE ||
+       region->header->header_size +
+       (size_t) region->header->slot_count * region->header->slot_size > region->size) {
+	munmap(address, st.st_size);
+	return -1;
+    }
+    region->slots = (const char *) address + region->header->header_size;
+    return 0;
+}
+
+static inline void cc_latest_close(cc_latest_region *region)
+{
+    munmap((void *) region->header, region->size);
+    region->header = NULL;
+}
+
+/* Returns the stream number of a plugin, or -1. */
+static inline int cc_latest_find_stream(const cc_latest_region *region, const char *plugin)
+{
+    uint32_t i;
+    uint32_t count = region->header->stream_count;
+    __sync_synchronize();
+    for(i = 0; i < count && i < CC_LATEST_MAX_STREAMS; i++)
+	if(strncmp(region->header->streams[i].plugin, plugin, CC_LATEST_NAME_LENGTH) == 0)
+	    return (int) i;
+    return -1;
+}
+
+/*
+ * Copies slot <index> consistently. Returns 0 if it holds a row, 1 if it is
+ * empty and 2 if it is a tombstone (or stays locked, e.g. because the agent
+ * died while writing it).
+ */
+static inline int cc_latest_read_slot(const cc_latest_region *region, uint32_t index,
+				      cc_latest_row *row)
+{
+    const cc_latest_slot *slot = (const cc_latest_slot *)
+	(region->slots + (size_t) index * region->header->slot_size);
+    size_t capacity = region->header->slot_size - sizeof(cc_latest_slot);
+    unsigned long tries;
+
+    for(tries = 0; tries < CC_LATEST_MAX_TRIES; tries++) {
+	uint32_t seq = slot->seq;
+	uint16_t state;
+	size_t length;
+	if(seq & 1)
+	    continue;
+	__sync_synchronize();
+	state = slot->state;
+	row->stream = slot->stream;
+	row->key_length = slot->key_length;
+	row->data_length = slot->data_length;
+	row->timestamp_ns = slot->timestamp_ns;
+	length = (size_t) row->key_length + row->data_length;
+	if(state == CC_LATEST_SLOT_USED && length <= capacity)
+	    memcpy(row->payload, (const char *) (slot + 1), length);
+	__sync_synchronize();
+	if(slot->seq != seq)
+	    continue;
+	if(state == CC_LATEST_SLOT_EMPTY)
+	    return 1;
+	if(state != CC_LATEST_SLOT_USED || length > capacity)
+	    return 2;
+	return 0;
+    }
+    return 2;
+}
+
+/* Reads the row of a key of a plugin. Returns 0, or -1 if there is none. */
+static inline int cc_latest_read(const cc_latest_region *region, const char *plugin,
+				 const char *key, cc_latest_row *row)
+{
+    uint32_t count = region->header->slot_count;
+    size_t key_length = strlen(key);
+    int stream = cc_latest_find_stream(region, plugin);
+    uint32_t index, probes;
+    if(stream < 0 || count == 0)
+	return -1;
+
+    index = (uint32_t) (cc_latest_hash(plugin, key, key_length) % count);
+    for(probes = 0; probes < count; probes++) {
+	int status = cc_latest_read_slot(region, index, row);
+	if(status == 1)
+	    return -1;
+	if(status == 0 && row->stream == stream && row->key_length == key_length &&
+	   memcmp(row->payload, key, key_length) == 0)
+	    return 0;
+	index = (index + 1) % count;
+    }
+    return -1;
+}
+
+/* Size of an encoded member of kind k at p, or 0 if unknown. */
+static inline size_t cc_latest_member_size(char k, const char *p, const char *end)
+{
+    uint32_t length;
+    switch(k) {
+    case 'b': case 'o': case 'c': return 1;
+    case 'h': case 'H': return 2;
+    case 'l': case 'L': case 'f': return 4;
+    case 'q': case 'Q': case 'd': return 8;
+    case 's':
+	if(end - p < 4)
+	    return 0;
+	length = (uint32_t) (unsigned char) p[0] | (uint32_t) (unsigned char) p[1] << 8 |
+	    (uint32_t) (unsigned char) p[2] << 16 | (uint32_t) (unsigned char) p[3] << 24;
+	return 4 + (size_t) length;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Finds a member of a row. Sets *kind and *value to its kind letter and
+ * encoding. Returns 0, or -1 if it is missing or follows a member that
+ * cannot be skipped (x).
+ */
+static inline int cc_latest_find_member(const cc_latest_region *region, const cc_latest_row *row,
+					const char *member, char *kind, const char **value)
+{
+    const char *layout;
+    const char *p = row->payload + row->key_length;
+    const char *end = p + row->data_length;
+    size_t member_length = strlen(member);
+    if(row->stream >= CC_LATEST_MAX_STREAMS)
+	return -1;
+    layout = region->header->streams[row->stream].layout;
+
+    while(*layout != '\0') {
+	const char *colon = strchr(layout, ':');
+	size_t size;
+	if(colon == NULL || colon[1] == '\0')
+	    return -1;
+	size = cc_latest_member_size(colon[1], p, end);
+	if((size_t) (colon - layout) == member_length &&
+	   memcmp(layout, member, member_length) == 0) {
+	    if(size == 0 || p + size > end)
+		return -1;
+	    *kind = colon[1];
+	    *value = p;
+	    return 0;
+	}
+	if(size == 0)
+	    return -1;
+	p += size;
+	layout = colon + 2;
+	if(*layout == ';')
+	    layout++;
+    }
+    return -1;
+}
+
+/* Reads a numeric member as a double. Returns 0, or -1. */
+static inline int cc_latest_get_double(const cc_latest_region *region, const cc_latest_row *row,
+				       const char *member, double *value)
+{
+    char kind;
+    const char *p;
+    uint64_t bits = 0;
+    size_t size, i;
+    if(cc_latest_find_member(region, row, member, &kind, &p) != 0 || kind == 's' || kind == 'c')
+	return -1;
+    size = cc_latest_member_size(kind, p, p + 8);
+    for(i = 0; i < size; i++)
+	bits |= (uint64_t) (unsigned char) p[i] << (8 * i);
+
+    switch(kind) {
+    case 'b': case 'o': case 'H': case 'L': case 'Q': *value = (double) bits; break;
+    case 'h': *value = (int16_t) bits; break;
+    case 'l': *value = (int32_t) bits; break;
+    case 'q': *value = (double) (int64_t) bits; break;
+    case 'f': { uint32_t b = (uint32_t) bits; float f; memcpy(&f, &b, 4); *value = f; break; }
+    case 'd': memcpy(value, &bits, 8); break;
+    default: return -1;
+    }
+    return 0;
+}
+
+/* Copies a string (or char) member, NUL-terminated. Returns 0, or -1. */
+static inline int cc_latest_get_string(const cc_latest_region *region, const cc_latest_row *row,
+				       const char *member, char *buffer, size_t size)
+{
+    char kind;
+    const char *p;
+    size_t length;
+    if(size == 0 || cc_latest_find_member(region, row, member, &kind, &p) != 0)
+	return -1;
+    if(kind == 'c') {
+	length = 1;
+    }
+    else if(kind == 's') {
+	length = cc_latest_member_size(kind, p, p + 4 + CC_LATEST_MAX_SLOT_SIZE) - 4;
+	p += 4;
+    }
+    else {
+	return -1;
+    }
+    if(length >= size)
+	length = size - 1;
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    return 0;
+}
+
+#endif /* CAVECANEM_LATEST_NO_READER */
+
+#endif /* CAVECANEM_LATEST_H */
@@ -0,0 +1,489 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include "config_cache.hpp"
+#include "sample_codec.hpp"
+
+using namespace std;
+
+/**
+ * @brief Reads a whole file.
+ *
+ * @return False if it cannot be read.
+ */
+static bool read_file(const string &path, vector<char> &contents)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if(file == NULL)
+	return false;
+
+    contents.clear();
+    char buffer[65536];
+    size_t length;
+    while((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	contents.insert(contents.end(), buffer, buffer + length);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * @brief FNV-1a hash of the contents of a file.
+ */
+static unsigned long long content_hash(const vector<char> &contents)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < contents.size(); i++)
+	hash = (hash ^ (unsigned char) contents[i]) * 1099511628211ULL;
+    return hash;
+}
+
+static void put_int(vector<char> &out, int value)
+{
+    put_uint32(out, (unsigned long) (unsigned int) value);
+}
+
+static bool get_int(const char *&p, const char *end, int &value)
+{
+    unsigned long bits;
+    if(!get_uint32(p, end, bits))
+	return false;
+    value = (int) (unsigned int) bits;
+    return true;
+}
+
+static void put_double(vector<char> &out, double value)
+{
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_uint64(out, bits);
+}
+
+static bool get_double(const char *&p, const char *end, double &value)
+{
+    unsigned long long bits;
+    if(!get_uint64(p, end, bits))
+	return false;
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+static void put_string(vector<char> &out, const string &value)
+{
+    put_uint32(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+static bool get_string(const char *&p, const char *end, string &value)
+{
+    unsigned long length;
+    if(!get_uint32(p, end, length) || (unsigned long) (end - p) < length)
+	return false;
+    value.assign(p, length);
+    p += length;
+    return true;
+}
+
+static bool get_count(const char *&p, const char *end, unsigned long &count)
+{
+    //Every element takes one byte at least
+    return get_uint32(p, end, count) && count <= (unsigned long) (end - p);
+}
+
+static void put_general(vector<char> &out, const cc_general_properties &general)
+{
+    put_int(out, general.publishing_period);
+    put_int(out, general.self_telemetry_period);
+    put_int(out, general.domain_id);
+    put_string(out, general.qos_file);
+    put_string(out, general.qos_library);
+    put_string(out, general.qos_profile);
+    put_string(out, general.alert_qos_profile);
+
+    put_string(out, general.sink.kind);
+    put_string(out, general.sink.path);
+    put_int(out, general.sink.size_kb);
+
+    put_string(out, general.latest_values.name);
+    put_int(out, general.latest_values.slots);
+    put_int(out, general.latest_values.slot_size);
+    put_int(out, general.latest_values.expire_sec);
+
+    put_string(out, general.spool.dir);
+    put_int(out, general.spool.size_mb);
+    put_int(out, general.spool.drain_per_sec);
+
+    out.push_back(general.egress.enabled ? 1 : 0);
+    put_double(out, general.egress.samples_per_sec);
+    put_double(out, general.egress.bytes_per_sec);
+    put_int(out, general.egress.burst_ms);
+    put_double(out, general.egress.spread);
+    put_int(out, general.egress.max_queue);
+    put_uint32(out, general.egress.limits.size());
+    for(list<cc_egress_limit>::const_iterator it = general.egress.limits.begin();
+	it != general.egress.limits.end(); ++it) {
+	put_string(out, it->plugin);
+	put_double(out, it->samples_per_sec);
+	put_double(out, it->bytes_per_sec);
+	put_double(out, it->spread);
+    }
+
+    put_double(out, general.cpu_budget.percent);
+    put_int(out, general.cpu_budget.window_sec);
+    put_int(out, general.cpu_budget.max_stretch);
+    put_string(out, general.control_socket);
+    put_int(out, general.startup_threads);
+    put_int(out, general.latency_probe ? 1 : 0);
+
+    put_uint32(out, general.plugin_list_map.size());
+    for(map<string, list<string> >::const_iterator it = general.plugin_list_map.begin();
+	it != general.plugin_list_map.end(); ++it) {
+	put_string(out, it->first);
+	put_uint32(out, it->second.size());
+	for(list<string>::const_iterator name = it->second.begin(); name != it->second.end(); ++name)
+	    put_string(out, *name);
+    }
+
+    put_uint32(out, general.rules.size());
+    for(list<cc_rule_definition>::const_iterator it = general.rules.begin();
+	it != general.rules.end(); ++it) {
+	put_string(out, it->name);
+	put_int(out, it->severity);
+	put_string(out, it->expression);
+    }
+
+    put_uint32(out, general.bursts.size());
+    for(list<cc_burst_definition>::const_iterator it = general.bursts.begin();
+	it != general.bursts.end(); ++it) {
+	put_string(out, it->alert);
+	put_string(out, it->source);
+	put_int(out, it->severity);
+	put_int(out, it->period_ms);
+	put_int(out, it->duration_sec);
+	put_uint32(out, it->plugins.size());
+	for(list<string>::const_iterator name = it->plugins.begin(); name != it->plugins.end(); ++name)
+	    put_string(out, *name);
+    }
+}
+
+static bool get_general(const char *&p, const char *end, cc_general_properties &general)
+{
+    unsigned long count;
+    char enabled;
+    int latency_probe;
+
+    if(!get_int(p, end, general.publishing_period) ||
+       !get_int(p, end, general.self_telemetry_period) ||
+       !get_int(p, end, general.domain_id) ||
+       !get_string(p, end, general.qos_file) ||
+       !get_string(p, end, general.qos_library) ||
+       !get_string(p, end, general.qos_profile) ||
+       !get_string(p, end, general.alert_qos_profile) ||
+       !get_string(p, end, general.sink.kind) ||
+       !get_string(p, end, general.sink.path) ||
+       !get_int(p, end, general.sink.size_kb) ||
+       !get_string(p, end, general.latest_values.name) ||
+       !get_int(p, end, general.latest_values.slots) ||
+       !get_int(p, end, general.latest_values.slot_size) ||
+       !get_int(p, end, general.latest_values.expire_sec) ||
+       !get_string(p, end, general.spool.dir) ||
+       !get_int(p, end, general.spool.size_mb) ||
+       !get_int(p, end, general.spool.drain_per_sec) ||
+       p >= end)
+	return false;
+
+    enabled = *p++;
+    general.egress.enabled = enabled != 0;
+    if(!get_double(p, end, general.egress.samples_per_sec) ||
+       !get_double(p, end, general.egress.bytes_per_sec) ||
+       !get_int(p, end, general.egress.burst_ms) ||
+       !get_double(p, end, general.egress.spread) ||
+       !get_int(p, end, general.egress.max_queue) ||
+       !get_count(p, end, count))
+	return false;
+    general.egress.limits.clear();
+    for(unsigned long i = 0; i < count; i++) {
+	cc_egress_limit limit;
+	if(!get_string(p, end, limit.plugin) ||
+	   !get_double(p, end, limit.samples_per_sec) ||
+	   !get_double(p, end, limit.bytes_per_sec) ||
+	   !get_double(p, end, limit.spread))
+	    return false;
+	general.egress.limits.push_back(limit);
+    }
+
+    if(!get_double(p, end, general.cpu_budget.percent) ||
+       !get_int(p, end, general.cpu_budget.window_sec) ||
+       !get_int(p, end, general.cpu_budget.max_stretch) ||
+       !get_string(p, end, general.control_socket) ||
+       !get_int(p, end, general.startup_threads) ||
+       !get_int(p, end, latency_probe) ||
+       !get_count(p, end, count))
+	return false;
+
+    general.latency_probe = latency_probe != 0;
+    general.plugin_list_map.clear();
+    for(unsigned long i = 0; i < count; i++) {
+	string dir;
+	unsigned long names;
+	if(!get_string(p, end, dir) || !get_count(p, end, names))
+	    return false;
+	list<string> &plugin_list = general.plugin_list_map[dir];
+	for(unsigned long j = 0; j < names; j++) {
+	    string name;
+	    if(!get_string(p, end, name))
+		return false;
+	    plugin_list.push_back(name);
+	}
+    }
+
+    if(!get_count(p, end, count))
+	return false;
+    general.rules.clear();
+    for(unsigned long i = 0; i < count; i++) {
+	cc_rule_definition rule;
+	if(!get_string(p, end, rule.name) ||
+	   !get_int(p, end, rule.severity) ||
+	   !get_string(p, end, rule.expression))
+	    return false;
+	general.rules.push_back(rule);
+    }
+
+    if(!get_count(p, end, count))
+	return false;
+    general.bursts.clear();
+    for(unsigned long i = 0; i < count; i++) {
+	cc_burst_definition burst;
+	unsigned long names;
+	if(!get_string(p, end, burst.alert) ||
+	   !get_string(p, end, burst.source) ||
+	   !get_int(p, end, burst.severity) ||
+	   !get_int(p, end, burst.period_ms) ||
+	   !get_int(p, end, burst.duration_sec) ||
+	   !get_count(p, end, names))
+	    return false;
+	for(unsigned long j = 0; j < names; j++) {
+	    string name;
+	    if(!get_string(p, end, name))
+		return false;
+	    burst.plugins.push_back(name);
+	}
+	general.bursts.push_back(burst);
+    }
+    return true;
+}
+
+static bool put_plugin(vector<char> &out, const cc_plugin_properties &plugin)
+{
+    put_string(out, plugin.dll);
+    put_string(out, plugin.create_function);
+    put_int(out, plugin.publishing_period);
+    put_string(out, plugin.qos_profile);
+    put_string(out, plugin.qos_library);
+    put_string(out, plugin.topic_name);
+
+    put_uint32(out, plugin.plugin_config.size());
+    for(map<string, string>::const_iterator it = plugin.plugin_config.begin();
+	it != plugin.plugin_config.end(); ++it) {
+	put_string(out, it->first);
+	put_string(out, it->second);
+    }
+
+    put_uint32(out, plugin.anomaly_detectors.size());
+    for(list<cc_anomaly_definition>::const_iterator it = plugin.anomaly_detectors.begin();
+	it != plugin.anomaly_detectors.end(); ++it) {
+	put_string(out, it->member);
+	put_string(out, it->method);
+	put_double(out, it->alpha);
+	put_int(out, it->window);
+	put_double(out, it->threshold);
+	put_int(out, it->warmup);
+	put_int(out, it->severity);
+    }
+
+    out.push_back(plugin.datawriter_qos != NULL ? 1 : 0);
+    out.push_back(plugin.type_code != NULL ? 1 : 0);
+    return plugin.type_code == NULL || encode_type(plugin.type_code, out);
+}
+
+static bool get_plugin(const char *&p, const char *end, cc_plugin_properties &plugin)
+{
+    unsigned long count;
+
+    if(!get_string(p, end, plugin.dll) ||
+       !get_string(p, end, plugin.create_function) ||
+       !get_int(p, end, plugin.publishing_period) ||
+       !get_string(p, end, plugin.qos_profile) ||
+       !get_string(p, end, plugin.qos_library) ||
+       !get_string(p, end, plugin.topic_name) ||
+       !get_count(p, end, count))
+	return false;
+    for(unsigned long i = 0; i < count; i++) {
+	string name, value;
+	if(!get_string(p, end, name) || !get_string(p, end, value))
+	    return false;
+	plugin.plugin_config[name] = value;
+    }
+
+    if(!get_count(p, end, count))
+	return false;
+    for(unsigned long i = 0; i < count; i++) {
+	cc_anomaly_definition detector;
+	if(!get_string(p, end, detector.member) ||
+	   !get_string(p, end, detector.method) ||
+	   !get_double(p, end, detector.alpha) ||
+	   !get_int(p, end, detector.window) ||
+	   !get_double(p, end, detector.threshold) ||
+	   !get_int(p, end, detector.warmup) ||
+	   !get_int(p, end, detector.severity))
+	    return false;
+	plugin.anomaly_detectors.push_back(detector);
+    }
+
+    if(end - p < 2)
+	return false;
+    plugin.datawriter_qos = *p++ ? &DDS_DATAWRITER_QOS_DEFAULT : NULL;
+    plugin.type_code = NULL;
+    if(*p++ && (plugin.type_code = decode_type(p, end)) == NULL)
+	return false;
+    return true;
+}
+
+
+/**
+ * @brief Loads the configuration from the cache, if it is still valid.
+ *
+ * @param path The cache file.
+ * @param cfg_file General configuration file the cache must have been
+ * written for.
+ * @param general Set to the general properties.
+ * @param plugins Set to the properties of every plugin.
+ *
+ * @return False if there is no cache, it was written by another version,
+ * for another file, or some source file changed since; nothing is set then.
+ */
+bool load_config_cache(const string &path,
+		       const string &cfg_file,
+		       cc_general_properties &general,
+		       map<string, cc_plugin_properties> &plugins)
+{
+    vector<char> cache;
+    if(!read_file(path, cache) || cache.size() < 12 ||
+       memcmp(&cache[0], CONFIG_CACHE_MAGIC, 8) != 0)
+	return false;
+    const char *p = &cache[8];
+    const char *end = &cache[0] + cache.size();
+    unsigned long version;
+    unsigned long count;
+    if(!get_uint32(p, end, version) || version != CONFIG_CACHE_VERSION ||
+       !get_count(p, end, count) || count == 0)
+	return false;
+
+    vector<char> contents;
+    for(unsigned long i = 0; i < count; i++) {
+	string source;
+	unsigned long long hash;
+	if(!get_string(p, end, source) || !get_uint64(p, end, hash))
+	    return false;
+	if(i == 0 && source != cfg_file)
+	    return false;
+	if(!read_file(source, contents) || content_hash(contents) != hash)
+	    return false;
+    }
+
+    cc_general_properties cached_general;
+    map<string, cc_plugin_properties> cached_plugins;
+    if(!get_general(p, end, cached_general) || !get_count(p, end, count))
+	return false;
+    for(unsigned long i = 0; i < count; i++) {
+	string name;
+	if(!get_string(p, end, name) || !get_plugin(p, end, cached_plugins[name]))
+	    return false;
+    }
+    if(p != end)
+	return false;
+
+    general = cached_general;
+    plugins = cached_plugins;
+    return true;
+}
+
+
+/**
+ * @brief Writes the cache of a configuration.
+ *
+ * The file is written aside and renamed, so that an agent starting
+ * meanwhile never reads half of it.
+ * @param path The cache file.
+ * @param sources Files the configuration was parsed from, the general
+ * configuration file first.
+ * @param general The general properties.
+ * @param plugins The properties of every plugin.
+ * @param error Set to a description of the problem when false is returned.
+ */
+bool store_config_cache(const string &path,
+			const vector<string> &sources,
+			const cc_general_properties &general,
+			const map<string, cc_plugin_properties> &plugins,
+			string &error)
+{
+    vector<char> cache(CONFIG_CACHE_MAGIC, CONFIG_CACHE_MAGIC + 8);
+    put_uint32(cache, CONFIG_CACHE_VERSION);
+
+    vector<char> contents;
+    put_uint32(cache, sources.size());
+    for(size_t i = 0; i < sources.size(); i++) {
+	if(!read_file(sources[i], contents)) {
+	    error = "cannot read " + sources[i];
+	    return false;
+	}
+	put_string(cache, sources[i]);
+	put_uint64(cache, content_hash(contents));
+    }
+
+    put_general(cache, general);
+    put_uint32(cache, plugins.size());
+    for(map<string, cc_plugin_properties>::const_iterator it = plugins.begin();
+	it != plugins.end(); ++it) {
+	put_string(cache, it->first);
+	if(!put_plugin(cache, it->second)) {
+	    error = "the type of " + it->first + " cannot be cached";
+	    return false;
+	}
+    }
+
+    string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if(file == NULL) {
+	error = "cannot create " + temporary + ": " + strerror(errno);
+	return false;
+    }
+    bool written = fwrite(&cache[0], 1, cache.size(), file) == cache.size();
+    if(fclose(file) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0) {
+	error = "cannot write " + path + ": " + strerror(errno);
+	remove(temporary.c_str());
+	return false;
+    }
+    return true;
+}
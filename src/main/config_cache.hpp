@@ -0,0 +1,60 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONFIG_CACHE_HPP
+#define CONFIG_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "xml_parser.hpp"
+
+#define CONFIG_CACHE_MAGIC "CCCONFIG"
+//Bump whenever cc_general_properties, cc_plugin_properties or the layout
+//below change, so that caches written by other builds are ignored
+#define CONFIG_CACHE_VERSION 3
+
+/*
+ * The configuration cache keeps what XML_parser got from the general
+ * configuration file and the files of the plugins, so that the agent starts
+ * without parsing them (every plugin file means a new DDS XML parser, its
+ * DTD and type code). Layout, little-endian:
+ *  - magic (8 bytes) and version (4);
+ *  - the source files: count (4), then path and FNV-1a hash (8) of the
+ *    contents of each, the general configuration file first;
+ *  - the general properties and the properties of every plugin, its type
+ *    code described by encode_type().
+ * The cache is only used if every source still has the same contents.
+ * DataWriter QoS elements are kept as a flag: the DataWriters are created
+ * with the default QoS when they are present.
+ */
+
+bool load_config_cache(const std::string &path,
+		       const std::string &cfg_file,
+		       cc_general_properties &general,
+		       std::map<std::string, cc_plugin_properties> &plugins);
+bool store_config_cache(const std::string &path,
+			const std::vector<std::string> &sources,
+			const cc_general_properties &general,
+			const std::map<std::string, cc_plugin_properties> &plugins,
+			std::string &error);
+
+#endif //CONFIG_CACHE_HPP
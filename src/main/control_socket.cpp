@@ -0,0 +1,204 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifndef RTI_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include "control_socket.hpp"
+
+using namespace std;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+control_socket::control_socket() : listen_fd_(-1)
+{
+}
+
+control_socket::~control_socket()
+{
+#ifndef RTI_WIN32
+    for(size_t i = 0; i < clients_.size(); i++)
+	close(clients_[i].fd);
+    if(listen_fd_ >= 0) {
+	close(listen_fd_);
+	unlink(path_.c_str());
+    }
+#endif
+}
+
+/**
+ * @brief Creates the socket and starts listening.
+ *
+ * A socket file left by a previous run is replaced.
+ * @param path Path of the socket.
+ * @param error Set to a description of the problem when false is returned.
+ */
+bool control_socket::open(const string &path, string &error)
+{
+#ifndef RTI_WIN32
+    struct sockaddr_un address;
+    if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+	error = "invalid control socket path '" + path + "'";
+	return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+	error = string("cannot create the control socket: ") + strerror(errno);
+	return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(path.c_str());
+    if(bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+       chmod(path.c_str(), 0600) != 0 ||
+       listen(fd, CONTROL_SOCKET_MAX_CLIENTS) != 0) {
+	error = "cannot listen on " + path + ": " + strerror(errno);
+	close(fd);
+	return false;
+    }
+
+    listen_fd_ = fd;
+    path_ = path;
+    return true;
+#else
+    error = "the control socket is not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * @brief Appends the descriptors to poll for input: the listening socket
+ * and the connections waiting for their command.
+ */
+void control_socket::descriptors(vector<int> &fds) const
+{
+    if(listen_fd_ < 0)
+	return;
+    fds.push_back(listen_fd_);
+    for(size_t i = 0; i < clients_.size(); i++)
+	fds.push_back(clients_[i].fd);
+}
+
+/**
+ * @brief Accepts the pending connections and reads what they sent.
+ *
+ * Every complete line becomes a command; its connection is then owned by
+ * the caller, which must answer it with reply(). Nothing blocks.
+ * @param commands The commands received are appended here.
+ */
+void control_socket::serve(vector<control_command> &commands)
+{
+#ifndef RTI_WIN32
+    if(listen_fd_ < 0)
+	return;
+
+    int fd;
+    while((fd = accept(listen_fd_, NULL, NULL)) >= 0) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+	if(clients_.size() >= CONTROL_SOCKET_MAX_CLIENTS) {
+	    //The oldest connection has been idle the longest
+	    reply(clients_[0].fd, "error too many connections");
+	    clients_.erase(clients_.begin());
+	}
+	control_client client;
+	client.fd = fd;
+	clients_.push_back(client);
+    }
+
+    for(size_t i = 0; i < clients_.size(); ) {
+	control_client &client = clients_[i];
+	char buffer[256];
+	ssize_t length;
+	bool closed = false;
+	while((length = recv(client.fd, buffer, sizeof(buffer), 0)) > 0)
+	    client.buffer.append(buffer, length);
+	if(length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+	    closed = true;
+
+	size_t newline = client.buffer.find('\n');
+	if(newline == string::npos && closed && !client.buffer.empty())
+	    newline = client.buffer.size();
+	if(newline != string::npos) {
+	    control_command command;
+	    command.client = client.fd;
+	    command.line = client.buffer.substr(0, newline);
+	    if(!command.line.empty() && command.line[command.line.size() - 1] == '\r')
+		command.line.erase(command.line.size() - 1);
+	    commands.push_back(command);
+	    clients_.erase(clients_.begin() + i);
+	}
+	else if(client.buffer.size() > CONTROL_SOCKET_MAX_LINE) {
+	    reply(client.fd, "error command too long");
+	    clients_.erase(clients_.begin() + i);
+	}
+	else if(closed) {
+	    close_client(i);
+	}
+	else {
+	    i++;
+	}
+    }
+#endif
+}
+
+/**
+ * @brief Writes the reply to a command and closes its connection.
+ *
+ * @param client Connection of the command.
+ * @param text Reply, without the line end.
+ */
+void control_socket::reply(int client, const string &text)
+{
+#ifndef RTI_WIN32
+    string line = text + "\n";
+    if(send(client, line.data(), line.size(), MSG_NOSIGNAL) < 0)
+	cerr << "Control socket: cannot reply: " << strerror(errno) << endl;
+    close(client);
+#endif
+}
+
+void control_socket::close_client(size_t index)
+{
+#ifndef RTI_WIN32
+    close(clients_[index].fd);
+#endif
+    clients_.erase(clients_.begin() + index);
+}
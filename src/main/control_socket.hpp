@@ -0,0 +1,82 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROL_SOCKET_HPP
+#define CONTROL_SOCKET_HPP
+
+#include <string>
+#include <vector>
+
+//Connections waiting for their command at most
+#define CONTROL_SOCKET_MAX_CLIENTS 16
+//Longest command line accepted
+#define CONTROL_SOCKET_MAX_LINE 1024
+
+/**
+ * @class control_command
+ * A command line received on the control socket, and the connection its
+ * reply goes to.
+ */
+struct control_command {
+    int client;
+    std::string line;
+};
+
+/**
+ * @class control_socket
+ * Local UNIX stream socket the agent is driven through while running. A
+ * client connects, writes one command line and reads one reply line, after
+ * which the connection is closed, so that it can be used with
+ * <code>socat - UNIX-CONNECT:path</code> or <code>nc -U path</code>.
+ *
+ * Everything is non-blocking: the descriptors are polled by the loop of the
+ * plugin manager along with those of the plugins, and serve() only reads
+ * what has arrived. The socket is created with mode 0600.
+ */
+class control_socket {
+public:
+    control_socket();
+    ~control_socket();
+
+    bool open(const std::string &path, std::string &error);
+
+    bool enabled() const
+    {
+	return listen_fd_ >= 0;
+    }
+
+    void descriptors(std::vector<int> &fds) const;
+    void serve(std::vector<control_command> &commands);
+    void reply(int client, const std::string &text);
+
+private:
+    struct control_client {
+	int fd;
+	std::string buffer;
+    };
+
+    void close_client(size_t index);
+
+    int listen_fd_;
+    std::string path_;
+    std::vector<control_client> clients_;
+};
+
+#endif //CONTROL_SOCKET_HPP
@@ -0,0 +1,265 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <ctime>
+
+#ifdef RTI_WIN32
+#include <windows.h>
+#endif
+
+#include "cpu_governor.hpp"
+
+using namespace std;
+
+cpu_governor::cpu_governor()
+    : budget_(0),
+      window_ns_(0),
+      max_stretch_(1),
+      window_start_ns_(0),
+      window_start_cpu_ns_(0)
+{
+}
+
+/**
+ * @brief Enables the governor.
+ *
+ * @param budget Share of one core the agent may use (e.g. 0.01).
+ * @param window_sec Seconds over which the usage is measured.
+ * @param max_stretch Times the configured period a period can be stretched.
+ */
+void cpu_governor::configure(double budget, int window_sec, int max_stretch)
+{
+    budget_ = budget;
+    window_ns_ = (window_sec > 0 ? window_sec : 1) * 1000000000LL;
+    max_stretch_ = max_stretch > 1 ? max_stretch : 1;
+}
+
+/**
+ * @brief Declares a plugin and its configured period.
+ */
+void cpu_governor::add_plugin(const string &plugin_name, int period_sec)
+{
+    governed_plugin plugin;
+    plugin.period_sec = period_sec;
+    plugin.stretch = 1;
+    plugin.cpu_ns = 0;
+    plugins_[plugin_name] = plugin;
+}
+
+/**
+ * @brief Forgets a plugin (e.g. when it is unloaded), and its stretches.
+ */
+void cpu_governor::remove_plugin(const string &plugin_name)
+{
+    map<string, governed_plugin>::iterator it = plugins_.find(plugin_name);
+    if(it != plugins_.end()) {
+	for(size_t i = 0; i < bound_.size(); i++)
+	    if(bound_[i] == &it->second)
+		bound_[i] = NULL;
+	plugins_.erase(it);
+    }
+    for(size_t i = 0; i < stretched_.size(); ) {
+	if(stretched_[i] == plugin_name)
+	    stretched_.erase(stretched_.begin() + i);
+	else
+	    i++;
+    }
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its entry, if it was declared with add_plugin().
+ */
+void cpu_governor::bind_plugin(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    map<string, governed_plugin>::iterator it = plugins_.find(plugin_name);
+    bound_[index] = (it != plugins_.end()) ? &it->second : NULL;
+}
+
+/**
+ * @brief Adds the CPU time of a run to the cost of a plugin in the window.
+ *
+ * @param index Index the plugin is bound to (see bind_plugin()).
+ * @param cpu_ns CPU time of the run.
+ */
+void cpu_governor::record_run(size_t index, long long cpu_ns)
+{
+    if(index < bound_.size() && bound_[index] != NULL)
+	bound_[index]->cpu_ns += cpu_ns;
+}
+
+/**
+ * @brief Returns the effective period of a plugin.
+ *
+ * @param index Index the plugin is bound to (see bind_plugin()).
+ * @param period_sec Its configured period, returned for unbound plugins.
+ */
+int cpu_governor::period(size_t index, int period_sec) const
+{
+    if(index >= bound_.size() || bound_[index] == NULL)
+	return period_sec;
+    return bound_[index]->period_sec * bound_[index]->stretch;
+}
+
+/**
+ * @brief Compares the usage of the window with the budget once the window
+ * is over, and stretches or shrinks a period accordingly.
+ *
+ * @param now_ns Current time, as returned by self_telemetry::now_ns().
+ * @param changes Filled with the periods changed (at most one).
+ *
+ * @return True if a period changed.
+ */
+bool cpu_governor::evaluate(long long now_ns, vector<governor_change> &changes)
+{
+    changes.clear();
+    long long cpu_ns = process_cpu_ns();
+    if(window_start_ns_ == 0) {
+	window_start_ns_ = now_ns;
+	window_start_cpu_ns_ = cpu_ns;
+	return false;
+    }
+    //Every plugin must have run within the window for its cost to count
+    long long window_ns = window_ns_;
+    for(map<string, governed_plugin>::iterator it = plugins_.begin();
+	it != plugins_.end(); ++it) {
+	long long period_ns = it->second.period_sec * it->second.stretch * 1000000000LL;
+	if(period_ns > window_ns)
+	    window_ns = period_ns;
+    }
+    long long elapsed_ns = now_ns - window_start_ns_;
+    if(elapsed_ns < window_ns)
+	return false;
+
+    double usage = (double) (cpu_ns - window_start_cpu_ns_) / elapsed_ns;
+    ostringstream reason;
+    reason.setf(ios::fixed);
+    reason.precision(2);
+
+    if(usage > budget_) {
+	map<string, governed_plugin>::iterator costliest = plugins_.end();
+	for(map<string, governed_plugin>::iterator it = plugins_.begin();
+	    it != plugins_.end(); ++it) {
+	    if(it->second.stretch * 2 > max_stretch_ || it->second.cpu_ns == 0)
+		continue;
+	    if(costliest == plugins_.end() || it->second.cpu_ns > costliest->second.cpu_ns)
+		costliest = it;
+	}
+
+	if(costliest != plugins_.end()) {
+	    int previous = costliest->second.period_sec * costliest->second.stretch;
+	    costliest->second.stretch *= 2;
+	    stretched_.push_back(costliest->first);
+	    reason << "cpu " << usage * 100 << "% over budget " << budget_ * 100
+		   << "%, plugin cost " << costliest->second.cpu_ns * 100.0 / elapsed_ns << "%";
+
+	    governor_change change;
+	    change.plugin_name = costliest->first;
+	    change.previous_period_sec = previous;
+	    change.period_sec = costliest->second.period_sec * costliest->second.stretch;
+	    change.reason = reason.str();
+	    changes.push_back(change);
+	}
+    }
+    else if(!stretched_.empty()) {
+	governed_plugin &last = plugins_[stretched_.back()];
+	double projected = usage + (double) last.cpu_ns / elapsed_ns;
+	if(projected <= budget_ * 0.9) {
+	    int previous = last.period_sec * last.stretch;
+	    last.stretch /= 2;
+	    reason << "cpu " << usage * 100 << "% under budget " << budget_ * 100
+		   << "%, " << projected * 100 << "% expected after shrinking";
+
+	    governor_change change;
+	    change.plugin_name = stretched_.back();
+	    change.previous_period_sec = previous;
+	    change.period_sec = last.period_sec * last.stretch;
+	    change.reason = reason.str();
+	    changes.push_back(change);
+	    stretched_.pop_back();
+	}
+    }
+
+    window_start_ns_ = now_ns;
+    window_start_cpu_ns_ = cpu_ns;
+    for(map<string, governed_plugin>::iterator it = plugins_.begin();
+	it != plugins_.end(); ++it)
+	it->second.cpu_ns = 0;
+    return !changes.empty();
+}
+
+/**
+ * @brief Discards what was measured in the current window; the next call to
+ * evaluate() starts a new one.
+ */
+void cpu_governor::reset_window()
+{
+    window_start_ns_ = 0;
+    for(map<string, governed_plugin>::iterator it = plugins_.begin();
+	it != plugins_.end(); ++it)
+	it->second.cpu_ns = 0;
+}
+
+/**
+ * @brief Returns the CPU time consumed by the calling thread, in nanoseconds.
+ */
+long long cpu_governor::thread_cpu_ns()
+{
+#ifndef RTI_WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (long long) (k.QuadPart + u.QuadPart) * 100;
+#endif
+}
+
+/**
+ * @brief Returns the CPU time consumed by the whole process (the DDS
+ * threads included), in nanoseconds.
+ */
+long long cpu_governor::process_cpu_ns()
+{
+#ifndef RTI_WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (long long) (k.QuadPart + u.QuadPart) * 100;
+#endif
+}
@@ -0,0 +1,93 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_GOVERNOR_HPP
+#define CPU_GOVERNOR_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+
+/**
+ * @class governor_change
+ * A change of the effective period of a plugin, and why it was made.
+ */
+struct governor_change {
+    std::string plugin_name;
+    int previous_period_sec;
+    int period_sec;
+    std::string reason;
+};
+
+/**
+ * @class cpu_governor
+ * Keeps the CPU used by the agent under a budget (a share of one core) by
+ * stretching the periods of the plugins. The CPU time of every run is
+ * measured with the thread CPU clock; every window the CPU of the whole
+ * process is compared with the budget:
+ *  - over it, the period of the plugin that cost the most in the window is
+ *    doubled (up to <code>max_stretch</code> times its configured period);
+ *  - under it, the last stretch is undone if the plugin, run twice as often,
+ *    would still leave 10% of the budget free.
+ * At most one period changes per window, so that the effect of a change is
+ * measured before the next one. Windows last at least the longest
+ * effective period, so that every plugin runs within them.
+ */
+class cpu_governor {
+public:
+    cpu_governor();
+
+    void configure(double budget, int window_sec, int max_stretch);
+
+    bool enabled() const
+    {
+	return budget_ > 0;
+    }
+
+    void add_plugin(const std::string &plugin_name, int period_sec);
+    void remove_plugin(const std::string &plugin_name);
+    void bind_plugin(size_t index, const std::string &plugin_name);
+    void record_run(size_t index, long long cpu_ns);
+    bool evaluate(long long now_ns, std::vector<governor_change> &changes);
+    void reset_window();
+    int period(size_t index, int period_sec) const;
+
+    static long long thread_cpu_ns();
+    static long long process_cpu_ns();
+
+private:
+    struct governed_plugin {
+	int period_sec;
+	int stretch;
+	long long cpu_ns;
+    };
+
+    double budget_;
+    long long window_ns_;
+    int max_stretch_;
+
+    long long window_start_ns_;
+    long long window_start_cpu_ns_;
+    std::map<std::string, governed_plugin> plugins_;
+    std::vector<governed_plugin *> bound_;   //plugin index -> entry, NULL if unbound
+    std::vector<std::string> stretched_;
+};
+
+#endif //CPU_GOVERNOR_HPP
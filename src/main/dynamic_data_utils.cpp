@@ -0,0 +1,174 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "dynamic_data_utils.hpp"
+
+using namespace std;
+
+/**
+ * @brief Tells whether members of a kind can be read as numbers.
+ *
+ * @param kind DDS_TCKind of the member.
+ *
+ * @return True for integer, floating point, boolean and octet members.
+ */
+bool is_numeric_kind(int kind)
+{
+    switch(kind) {
+    case DDS_TK_SHORT:
+    case DDS_TK_USHORT:
+    case DDS_TK_LONG:
+    case DDS_TK_ENUM:
+    case DDS_TK_ULONG:
+    case DDS_TK_LONGLONG:
+    case DDS_TK_ULONGLONG:
+    case DDS_TK_FLOAT:
+    case DDS_TK_DOUBLE:
+    case DDS_TK_BOOLEAN:
+    case DDS_TK_OCTET:
+	return true;
+    default:
+	return false;
+    }
+}
+
+/**
+ * @brief Reads a numeric member of a sample as a double.
+ *
+ * @param data The sample.
+ * @param name Name of the member.
+ * @param kind DDS_TCKind of the member, as given by the type code.
+ * @param number Set to the value of the member.
+ *
+ * @return False if the member is not numeric or could not be read.
+ */
+bool get_numeric_member(const DDS_DynamicData &data,
+			const char *name,
+			int kind,
+			double &number)
+{
+    DDS_ReturnCode_t retcode;
+
+    switch(kind) {
+    case DDS_TK_SHORT: {
+	DDS_Short v; retcode = data.get_short(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    case DDS_TK_USHORT: {
+	DDS_UnsignedShort v; retcode = data.get_ushort(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    case DDS_TK_LONG:
+    case DDS_TK_ENUM: {
+	DDS_Long v; retcode = data.get_long(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    case DDS_TK_ULONG: {
+	DDS_UnsignedLong v; retcode = data.get_ulong(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    case DDS_TK_LONGLONG: {
+	DDS_LongLong v; retcode = data.get_longlong(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = (double) v; break;
+    }
+    case DDS_TK_ULONGLONG: {
+	DDS_UnsignedLongLong v; retcode = data.get_ulonglong(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = (double) v; break;
+    }
+    case DDS_TK_FLOAT: {
+	DDS_Float v; retcode = data.get_float(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    case DDS_TK_DOUBLE: {
+	DDS_Double v; retcode = data.get_double(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    case DDS_TK_BOOLEAN: {
+	DDS_Boolean v; retcode = data.get_boolean(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v ? 1 : 0; break;
+    }
+    case DDS_TK_OCTET: {
+	DDS_Octet v; retcode = data.get_octet(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	number = v; break;
+    }
+    default:
+	return false;
+    }
+
+    return retcode == DDS_RETCODE_OK;
+}
+
+/**
+ * @brief Reads a string, char or numeric member of a sample as text
+ * (e.g. to identify the instance a sample belongs to).
+ *
+ * @param data The sample.
+ * @param name Name of the member.
+ * @param kind DDS_TCKind of the member.
+ * @param buffer Reusable buffer for string members, grown as needed.
+ * @param value Set to the text of the member.
+ *
+ * @return False if the member could not be read.
+ */
+bool get_member_as_string(const DDS_DynamicData &data,
+			  const char *name,
+			  int kind,
+			  vector<char> &buffer,
+			  string &value)
+{
+    if(kind == DDS_TK_STRING) {
+	if(buffer.size() < 256)
+	    buffer.resize(256);
+	char *str = &buffer[0];
+	DDS_UnsignedLong size = buffer.size();
+	DDS_ReturnCode_t retcode =
+	    data.get_string(str, &size, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	if(retcode != DDS_RETCODE_OK && size >= buffer.size()) {
+	    //Too small: size is now the required length
+	    buffer.resize(size + 1);
+	    str = &buffer[0];
+	    size = buffer.size();
+	    retcode = data.get_string(str, &size, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	}
+	if(retcode != DDS_RETCODE_OK)
+	    return false;
+	value.assign(&buffer[0], strlen(&buffer[0]));
+	return true;
+    }
+
+    if(kind == DDS_TK_CHAR) {
+	DDS_Char v;
+	if(data.get_char(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK)
+	    return false;
+	value.assign(1, v);
+	return true;
+    }
+
+    double number;
+    if(!get_numeric_member(data, name, kind, number))
+	return false;
+    char text[32];
+    snprintf(text, sizeof(text), "%.17g", number);
+    value = text;
+    return true;
+}
@@ -0,0 +1,41 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DYNAMIC_DATA_UTILS_HPP
+#define DYNAMIC_DATA_UTILS_HPP
+
+#include <string>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+bool is_numeric_kind(int kind);
+
+bool get_numeric_member(const DDS_DynamicData &data,
+			const char *name,
+			int kind,
+			double &number);
+
+bool get_member_as_string(const DDS_DynamicData &data,
+			  const char *name,
+			  int kind,
+			  std::vector<char> &buffer,
+			  std::string &value);
+
+#endif //DYNAMIC_DATA_UTILS_HPP
@@ -0,0 +1,421 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include "egress_shaper.hpp"
+
+using namespace std;
+
+/**
+ * @brief Depth of a bucket letting through <code>burst_ns</code> worth of
+ * its rate at once (at least one unit).
+ */
+static double bucket_depth(double rate, long long burst_ns)
+{
+    double depth = rate * burst_ns / 1e9;
+    return depth < 1 ? 1 : depth;
+}
+
+
+token_bucket::token_bucket() : rate_(0), depth_(0), tokens_(0), last_ns_(0)
+{
+}
+
+/**
+ * @brief Sets the rate and the depth of the bucket, which starts full.
+ */
+void token_bucket::configure(double rate, double depth)
+{
+    rate_ = rate;
+    depth_ = depth;
+    tokens_ = depth;
+    last_ns_ = 0;
+}
+
+double token_bucket::available(long long now_ns) const
+{
+    if(last_ns_ == 0)
+	return depth_;
+    double tokens = tokens_ + (now_ns - last_ns_) * rate_ / 1e9;
+    return tokens > depth_ ? depth_ : tokens;
+}
+
+/**
+ * @brief Returns how long to wait before <code>amount</code> can be taken
+ * (0 if it can be taken now).
+ */
+long long token_bucket::wait_ns(double amount, long long now_ns) const
+{
+    if(rate_ <= 0)
+	return 0;
+    double needed = (amount < depth_ ? amount : depth_) - available(now_ns);
+    if(needed <= 0)
+	return 0;
+    return (long long) (needed * 1e9 / rate_) + 1;
+}
+
+void token_bucket::take(double amount, long long now_ns)
+{
+    if(rate_ <= 0)
+	return;
+    tokens_ = available(now_ns) - amount;
+    last_ns_ = now_ns;
+}
+
+
+egress_shaper::egress_shaper()
+    : enabled_(false),
+      burst_ns_(0),
+      spread_(0),
+      max_queue_(0),
+      period_ns_(0),
+      cursor_(0)
+{
+}
+
+egress_shaper::~egress_shaper()
+{
+    for(size_t i = 0; i < streams_.size(); i++) {
+	if(streams_[i]->count > 0)
+	    cerr << streams_[i]->plugin_name << ": " << streams_[i]->count
+		 << " samples still queued for egress were discarded" << endl;
+	delete streams_[i]->data;
+	delete streams_[i];
+    }
+}
+
+/**
+ * @brief Enables the shaper.
+ *
+ * @param samples_per_sec Samples per second of all the plugins together (0
+ * or less: no limit).
+ * @param bytes_per_sec Bytes per second of all the plugins together (0 or
+ * less: no limit).
+ * @param burst_ms Milliseconds worth of tokens the buckets hold.
+ * @param spread Fraction of the publishing period the burst of a run is
+ * spread over, for the plugins not setting their own (0: no spreading).
+ * @param max_queue Samples queued per plugin at most.
+ * @param period_sec Publishing period.
+ */
+void egress_shaper::configure(double samples_per_sec,
+			      double bytes_per_sec,
+			      int burst_ms,
+			      double spread,
+			      int max_queue,
+			      int period_sec)
+{
+    enabled_ = true;
+    burst_ns_ = (burst_ms > 0 ? burst_ms : 1) * 1000000LL;
+    spread_ = spread > 1 ? 1 : spread;
+    max_queue_ = max_queue > 0 ? max_queue : 1;
+    period_ns_ = period_sec * 1000000000LL;
+    samples_.configure(samples_per_sec, bucket_depth(samples_per_sec, burst_ns_));
+    bytes_.configure(bytes_per_sec, bucket_depth(bytes_per_sec, burst_ns_));
+}
+
+/**
+ * @brief Declares a plugin. Its samples are queued only if something
+ * shapes them: spreading, or a limit of its own or of all the plugins.
+ *
+ * @param plugin_name Name of the plugin.
+ * @param writer DataWriter the samples are released to.
+ * @param type_code Type of the samples.
+ * @param samples_per_sec Samples per second of the plugin (0 or less: no
+ * limit).
+ * @param bytes_per_sec Bytes per second of the plugin (0 or less: no limit).
+ * @param spread Fraction of the period its bursts are spread over; negative
+ * to use the one of the shaper.
+ *
+ * @return False if the type cannot be queued.
+ */
+bool egress_shaper::add_plugin(const string &plugin_name,
+			       DDSDynamicDataWriter *writer,
+			       const DDS_TypeCode *type_code,
+			       double samples_per_sec,
+			       double bytes_per_sec,
+			       double spread)
+{
+    if(spread < 0)
+	spread = spread_;
+    else if(spread > 1)
+	spread = 1;
+    if(spread <= 0 && samples_per_sec <= 0 && bytes_per_sec <= 0 &&
+       !samples_.limited() && !bytes_.limited())
+	return true;
+
+    vector<char> description;
+    if(!encode_type(type_code, description)) {
+	cerr << plugin_name << ": the samples of this type cannot be shaped" << endl;
+	return false;
+    }
+
+    shaped_stream *stream = new shaped_stream();
+    stream->plugin_name = plugin_name;
+    stream->plugin_index = (size_t) -1;
+    stream->writer = writer;
+    stream->data = new DDS_DynamicData(type_code, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+    stream->samples.configure(samples_per_sec, bucket_depth(samples_per_sec, burst_ns_));
+    stream->bytes.configure(bytes_per_sec, bucket_depth(bytes_per_sec, burst_ns_));
+    stream->spread = spread;
+    stream->head = 0;
+    stream->count = 0;
+    stream->dropped = 0;
+    stream->next_ns = 0;
+    stream->interval_ns = 0;
+
+    index_[plugin_name] = streams_.size();
+    streams_.push_back(stream);
+    return true;
+}
+
+/**
+ * @brief Forgets a plugin (e.g. before its DataWriter is deleted),
+ * discarding the samples it has queued.
+ */
+void egress_shaper::remove_plugin(const string &plugin_name)
+{
+    map<string, size_t>::iterator it = index_.find(plugin_name);
+    if(it == index_.end())
+	return;
+    size_t removed = it->second;
+    shaped_stream *stream = streams_[removed];
+    if(stream->count > 0)
+	cerr << plugin_name << ": " << stream->count
+	     << " samples still queued for egress were discarded" << endl;
+    if(stream->plugin_index < bound_.size() && bound_[stream->plugin_index] == stream)
+	bound_[stream->plugin_index] = NULL;
+    delete stream->data;
+    delete stream;
+
+    streams_.erase(streams_.begin() + removed);
+    index_.erase(it);
+    for(it = index_.begin(); it != index_.end(); ++it)
+	if(it->second > removed)
+	    it->second--;
+    if(cursor_ > removed)
+	cursor_--;
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its stream, if it is shaped, so that queueing its samples does not
+ * look its name up.
+ */
+void egress_shaper::bind_plugin(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    map<string, size_t>::const_iterator it = index_.find(plugin_name);
+    bound_[index] = (it != index_.end()) ? streams_[it->second] : NULL;
+    if(bound_[index] != NULL)
+	bound_[index]->plugin_index = index;
+}
+
+/**
+ * @brief Queues a sample of a plugin.
+ *
+ * @param index Index the plugin is bound to (see bind_plugin()).
+ * @param timestamp Source timestamp it is written with once released.
+ *
+ * @return False if the plugin is not shaped or the sample cannot be encoded.
+ */
+bool egress_shaper::enqueue(size_t index,
+			    const DDS_DynamicData &data,
+			    long long now_ns,
+			    unsigned long long timestamp)
+{
+    if(!shapes(index))
+	return false;
+    shaped_stream &stream = *bound_[index];
+
+    shaped_sample &sample = push(stream);
+    sample.buffer.clear();
+    if(!encoder_.encode(data, sample.buffer)) {
+	stream.count--;
+	return false;
+    }
+    sample.enqueued_ns = now_ns;
+    sample.timestamp = timestamp;
+    return true;
+}
+
+/**
+ * @brief Spreads what a plugin queued over the period, once its run is over.
+ *
+ * Samples still queued from previous runs are spread along with the new
+ * ones.
+ */
+void egress_shaper::end_run(size_t index, long long now_ns)
+{
+    if(!shapes(index))
+	return;
+    shaped_stream &stream = *bound_[index];
+    if(stream.count == 0 || stream.spread <= 0)
+	return;
+
+    stream.interval_ns = (long long) (stream.spread * period_ns_ / stream.count);
+    if(stream.next_ns < now_ns)
+	stream.next_ns = now_ns;
+}
+
+/**
+ * @brief Returns the next sample due, decoded, or NULL if none is.
+ *
+ * Plugins are served in turns, one sample each.
+ * @param now_ns Current time, as returned by self_telemetry::now_ns().
+ * @param plugin_name Set to the plugin of the sample.
+ * @param plugin_index Set to the index it is bound to, or (size_t) -1.
+ * @param writer Set to the DataWriter of the plugin.
+ * @param waited_ns Set to the time the sample spent queued.
+ * @param timestamp Set to the source timestamp of the sample.
+ *
+ * @return The sample, valid until the next call.
+ */
+DDS_DynamicData *egress_shaper::next(long long now_ns,
+				     string &plugin_name,
+				     size_t &plugin_index,
+				     DDSDynamicDataWriter *&writer,
+				     long long &waited_ns,
+				     unsigned long long &timestamp)
+{
+    for(size_t n = 0; n < streams_.size(); n++) {
+	size_t i = (cursor_ + n) % streams_.size();
+	shaped_stream &stream = *streams_[i];
+	if(stream.count == 0 || ready_ns(stream, now_ns) > now_ns)
+	    continue;
+
+	shaped_sample &sample = stream.queue[stream.head];
+	double size = (double) sample.buffer.size();
+	stream.samples.take(1, now_ns);
+	stream.bytes.take(size, now_ns);
+	samples_.take(1, now_ns);
+	bytes_.take(size, now_ns);
+	if(stream.interval_ns > 0) {
+	    //Falling behind does not earn a burst
+	    long long earliest = now_ns - stream.interval_ns;
+	    stream.next_ns = (stream.next_ns > earliest ? stream.next_ns : earliest) +
+		stream.interval_ns;
+	}
+
+	waited_ns = now_ns - sample.enqueued_ns;
+	timestamp = sample.timestamp;
+	bool decoded = !sample.buffer.empty() &&
+	    decoder_.decode(&sample.buffer[0], sample.buffer.size(), *stream.data);
+	pop(stream);
+	if(stream.count == 0 && stream.dropped > 0) {
+	    cerr << stream.plugin_name << ": egress queue drained (" << stream.dropped
+		 << " samples dropped while full)" << endl;
+	    stream.dropped = 0;
+	}
+	if(!decoded)
+	    continue;
+
+	cursor_ = i + 1;
+	plugin_name = stream.plugin_name;
+	plugin_index = stream.plugin_index;
+	writer = stream.writer;
+	return stream.data;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns when the next sample will be due, or -1 if none is queued.
+ */
+long long egress_shaper::next_release_ns(long long now_ns) const
+{
+    long long earliest = -1;
+    for(size_t i = 0; i < streams_.size(); i++) {
+	if(streams_[i]->count == 0)
+	    continue;
+	long long ready = ready_ns(*streams_[i], now_ns);
+	if(earliest < 0 || ready < earliest)
+	    earliest = ready;
+    }
+    return earliest;
+}
+
+/**
+ * @brief Returns when the first queued sample of a stream can be released.
+ */
+long long egress_shaper::ready_ns(const shaped_stream &stream, long long now_ns) const
+{
+    double size = (double) stream.queue[stream.head].buffer.size();
+    long long wait = 0;
+    long long bucket_wait;
+
+    if(stream.interval_ns > 0 && stream.next_ns - now_ns > wait)
+	wait = stream.next_ns - now_ns;
+    if((bucket_wait = stream.samples.wait_ns(1, now_ns)) > wait)
+	wait = bucket_wait;
+    if((bucket_wait = stream.bytes.wait_ns(size, now_ns)) > wait)
+	wait = bucket_wait;
+    if((bucket_wait = samples_.wait_ns(1, now_ns)) > wait)
+	wait = bucket_wait;
+    if((bucket_wait = bytes_.wait_ns(size, now_ns)) > wait)
+	wait = bucket_wait;
+    return now_ns + wait;
+}
+
+/**
+ * @brief Makes room for a sample at the end of the queue of a stream,
+ * growing the ring up to max_queue samples and dropping the oldest one
+ * beyond that.
+ */
+egress_shaper::shaped_sample &egress_shaper::push(shaped_stream &stream)
+{
+    if(stream.count == stream.queue.size()) {
+	if(stream.queue.size() < max_queue_) {
+	    size_t size = stream.queue.size() * 2;
+	    if(size < 16)
+		size = 16;
+	    if(size > max_queue_)
+		size = max_queue_;
+
+	    //Unroll the ring, moving the buffers instead of copying them
+	    vector<shaped_sample> grown(size);
+	    for(size_t k = 0; k < stream.count; k++) {
+		shaped_sample &from = stream.queue[(stream.head + k) % stream.queue.size()];
+		grown[k].enqueued_ns = from.enqueued_ns;
+		grown[k].timestamp = from.timestamp;
+		grown[k].buffer.swap(from.buffer);
+	    }
+	    stream.queue.swap(grown);
+	    stream.head = 0;
+	}
+	else {
+	    if(stream.dropped++ == 0)
+		cerr << stream.plugin_name << ": egress queue full ("
+		     << stream.count << " samples), dropping the oldest" << endl;
+	    pop(stream);
+	}
+    }
+
+    shaped_sample &sample = stream.queue[(stream.head + stream.count) % stream.queue.size()];
+    stream.count++;
+    return sample;
+}
+
+void egress_shaper::pop(shaped_stream &stream)
+{
+    stream.head = (stream.head + 1) % stream.queue.size();
+    stream.count--;
+}
@@ -0,0 +1,172 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EGRESS_SHAPER_HPP
+#define EGRESS_SHAPER_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+#include "sample_codec.hpp"
+
+/**
+ * @class token_bucket
+ * Allows <code>rate</code> units per second in bursts of at most
+ * <code>depth</code> units. A rate of 0 or less means no limit. Amounts
+ * larger than the depth are let through once the bucket is full, leaving
+ * it in debt.
+ */
+class token_bucket {
+public:
+    token_bucket();
+
+    void configure(double rate, double depth);
+
+    bool limited() const
+    {
+	return rate_ > 0;
+    }
+
+    long long wait_ns(double amount, long long now_ns) const;
+    void take(double amount, long long now_ns);
+
+private:
+    double available(long long now_ns) const;
+
+    double rate_;
+    double depth_;
+    double tokens_;
+    long long last_ns_;
+};
+
+/**
+ * @class egress_shaper
+ * Paces the samples written by the plugins. Samples of shaped plugins are
+ * queued (encoded with sample_encoder) instead of being written during the
+ * run of the plugin, and released afterwards by next():
+ *  - the burst of every run is spread evenly over <code>spread</code> times
+ *    the publishing period;
+ *  - a global token bucket and one per plugin bound the samples and bytes
+ *    (encoded size) per second, in bursts of <code>burst_ms</code> worth
+ *    of tokens.
+ * The queue of a plugin holds at most <code>max_queue</code> samples; the
+ * oldest are dropped beyond that. Buffers are reused, so a steady flow of
+ * samples does not allocate.
+ */
+class egress_shaper {
+public:
+    egress_shaper();
+    ~egress_shaper();
+
+    void configure(double samples_per_sec,
+		   double bytes_per_sec,
+		   int burst_ms,
+		   double spread,
+		   int max_queue,
+		   int period_sec);
+
+    bool enabled() const
+    {
+	return enabled_;
+    }
+
+    bool add_plugin(const std::string &plugin_name,
+		    DDSDynamicDataWriter *writer,
+		    const DDS_TypeCode *type_code,
+		    double samples_per_sec,
+		    double bytes_per_sec,
+		    double spread);
+    void remove_plugin(const std::string &plugin_name);
+    void bind_plugin(size_t index, const std::string &plugin_name);
+
+    /**
+     * @brief Tells whether the samples of a plugin are queued.
+     *
+     * @param index Index the plugin is bound to (see bind_plugin()).
+     */
+    bool shapes(size_t index) const
+    {
+	return index < bound_.size() && bound_[index] != NULL;
+    }
+
+    bool enqueue(size_t index,
+		 const DDS_DynamicData &data,
+		 long long now_ns,
+		 unsigned long long timestamp);
+    void end_run(size_t index, long long now_ns);
+
+    DDS_DynamicData *next(long long now_ns,
+			  std::string &plugin_name,
+			  size_t &plugin_index,
+			  DDSDynamicDataWriter *&writer,
+			  long long &waited_ns,
+			  unsigned long long &timestamp);
+    long long next_release_ns(long long now_ns) const;
+
+private:
+    struct shaped_sample {
+	long long enqueued_ns;
+	unsigned long long timestamp;
+	std::vector<char> buffer;
+    };
+
+    struct shaped_stream {
+	std::string plugin_name;
+	size_t plugin_index;    //Index it is bound to, or (size_t) -1
+	DDSDynamicDataWriter *writer;
+	DDS_DynamicData *data;
+	token_bucket samples;
+	token_bucket bytes;
+	double spread;
+
+	//Ring of queued samples
+	std::vector<shaped_sample> queue;
+	size_t head;
+	size_t count;
+	unsigned long long dropped;
+
+	//Pacing of the burst of the last run
+	long long next_ns;
+	long long interval_ns;
+    };
+
+    long long ready_ns(const shaped_stream &stream, long long now_ns) const;
+    shaped_sample &push(shaped_stream &stream);
+    void pop(shaped_stream &stream);
+
+    bool enabled_;
+    long long burst_ns_;
+    double spread_;
+    size_t max_queue_;
+    long long period_ns_;
+    token_bucket samples_;
+    token_bucket bytes_;
+
+    std::vector<shaped_stream *> streams_;
+    std::map<std::string, size_t> index_;
+    std::vector<shaped_stream *> bound_;   //plugin index -> stream, NULL if unbound
+    size_t cursor_;
+    sample_encoder encoder_;
+    sample_decoder decoder_;
+};
+
+#endif //EGRESS_SHAPER_HPP
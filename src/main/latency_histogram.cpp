@@ -0,0 +1,137 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency_histogram.hpp"
+
+#define SUB_BUCKETS (1ULL << LATENCY_HISTOGRAM_SUB_BITS)
+#define HALF_SUB_BUCKETS (SUB_BUCKETS / 2)
+#define BUCKET_COUNT ((LATENCY_HISTOGRAM_MAX_BITS - LATENCY_HISTOGRAM_SUB_BITS + 2) * HALF_SUB_BUCKETS)
+
+latency_histogram::latency_histogram()
+    : buckets_(BUCKET_COUNT, 0),
+      count_(0),
+      total_(0),
+      max_(0)
+{
+}
+
+/**
+ * @brief Returns the bucket of a value.
+ *
+ * Values below SUB_BUCKETS have a bucket each. Above, the bucket is given
+ * by the position of the most significant bit (shift) and the next
+ * LATENCY_HISTOGRAM_SUB_BITS - 1 bits.
+ */
+size_t latency_histogram::index_of(unsigned long long value)
+{
+    if(value < SUB_BUCKETS)
+	return (size_t) value;
+
+    int msb;
+#if defined(__GNUC__)
+    msb = 63 - __builtin_clzll(value);
+#else
+    msb = 0;
+    for(unsigned long long v = value; v > 1; v >>= 1)
+	msb++;
+#endif
+    if(msb >= LATENCY_HISTOGRAM_MAX_BITS)
+	return BUCKET_COUNT - 1;
+
+    int shift = msb - LATENCY_HISTOGRAM_SUB_BITS + 1;
+    return (size_t) (shift * HALF_SUB_BUCKETS + (value >> shift));
+}
+
+/**
+ * @brief Returns the highest value that falls in a bucket.
+ */
+unsigned long long latency_histogram::highest_of(size_t index)
+{
+    if(index < SUB_BUCKETS)
+	return index;
+
+    int shift = (int) (index / HALF_SUB_BUCKETS) - 1;
+    unsigned long long sub = index % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Records a duration.
+ *
+ * @param value Duration in nanoseconds (negative values count as 0).
+ */
+void latency_histogram::record(long long value)
+{
+    if(value < 0)
+	value = 0;
+    buckets_[index_of((unsigned long long) value)]++;
+    count_++;
+    total_ += value;
+    if(value > max_)
+	max_ = value;
+}
+
+/**
+ * @brief Forgets all the recorded values.
+ */
+void latency_histogram::reset()
+{
+    if(count_ == 0)
+	return;
+    for(size_t i = 0; i < buckets_.size(); i++)
+	buckets_[i] = 0;
+    count_ = 0;
+    total_ = 0;
+    max_ = 0;
+}
+
+/**
+ * @brief Returns the value below which a percentage of the recorded
+ * values fall.
+ *
+ * @param percent Percentage, from 0 to 100.
+ *
+ * @return The highest value of the bucket reaching the percentage (never
+ * above the maximum recorded value), or 0 if nothing was recorded.
+ */
+long long latency_histogram::percentile(double percent) const
+{
+    if(count_ == 0)
+	return 0;
+
+    unsigned long long target = (unsigned long long) (percent / 100.0 * count_ + 0.5);
+    if(target < 1)
+	target = 1;
+    if(target > count_)
+	target = count_;
+
+    unsigned long long seen = 0;
+    for(size_t i = 0; i < buckets_.size(); i++) {
+	seen += buckets_[i];
+	if(seen >= target) {
+	    //The last bucket also holds every value beyond the range
+	    if(i == buckets_.size() - 1)
+		return max_;
+	    long long value = (long long) highest_of(i);
+	    return value < max_ ? value : max_;
+	}
+    }
+    return max_;
+}
@@ -0,0 +1,73 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstddef>
+#include <vector>
+
+//Each power of two is split in 2^(LATENCY_HISTOGRAM_SUB_BITS - 1) linear
+//buckets, so recorded values are exact to within ~3%
+#define LATENCY_HISTOGRAM_SUB_BITS 6
+//Values up to 2^LATENCY_HISTOGRAM_MAX_BITS ns (about 18 minutes)
+#define LATENCY_HISTOGRAM_MAX_BITS 40
+
+/**
+ * @class latency_histogram
+ * HDR-style log-linear histogram of durations in nanoseconds. Recording a
+ * value is a couple of shifts and an increment in a fixed array, so it can
+ * be done on every write without measurable overhead.
+ */
+class latency_histogram {
+public:
+    latency_histogram();
+
+    void record(long long value);
+    void reset();
+
+    unsigned long long count() const
+    {
+	return count_;
+    }
+
+    long long max() const
+    {
+	return max_;
+    }
+
+    long long total() const
+    {
+	return total_;
+    }
+
+    long long percentile(double percent) const;
+
+private:
+    static size_t index_of(unsigned long long value);
+    static unsigned long long highest_of(size_t index);
+
+    std::vector<unsigned int> buckets_;
+    unsigned long long count_;
+    long long total_;
+    long long max_;
+};
+
+#endif //LATENCY_HISTOGRAM_HPP
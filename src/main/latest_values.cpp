@@ -0,0 +1,370 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#ifndef RTI_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "latest_values.hpp"
+#include "dynamic_data_utils.hpp"
+#define CAVECANEM_LATEST_NO_READER
+#include "cavecanem_latest.h"
+
+using namespace std;
+
+/**
+ * @brief Returns the kind letter of a member in the layout strings of
+ * cavecanem_latest.h.
+ */
+static char layout_kind(const DDS_TypeCode *type)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_TCKind kind = type->kind(ex);
+    while(kind == DDS_TK_ALIAS) {
+	type = type->content_type(ex);
+	kind = type->kind(ex);
+    }
+
+    switch(kind) {
+    case DDS_TK_BOOLEAN: return 'b';
+    case DDS_TK_OCTET: return 'o';
+    case DDS_TK_CHAR: return 'c';
+    case DDS_TK_SHORT: return 'h';
+    case DDS_TK_USHORT: return 'H';
+    case DDS_TK_LONG:
+    case DDS_TK_ENUM: return 'l';
+    case DDS_TK_ULONG: return 'L';
+    case DDS_TK_LONGLONG: return 'q';
+    case DDS_TK_ULONGLONG: return 'Q';
+    case DDS_TK_FLOAT: return 'f';
+    case DDS_TK_DOUBLE: return 'd';
+    case DDS_TK_STRING: return 's';
+    default: return 'x';
+    }
+}
+
+
+latest_values::latest_values()
+    : header_(NULL),
+      slots_(NULL),
+      mapped_size_(0),
+      expire_ns_(0)
+{
+}
+
+latest_values::~latest_values()
+{
+#ifndef RTI_WIN32
+    if(header_ != NULL)
+	munmap(header_, mapped_size_);
+#endif
+}
+
+/**
+ * @brief Creates (or reuses) and maps the shared-memory region.
+ *
+ * The region is reset, so rows of a previous run are not served.
+ * @param name Name of the object (e.g. "/cavecanem_latest").
+ * @param slots Number of rows of the table.
+ * @param slot_size Bytes per row, slot header included (rounded up to 8).
+ * @param expire_sec Rows not updated for this long are removed.
+ * @param error Set to a description of the problem when false is returned.
+ */
+bool latest_values::open(const string &name,
+			 unsigned int slots,
+			 unsigned int slot_size,
+			 int expire_sec,
+			 string &error)
+{
+#ifndef RTI_WIN32
+    if(name.empty() || name[0] != '/') {
+	error = "the latest values region requires a name starting with '/'";
+	return false;
+    }
+    slot_size = (slot_size + 7) & ~7U;
+    if(slot_size < 128 || slot_size > CC_LATEST_MAX_SLOT_SIZE) {
+	error = "the slot size of the latest values region must be between 128 and 4096 bytes";
+	return false;
+    }
+    if(slots == 0) {
+	error = "the latest values region requires at least one slot";
+	return false;
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if(fd < 0) {
+	error = "cannot open shared memory " + name + ": " + strerror(errno);
+	return false;
+    }
+    mapped_size_ = sizeof(cc_latest_header) + (size_t) slots * slot_size;
+    if(ftruncate(fd, mapped_size_) != 0) {
+	error = "cannot size shared memory " + name + ": " + strerror(errno);
+	close(fd);
+	return false;
+    }
+    void *address = mmap(NULL, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED) {
+	error = "cannot map shared memory " + name + ": " + strerror(errno);
+	return false;
+    }
+
+    header_ = (cc_latest_header *) address;
+    slots_ = (char *) address + sizeof(cc_latest_header);
+    expire_ns_ = expire_sec > 0 ? expire_sec * 1000000000LL : 0;
+
+    //Invalidate the magic while the region is rewritten
+    memset(header_->magic, 0, sizeof(header_->magic));
+    __sync_synchronize();
+    header_->version = CC_LATEST_VERSION;
+    header_->header_size = sizeof(cc_latest_header);
+    header_->slot_count = slots;
+    header_->slot_size = slot_size;
+    header_->stream_count = 0;
+    header_->reserved = 0;
+    header_->dropped = 0;
+    memset(header_->streams, 0, sizeof(header_->streams));
+    memset(slots_, 0, (size_t) slots * slot_size);
+    __sync_synchronize();
+    memcpy(header_->magic, CC_LATEST_MAGIC, sizeof(header_->magic));
+    return true;
+#else
+    error = "the latest values region is not available on Windows";
+    return false;
+#endif
+}
+
+/**
+ * @brief Declares a plugin: publishes its layout and finds its key members.
+ *
+ * @return False if there is no room for another plugin.
+ */
+bool latest_values::add_stream(const string &plugin_name,
+			       const DDS_TypeCode *type_code)
+{
+    if(streams_.find(plugin_name) != streams_.end())
+	return true;
+    if(streams_.size() >= CC_LATEST_MAX_STREAMS) {
+	cerr << "Too many plugins for the latest values region: " << plugin_name
+	     << " ignored" << endl;
+	return false;
+    }
+
+    stream_info stream;
+    stream.id = streams_.size();
+    string layout;
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_UnsignedLong count = type_code->member_count(ex);
+    for(DDS_UnsignedLong i = 0; i < count; i++) {
+	string name = type_code->member_name(i, ex);
+	const DDS_TypeCode *member_type = type_code->member_type(i, ex);
+	if(type_code->is_member_key(i, ex)) {
+	    stream.keys.push_back(name);
+	    stream.key_kinds.push_back(member_type->kind(ex));
+	}
+
+	string entry = name + ':' + layout_kind(member_type);
+	if(layout.size() + entry.size() + 1 >= CC_LATEST_LAYOUT_LENGTH) {
+	    cerr << "latest values: layout of " << plugin_name << " truncated at "
+		 << name << endl;
+	    break;
+	}
+	if(!layout.empty())
+	    layout += ';';
+	layout += entry;
+    }
+
+    cc_latest_stream &entry = header_->streams[stream.id];
+    strncpy(entry.plugin, plugin_name.c_str(), CC_LATEST_NAME_LENGTH - 1);
+    strncpy(entry.layout, layout.c_str(), CC_LATEST_LAYOUT_LENGTH - 1);
+    __sync_synchronize();
+    header_->stream_count = stream.id + 1;
+
+    streams_[plugin_name] = stream;
+    return true;
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its stream, if it was added, so that updates do not look its name up.
+ */
+void latest_values::bind_stream(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    map<string, stream_info>::iterator it = streams_.find(plugin_name);
+    bound_[index] = (it != streams_.end()) ? &it->second : NULL;
+}
+
+/**
+ * @brief Stores a sample as the latest row of its instance.
+ *
+ * The stream of a plugin not bound yet is looked up by name (and added if
+ * needed), and then bound if the index was given one by bind_stream().
+ * @param plugin_name Name of the plugin.
+ * @param index Index the plugin is bound to (see bind_stream()).
+ * @param data The sample.
+ */
+void latest_values::update(const string &plugin_name,
+			   size_t index,
+			   const DDS_DynamicData &data)
+{
+    stream_info *bound = index < bound_.size() ? bound_[index] : NULL;
+    if(bound == NULL) {
+	if(!add_stream(plugin_name, data.get_type()))
+	    return;
+	bound = &streams_[plugin_name];
+	if(index < bound_.size())
+	    bound_[index] = bound;
+    }
+    const stream_info &stream = *bound;
+
+    key_.clear();
+    for(size_t i = 0; i < stream.keys.size(); i++) {
+	if(!get_member_as_string(data, stream.keys[i].c_str(), stream.key_kinds[i],
+				 buffer_, key_value_))
+	    key_value_.clear();
+	if(i > 0)
+	    key_ += ' ';
+	key_ += stream.keys[i];
+	key_ += '=';
+	key_ += key_value_;
+    }
+
+    data_.clear();
+    if(!encoder_.encode(data, data_) ||
+       sizeof(cc_latest_slot) + key_.size() + data_.size() > header_->slot_size) {
+	header_->dropped = header_->dropped + 1;
+	return;
+    }
+
+    long long now = now_ns();
+    row_name_ = plugin_name;
+    row_name_ += '\0';
+    row_name_ += key_;
+    unsigned long long hash = cc_latest_hash(plugin_name.c_str(), key_.data(), key_.size());
+
+    map<string, row_info>::iterator row = rows_.find(row_name_);
+    if(row == rows_.end()) {
+	int slot = find_free_slot(hash);
+	if(slot < 0) {
+	    header_->dropped = header_->dropped + 1;
+	    return;
+	}
+	row_info info;
+	info.slot = slot;
+	row = rows_.insert(make_pair(row_name_, info)).first;
+    }
+    row->second.updated_ns = now;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    write_slot(row->second.slot, CC_LATEST_SLOT_USED, stream.id, key_, data_,
+	       ts.tv_sec * 1000000000LL + ts.tv_nsec, hash);
+}
+
+/**
+ * @brief Turns the rows not updated within the expiry time into tombstones.
+ * Called once per publishing tick.
+ */
+void latest_values::expire()
+{
+    if(expire_ns_ <= 0)
+	return;
+
+    long long now = now_ns();
+    vector<char> none;
+    for(map<string, row_info>::iterator it = rows_.begin(); it != rows_.end(); ) {
+	if(now - it->second.updated_ns > expire_ns_) {
+	    write_slot(it->second.slot, CC_LATEST_SLOT_TOMBSTONE, 0, "", none, 0, 0);
+	    rows_.erase(it++);
+	}
+	else {
+	    ++it;
+	}
+    }
+}
+
+/**
+ * @brief Returns a monotonic time in nanoseconds.
+ */
+long long latest_values::now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Finds where a new row goes: the first empty slot or tombstone
+ * probing linearly from its hash, so that readers probing until an empty
+ * slot find it.
+ *
+ * @return The slot, or -1 if the table is full.
+ */
+int latest_values::find_free_slot(unsigned long long hash)
+{
+    unsigned int count = header_->slot_count;
+    unsigned int index = hash % count;
+    for(unsigned int probes = 0; probes < count; probes++) {
+	cc_latest_slot *slot = (cc_latest_slot *) (slots_ + (size_t) index * header_->slot_size);
+	if(slot->state != CC_LATEST_SLOT_USED)
+	    return index;
+	index = (index + 1) % count;
+    }
+    return -1;
+}
+
+/**
+ * @brief Rewrites a slot under its seqlock: the sequence is odd while the
+ * slot is inconsistent, and readers retry if it changed while they copied.
+ */
+void latest_values::write_slot(unsigned int index,
+			       int state,
+			       unsigned int stream,
+			       const string &key,
+			       const vector<char> &data,
+			       long long timestamp_ns,
+			       unsigned long long hash)
+{
+    cc_latest_slot *slot = (cc_latest_slot *) (slots_ + (size_t) index * header_->slot_size);
+
+    slot->seq = slot->seq + 1;
+    __sync_synchronize();
+    slot->state = state;
+    slot->stream = stream;
+    slot->key_length = key.size();
+    slot->data_length = data.size();
+    slot->timestamp_ns = timestamp_ns;
+    slot->hash = hash;
+    char *payload = (char *) (slot + 1);
+    memcpy(payload, key.data(), key.size());
+    if(!data.empty())
+	memcpy(payload + key.size(), &data[0], data.size());
+    __sync_synchronize();
+    slot->seq = slot->seq + 1;
+}
@@ -0,0 +1,108 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATEST_VALUES_HPP
+#define LATEST_VALUES_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+#include "sample_codec.hpp"
+
+struct cc_latest_header;
+
+/**
+ * @class latest_values
+ * Keeps the last sample of every instance (plugin and key members) in a
+ * shared-memory region laid out as described in cavecanem_latest.h, so that
+ * local consumers (a dashboard, a health check) get the current values
+ * without DDS and without system calls.
+ *
+ * Rows are updated in place under a per-slot seqlock. Where every row lives
+ * is also kept here, so updating a known instance does not probe the table;
+ * instances not updated within the expiry time become tombstones.
+ */
+class latest_values {
+public:
+    latest_values();
+    ~latest_values();
+
+    bool open(const std::string &name,
+	      unsigned int slots,
+	      unsigned int slot_size,
+	      int expire_sec,
+	      std::string &error);
+
+    bool enabled() const
+    {
+	return header_ != NULL;
+    }
+
+    bool add_stream(const std::string &plugin_name,
+		    const DDS_TypeCode *type_code);
+    void bind_stream(size_t index, const std::string &plugin_name);
+    void update(const std::string &plugin_name,
+		size_t index,
+		const DDS_DynamicData &data);
+    void expire();
+
+    static long long now_ns();
+
+private:
+    struct stream_info {
+	unsigned int id;
+	std::vector<std::string> keys;
+	std::vector<int> key_kinds;
+    };
+
+    struct row_info {
+	unsigned int slot;
+	long long updated_ns;
+    };
+
+    int find_free_slot(unsigned long long hash);
+    void write_slot(unsigned int index,
+		    int state,
+		    unsigned int stream,
+		    const std::string &key,
+		    const std::vector<char> &data,
+		    long long timestamp_ns,
+		    unsigned long long hash);
+
+    cc_latest_header *header_;
+    char *slots_;
+    size_t mapped_size_;
+    long long expire_ns_;
+
+    std::map<std::string, stream_info> streams_;
+    std::vector<stream_info *> bound_;   //plugin index -> stream, NULL if unbound
+    std::map<std::string, row_info> rows_;
+
+    std::string key_;
+    std::string key_value_;
+    std::string row_name_;
+    std::vector<char> buffer_;
+    std::vector<char> data_;
+    sample_encoder encoder_;
+};
+
+#endif //LATEST_VALUES_HPP
@@ -25,13 +25,98 @@
 #include <iostream>
 #include <map>
 #include <stdexcept>
+#include <string>
 
-class cc_plugin {
+/**
+ * @class cc_alert
+ * A detection raised by a plugin (e.g. a signature found in a log line). It
+ * is published by the agent on the <code>cavecanem_alert</code> topic.
+ */
+struct cc_alert {
+    std::string rule;     //Identifier of the signature or rule
+    int severity;
+    std::string message;
+    std::string subject;  //What matched (log line, command line...)
+};
 
-    // protected:
-    //     ~cc_plugin(void) {}
+/**
+ * @class cc_tick
+ * Stamp of a run of a plugin: the sequence number of the publishing period
+ * it belongs to and the time the run started. Every sample written in the
+ * run carries both (see cc_plugin::stamp_tick()), so that subscribers can
+ * join the samples of different topics taken in the same period by their
+ * sequence number.
+ */
+struct cc_tick {
+    unsigned long long sequence;
+    long long timestamp_ns;  //Start of the run, since the epoch; also the source timestamp
+};
 
+/**
+ * @class cc_plugin_host
+ * Services the agent offers to its plugins.
+ */
+class cc_plugin_host {
 public:
+    virtual ~cc_plugin_host() {}
+
+    /**
+     * @brief Publishes an alert on behalf of a plugin.
+     *
+     * @param plugin_name Name of the plugin raising the alert.
+     * @param alert The alert.
+     *
+     * @return True if the alert was published.
+     */
+    virtual bool raise_alert(const std::string &plugin_name,
+			     const cc_alert &alert) = 0;
+
+    /**
+     * @brief Lets the agent look at a sample before a plugin publishes it
+     * (e.g. to evaluate the rules of the general configuration).
+     *
+     * @param plugin_name Name of the plugin publishing the sample.
+     * @param data The sample.
+     */
+    virtual void inspect_sample(const std::string &plugin_name,
+				const DDS_DynamicData &data) {}
+
+    /**
+     * @brief Writes a sample on behalf of a plugin.
+     *
+     * Hosts may override it to measure the writes.
+     * @param plugin_name Name of the plugin publishing the sample.
+     * @param writer The DataWriter of the plugin.
+     * @param data The sample.
+     *
+     * @return True if the sample was written.
+     */
+    virtual bool write_sample(const std::string &plugin_name,
+			      DDSDynamicDataWriter *writer,
+			      DDS_DynamicData *data)
+    {
+	inspect_sample(plugin_name, *data);
+	DDS_InstanceHandle_t instance_handle = DDS_HANDLE_NIL;
+	return writer->write(*data, instance_handle) == DDS_RETCODE_OK;
+    }
+};
+
+class cc_plugin {
+public:
+    cc_plugin() : host_(NULL)
+    {
+	tick_.sequence = 0;
+	tick_.timestamp_ns = 0;
+    }
+
+    /**
+     * @brief Destructor of the plugin.
+     *
+     * Virtual, so that destroy_plugin() runs the destructor of the plugin
+     * class and releases what it holds (descriptors, sigar handles...).
+     */
+    virtual ~cc_plugin() {}
+
     /** 
      * @brief Returns the name of the plugin.
      *
@@ -51,7 +136,20 @@ public:
      */
     virtual bool generate_and_publish_information(DDSDynamicDataWriter *writer,
 						  DDS_DynamicData *data) = 0;
-    
+
+    /**
+     * @brief Returns a descriptor that wakes the plugin up when it becomes readable.
+     *
+     * Event-driven plugins (e.g. plugins waiting on inotify) may return a pollable
+     * file descriptor. Whenever it becomes readable the plugin manager calls
+     * generate_and_publish_information() without waiting for the next period.
+     * @return The descriptor, or -1 if the plugin only publishes periodically.
+     */
+    virtual int wakeup_descriptor()
+    {
+	return -1;
+    }
+
     /** 
      * @brief Plugins must use this method to publish the information in generate_and_publish_information().
      * 
@@ -65,6 +163,14 @@ public:
     virtual bool publish_information(DDSDynamicDataWriter *writer,
 				     DDS_DynamicData *data) 
     {
+	if(host_ != NULL) {
+	    if(!host_->write_sample(plugin_name_, writer, data)) {
+		std::cerr << "Error writing instance" << std::endl;
+		return false;
+	    }
+	    return true;
+	}
+
 	DDS_InstanceHandle_t instance_handle = DDS_HANDLE_NIL;
 	DDS_ReturnCode_t retcode = writer->write(*data,instance_handle);
 	if (retcode != DDS_RETCODE_OK) {
@@ -74,6 +180,56 @@ public:
 	return true;
     }
   
+    /**
+     * @brief Sets the agent services the plugin may use. Called by the
+     * plugin manager right after creating the plugin.
+     */
+    void set_host(cc_plugin_host *host, const std::string &plugin_name)
+    {
+	host_ = host;
+	plugin_name_ = plugin_name;
+    }
+
+    /**
+     * @brief Sets the tick of the next run of the plugin. Called by the host
+     * before every call of generate_and_publish_information().
+     */
+    void set_tick(const cc_tick &tick)
+    {
+	tick_ = tick;
+    }
+
+    /**
+     * @brief Stamps a sample with the tick of the run: the sequence number of
+     * its period (<code>tick</code> member) and the time the run started, in
+     * seconds (<code>ts</code>).
+     *
+     * Plugins stamp every row with it instead of reading the clock, so all
+     * the rows of a run share the same time.
+     */
+    void stamp_tick(DDS_DynamicData *data)
+    {
+	data->set_long("ts",
+		       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		       (DDS_Long) (tick_.timestamp_ns / 1000000000LL));
+	data->set_ulonglong("tick",
+			    DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			    tick_.sequence);
+    }
+
+    /**
+     * @brief Publishes an alert on the alert topic of the agent.
+     *
+     * @return False if the alert could not be published (or if the plugin
+     * is not hosted by a plugin manager).
+     */
+    bool raise_alert(const cc_alert &alert)
+    {
+	if(host_ == NULL)
+	    return false;
+	return host_->raise_alert(plugin_name_, alert);
+    }
+
     /** 
      * @brief Deletes the plugin.
      * 
@@ -84,6 +240,11 @@ public:
 	delete this;
     }
 
+protected:
+    cc_plugin_host *host_;
+    std::string plugin_name_;
+    cc_tick tick_;
+
 };
 
 /** 
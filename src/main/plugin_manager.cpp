@@ -19,31 +19,150 @@
  */
 
 
+extern "C" {
+#include <sigar.h>
+}
+
+#include <algorithm>
+
 #include "plugin_manager.hpp"
+#include "config_cache.hpp"
 
 using namespace std;
 
+/**
+ * @brief Path of the XML configuration file of a plugin.
+ *
+ * @param plugin_name Name of the plugin.
+ * @param plugin_library Plugin library (directory) the plugin belongs to.
+ */
+static string plugin_configuration_file(const string &plugin_name,
+					const string &plugin_library)
+{
+    return string(CAVECANEM_DIR) + "/" + plugin_library + "/" +
+	plugin_name + "/" + plugin_name + ".xml";
+}
+
+/**
+ * @brief Appends the time spent since <code>since</code> to the startup
+ * report, and restarts the measure.
+ */
+static void add_phase(string &report, const string &phase, long long &since)
+{
+    long long now = self_telemetry::now_ns();
+    ostringstream text;
+    text << (report.empty() ? " " : ", ") << phase << " " << (now - since) / 1000000.0 << " ms";
+    report += text.str();
+    since = now;
+}
+
 /** 
  * @brief Constructor of the plugin_manager class
  * 
  * The constructor of the plugin_manager class parses the general configuration
  * file by XML_parser. Then, it loads the plugins indicated in the file by using 
- * load_plugins(), and finally it creates all the DDS entities trough initialize_dds().
+ * load_plugins(), compiles the rules of the general configuration by compile_rules(),
+ * and finally it creates all the DDS entities trough initialize_dds(), unless
+ * the sink of the configuration does not use DDS.
+ *
+ * Parsing the XML files (and building their TypeCodes) is skipped when the
+ * binary cache next to <code>cfgfile</code> was written for the same files;
+ * otherwise the cache is rewritten once all the plugins have been loaded.
+ * The time taken by every phase is printed once started.
  * @param cfgfile General XML configuration file.
  */
 plugin_manager::plugin_manager(string cfgfile)
+    : participant_(NULL),
+      publisher_(NULL),
+      cfg_file_(cfgfile),
+      running_(NULL),
+      next_tick_ns_(0),
+      tick_busy_ns_(0),
+      sink_(NULL),
+      recorder_(NULL),
+      run_samples_(0),
+      run_write_ns_(0)
 {
+    tick_.sequence = 0;
+    tick_.timestamp_ns = 0;
+
+    long long start = self_telemetry::now_ns();
+    long long since = start;
 
     //Here we should get all the XML information
     //to deal with the plugins, etc.
-    if(XML_parser::get_singleton()->parse_general_configuration_file(cfgfile))
+    string cache_file = cfg_file_ + ".cache";
+    bool cached = load_config_cache(cache_file, cfg_file_,
+				    general_properties_, plugin_properties_map_);
+    bool parsed = !cached &&
+	XML_parser::get_singleton()->parse_general_configuration_file(cfg_file_);
+    if(parsed)
 	general_properties_ = XML_parser::get_singleton()->get_general_properties();
+    add_phase(startup_report_, cached ? "configuration (cache)" : "configuration", since);
 
     if(!load_plugins()) {
 	unload_plugins();
 	throw runtime_error("The plugin manager was not able to load all the plugins");
     }
+
+    //Only a configuration that was parsed is worth caching
+    if(parsed) {
+	vector<string> sources(1, cfg_file_);
+	for(map<string, list<string> >::iterator it = general_properties_.plugin_list_map.begin();
+	    it != general_properties_.plugin_list_map.end(); ++it)
+	    for(list<string>::iterator it2 = (it->second).begin(); it2 != (it->second).end(); ++it2)
+		sources.push_back(plugin_configuration_file(*it2, it->first));
+	string error;
+	if(!store_config_cache(cache_file, sources, general_properties_,
+			       plugin_properties_map_, error))
+	    cerr << "Configuration cache not written: " << error << endl;
+    }
+    since = self_telemetry::now_ns();
+
+    if(!compile_rules()) {
+	unload_plugins();
+	throw runtime_error("The plugin manager was not able to compile all the rules");
+    }
     
+    string error;
+    sink_ = cc_sink::create(general_properties_.sink.kind,
+			    general_properties_.sink.path,
+			    general_properties_.sink.size_kb,
+			    error);
+    if(sink_ == NULL) {
+	unload_plugins();
+	throw runtime_error("The plugin manager was not able to create the sink: " + error);
+    }
+
+    if(!initialize_latest_values()) {
+	delete sink_;
+	unload_plugins();
+	throw runtime_error("The plugin manager was not able to create the latest values region");
+    }
+    add_phase(startup_report_, "rules and sink", since);
+
+    if(!sink_->needs_dds()) {
+	if(!initialize_sink_streams()) {
+	    delete sink_;
+	    unload_plugins();
+	    throw runtime_error("The plugin manager was not able to initialize the sink");
+	}
+	if(!initialize_egress()) {
+	    delete sink_;
+	    unload_plugins();
+	    throw runtime_error("The plugin manager was not able to create the egress shaper");
+	}
+	if(!initialize_control()) {
+	    delete sink_;
+	    unload_plugins();
+	    throw runtime_error("The plugin manager was not able to open the control socket");
+	}
+	add_phase(startup_report_, "streams", since);
+	cerr << "Startup:" << startup_report_ << ", total "
+	     << (self_telemetry::now_ns() - start) / 1000000.0 << " ms" << endl;
+	return;
+    }
+
     if(!initialize_dds(general_properties_.domain_id,
     		       general_properties_.qos_file,
     		       general_properties_.qos_library,
@@ -52,7 +171,31 @@ plugin_manager::plugin_manager(string cfgfile)
 	shutdown_dds();
 	unload_plugins();
     }
-    
+    add_phase(startup_report_, "dds", since);
+
+    if(!initialize_spool()) {
+	shutdown_dds();
+	delete sink_;
+	unload_plugins();
+	throw runtime_error("The plugin manager was not able to create the spool");
+    }
+
+    if(!initialize_egress()) {
+	shutdown_dds();
+	delete sink_;
+	unload_plugins();
+	throw runtime_error("The plugin manager was not able to create the egress shaper");
+    }
+
+    if(!initialize_control()) {
+	shutdown_dds();
+	delete sink_;
+	unload_plugins();
+	throw runtime_error("The plugin manager was not able to open the control socket");
+    }
+    add_phase(startup_report_, "streams", since);
+    cerr << "Startup:" << startup_report_ << ", total "
+	 << (self_telemetry::now_ns() - start) / 1000000.0 << " ms" << endl;
 }
 
  
@@ -65,29 +208,166 @@ plugin_manager::plugin_manager(string cfgfile)
  */
 plugin_manager::~plugin_manager()
 {
+    //The plugins being unloaded go before the participant
+    reaper_.wait();
+    finish_unloads();
+    if(sink_ != NULL)
+	sink_->flush();
+    delete recorder_;
     shutdown_dds();
+    if(sink_ != NULL && !sink_->needs_dds()) {
+	for(map<string, dynamicdata_info>::iterator it = dynamicdata_info_map_.begin();
+	    it != dynamicdata_info_map_.end(); ++it)
+	    delete it->second.data;
+    }
+    delete sink_;
     unload_plugins();
 }
 
 
+/**
+ * @brief Shared state of the threads of construct_plugins().
+ */
+struct plugin_loader {
+    vector<plugin_load_job> *jobs;
+    size_t next;
+#ifndef RTI_WIN32
+    pthread_mutex_t lock;
+#endif
+};
+
+/**
+ * @brief Opens the library of a plugin and constructs the plugin.
+ *
+ * Plugins compiled into the agent (see find_builtin_plugin()) are
+ * constructed without opening their library. Only touches the job, so that
+ * several plugins can be constructed at the same time.
+ * @param job The plugin to construct; its library, plugin and error are set.
+ */
+static void construct_plugin(plugin_load_job &job)
+{
+    long long start = self_telemetry::now_ns();
+    cc_create_plugin_t * create_fnc = find_builtin_plugin(job.create_function);
+    if(create_fnc == NULL) {
+	job.library = RTIOsapiLibrary_open(job.library_path.c_str(), RTI_OSAPI_LIBRARY_RTLD_NOW);
+	if(job.library == NULL) {
+	    job.error = "cannot open " + job.library_path;
+	    job.elapsed_ns = self_telemetry::now_ns() - start;
+	    return;
+	}
+	create_fnc = (cc_create_plugin_t *)
+	    RTIOsapiLibrary_getSymbolAddress(job.library, job.create_function.c_str());
+    }
+    if(create_fnc == NULL) {
+	job.error = "no " + job.create_function + " in " + job.library_path;
+	job.elapsed_ns = self_telemetry::now_ns() - start;
+	return;
+    }
+
+    try {
+	job.plugin = create_fnc(job.plugin_name, job.config);
+	if(job.plugin == NULL)
+	    job.error = job.create_function + " failed";
+    } catch (exception& e) {
+	job.error = e.what();
+    }
+    job.elapsed_ns = self_telemetry::now_ns() - start;
+}
+
+/**
+ * @brief Body of the threads of load_plugins(): constructs the plugins not
+ * taken by another thread yet.
+ */
+static void *construct_plugins(void *arg)
+{
+    plugin_loader *loader = (plugin_loader *) arg;
+    for(;;) {
+#ifndef RTI_WIN32
+	pthread_mutex_lock(&loader->lock);
+#endif
+	size_t index = loader->next++;
+#ifndef RTI_WIN32
+	pthread_mutex_unlock(&loader->lock);
+#endif
+	if(index >= loader->jobs->size())
+	    break;
+	construct_plugin((*loader->jobs)[index]);
+    }
+    return NULL;
+}
+
 /** 
  * @brief Loads all the cc_plugins specified in the general configuration file
  * 
  * Loads the plugins specified in the general configuration file for each plugin
  * library -- directory containing plugin definitions.
  *
+ * Configuration files are parsed one after another (XML_parser is not
+ * reentrant), but the plugins, whose constructors may be slow, are
+ * constructed by up to <code>startup_threads</code> threads at the same time.
+ * They are then installed, and their errors reported, in the order of the
+ * configuration, so that the outcome does not depend on the threads.
+ *
  * @return True if plugins were loaded correctly and False if they were not.
  */
 bool plugin_manager::load_plugins()
 {
+    long long since = self_telemetry::now_ns();
+    vector<plugin_load_job> jobs;
     for(map<string, list<string> >::iterator it = general_properties_.plugin_list_map.begin();
 	it != general_properties_.plugin_list_map.end(); ++it)
 	for(list<string>::iterator it2 = (it->second).begin();
-	    it2 != (it->second).end(); ++it2)
-	    if(!load_plugin(*it2,it->first)) //(name,dir)
+	    it2 != (it->second).end(); ++it2) {
+	    jobs.push_back(plugin_load_job());
+	    if(!prepare_plugin(*it2, it->first, jobs.back())) //(name,dir)
 		return false;
-    
-    return true;
+	}
+    add_phase(startup_report_, "plugin configuration", since);
+
+    plugin_loader loader;
+    loader.jobs = &jobs;
+    loader.next = 0;
+    size_t helpers = 0;
+#ifndef RTI_WIN32
+    pthread_mutex_init(&loader.lock, NULL);
+    size_t wanted = general_properties_.startup_threads > 1 ?
+	general_properties_.startup_threads : 1;
+    if(wanted > jobs.size())
+	wanted = jobs.size();
+    //This thread is one of them
+    vector<pthread_t> threads;
+    for(size_t i = 1; i < wanted; i++) {
+	pthread_t thread;
+	if(pthread_create(&thread, NULL, construct_plugins, &loader) != 0)
+	    break;
+	threads.push_back(thread);
+    }
+    helpers = threads.size();
+#endif
+    construct_plugins(&loader);
+#ifndef RTI_WIN32
+    for(size_t i = 0; i < threads.size(); i++)
+	pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&loader.lock);
+#endif
+
+    ostringstream construction;
+    construction << "plugin construction (" << helpers + 1 << " threads";
+    size_t slowest = 0;
+    for(size_t i = 1; i < jobs.size(); i++)
+	if(jobs[i].elapsed_ns > jobs[slowest].elapsed_ns)
+	    slowest = i;
+    if(!jobs.empty())
+	construction << ", slowest " << jobs[slowest].plugin_name << " "
+		     << jobs[slowest].elapsed_ns / 1000000.0 << " ms";
+    construction << ")";
+    add_phase(startup_report_, construction.str(), since);
+
+    bool ok = true;
+    for(size_t i = 0; i < jobs.size(); i++)
+	if(!install_plugin(jobs[i]))
+	    ok = false;
+    return ok;
 }
 
 /**
@@ -111,60 +391,477 @@ void plugin_manager::unload_plugins()
  * @brief Loads a plugin.
  * 
  * This method loads a plugin given its plugin name and the directory were 
- * its XML configuration file is stored. To achieve this goal it parses the
- * XML file using the <code>parse_plugin_configuration_file()</code> method of the XML_parser 
- * class and the <code>get_plugin_properties()</code> of the same class to get the properties.
+ * its XML configuration file is stored, by prepare_plugin(),
+ * construct_plugin() and install_plugin().
  * @param plugin_name Name of the plugin.
  * @param dir Directory were the XML configuration file of the plugin is stored.
  */
 bool plugin_manager::load_plugin(string plugin_name, string plugin_library)
 {
+    plugin_load_job job;
+    if(!prepare_plugin(plugin_name, plugin_library, job))
+	return false;
+    construct_plugin(job);
+    return install_plugin(job);
+}
 
+
+/**
+ * @brief Gets the configuration of a plugin ready for construct_plugin().
+ * 
+ * It parses the XML file of the plugin using the
+ * <code>parse_plugin_configuration_file()</code> method of the XML_parser 
+ * class and the <code>get_plugin_properties()</code> of the same class to get the properties.
+ * The XML file is not parsed if the properties of the plugin are already
+ * known, i.e. they were loaded from the configuration cache. The anomaly
+ * detectors of the plugin are configured too.
+ * @param plugin_name Name of the plugin.
+ * @param plugin_library Directory were the XML configuration file of the plugin is stored.
+ * @param job Set to what construct_plugin() needs.
+ */
+bool plugin_manager::prepare_plugin(const string &plugin_name,
+				    const string &plugin_library,
+				    plugin_load_job &job)
+{
     //TODO: if we want to put both dynamic libraries and configuration files
     //within the same directory we would have to change this line.
     // string library_path(LIBDIR);
-	string cavecanem_dir(CAVECANEM_DIR);
-    if(!XML_parser::get_singleton()->
-       parse_plugin_configuration_file(string(cavecanem_dir + "/" +
-					      plugin_library +"/" +
-					      plugin_name + "/" +
-					      plugin_name+".xml"))) {
+    string cavecanem_dir(CAVECANEM_DIR);
+    if(plugin_properties_map_.find(plugin_name) == plugin_properties_map_.end()) {
+	if(!XML_parser::get_singleton()->
+	   parse_plugin_configuration_file(plugin_configuration_file(plugin_name,
+								     plugin_library))) {
+	    return false;
+	}
+
+	plugin_properties_map_[plugin_name] = 
+	    XML_parser::get_singleton()->get_plugin_properties(plugin_name);
+    }
+    cc_plugin_properties &properties = plugin_properties_map_[plugin_name];
+
+    string error;
+    if(!anomalies_.configure(plugin_name, properties.anomaly_detectors, error)) {
+	cerr << "Error in the anomaly detectors of " << plugin_name << ": " << error << endl;
 	return false;
     }
-           
-    plugin_properties_map_[plugin_name] = 
-        XML_parser::get_singleton()->get_plugin_properties(plugin_name);
 
-    libraries_map_[plugin_name] = RTIOsapiLibrary_open((cavecanem_dir + "/" +
-							plugin_library + "/" +
-							plugin_name + "/" +
-							plugin_properties_map_[plugin_name].dll).c_str(),
-						       RTI_OSAPI_LIBRARY_RTLD_NOW);
+    job.plugin_name = plugin_name;
+    job.library_path = cavecanem_dir + "/" + plugin_library + "/" +
+	plugin_name + "/" + properties.dll;
+    job.create_function = properties.create_function;
+    job.config = properties.plugin_config;
+    job.library = NULL;
+    job.plugin = NULL;
+    job.elapsed_ns = 0;
+    return true;
+}
 
-    if(libraries_map_[plugin_name] == NULL) {
-        return false;
+
+/**
+ * @brief Adds a plugin constructed by construct_plugin() to the plugins of
+ * the manager, or reports why it could not be constructed.
+ *
+ * What was constructed is kept even on failure, so that unload_plugin() or
+ * unload_plugins() release it.
+ * @param job The constructed plugin.
+ */
+bool plugin_manager::install_plugin(const plugin_load_job &job)
+{
+    if(job.library != NULL)
+	libraries_map_[job.plugin_name] = job.library;
+    if(job.plugin != NULL) {
+	plugin_map_[job.plugin_name] = job.plugin;
+	job.plugin->set_host(this, job.plugin_name);
     }
+    if(!job.error.empty()) {
+	cerr << "Error loading " << job.plugin_name << ": " << job.error << endl;
+	return false;
+    }
+
+    //If everything was correct the plugin is scheduled by initialize_schedule()
+    schedule_plugin(job.plugin_name, 0);
+    return true;
+}
 
-    cc_create_plugin_t * create_fnc = (cc_create_plugin_t *)
-	RTIOsapiLibrary_getSymbolAddress(libraries_map_[plugin_name], 
-					 plugin_properties_map_[plugin_name].create_function.c_str());
 
-    try {
-	plugin_map_[plugin_name] = create_fnc(plugin_name, 
-					      plugin_properties_map_[plugin_name].plugin_config);
-        if(plugin_map_[plugin_name] == NULL) {
-	        return false;
-	    }
-    } catch (exception& e) {
-      cerr << e.what() << endl;
-	  return false;
+/**
+ * @brief Unloads a plugin loaded by load_plugin().
+ *
+ * Destroys the plugin, closes its library and forgets its configuration,
+ * anomaly detectors and telemetry. It also cleans up after a load_plugin()
+ * that failed halfway. Its DataWriter is deleted by delete_plugin_streams().
+ * @param plugin_name Name of the plugin.
+ */
+void plugin_manager::unload_plugin(const string &plugin_name)
+{
+    reaper_job job = new_reaper_job(plugin_name);
+    take_plugin(plugin_name, job);
+    plugin_reaper::tear_down(job);
+}
+
+
+/**
+ * @brief What is torn down of a plugin, nothing yet.
+ *
+ * @param plugin_name Name of the plugin.
+ */
+reaper_job plugin_manager::new_reaper_job(const string &plugin_name)
+{
+    reaper_job job;
+    job.plugin_name = plugin_name;
+    job.participant = participant_;
+    job.publisher = publisher_;
+    job.writer = NULL;
+    job.data = NULL;
+    job.type_support = NULL;
+    job.plugin = NULL;
+    job.library = NULL;
+    job.handed_ns = 0;
+    job.done_ns = 0;
+    return job;
+}
+
+
+/**
+ * @brief Forgets a plugin loaded by load_plugin(), as unload_plugin() does,
+ * but leaves destroying it and closing its library to the caller.
+ *
+ * @param plugin_name Name of the plugin.
+ * @param job Its plugin and library are set.
+ */
+void plugin_manager::take_plugin(const string &plugin_name, reaper_job &job)
+{
+    map<string, cc_plugin*>::iterator plugin = plugin_map_.find(plugin_name);
+    if(plugin != plugin_map_.end()) {
+	job.plugin = plugin->second;
+	plugin_map_.erase(plugin);
+    }
+
+    map<string, void*>::iterator library = libraries_map_.find(plugin_name);
+    if(library != libraries_map_.end()) {
+	job.library = library->second;
+	libraries_map_.erase(library);
     }
-    //If everything was correct we set the period counter for the plugin
-    // period_counter_map_[plugin_name] = plugin_properties_map_[plugin_name].publishing_period;
-    period_counter_map_[plugin_name] = 0;
 
+    unschedule_plugin(plugin_name);
+    plugin_properties_map_.erase(plugin_name);
+    anomalies_.remove_plugin(plugin_name);
+    telemetry_.remove_plugin(plugin_name);
+    governor_.remove_plugin(plugin_name);
+}
+
+
+/** 
+ * @brief Tells whether the settings that cannot change without a restart
+ * (the participant, the sink and the regions, spool and shaper sitting in
+ * front of it, the control socket and the latency probe) are the same in
+ * two configurations.
+ */
+static bool same_restart_settings(const cc_general_properties &a,
+				  const cc_general_properties &b)
+{
+    if(a.domain_id != b.domain_id ||
+       a.qos_file != b.qos_file ||
+       a.qos_library != b.qos_library ||
+       a.qos_profile != b.qos_profile ||
+       a.alert_qos_profile != b.alert_qos_profile ||
+       a.self_telemetry_period != b.self_telemetry_period ||
+       a.sink.kind != b.sink.kind ||
+       a.sink.path != b.sink.path ||
+       a.sink.size_kb != b.sink.size_kb ||
+       a.latest_values.name != b.latest_values.name ||
+       a.latest_values.slots != b.latest_values.slots ||
+       a.latest_values.slot_size != b.latest_values.slot_size ||
+       a.latest_values.expire_sec != b.latest_values.expire_sec ||
+       a.spool.dir != b.spool.dir ||
+       a.spool.size_mb != b.spool.size_mb ||
+       a.spool.drain_per_sec != b.spool.drain_per_sec ||
+       a.egress.enabled != b.egress.enabled ||
+       a.egress.samples_per_sec != b.egress.samples_per_sec ||
+       a.egress.bytes_per_sec != b.egress.bytes_per_sec ||
+       a.egress.burst_ms != b.egress.burst_ms ||
+       a.egress.spread != b.egress.spread ||
+       a.egress.max_queue != b.egress.max_queue ||
+       a.egress.limits.size() != b.egress.limits.size() ||
+       a.control_socket != b.control_socket ||
+       a.latency_probe != b.latency_probe)
+	return false;
+
+    for(list<cc_egress_limit>::const_iterator i = a.egress.limits.begin(), j = b.egress.limits.begin();
+	i != a.egress.limits.end(); ++i, ++j) {
+	if(i->plugin != j->plugin ||
+	   i->samples_per_sec != j->samples_per_sec ||
+	   i->bytes_per_sec != j->bytes_per_sec ||
+	   i->spread != j->spread)
+	    return false;
+    }
     return true;
-    
+}
+
+
+/** 
+ * @brief Tells whether two configurations of a plugin can share a
+ * DataWriter: same topic, type and QoS.
+ */
+static bool same_writer(const cc_plugin_properties &a,
+			const cc_plugin_properties &b)
+{
+    if(a.topic_name != b.topic_name ||
+       a.qos_library != b.qos_library ||
+       a.qos_profile != b.qos_profile ||
+       (a.datawriter_qos == NULL) != (b.datawriter_qos == NULL))
+	return false;
+    if(a.type_code == NULL || b.type_code == NULL)
+	return a.type_code == b.type_code;
+
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    return a.type_code->equal(b.type_code, ex) && ex == DDS_NO_EXCEPTION_CODE;
+}
+
+
+/** 
+ * @brief Resolves the QoS a DataWriter of a plugin is created with, as
+ * create_dds_topic_and_datawriter() does: the profile of the plugin, or the
+ * default DataWriter QoS of the publisher.
+ */
+bool plugin_manager::resolve_writer_qos(const cc_plugin_properties &properties,
+					DDS_DataWriterQos &qos)
+{
+    if(properties.datawriter_qos != NULL || properties.qos_profile == "default")
+	return publisher_->get_default_datawriter_qos(qos) == DDS_RETCODE_OK;
+    return DDSTheParticipantFactory->
+	get_datawriter_qos_from_profile(qos,
+					properties.qos_library.c_str(),
+					properties.qos_profile.c_str()) == DDS_RETCODE_OK;
+}
+
+
+/** 
+ * @brief Tells whether two lists of anomaly detectors are the same.
+ */
+static bool same_detectors(const list<cc_anomaly_definition> &a,
+			   const list<cc_anomaly_definition> &b)
+{
+    if(a.size() != b.size())
+	return false;
+    for(list<cc_anomaly_definition>::const_iterator i = a.begin(), j = b.begin();
+	i != a.end(); ++i, ++j) {
+	if(i->member != j->member ||
+	   i->method != j->method ||
+	   i->alpha != j->alpha ||
+	   i->window != j->window ||
+	   i->threshold != j->threshold ||
+	   i->warmup != j->warmup ||
+	   i->severity != j->severity)
+	    return false;
+    }
+    return true;
+}
+
+
+/** 
+ * @brief Reloads the configuration files, applying the changes in place.
+ * 
+ * The general configuration file and the files of the plugins are parsed
+ * again and compared with the running configuration:
+ *  - plugins no longer listed are unloaded and their DataWriters and
+ *    topics deleted; new plugins are loaded and get theirs;
+ *  - a plugin whose library, create function or plugin_config changed is
+ *    created again, and one whose topic, type or QoS changed gets a new
+ *    DataWriter; its anomaly detectors are configured again if they
+ *    changed. The DataWriters of the other plugins stay up. The QoS
+ *    profiles are read again, and the QoS they resolve to is compared, so
+ *    editing the profile of a plugin in the QoS file gives it a new
+ *    DataWriter too;
+ *  - the rules and bursts are replaced and the schedule is computed again
+ *    on the next call to publish_plugins_information(), so new periods
+ *    apply from then on (the CPU governor starts over).
+ * The participant, the sink (streams keep the type they were declared
+ * with), the latest values region, the spool, the egress shaper, the
+ * control socket and the latency probe stay as they are: changes to their settings are reported
+ * and need a restart.
+ * If the general configuration file is not valid nothing changes.
+ *
+ * @return False if the general configuration file is not valid, or if some
+ * plugin or rule could not be loaded; the rest of the changes are applied
+ * anyway.
+ */
+bool plugin_manager::reload()
+{
+    XML_parser *parser = XML_parser::get_singleton();
+    if(!parser->parse_general_configuration_file(cfg_file_)) {
+	cerr << "Reload: keeping the running configuration" << endl;
+	return false;
+    }
+    cc_general_properties properties = parser->get_general_properties();
+
+    if(!same_restart_settings(properties, general_properties_))
+	cerr << "Reload: changes to dds_properties, self_telemetry_period_sec, sink, "
+	     << "latest_values, spool, egress, control_socket and latency_probe need a restart" << endl;
+    properties.domain_id = general_properties_.domain_id;
+    properties.qos_file = general_properties_.qos_file;
+    properties.qos_library = general_properties_.qos_library;
+    properties.qos_profile = general_properties_.qos_profile;
+    properties.alert_qos_profile = general_properties_.alert_qos_profile;
+    properties.self_telemetry_period = general_properties_.self_telemetry_period;
+    properties.sink = general_properties_.sink;
+    properties.latest_values = general_properties_.latest_values;
+    properties.spool = general_properties_.spool;
+    properties.egress = general_properties_.egress;
+    properties.control_socket = general_properties_.control_socket;
+    properties.latency_probe = general_properties_.latency_probe;
+
+    //Plugins being unloaded through the control socket go first, so that
+    //they can be loaded again
+    reaper_.wait();
+    finish_unloads();
+
+    //QoS of the running DataWriters, as resolved before the profiles are
+    //read again
+    map<string, DDS_DataWriterQos *> running_qos;
+    if(publisher_ != NULL) {
+	for(map<string, cc_plugin*>::iterator it = plugin_map_.begin(); it != plugin_map_.end(); ++it) {
+	    DDS_DataWriterQos *qos = new DDS_DataWriterQos();
+	    if(resolve_writer_qos(plugin_properties_map_[it->first], *qos))
+		running_qos[it->first] = qos;
+	    else
+		delete qos;
+	}
+	if(DDSTheParticipantFactory->reload_profiles() != DDS_RETCODE_OK)
+	    cerr << "Reload: cannot read the QoS profiles again, keeping the loaded ones" << endl;
+    }
+
+    //plugin -> plugin library, before and after
+    map<string, string> running;
+    map<string, string> wanted;
+    for(map<string, list<string> >::iterator it = general_properties_.plugin_list_map.begin();
+	it != general_properties_.plugin_list_map.end(); ++it)
+	for(list<string>::iterator it2 = (it->second).begin(); it2 != (it->second).end(); ++it2)
+	    running[*it2] = it->first;
+    for(map<string, list<string> >::iterator it = properties.plugin_list_map.begin();
+	it != properties.plugin_list_map.end(); ++it)
+	for(list<string>::iterator it2 = (it->second).begin(); it2 != (it->second).end(); ++it2)
+	    wanted[*it2] = it->first;
+
+    bool ok = true;
+
+    //Plugins removed, or moved to another plugin library
+    vector<string> removed;
+    for(map<string, cc_plugin*>::iterator it = plugin_map_.begin(); it != plugin_map_.end(); ++it) {
+	map<string, string>::iterator target = wanted.find(it->first);
+	if(target == wanted.end() || target->second != running[it->first])
+	    removed.push_back(it->first);
+    }
+    for(size_t i = 0; i < removed.size(); i++) {
+	delete_plugin_streams(removed[i]);
+	unload_plugin(removed[i]);
+	cerr << "Reload: " << removed[i] << " unloaded" << endl;
+    }
+
+    for(map<string, string>::iterator it = wanted.begin(); it != wanted.end(); ++it) {
+	const string &name = it->first;
+
+	if(plugin_map_.find(name) == plugin_map_.end()) {
+	    if(!load_plugin(name, it->second) || !create_plugin_streams(name)) {
+		cerr << "Reload: " << name << " could not be loaded" << endl;
+		delete_plugin_streams(name);
+		unload_plugin(name);
+		ok = false;
+		continue;
+	    }
+	    cerr << "Reload: " << name << " loaded" << endl;
+	    continue;
+	}
+
+	if(!parser->parse_plugin_configuration_file(plugin_configuration_file(name, it->second))) {
+	    cerr << "Reload: keeping the running configuration of " << name << endl;
+	    ok = false;
+	    continue;
+	}
+	cc_plugin_properties updated = parser->get_plugin_properties(name);
+	//A copy: creating the plugin again erases its entry from the map
+	const cc_plugin_properties current = plugin_properties_map_[name];
+
+	bool new_writer = !same_writer(current, updated);
+	map<string, DDS_DataWriterQos *>::iterator running = running_qos.find(name);
+	if(!new_writer && running != running_qos.end()) {
+	    DDS_DataWriterQos qos;
+	    new_writer = !resolve_writer_qos(updated, qos) ||
+		!DDS_DataWriterQos_equals(running->second, &qos);
+	    if(new_writer)
+		cerr << "Reload: QoS profile of " << name << " changed" << endl;
+	}
+	bool new_plugin = current.dll != updated.dll ||
+	    current.create_function != updated.create_function ||
+	    current.plugin_config != updated.plugin_config;
+	bool new_detectors = !same_detectors(current.anomaly_detectors, updated.anomaly_detectors);
+	if(current.publishing_period != updated.publishing_period)
+	    cerr << "Reload: " << name << " period " << current.publishing_period
+		 << " s -> " << updated.publishing_period << " s" << endl;
+	if(!new_writer && !new_plugin && !new_detectors) {
+	    plugin_properties_map_[name] = updated;
+	    continue;
+	}
+
+	if(new_writer)
+	    delete_plugin_streams(name);
+
+	if(new_plugin) {
+	    //load_plugin() configures the detectors again too
+	    unload_plugin(name);
+	    if(!load_plugin(name, it->second)) {
+		cerr << "Reload: " << name << " could not be created again" << endl;
+		delete_plugin_streams(name);
+		unload_plugin(name);
+		ok = false;
+		continue;
+	    }
+	}
+	else {
+	    if(new_detectors) {
+		string error;
+		anomalies_.remove_plugin(name);
+		if(!anomalies_.configure(name, updated.anomaly_detectors, error)) {
+		    cerr << "Error in the anomaly detectors of " << name << ": " << error << endl;
+		    ok = false;
+		}
+	    }
+	    plugin_properties_map_[name] = updated;
+	}
+
+	if(new_writer && !create_plugin_streams(name)) {
+	    cerr << "Reload: " << name << " could not get a new DataWriter" << endl;
+	    delete_plugin_streams(name);
+	    unload_plugin(name);
+	    ok = false;
+	    continue;
+	}
+	cerr << "Reload: " << name << " updated"
+	     << (new_plugin ? " (plugin created again)" : "")
+	     << (new_writer ? " (new DataWriter)" : "") << endl;
+    }
+
+    general_properties_ = properties;
+    rules_ = rule_engine();
+    if(!compile_rules())
+	ok = false;
+
+    bursts_ = burst_mode();
+    governor_ = cpu_governor();
+    if(egress_.enabled())
+	egress_.configure(general_properties_.egress.samples_per_sec,
+			  general_properties_.egress.bytes_per_sec,
+			  general_properties_.egress.burst_ms,
+			  general_properties_.egress.spread,
+			  general_properties_.egress.max_queue,
+			  general_properties_.publishing_period);
+    //initialize_schedule() runs again on the next publishing period
+    next_tick_ns_ = 0;
+
+    for(map<string, DDS_DataWriterQos *>::iterator it = running_qos.begin();
+	it != running_qos.end(); ++it)
+	delete it->second;
+    return ok;
 }
 
 
@@ -191,6 +888,28 @@ bool plugin_manager::initialize_dds(int domain_id,
 	    return  false;
     }
 
+    //..the alert topic shared by all the plugins..
+    if(!alerts_.initialize(participant_, publisher_, qos_library,
+			   general_properties_.alert_qos_profile.empty() ?
+			   qos_profile : general_properties_.alert_qos_profile)) {
+	shutdown_dds();
+	return false;
+    }
+
+    //..the telemetry of the agent itself..
+    if(!telemetry_.initialize(participant_, publisher_, qos_library, qos_profile,
+			      general_properties_.self_telemetry_period)) {
+	shutdown_dds();
+	return false;
+    }
+
+    //..the latency probes..
+    if(!probe_.initialize(participant_, publisher_, qos_library, qos_profile,
+			  general_properties_.latency_probe)) {
+	shutdown_dds();
+	return false;
+    }
+
     //..then we create a DataWriter for each plugin
     for(map<string, cc_plugin*>::iterator it = plugin_map_.begin();
     	it != plugin_map_.end(); ++it) {
@@ -210,36 +929,227 @@ bool plugin_manager::initialize_dds(int domain_id,
 
 
 /** 
- * @brief Creates a DDS Domain Participant and DDS Publisher.
+ * @brief Prepares the plugins to write to a sink without DDS.
  * 
- * It creates a DDS Domain Participant and a DDS Publisher from which we will create
- * the topics and DataWriters for each plugin.
+ * Creates the sample of each plugin (there are no DataWriters, so the
+ * plugins get NULL ones) and declares its stream to the sink. Alerts and
+ * self telemetry are not published in this mode.
  *
- * @param domain_id  DDS Domain ID
- * @param qos_configuration_file XML configuration file.
- * @param qos_library Name of the QoS library.
- * @param qos_profile Name of the QoS profile (if "default" it loads default RTI DDS QoS settings).
- * 
- * @return Returns true if everything went good and false if it was not.
+ * @return False if a stream could not be declared.
  */
-bool plugin_manager::create_dds_participant_and_publisher(int domain_id,
-							  string qos_configuration_file,
-							  string qos_library,
-							  string qos_profile)
+bool plugin_manager::initialize_sink_streams()
 {
+    for(map<string, cc_plugin*>::iterator it = plugin_map_.begin();
+	it != plugin_map_.end(); ++it) {
+	cc_plugin_properties &properties = plugin_properties_map_[it->first];
+	if(properties.type_code == NULL) {
+	    cerr << "error creating " << it->first << " typecode" << endl;
+	    return false;
+	}
 
-    DDS_DomainParticipantFactoryQos factory_qos;
-    DDSTheParticipantFactory->get_qos(factory_qos);
-    factory_qos.profile.url_profile.ensure_length(1,1);
-    factory_qos.profile.url_profile[0] = DDS_String_dup(qos_configuration_file.c_str());
-    
-    DDSTheParticipantFactory->set_qos(factory_qos);
-
+	dynamicdata_info &info = dynamicdata_info_map_[it->first];
+	info.writer = NULL;
+	info.type_support = NULL;
+	info.data = new DDS_DynamicData((DDS_TypeCode *) properties.type_code,
+					DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+	if(!sink_->add_stream(it->first, properties.topic_name,
+			      (DDS_TypeCode *) properties.type_code)) {
+	    cerr << it->first << ": cannot declare its stream to the sink" << endl;
+	    return false;
+	}
+    }
+    return true;
+}
 
-    if (qos_profile == "default") { //We use the default QoS profile
 
-	//Created DDS Domain Participant
-	participant_ = DDSTheParticipantFactory->
+/** 
+ * @brief Creates the shared-memory region of latest values, if configured,
+ * and declares the plugins in it.
+ *
+ * @return False if the region could not be created.
+ */
+bool plugin_manager::initialize_latest_values()
+{
+    const cc_latest_definition &definition = general_properties_.latest_values;
+    if(definition.name.empty())
+	return true;
+
+    string error;
+    if(!latest_.open(definition.name, definition.slots, definition.slot_size,
+		     definition.expire_sec, error)) {
+	cerr << "Latest values: " << error << endl;
+	return false;
+    }
+
+    for(map<string, cc_plugin*>::iterator it = plugin_map_.begin();
+	it != plugin_map_.end(); ++it) {
+	cc_plugin_properties &properties = plugin_properties_map_[it->first];
+	if(properties.type_code != NULL)
+	    latest_.add_stream(it->first, (DDS_TypeCode *) properties.type_code);
+    }
+    return true;
+}
+
+
+/** 
+ * @brief Opens the spool of every plugin, if configured.
+ * 
+ * Requires the DataWriters, so it is called after initialize_dds().
+ *
+ * @return False if the spool could not be opened.
+ */
+bool plugin_manager::initialize_spool()
+{
+    const cc_spool_definition &definition = general_properties_.spool;
+    if(definition.dir.empty())
+	return true;
+
+    string error;
+    if(!spool_.open(definition.dir, definition.size_mb, definition.drain_per_sec, error)) {
+	cerr << "Spool: " << error << endl;
+	return false;
+    }
+
+    for(map<string, dynamicdata_info>::iterator it = dynamicdata_info_map_.begin();
+	it != dynamicdata_info_map_.end(); ++it) {
+	cc_plugin_properties &properties = plugin_properties_map_[it->first];
+	if(it->second.writer == NULL || properties.type_code == NULL)
+	    continue;
+	if(!spool_.add_topic(it->first, it->second.writer,
+			     (DDS_TypeCode *) properties.type_code, error))
+	    cerr << "Spool: " << error << endl;
+    }
+    return true;
+}
+
+
+/** 
+ * @brief Declares the plugins in the egress shaper, if configured.
+ * 
+ * Requires the DataWriters (or the sink streams), so it is called after
+ * them.
+ *
+ * @return False if the samples of some plugin cannot be shaped.
+ */
+bool plugin_manager::initialize_egress()
+{
+    const cc_egress_definition &definition = general_properties_.egress;
+    if(!definition.enabled)
+	return true;
+
+    egress_.configure(definition.samples_per_sec, definition.bytes_per_sec,
+		      definition.burst_ms, definition.spread, definition.max_queue,
+		      general_properties_.publishing_period);
+
+    bool ok = true;
+    for(map<string, dynamicdata_info>::iterator it = dynamicdata_info_map_.begin();
+	it != dynamicdata_info_map_.end(); ++it) {
+	if(!add_egress_plugin(it->first))
+	    ok = false;
+    }
+    return ok;
+}
+
+
+/** 
+ * @brief Declares a plugin in the egress shaper, with the limits of the
+ * configuration for it.
+ * 
+ * @param plugin_name Name of the plugin (its DataWriter or sink stream must
+ * exist).
+ *
+ * @return False if its samples cannot be shaped.
+ */
+bool plugin_manager::add_egress_plugin(const string &plugin_name)
+{
+    const cc_egress_definition &definition = general_properties_.egress;
+    cc_plugin_properties &properties = plugin_properties_map_[plugin_name];
+    if(properties.type_code == NULL)
+	return true;
+
+    double samples_per_sec = 0;
+    double bytes_per_sec = 0;
+    double spread = -1;
+    for(list<cc_egress_limit>::const_iterator limit = definition.limits.begin();
+	limit != definition.limits.end(); ++limit) {
+	if(limit->plugin == plugin_name) {
+	    samples_per_sec = limit->samples_per_sec;
+	    bytes_per_sec = limit->bytes_per_sec;
+	    spread = limit->spread;
+	}
+    }
+
+    return egress_.add_plugin(plugin_name, dynamicdata_info_map_[plugin_name].writer,
+			      (DDS_TypeCode *) properties.type_code,
+			      samples_per_sec, bytes_per_sec, spread);
+}
+
+
+/** 
+ * @brief Records every sample published from now on to a file.
+ * 
+ * Samples are appended in the format of the file sink, with the type of
+ * every topic, whatever the sink of the configuration is. The file can be
+ * republished with cavecanem_replay.
+ * @param path File the samples are appended to.
+ *
+ * @return False if the file could not be opened.
+ */
+bool plugin_manager::record_samples(const string &path)
+{
+    string error;
+    cc_sink *recorder = cc_sink::create("file", path, 0, error);
+    if(recorder == NULL) {
+	cerr << "Cannot record samples: " << error << endl;
+	return false;
+    }
+
+    for(map<string, cc_plugin*>::iterator it = plugin_map_.begin();
+	it != plugin_map_.end(); ++it) {
+	cc_plugin_properties &properties = plugin_properties_map_[it->first];
+	if(properties.type_code != NULL)
+	    recorder->add_stream(it->first, properties.topic_name,
+				 (DDS_TypeCode *) properties.type_code);
+    }
+    recorder->flush();
+
+    delete recorder_;
+    recorder_ = recorder;
+    return true;
+}
+
+
+/** 
+ * @brief Creates a DDS Domain Participant and DDS Publisher.
+ * 
+ * It creates a DDS Domain Participant and a DDS Publisher from which we will create
+ * the topics and DataWriters for each plugin.
+ *
+ * @param domain_id  DDS Domain ID
+ * @param qos_configuration_file XML configuration file.
+ * @param qos_library Name of the QoS library.
+ * @param qos_profile Name of the QoS profile (if "default" it loads default RTI DDS QoS settings).
+ * 
+ * @return Returns true if everything went good and false if it was not.
+ */
+bool plugin_manager::create_dds_participant_and_publisher(int domain_id,
+							  string qos_configuration_file,
+							  string qos_library,
+							  string qos_profile)
+{
+
+    DDS_DomainParticipantFactoryQos factory_qos;
+    DDSTheParticipantFactory->get_qos(factory_qos);
+    factory_qos.profile.url_profile.ensure_length(1,1);
+    factory_qos.profile.url_profile[0] = DDS_String_dup(qos_configuration_file.c_str());
+    
+    DDSTheParticipantFactory->set_qos(factory_qos);
+
+
+    if (qos_profile == "default") { //We use the default QoS profile
+
+	//Created DDS Domain Participant
+	participant_ = DDSTheParticipantFactory->
 	    create_participant(domain_id, //Domain ID
 			       DDS_PARTICIPANT_QOS_DEFAULT, //QoS
 			       NULL, //Listener
@@ -334,6 +1244,9 @@ bool plugin_manager::create_dds_topic_and_datawriter(std::string plugin_name,
 	return false;
     }
     type_name = type_support->get_type_name();
+    dynamicdata_info_map_[plugin_name].writer = NULL;
+    dynamicdata_info_map_[plugin_name].data = NULL;
+    dynamicdata_info_map_[plugin_name].type_support = type_support;
 
     //Register type before creating topic
     retcode = type_support->register_type(participant_, type_name);
@@ -386,7 +1299,6 @@ bool plugin_manager::create_dds_topic_and_datawriter(std::string plugin_name,
 	return false;
     }
     
-    dynamicdata_info_map_[plugin_name].writer = NULL;
     dynamicdata_info_map_[plugin_name].writer = DDSDynamicDataWriter::narrow(writer);
     if (dynamicdata_info_map_[plugin_name].writer == NULL) {
 	cerr << plugin_name << "DataWriter narrow error" << endl;
@@ -404,6 +1316,103 @@ bool plugin_manager::create_dds_topic_and_datawriter(std::string plugin_name,
 }
 
 
+/** 
+ * @brief Creates what a plugin loaded after the start needs to publish.
+ * 
+ * Its DataWriter (or its sink stream, with a sink without DDS), and its
+ * entries in the latest values region, the recording, the spool and the
+ * egress shaper, as initialize_dds() and the other initialize methods do
+ * for the plugins loaded at the start.
+ * @param plugin_name Name of the plugin.
+ *
+ * @return False if the plugin cannot publish.
+ */
+bool plugin_manager::create_plugin_streams(const string &plugin_name)
+{
+    cc_plugin_properties &properties = plugin_properties_map_[plugin_name];
+    if(properties.type_code == NULL) {
+	cerr << "error creating " << plugin_name << " typecode" << endl;
+	return false;
+    }
+
+    if(sink_->needs_dds()) {
+	if(!create_dds_topic_and_datawriter(plugin_name,
+					    properties.qos_library,
+					    properties.qos_profile,
+					    properties.topic_name,
+					    (DDS_TypeCode *) properties.type_code,
+					    (DDS_DataWriterQos *) properties.datawriter_qos))
+	    return false;
+    }
+    else {
+	dynamicdata_info &info = dynamicdata_info_map_[plugin_name];
+	info.writer = NULL;
+	info.type_support = NULL;
+	info.data = new DDS_DynamicData((DDS_TypeCode *) properties.type_code,
+					DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+	if(!sink_->add_stream(plugin_name, properties.topic_name,
+			      (DDS_TypeCode *) properties.type_code)) {
+	    cerr << plugin_name << ": cannot declare its stream to the sink" << endl;
+	    return false;
+	}
+    }
+
+    if(latest_.enabled())
+	latest_.add_stream(plugin_name, (DDS_TypeCode *) properties.type_code);
+    if(recorder_ != NULL)
+	recorder_->add_stream(plugin_name, properties.topic_name,
+			      (DDS_TypeCode *) properties.type_code);
+    if(spool_.enabled()) {
+	string error;
+	if(!spool_.add_topic(plugin_name, dynamicdata_info_map_[plugin_name].writer,
+			     (DDS_TypeCode *) properties.type_code, error))
+	    cerr << "Spool: " << error << endl;
+    }
+    if(egress_.enabled() && !add_egress_plugin(plugin_name))
+	return false;
+    return true;
+}
+
+
+/** 
+ * @brief Deletes the DataWriter and the topic of a plugin (or the sample of
+ * its sink stream), with its spool and its queue in the egress shaper.
+ * 
+ * The other DataWriters and the participant are not touched. The type is
+ * unregistered unless another topic still uses it.
+ * @param plugin_name Name of the plugin.
+ */
+void plugin_manager::delete_plugin_streams(const string &plugin_name)
+{
+    reaper_job job = new_reaper_job(plugin_name);
+    take_plugin_streams(plugin_name, job);
+    plugin_reaper::tear_down(job);
+}
+
+
+/** 
+ * @brief Forgets the streams of a plugin, as delete_plugin_streams() does,
+ * but leaves deleting its DataWriter, topic and sample to the caller.
+ * 
+ * @param plugin_name Name of the plugin.
+ * @param job Its DataWriter, sample and type support are set.
+ */
+void plugin_manager::take_plugin_streams(const string &plugin_name, reaper_job &job)
+{
+    map<string, dynamicdata_info>::iterator it = dynamicdata_info_map_.find(plugin_name);
+    if(it == dynamicdata_info_map_.end())
+	return;
+
+    egress_.remove_plugin(plugin_name);
+    spool_.remove_topic(plugin_name);
+
+    job.writer = it->second.writer;
+    job.data = it->second.data;
+    job.type_support = it->second.type_support;
+    dynamicdata_info_map_.erase(it);
+}
+
+
 /** 
  * @brief Deletes all the DDS Entities initialized in initialize_dds()
  * 
@@ -433,36 +1442,916 @@ bool plugin_manager::shutdown_dds()
 }
 
 
+/**
+ * @brief Publishes an alert raised by a plugin on the cavecanem_alert topic.
+ *
+ * @param plugin_name Name of the plugin raising the alert.
+ * @param alert The alert.
+ *
+ * @return True if the alert was published.
+ */
+bool plugin_manager::raise_alert(const string &plugin_name,
+				 const cc_alert &alert)
+{
+    if(bursts_.enabled())
+	trigger_bursts(plugin_name, alert);
+    return alerts_.publish(plugin_name, alert);
+}
+
+
+/** 
+ * @brief Compiles the rules of the general configuration file.
+ * 
+ * Every rule is compiled once here; samples are then evaluated against the
+ * compiled programs by inspect_sample().
+ *
+ * @return False if any rule is invalid.
+ */
+bool plugin_manager::compile_rules()
+{
+    bool ok = true;
+    for(list<cc_rule_definition>::iterator it = general_properties_.rules.begin();
+	it != general_properties_.rules.end(); ++it) {
+	string error;
+	if(!rules_.add_rule(it->name, it->severity, it->expression, error)) {
+	    cerr << "Error compiling rule " << it->name << ": " << error << endl;
+	    ok = false;
+	}
+    }
+    return ok;
+}
+
+
+/** 
+ * @brief Evaluates the rules and anomaly detectors of a plugin against the
+ * sample it is about to publish.
+ * 
+ * Alerts fired by them are published on the alert topic straight away,
+ * without waiting for the next publishing period. The sample also becomes
+ * the latest row of its instance, if the latest values region is enabled.
+ * @param plugin_name Name of the plugin publishing the sample.
+ * @param data The sample.
+ */
+void plugin_manager::inspect_sample(const string &plugin_name,
+				    const DDS_DynamicData &data)
+{
+    inspect_sample(plugin_name, plugin_index(plugin_name), data);
+}
+
+
+/** 
+ * @brief Evaluates a sample of the plugin bound to an index (see
+ * schedule_plugin()).
+ */
+void plugin_manager::inspect_sample(const string &plugin_name,
+				    size_t index,
+				    const DDS_DynamicData &data)
+{
+    fired_.clear();
+
+    if(rules_.has_rules(index)) {
+	double now;
+#ifndef RTI_WIN32
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+	now = (double) time(NULL);
+#endif
+	rules_.evaluate(index, data, now, fired_);
+    }
+
+    if(anomalies_.has_detectors(index))
+	anomalies_.evaluate(index, data, fired_);
+
+    for(size_t i = 0; i < fired_.size(); i++) {
+	if(bursts_.enabled())
+	    trigger_bursts(plugin_name, fired_[i]);
+	alerts_.publish(plugin_name, fired_[i]);
+    }
+
+    if(latest_.enabled())
+	latest_.update(plugin_name, index, data);
+}
+
+
+/** 
+ * @brief Writes a sample of a plugin.
+ * 
+ * Evaluates the sample with inspect_sample() and writes it to the sink (and
+ * to the recording, if any), recording the duration and size of the write
+ * in the self telemetry. Samples of plugins paced by the egress shaper are
+ * queued instead, and written later by release_samples(). Either way the
+ * time the run of the plugin started is their source timestamp.
+ * @param plugin_name Name of the plugin publishing the sample.
+ * @param writer The DataWriter of the plugin.
+ * @param data The sample.
+ *
+ * @return True if the sample was written.
+ */
+bool plugin_manager::write_sample(const string &plugin_name,
+				  DDSDynamicDataWriter *writer,
+				  DDS_DynamicData *data)
+{
+    unsigned long long timestamp = tick_.timestamp_ns;
+    size_t index = plugin_index(plugin_name);
+    inspect_sample(plugin_name, index, *data);
+    if(probe_.enabled()) {
+	run_samples_++;
+	run_write_ns_ = self_telemetry::now_ns();
+    }
+    if(recorder_ != NULL)
+	recorder_->write(plugin_name, index, NULL, *data, timestamp);
+
+    if(egress_.enabled() && egress_.shapes(index))
+	return egress_.enqueue(index, *data, self_telemetry::now_ns(), timestamp);
+
+    if(!telemetry_.enabled())
+	return deliver_sample(plugin_name, index, writer, data, timestamp);
+
+    long long start = self_telemetry::now_ns();
+    bool ok = deliver_sample(plugin_name, index, writer, data, timestamp);
+    long long elapsed = self_telemetry::now_ns() - start;
+
+    DDS_DynamicDataInfo info;
+    long long bytes = (data->get_info(info) == DDS_RETCODE_OK) ? info.stored_size : 0;
+    telemetry_.record_write(index, elapsed, bytes, ok);
+    return ok;
+}
+
+
 /** 
- * @brief Calls all the loaded plugins to publish.
+ * @brief Writes a sample to the sink, or to the spool if its topic has no
+ * readers or the write fails.
  * 
- * Calls the publishing method of all the plugins loaded. It also controls the publishing rate
- * of each function.
+ * @param index Index the plugin is bound to (see schedule_plugin()).
+ * @param timestamp Source timestamp (nanoseconds since the epoch).
  *
+ * @return True if the sample was written or spooled.
+ */
+bool plugin_manager::deliver_sample(const string &plugin_name,
+				    size_t index,
+				    DDSDynamicDataWriter *writer,
+				    DDS_DynamicData *data,
+				    unsigned long long timestamp)
+{
+    if(spool_.enabled() && spool_.diverts(index))
+	return spool_.store(plugin_name, index, *data, timestamp);
+    if(sink_->write(plugin_name, index, writer, *data, timestamp))
+	return true;
+    return spool_.enabled() && spool_.store(plugin_name, index, *data, timestamp);
+}
+
+
+/** 
+ * @brief Writes the samples the egress shaper lets through now.
+ */
+void plugin_manager::release_samples()
+{
+    //A member, so that long names are not allocated again on every release
+    string &plugin_name = released_plugin_;
+    size_t index;
+    DDSDynamicDataWriter *writer;
+    long long waited;
+    unsigned long long timestamp;
+    DDS_DynamicData *data;
+
+    while((data = egress_.next(self_telemetry::now_ns(), plugin_name, index, writer,
+			       waited, timestamp)) != NULL) {
+	if(!telemetry_.enabled()) {
+	    deliver_sample(plugin_name, index, writer, data, timestamp);
+	    continue;
+	}
+
+	long long start = self_telemetry::now_ns();
+	bool ok = deliver_sample(plugin_name, index, writer, data, timestamp);
+	long long elapsed = self_telemetry::now_ns() - start;
+
+	DDS_DynamicDataInfo info;
+	long long bytes = (data->get_info(info) == DDS_RETCODE_OK) ? info.stored_size : 0;
+	telemetry_.record_release(index, waited, elapsed, bytes, ok);
+    }
+}
+
+
+/** 
+ * @brief Runs one publishing period of the plugins.
+ * 
+ * Periods start at fixed points of the wall clock, shifted by a phase
+ * derived from the hostname, so that the agents of a fleet restarted at
+ * the same time do not publish in step. Within them every plugin runs at
+ * its own offset (see initialize_schedule()). When the period ends, the
+ * sinks are flushed, the spool drained, the latest values expired, the
+ * bursts over ended and the CPU governor consulted.
+ *
+ * If a signal interrupts the wait, it returns early, so that the caller can
+ * check whether to quit; the next call resumes the same period.
  */
 void plugin_manager::publish_plugins_information()
 {
+    if(next_tick_ns_ == 0)
+	initialize_schedule();
 
-    for(map<string, cc_plugin*>::iterator it = plugin_map_.begin();
-	it != plugin_map_.end(); ++it) {
-	//Checks if it is its turn to publish
-	if(period_counter_map_[it->first] <= 0) {
-	    it->second->
-		generate_and_publish_information(dynamicdata_info_map_[it->first].writer,
-						 dynamicdata_info_map_[it->first].data);
-	    period_counter_map_[it->first] =  plugin_properties_map_[it->first].publishing_period - general_properties_.publishing_period;
+    if(!serve_until(next_tick_ns_))
+	return;
+
+    long long start = self_telemetry::now_ns();
+
+    if(egress_.enabled())
+	release_samples();
+    sink_->flush();
+    if(recorder_ != NULL)
+	recorder_->flush();
+    if(spool_.enabled())
+	spool_.drain();
+    if(latest_.enabled())
+	latest_.expire();
+
+    long long end = self_telemetry::now_ns();
+    if(bursts_.active())
+	expire_bursts();
+    //Bursts are paid for on purpose: they do not count against the budget
+    if(governor_.enabled() && bursts_.active())
+	governor_.reset_window();
+    else if(governor_.enabled() && governor_.evaluate(end, period_changes_))
+	apply_period_changes();
+    if(telemetry_.enabled()) {
+	telemetry_.record_tick(tick_busy_ns_ + end - start);
+	telemetry_.publish_if_due(end);
+    }
+    tick_busy_ns_ = 0;
+
+    long long period_ns = general_properties_.publishing_period * 1000000000LL;
+    next_tick_ns_ += period_ns;
+    if(next_tick_ns_ <= end) //Overran whole periods: skip them
+	next_tick_ns_ += ((end - next_tick_ns_) / period_ns + 1) * period_ns;
+    begin_tick();
+}
+
+
+/** 
+ * @brief Starts the next tick: the samples of the period to come get its
+ * sequence number (see cc_plugin::stamp_tick()). Their time is the one
+ * of the run of their plugin, set by run_plugin().
+ */
+void plugin_manager::begin_tick()
+{
+    tick_.sequence++;
+}
+
+
+/** 
+ * @brief Returns the period of the configuration file of a plugin, or the
+ * general one if it does not set any.
+ */
+int plugin_manager::configured_period_sec(const string &plugin_name)
+{
+    int period_sec = plugin_properties_map_[plugin_name].publishing_period;
+    if(period_sec <= 0)
+	period_sec = general_properties_.publishing_period;
+    return period_sec;
+}
+
+
+/** 
+ * @brief Returns the period a plugin runs at: the fast one if it is in a
+ * burst, otherwise its configured one as stretched by the CPU governor.
+ */
+long long plugin_manager::plugin_period_ns(const scheduled_plugin &scheduled)
+{
+    long long burst_ns = bursts_.period_ns(scheduled.index);
+    if(burst_ns > 0)
+	return burst_ns;
+    return governor_.period(scheduled.index, scheduled.period_sec) * 1000000000LL;
+}
+
+
+/** 
+ * @brief Applies the periods changed by the CPU governor.
+ * 
+ * The next run of the plugin moves by the difference between its new and
+ * its old period, and the change is logged and reported on the self
+ * telemetry.
+ */
+void plugin_manager::apply_period_changes()
+{
+    for(size_t i = 0; i < period_changes_.size(); i++) {
+	const governor_change &change = period_changes_[i];
+	scheduled_plugin *scheduled = find_scheduled(change.plugin_name);
+	if(scheduled == NULL)
+	    continue;
+	long long previous_ns = change.previous_period_sec * 1000000000LL;
+	scheduled->period_ns = plugin_period_ns(*scheduled);
+	scheduled->next_run_ns += scheduled->period_ns - previous_ns;
+
+	cerr << change.plugin_name << ": period " << change.previous_period_sec
+	     << " s -> " << change.period_sec << " s (" << change.reason << ")" << endl;
+	telemetry_.record_period(change.plugin_name, change.period_sec, change.reason);
+    }
+}
+
+
+/** 
+ * @brief Starts the bursts triggered by an alert.
+ * 
+ * The plugins switched to a fast period run right away.
+ * @param plugin_name Plugin the alert was raised for.
+ * @param alert The alert.
+ */
+void plugin_manager::trigger_bursts(const string &plugin_name,
+				    const cc_alert &alert)
+{
+    long long now = self_telemetry::now_ns();
+    if(!bursts_.trigger(plugin_name, alert, now, burst_changes_))
+	return;
+
+    for(size_t i = 0; i < burst_changes_.size(); i++) {
+	scheduled_plugin *scheduled = find_scheduled(burst_changes_[i]);
+	if(scheduled == NULL)
+	    continue;
+	scheduled->period_ns = plugin_period_ns(*scheduled);
+	scheduled->next_run_ns = now;
+	telemetry_.record_period(scheduled->plugin_name, scheduled->period_ns / 1e9,
+				 "burst on " + alert.rule + " from " + plugin_name);
+    }
+}
+
+
+/** 
+ * @brief Ends the bursts whose window is over; their plugins run again a
+ * whole period later.
+ */
+void plugin_manager::expire_bursts()
+{
+    long long now = self_telemetry::now_ns();
+    bursts_.expire(now, burst_changes_);
+
+    for(size_t i = 0; i < burst_changes_.size(); i++) {
+	scheduled_plugin *scheduled = find_scheduled(burst_changes_[i]);
+	if(scheduled == NULL)
+	    continue;
+	scheduled->period_ns = plugin_period_ns(*scheduled);
+	scheduled->next_run_ns = now + scheduled->period_ns;
+	cerr << scheduled->plugin_name << ": burst over" << endl;
+	telemetry_.record_period(scheduled->plugin_name, scheduled->period_ns / 1e9, "burst over");
+    }
+}
+
+
+/** 
+ * @brief Returns the monotonic time of the next instant, from now on, at
+ * which the wall clock is <code>offset_ns</code> past a multiple of
+ * <code>period_ns</code>.
+ */
+static long long next_aligned_ns(long long now_ns,
+				 long long realtime_ns,
+				 long long period_ns,
+				 long long offset_ns)
+{
+    long long delta = (offset_ns - realtime_ns % period_ns) % period_ns;
+    if(delta < 0)
+	delta += period_ns;
+    return now_ns + delta;
+}
+
+
+/** 
+ * @brief Computes when every plugin runs for the first time.
+ * 
+ * The hostname is hashed (FNV-1a) into a phase within the publishing
+ * period, and into one within the period of every plugin. The plugins of
+ * the agent are then spaced evenly over their period on top of it, in the
+ * order of their names. Hosts and plugins keep the same offsets across
+ * restarts. The CPU governor and the bursts, if configured, are also set
+ * up here.
+ */
+void plugin_manager::initialize_schedule()
+{
+    string hostname;
+    sigar_t *sig;
+    if(sigar_open(&sig) == 0) {
+	sigar_net_info_t net_info;
+	if(sigar_net_info_get(sig, &net_info) == 0)
+	    hostname = net_info.host_name;
+	sigar_close(sig);
+    }
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < hostname.size(); i++)
+	hash = (hash ^ (unsigned char) hostname[i]) * 1099511628211ULL;
+
+    long long now = self_telemetry::now_ns();
+    long long realtime;
+#ifndef RTI_WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    realtime = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    realtime = (long long) time(NULL) * 1000000000LL;
+#endif
 
+    long long period_ns = general_properties_.publishing_period * 1000000000LL;
+    next_tick_ns_ = next_aligned_ns(now, realtime, period_ns, hash % period_ns);
+    begin_tick();
+
+    for(list<cc_burst_definition>::iterator burst = general_properties_.bursts.begin();
+	burst != general_properties_.bursts.end(); ++burst) {
+	for(list<string>::iterator plugin = burst->plugins.begin();
+	    plugin != burst->plugins.end(); ++plugin) {
+	    if(plugin_map_.find(*plugin) == plugin_map_.end())
+		cerr << "Burst: unknown plugin " << *plugin << endl;
 	}
+	bursts_.add_trigger(burst->alert, burst->source, burst->severity,
+			    burst->period_ms, burst->duration_sec, burst->plugins);
+    }
+
+    const cc_cpu_budget_definition &budget = general_properties_.cpu_budget;
+    if(budget.percent > 0)
+	governor_.configure(budget.percent / 100, budget.window_sec, budget.max_stretch);
+
+    for(size_t index = 0; index < schedule_.size(); index++) {
+	const string &plugin_name = schedule_[index].plugin_name;
+	long long period = configured_period_sec(plugin_name) * 1000000000LL;
+	if(governor_.enabled())
+	    governor_.add_plugin(plugin_name, (int) (period / 1000000000LL));
+	telemetry_.record_period(plugin_name, (int) (period / 1000000000LL), "");
+
+	//Also binds the plugin to the streams created since it was installed
+	long long offset_ns = hash % period +
+	    period / (long long) schedule_.size() * index;
+	schedule_plugin(plugin_name, next_aligned_ns(now, realtime, period, offset_ns % period));
+    }
+}
+
+
+/** 
+ * @brief Orders the schedule by plugin name.
+ */
+static bool scheduled_before(const scheduled_plugin &scheduled,
+			     const string &plugin_name)
+{
+    return scheduled.plugin_name < plugin_name;
+}
+
+
+/** 
+ * @brief Returns the entry of a plugin in the schedule, or NULL if it is
+ * not scheduled.
+ */
+scheduled_plugin *plugin_manager::find_scheduled(const string &plugin_name)
+{
+    vector<scheduled_plugin>::iterator it =
+	lower_bound(schedule_.begin(), schedule_.end(), plugin_name, scheduled_before);
+    if(it == schedule_.end() || it->plugin_name != plugin_name)
+	return NULL;
+    return &*it;
+}
+
+
+/** 
+ * @brief Returns the index a plugin is bound to, or (size_t) -1 if it is
+ * not scheduled.
+ * 
+ * Samples are written while their plugin runs, so the entry of the run in
+ * progress is checked before the schedule is searched.
+ */
+size_t plugin_manager::plugin_index(const string &plugin_name)
+{
+    if(running_ != NULL && running_->plugin_name == plugin_name)
+	return running_->index;
+    scheduled_plugin *scheduled = find_scheduled(plugin_name);
+    return scheduled != NULL ? scheduled->index : (size_t) -1;
+}
 
+
+/** 
+ * @brief Schedules the next run of a plugin, adding it to the schedule if
+ * it was not in it.
+ * 
+ * The plugin, its DataWriter and Dynamic Data, and its period are looked
+ * up here once, and the components handling its samples bound to its
+ * index, so they have to be in place before the plugin runs: the plugin is
+ * scheduled again whenever they change. Entries are kept sorted by name,
+ * so adding one moves the others; a new one takes the index of a plugin
+ * unscheduled, if any, so that indices stay dense.
+ * @param plugin_name Name of the plugin.
+ * @param next_run_ns When it runs next, as returned by self_telemetry::now_ns().
+ */
+void plugin_manager::schedule_plugin(const string &plugin_name, long long next_run_ns)
+{
+    scheduled_plugin *scheduled = find_scheduled(plugin_name);
+    if(scheduled == NULL) {
+	scheduled_plugin entry;
+	entry.plugin_name = plugin_name;
+	if(free_indexes_.empty()) {
+	    entry.index = schedule_.size();
+	}
 	else {
-	    period_counter_map_[it->first] -= general_properties_.publishing_period;
+	    entry.index = free_indexes_.back();
+	    free_indexes_.pop_back();
+	}
+	scheduled = &*schedule_.insert(lower_bound(schedule_.begin(), schedule_.end(),
+						   plugin_name, scheduled_before),
+				       entry);
+    }
+
+    map<string, cc_plugin*>::iterator plugin = plugin_map_.find(plugin_name);
+    scheduled->plugin = (plugin != plugin_map_.end()) ? plugin->second : NULL;
+    map<string, dynamicdata_info>::iterator info = dynamicdata_info_map_.find(plugin_name);
+    scheduled->info = (info != dynamicdata_info_map_.end()) ? &info->second : NULL;
+    bind_plugin(*scheduled);
+    scheduled->next_run_ns = next_run_ns;
+    scheduled->period_sec = configured_period_sec(plugin_name);
+    scheduled->period_ns = plugin_period_ns(*scheduled);
+}
 
+
+/** 
+ * @brief Binds the components handling the samples of a plugin to its
+ * index, so that they find what they keep for it without looking its name
+ * up. Components replaced since (e.g. by a reload) are bound again.
+ */
+void plugin_manager::bind_plugin(const scheduled_plugin &scheduled)
+{
+    size_t index = scheduled.index;
+    const string &plugin_name = scheduled.plugin_name;
+    rules_.bind_plugin(index, plugin_name);
+    anomalies_.bind_plugin(index, plugin_name);
+    telemetry_.bind_plugin(index, plugin_name);
+    governor_.bind_plugin(index, plugin_name);
+    bursts_.bind_plugin(index, plugin_name);
+    latest_.bind_stream(index, plugin_name);
+    spool_.bind_topic(index, plugin_name);
+    egress_.bind_plugin(index, plugin_name);
+    //Plugins are installed before the sink is created
+    if(sink_ != NULL)
+	sink_->bind_stream(index, plugin_name);
+    if(recorder_ != NULL)
+	recorder_->bind_stream(index, plugin_name);
+}
+
+
+/** 
+ * @brief Removes a plugin from the schedule. Its index is given to the
+ * next plugin scheduled.
+ */
+void plugin_manager::unschedule_plugin(const string &plugin_name)
+{
+    vector<scheduled_plugin>::iterator it =
+	lower_bound(schedule_.begin(), schedule_.end(), plugin_name, scheduled_before);
+    if(it != schedule_.end() && it->plugin_name == plugin_name) {
+	free_indexes_.push_back(it->index);
+	schedule_.erase(it);
+    }
+}
+
+
+/** 
+ * @brief Asks a plugin to publish, measuring how long it takes and the CPU
+ * time it uses.
+ * 
+ * The samples of the run are stamped with the sequence number of the
+ * current tick and the time the run starts, so that plugins running late
+ * in the period, in a burst or woken by an event are not stamped with the
+ * start of the period. What the plugin queued in the egress shaper is then spread over the
+ * period, and if the latency probes are enabled, a probe of the run is
+ * published when it wrote any sample.
+ * @param scheduled The plugin, as found in the schedule.
+ */
+void plugin_manager::run_plugin(scheduled_plugin &scheduled)
+{
+    const string &plugin_name = scheduled.plugin_name;
+    dynamicdata_info &info = *scheduled.info;
+    tick_.timestamp_ns = self_telemetry::epoch_ns();
+    scheduled.plugin->set_tick(tick_);
+    running_ = &scheduled;
+
+    long long probe_start = 0;
+    if(probe_.enabled()) {
+	run_samples_ = 0;
+	probe_start = self_telemetry::now_ns();
+    }
+
+    if(!telemetry_.enabled() && !governor_.enabled()) {
+	scheduled.plugin->generate_and_publish_information(info.writer, info.data);
+    }
+    else {
+	long long start = self_telemetry::now_ns();
+	long long cpu_start = cpu_governor::thread_cpu_ns();
+	scheduled.plugin->generate_and_publish_information(info.writer, info.data);
+	long long cpu = cpu_governor::thread_cpu_ns() - cpu_start;
+	long long elapsed = self_telemetry::now_ns() - start;
+	telemetry_.record_run(scheduled.index, elapsed, cpu);
+	governor_.record_run(scheduled.index, cpu);
+	tick_busy_ns_ += elapsed;
+    }
+    running_ = NULL;
+
+    if(egress_.enabled())
+	egress_.end_run(scheduled.index, self_telemetry::now_ns());
+
+    if(probe_.enabled() && run_samples_ > 0)
+	probe_.publish(plugin_name, tick_.sequence, run_samples_,
+		       tick_.timestamp_ns, probe_start, run_write_ns_);
+}
+
+
+/** 
+ * @brief Runs the plugins as their turn comes until a deadline, while
+ * serving event-driven plugins and the control socket.
+ * 
+ * Sleeps until the next plugin is due. Plugins returning a valid descriptor
+ * from <code>wakeup_descriptor()</code> are polled meanwhile, and asked to
+ * publish as soon as their descriptor becomes readable, and the samples
+ * queued in the egress shaper are released as they become due (on Windows
+ * descriptors are not polled). Plugins being unloaded are torn down by the
+ * plugin reaper meanwhile, and their unloads reported when it is done.
+ * @param deadline_ns End of the period, as returned by self_telemetry::now_ns().
+ *
+ * @return False if a signal interrupted the wait before the deadline, or if
+ * the configuration was reloaded (the schedule then starts over).
+ */
+bool plugin_manager::serve_until(long long deadline_ns)
+{
+    for(;;) {
+	long long now = self_telemetry::now_ns();
+	long long wakeup = deadline_ns;
+
+	for(size_t i = 0; i < schedule_.size(); i++) {
+	    scheduled_plugin &scheduled = schedule_[i];
+	    if(scheduled.next_run_ns > now)
+		continue;
+	    run_plugin(scheduled);
+	    long long period = scheduled.period_ns;
+	    scheduled.next_run_ns += period;
+	    now = self_telemetry::now_ns();
+	    if(scheduled.next_run_ns <= now) //Overran whole periods: skip them
+		scheduled.next_run_ns += ((now - scheduled.next_run_ns) / period + 1) * period;
+	}
+	//Runs can move other plugins (bursts), so look for the next one afterwards
+	for(size_t i = 0; i < schedule_.size(); i++) {
+	    if(schedule_[i].next_run_ns < wakeup)
+		wakeup = schedule_[i].next_run_ns;
+	}
+
+	if(egress_.enabled()) {
+	    release_samples();
+	    now = self_telemetry::now_ns();
+	    long long release_ns = egress_.next_release_ns(now);
+	    if(release_ns >= 0 && release_ns < wakeup)
+		wakeup = release_ns;
+	}
+
+	if(now >= deadline_ns)
+	    return true;
+	if(wakeup <= now)
+	    continue;
+	long long timeout_ms = (wakeup - now + 999999) / 1000000;
+
+#ifndef RTI_WIN32
+	//Only scheduled plugins are polled; the set changes on loads and unloads
+	poll_fds_.clear();
+	poll_owners_.clear();
+	for(size_t i = 0; i < schedule_.size(); i++) {
+	    int fd = schedule_[i].plugin->wakeup_descriptor();
+	    if(fd >= 0) {
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll_fds_.push_back(pfd);
+		poll_owners_.push_back(i);
+	    }
+	}
+	control_fds_.clear();
+	control_.descriptors(control_fds_);
+	for(size_t i = 0; i < control_fds_.size(); i++) {
+	    struct pollfd pfd;
+	    pfd.fd = control_fds_[i];
+	    pfd.events = POLLIN;
+	    pfd.revents = 0;
+	    poll_fds_.push_back(pfd);
+	    poll_owners_.push_back(schedule_.size()); //The control socket
+	}
+	if(!unloads_.empty() && reaper_.descriptor() >= 0) {
+	    struct pollfd pfd;
+	    pfd.fd = reaper_.descriptor();
+	    pfd.events = POLLIN;
+	    pfd.revents = 0;
+	    poll_fds_.push_back(pfd);
+	    poll_owners_.push_back(schedule_.size() + 1); //The plugin reaper
+	}
+
+	int ready = poll(poll_fds_.empty() ? NULL : &poll_fds_[0], poll_fds_.size(),
+			 (int) timeout_ms);
+	if(ready < 0) {
+	    //Interrupted by a signal: let the caller check whether to quit
+	    if(errno != EINTR)
+		cerr << "poll error: " << strerror(errno) << endl;
+	    return false;
+	}
+
+	bool control = false;
+	for(size_t i = 0; i < poll_fds_.size() && ready > 0; i++) {
+	    if(poll_fds_[i].revents == 0)
+		continue;
+	    ready--;
+	    if(poll_owners_[i] == schedule_.size())
+		control = true;
+	    else if(poll_owners_[i] == schedule_.size() + 1)
+		finish_unloads();
+	    else
+		run_plugin(schedule_[poll_owners_[i]]);
+	}
+	if(control) {
+	    serve_control();
+	    if(next_tick_ns_ == 0)
+		return false;
+	}
+#else
+	DDS_Duration_t timeout;
+	timeout.sec = (DDS_Long) (timeout_ms / 1000);
+	timeout.nanosec = (DDS_UnsignedLong) (timeout_ms % 1000) * 1000000;
+	NDDSUtility::sleep(timeout);
+#endif
+    }
+}
+
+
+/** 
+ * @brief Opens the control socket, if configured.
+ *
+ * @return False if it could not be opened.
+ */
+bool plugin_manager::initialize_control()
+{
+    if(general_properties_.control_socket.empty())
+	return true;
+
+    string error;
+    if(!control_.open(general_properties_.control_socket, error)) {
+	cerr << "Control socket: " << error << endl;
+	return false;
+    }
+    return true;
+}
+
+
+/** 
+ * @brief Runs the commands received on the control socket.
+ */
+void plugin_manager::serve_control()
+{
+    commands_.clear();
+    control_.serve(commands_);
+    for(size_t i = 0; i < commands_.size(); i++)
+	handle_command(commands_[i]);
+}
+
+
+/** 
+ * @brief Runs a command of the control socket and replies to it.
+ * 
+ * Commands are:
+ *  - <code>load LIBRARY PLUGIN</code>: loads a plugin of a plugin library,
+ *    as if it were listed in the general configuration file, and runs it
+ *    right away and then every period. The reply tells how long loading
+ *    it took;
+ *  - <code>unload PLUGIN</code>: stops running a plugin straight away
+ *    (samples it had queued in the egress shaper are discarded), and hands
+ *    it to the plugin reaper (see retire_plugin()), which tears it down in
+ *    its own thread, so that the runs of the other plugins are not delayed.
+ *    The reply is sent once it is done, and tells how long each step took;
+ *  - <code>list</code>: the plugins loaded and their periods;
+ *  - <code>reload</code>: reload(), as SIGHUP does.
+ * Replies start with "ok" or "error". A reload applies the configuration
+ * file, so plugins loaded or unloaded through the socket and not changed
+ * in the file are unloaded or loaded again then.
+ * @param command The command.
+ */
+void plugin_manager::handle_command(const control_command &command)
+{
+    long long start = self_telemetry::now_ns();
+    istringstream input(command.line);
+    string verb, library, name;
+    input >> verb;
+    ostringstream reply;
+    reply.setf(ios::fixed);
+    reply.precision(3);
+
+    if(verb == "load" && (input >> library >> name)) {
+	if(name.find('/') != string::npos || library.find("..") != string::npos) {
+	    control_.reply(command.client, "error invalid plugin name");
+	    return;
+	}
+	if(plugin_map_.find(name) != plugin_map_.end()) {
+	    control_.reply(command.client, "error " + name + " is already loaded");
+	    return;
 	}
+	for(size_t i = 0; i < unloads_.size(); i++) {
+	    if(unloads_[i].plugin_name == name) {
+		//Its type may still be registered: let the reaper finish
+		reaper_.wait();
+		finish_unloads();
+		break;
+	    }
+	}
+	if(!load_plugin(name, library) || !create_plugin_streams(name)) {
+	    delete_plugin_streams(name);
+	    unload_plugin(name);
+	    control_.reply(command.client, "error " + name + " could not be loaded (see the log)");
+	    return;
+	}
+
+	general_properties_.plugin_list_map[library].push_back(name);
+	int period_sec = configured_period_sec(name);
+	if(governor_.enabled())
+	    governor_.add_plugin(name, period_sec);
+	telemetry_.record_period(name, period_sec, "loaded");
+	schedule_plugin(name, self_telemetry::now_ns());
+
+	reply << "ok " << name << " loaded in " << (self_telemetry::now_ns() - start) / 1e6 << " ms";
+	cerr << "Control socket: " << reply.str().substr(3) << endl;
+	control_.reply(command.client, reply.str());
     }
-    DDS_Duration_t publishing_period;
-    publishing_period.sec = general_properties_.publishing_period;
-    publishing_period.nanosec = 0;
-    NDDSUtility::sleep(publishing_period);
+    else if(verb == "unload" && (input >> name)) {
+	bool pending = false;
+	for(size_t i = 0; i < unloads_.size(); i++)
+	    pending = pending || unloads_[i].plugin_name == name;
+	if(plugin_map_.find(name) == plugin_map_.end() || pending) {
+	    control_.reply(command.client, "error " + name + " is not loaded");
+	    return;
+	}
+
+	//Quiesce: no more runs nor queued samples
+	unschedule_plugin(name);
+	egress_.remove_plugin(name);
+	for(map<string, list<string> >::iterator it = general_properties_.plugin_list_map.begin();
+	    it != general_properties_.plugin_list_map.end(); ++it)
+	    it->second.remove(name);
+
+	pending_unload unload;
+	unload.plugin_name = name;
+	unload.client = command.client;
+	unload.requested_ns = start;
+	unload.quiesced_ns = self_telemetry::now_ns();
+	unloads_.push_back(unload);
+	retire_plugin(name);
+    }
+    else if(verb == "list") {
+	reply << "ok";
+	for(size_t i = 0; i < schedule_.size(); i++)
+	    reply << " " << schedule_[i].plugin_name << "=" << schedule_[i].period_ns / 1e9 << "s";
+	control_.reply(command.client, reply.str());
+    }
+    else if(verb == "reload") {
+	control_.reply(command.client, reload() ? "ok reloaded" : "error reload incomplete (see the log)");
+    }
+    else {
+	control_.reply(command.client, "error usage: load LIBRARY PLUGIN | unload PLUGIN | list | reload");
+    }
+}
 
+
+/** 
+ * @brief Forgets a plugin being unloaded and hands it to the plugin reaper.
+ * 
+ * Only the bookkeeping is done here; deleting its DataWriter and topic,
+ * destroying it and closing its library happen in the thread of the
+ * reaper, and finish_unloads() replies once they are done.
+ * @param plugin_name Name of the plugin.
+ */
+void plugin_manager::retire_plugin(const string &plugin_name)
+{
+    reaper_job job = new_reaper_job(plugin_name);
+    take_plugin_streams(plugin_name, job);
+    take_plugin(plugin_name, job);
+    reaper_.hand_over(job);
 }
 
+
+/** 
+ * @brief Replies to the commands whose plugins the reaper tore down.
+ */
+void plugin_manager::finish_unloads()
+{
+    vector<reaper_job> jobs;
+    reaper_.finished(jobs);
+    for(size_t i = 0; i < jobs.size(); i++) {
+	vector<pending_unload>::iterator unload = unloads_.begin();
+	while(unload != unloads_.end() && unload->plugin_name != jobs[i].plugin_name)
+	    ++unload;
+	if(unload == unloads_.end())
+	    continue;
+
+	ostringstream reply;
+	reply.setf(ios::fixed);
+	reply.precision(3);
+	reply << "ok " << unload->plugin_name << " unloaded in "
+	      << (jobs[i].done_ns - unload->requested_ns) / 1e6 << " ms (quiesce "
+	      << (unload->quiesced_ns - unload->requested_ns) / 1e6 << " ms, teardown "
+	      << (jobs[i].done_ns - jobs[i].handed_ns) / 1e6 << " ms off the loop)";
+	cerr << "Control socket: " << reply.str().substr(3) << endl;
+	control_.reply(unload->client, reply.str());
+	unloads_.erase(unload);
+    }
+}
@@ -23,12 +23,36 @@
 #define PLUGIN_MANAGER_HPP
 
 #include <iostream>
+#include <sstream>
 #include <map>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#ifndef RTI_WIN32
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#endif
 
 #include <ndds/osapi/osapi_library.h>
 #include <ndds/ndds_cpp.h>
 
 #include "plugin.hpp"
+#include "builtin_plugins.hpp"
+#include "alert.hpp"
+#include "rule_engine.hpp"
+#include "anomaly_detector.hpp"
+#include "probe.hpp"
+#include "self_telemetry.hpp"
+#include "sink.hpp"
+#include "latest_values.hpp"
+#include "spool.hpp"
+#include "egress_shaper.hpp"
+#include "cpu_governor.hpp"
+#include "burst_mode.hpp"
+#include "control_socket.hpp"
+#include "plugin_reaper.hpp"
 #include "xml_parser.hpp"
 
 #ifndef CAVECANEM_DIR
@@ -40,20 +64,76 @@
  * @class dynamicdata_info
  * Stores the information related to the dynamic data used to publish
  * the plugin information in the DDS Global Data Space, that is, a 
- * DDS Dynamic DataWriter and the DDS Dynamic Data.
+ * DDS Dynamic DataWriter and the DDS Dynamic Data (and the type support
+ * they were created with, NULL with a sink without DDS).
  */
 struct dynamicdata_info {
     DDSDynamicDataWriter *writer;
     DDS_DynamicData *data;
+    DDSDynamicDataTypeSupport *type_support;
+};
+
+/** 
+ * @class plugin_load_job
+ * A plugin being loaded: what constructing it needs (see
+ * plugin_manager::prepare_plugin()), and what came out of it (library,
+ * plugin, or the error that stopped it, and how long it took).
+ */
+struct plugin_load_job {
+    std::string plugin_name;
+    std::string library_path;
+    std::string create_function;
+    std::map<std::string, std::string> config;
+    void *library;
+    cc_plugin *plugin;
+    std::string error;
+    long long elapsed_ns;
+};
+
+/** 
+ * @class scheduled_plugin
+ * A plugin the loop runs, with everything running it needs resolved when it
+ * is scheduled (see plugin_manager::schedule_plugin()), so that the loop
+ * does not look anything up by name. Its index is dense and stays the same
+ * while it is scheduled: the components handling its samples are bound to
+ * it, and keep what they need for the plugin in vectors indexed by it.
+ */
+struct scheduled_plugin {
+    std::string plugin_name;
+    size_t index;
+    cc_plugin *plugin;
+    dynamicdata_info *info;
+    long long next_run_ns;
+    int period_sec;           //As configured
+    long long period_ns;      //Effective: stretched or in burst
 };
 
 /** 
  * @class plugin_manager
  * Addresses the load and unload of plugins. This process involves
  * the initialization and destruction of DDS entities used within the
- * plugins.
+ * plugins. It also hosts the plugins, publishing the alerts they raise
+ * and those of the rules of the general configuration file and of the
+ * anomaly detectors of the plugin files.
+ *
+ * Samples are written through the sink of the general configuration: with
+ * the DataWriters of the plugins (the default), or locally to a file or a
+ * shared-memory ring, in which case no DDS entity is created. The latest
+ * sample of every instance can also be kept in a shared-memory region for
+ * local consumers, and every sample recorded to a file for cavecanem_replay.
+ * With the DDS sink, samples of topics without readers can be spooled to
+ * disk until readers come back, and the samples written by the plugins can
+ * be paced by an egress shaper so that their bursts do not flood the
+ * network. A CPU governor can stretch the periods of the plugins to keep
+ * the agent under a CPU budget, and alerts can switch plugins to a fast
+ * period for a while (bursts).
+ *
+ * The configuration can be reloaded while running (see reload()): plugins
+ * are added, removed and updated in place, keeping the participant and the
+ * DataWriters they do not affect. Single plugins can also be loaded and
+ * unloaded through the control socket, if configured (see handle_command()).
  */
-class plugin_manager {
+class plugin_manager : public cc_plugin_host {
 public:
     plugin_manager(std::string cfgfile);
     ~plugin_manager();
@@ -63,19 +143,77 @@ public:
 			std::string qos_library,
 			std::string qos_profile);
     bool load_plugins();
+    bool initialize_sink_streams();
+    bool initialize_latest_values();
+    bool initialize_spool();
+    bool initialize_egress();
+    bool initialize_control();
+    bool record_samples(const std::string &path);
     void publish_plugins_information();
+    bool reload();
     void unload_plugins();
     bool shutdown_dds();
 
+    bool raise_alert(const std::string &plugin_name,
+		     const cc_alert &alert);
+    void inspect_sample(const std::string &plugin_name,
+			const DDS_DynamicData &data);
+    bool write_sample(const std::string &plugin_name,
+		      DDSDynamicDataWriter *writer,
+		      DDS_DynamicData *data);
+
 private:
     bool load_plugin(std::string plugin_name, 
 		     std::string dir);
+    bool prepare_plugin(const std::string &plugin_name,
+			const std::string &plugin_library,
+			plugin_load_job &job);
+    bool install_plugin(const plugin_load_job &job);
+    void unload_plugin(const std::string &plugin_name);
+    bool create_plugin_streams(const std::string &plugin_name);
+    void delete_plugin_streams(const std::string &plugin_name);
+    reaper_job new_reaper_job(const std::string &plugin_name);
+    void take_plugin(const std::string &plugin_name, reaper_job &job);
+    void take_plugin_streams(const std::string &plugin_name, reaper_job &job);
+    bool add_egress_plugin(const std::string &plugin_name);
+    void serve_control();
+    void handle_command(const control_command &command);
+    void retire_plugin(const std::string &plugin_name);
+    void finish_unloads();
+    bool compile_rules();
+    void inspect_sample(const std::string &plugin_name,
+			size_t index,
+			const DDS_DynamicData &data);
+    bool deliver_sample(const std::string &plugin_name,
+			size_t index,
+			DDSDynamicDataWriter *writer,
+			DDS_DynamicData *data,
+			unsigned long long timestamp);
+
+    void initialize_schedule();
+    void begin_tick();
+    scheduled_plugin *find_scheduled(const std::string &plugin_name);
+    size_t plugin_index(const std::string &plugin_name);
+    void schedule_plugin(const std::string &plugin_name, long long next_run_ns);
+    void bind_plugin(const scheduled_plugin &scheduled);
+    void unschedule_plugin(const std::string &plugin_name);
+    int configured_period_sec(const std::string &plugin_name);
+    long long plugin_period_ns(const scheduled_plugin &scheduled);
+    void apply_period_changes();
+    void trigger_bursts(const std::string &plugin_name,
+			const cc_alert &alert);
+    void expire_bursts();
+    void release_samples();
+    void run_plugin(scheduled_plugin &scheduled);
+    bool serve_until(long long deadline_ns);
 
     bool create_dds_participant_and_publisher(int domain_id,
 					      std::string qos_configuration_file,
 					      std::string qos_library,
 					      std::string qos_profile);
     
+    bool resolve_writer_qos(const cc_plugin_properties &properties,
+			    DDS_DataWriterQos &qos);
     bool create_dds_topic_and_datawriter(std::string plugin_name,
 					 std::string qos_library,
 					 std::string qos_profile,
@@ -99,9 +237,62 @@ private:
     std::map<std::string, void *> libraries_map_;
     std::map<std::string, dynamicdata_info> dynamicdata_info_map_;
 
+    std::string cfg_file_;
+    std::string startup_report_;
     cc_general_properties general_properties_;
     std::map<std::string, cc_plugin_properties> plugin_properties_map_;
-    std::map<std::string, int> period_counter_map_;
+    //Sorted by name; the loop walks it without allocating
+    std::vector<scheduled_plugin> schedule_;
+    std::vector<size_t> free_indexes_;    //Indices of plugins unscheduled
+    scheduled_plugin *running_;           //Entry of the run in progress, or NULL
+    long long next_tick_ns_;
+    cc_tick tick_;
+    long long tick_busy_ns_;
+
+    cc_sink *sink_;
+    cc_sink *recorder_;
+    latest_values latest_;
+    dds_spool spool_;
+    egress_shaper egress_;
+    cpu_governor governor_;
+    std::vector<governor_change> period_changes_;
+    burst_mode bursts_;
+    std::vector<std::string> burst_changes_;
+    alert_publisher alerts_;
+    rule_engine rules_;
+    anomaly_detector anomalies_;
+    self_telemetry telemetry_;
+    latency_probe probe_;
+    //Samples written by the run in progress and time of the last one
+    long run_samples_;
+    long long run_write_ns_;
+    std::vector<cc_alert> fired_;
+
+    /**
+     * @class pending_unload
+     * A plugin unloaded through the control socket: it is no longer
+     * scheduled, and the plugin reaper is tearing it down.
+     */
+    struct pending_unload {
+	std::string plugin_name;
+	int client;
+	long long requested_ns;
+	long long quiesced_ns;
+    };
+
+    control_socket control_;
+    std::vector<control_command> commands_;
+#ifndef RTI_WIN32
+    //Poll set of serve_until(), kept across periods: owners are indices in
+    //schedule_, schedule_.size() for the control socket or
+    //schedule_.size() + 1 for the plugin reaper
+    std::vector<struct pollfd> poll_fds_;
+    std::vector<size_t> poll_owners_;
+    std::vector<int> control_fds_;
+#endif
+    std::string released_plugin_;
+    std::vector<pending_unload> unloads_;
+    plugin_reaper reaper_;
 };
 
 #endif //PLUGIN_MANAGER_HPP
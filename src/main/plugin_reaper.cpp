@@ -0,0 +1,247 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifndef RTI_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <ndds/osapi/osapi_library.h>
+
+#include "plugin_reaper.hpp"
+#include "self_telemetry.hpp"
+
+using namespace std;
+
+plugin_reaper::plugin_reaper()
+{
+    notify_[0] = notify_[1] = -1;
+#ifndef RTI_WIN32
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&wanted_, NULL);
+    pthread_cond_init(&idle_, NULL);
+    started_ = false;
+    stopping_ = false;
+    working_ = false;
+    if(pipe(notify_) == 0) {
+	fcntl(notify_[0], F_SETFL, O_NONBLOCK);
+	fcntl(notify_[1], F_SETFL, O_NONBLOCK);
+	fcntl(notify_[0], F_SETFD, FD_CLOEXEC);
+	fcntl(notify_[1], F_SETFD, FD_CLOEXEC);
+    }
+    else {
+	cerr << "Plugin reaper: cannot create its pipe, unloads are reported late" << endl;
+	notify_[0] = notify_[1] = -1;
+    }
+#endif
+}
+
+/**
+ * @brief Tears down what is still queued and stops the thread.
+ */
+plugin_reaper::~plugin_reaper()
+{
+#ifndef RTI_WIN32
+    wait();
+    if(started_) {
+	pthread_mutex_lock(&lock_);
+	stopping_ = true;
+	pthread_cond_signal(&wanted_);
+	pthread_mutex_unlock(&lock_);
+	pthread_join(thread_, NULL);
+    }
+    pthread_cond_destroy(&idle_);
+    pthread_cond_destroy(&wanted_);
+    pthread_mutex_destroy(&lock_);
+    if(notify_[0] >= 0) {
+	close(notify_[0]);
+	close(notify_[1]);
+    }
+#endif
+}
+
+/**
+ * @brief Queues a plugin to be torn down.
+ *
+ * Starts the thread the first time; if it cannot be started the plugin is
+ * torn down right away.
+ * @param job The plugin; its handed_ns is set.
+ */
+void plugin_reaper::hand_over(const reaper_job &job)
+{
+    reaper_job queued = job;
+    queued.handed_ns = self_telemetry::now_ns();
+    queued.done_ns = 0;
+#ifndef RTI_WIN32
+    pthread_mutex_lock(&lock_);
+    if(!started_ && pthread_create(&thread_, NULL, run, this) == 0)
+	started_ = true;
+    if(started_) {
+	pending_.push_back(queued);
+	pthread_cond_signal(&wanted_);
+	pthread_mutex_unlock(&lock_);
+	return;
+    }
+    pthread_mutex_unlock(&lock_);
+    cerr << "Plugin reaper: cannot start its thread, tearing "
+	 << job.plugin_name << " down in the loop" << endl;
+#endif
+    tear_down(queued);
+    queued.done_ns = self_telemetry::now_ns();
+#ifndef RTI_WIN32
+    pthread_mutex_lock(&lock_);
+    done_.push_back(queued);
+    notify();
+    pthread_mutex_unlock(&lock_);
+#else
+    done_.push_back(queued);
+#endif
+}
+
+/**
+ * @brief Takes the plugins torn down since the last call.
+ *
+ * @param jobs Set to them, in the order they were handed over.
+ */
+void plugin_reaper::finished(vector<reaper_job> &jobs)
+{
+#ifndef RTI_WIN32
+    char buffer[64];
+    if(notify_[0] >= 0)
+	while(read(notify_[0], buffer, sizeof(buffer)) > 0)
+	    ;
+    pthread_mutex_lock(&lock_);
+#endif
+    jobs.swap(done_);
+    done_.clear();
+#ifndef RTI_WIN32
+    pthread_mutex_unlock(&lock_);
+#endif
+}
+
+/**
+ * @brief Waits until every plugin handed over has been torn down.
+ */
+void plugin_reaper::wait()
+{
+#ifndef RTI_WIN32
+    pthread_mutex_lock(&lock_);
+    while(!pending_.empty() || working_)
+	pthread_cond_wait(&idle_, &lock_);
+    pthread_mutex_unlock(&lock_);
+#endif
+}
+
+/**
+ * @brief Tells whether some plugin handed over is not torn down yet.
+ */
+bool plugin_reaper::busy() const
+{
+#ifndef RTI_WIN32
+    pthread_mutex_lock(&lock_);
+    bool busy = !pending_.empty() || working_;
+    pthread_mutex_unlock(&lock_);
+    return busy;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Tears down a plugin, as plugin_manager::delete_plugin_streams()
+ * and plugin_manager::unload_plugin() did in the loop: the DataWriter and
+ * its topic, the type (unless another topic still uses it), the plugin and
+ * its library.
+ *
+ * @param job The plugin.
+ */
+void plugin_reaper::tear_down(reaper_job &job)
+{
+    if(job.type_support == NULL)
+	delete job.data;
+    else {
+	if(job.data != NULL)
+	    job.type_support->delete_data(job.data);
+	if(job.writer != NULL) {
+	    DDSTopic *topic = job.writer->get_topic();
+	    if(job.publisher->delete_datawriter(job.writer) != DDS_RETCODE_OK)
+		cerr << job.plugin_name << ": delete_datawriter error" << endl;
+	    else if(job.participant->delete_topic(topic) != DDS_RETCODE_OK)
+		cerr << job.plugin_name << ": delete_topic error" << endl;
+	}
+	//The type support must outlive its registration
+	if(job.type_support->unregister_type(job.participant,
+					     job.type_support->get_type_name()) == DDS_RETCODE_OK)
+	    delete job.type_support;
+    }
+
+    if(job.plugin != NULL)
+	job.plugin->destroy_plugin();
+    if(job.library != NULL)
+	RTIOsapiLibrary_close(job.library);
+}
+
+#ifndef RTI_WIN32
+/**
+ * @brief Makes descriptor() readable. Called with the lock held.
+ */
+void plugin_reaper::notify()
+{
+    //A full pipe is readable already
+    if(notify_[1] >= 0 && write(notify_[1], "x", 1) < 0 && errno != EAGAIN)
+	cerr << "Plugin reaper: cannot notify: " << strerror(errno) << endl;
+}
+
+/**
+ * @brief Body of the thread: tears down the plugins handed over, one at a
+ * time, and tells the plugin manager through the pipe.
+ */
+void *plugin_reaper::run(void *arg)
+{
+    plugin_reaper *self = (plugin_reaper *) arg;
+    pthread_mutex_lock(&self->lock_);
+    for(;;) {
+	while(self->pending_.empty() && !self->stopping_)
+	    pthread_cond_wait(&self->wanted_, &self->lock_);
+	if(self->pending_.empty())
+	    break;
+	reaper_job job = self->pending_.front();
+	self->pending_.erase(self->pending_.begin());
+	self->working_ = true;
+	pthread_mutex_unlock(&self->lock_);
+
+	tear_down(job);
+	job.done_ns = self_telemetry::now_ns();
+
+	pthread_mutex_lock(&self->lock_);
+	self->working_ = false;
+	self->done_.push_back(job);
+	self->notify();
+	if(self->pending_.empty())
+	    pthread_cond_broadcast(&self->idle_);
+    }
+    pthread_mutex_unlock(&self->lock_);
+    return NULL;
+}
+#endif
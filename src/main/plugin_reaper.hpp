@@ -0,0 +1,104 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLUGIN_REAPER_HPP
+#define PLUGIN_REAPER_HPP
+
+#include <string>
+#include <vector>
+
+#ifndef RTI_WIN32
+#include <pthread.h>
+#endif
+
+#include <ndds/ndds_cpp.h>
+
+#include "plugin.hpp"
+
+/**
+ * @class reaper_job
+ * What is left of a plugin once the plugin manager forgot it: its
+ * DataWriter and topic (or the sample of its sink stream), the plugin and
+ * its library. Any of them may be NULL.
+ */
+struct reaper_job {
+    std::string plugin_name;
+    DDSDomainParticipant *participant;
+    DDSPublisher *publisher;
+    DDSDynamicDataWriter *writer;
+    DDS_DynamicData *data;
+    DDSDynamicDataTypeSupport *type_support;
+    cc_plugin *plugin;
+    void *library;
+    //Handed over and torn down, as given by self_telemetry::now_ns()
+    long long handed_ns;
+    long long done_ns;
+};
+
+/**
+ * @class plugin_reaper
+ * Tears down unloaded plugins in a thread of its own, so that the loop of
+ * the plugin manager never waits for a destructor, the deletion of a
+ * DataWriter or the closing of a library: handing a plugin over only
+ * queues it.
+ *
+ * The thread is started with the first plugin handed over. Jobs are torn
+ * down in order, and the plugin manager collects the finished ones with
+ * finished(); descriptor() becomes readable when there are some, so that
+ * it can be polled along with the plugins. On Windows plugins are torn
+ * down when handed over.
+ */
+class plugin_reaper {
+public:
+    plugin_reaper();
+    ~plugin_reaper();
+
+    void hand_over(const reaper_job &job);
+    void finished(std::vector<reaper_job> &jobs);
+    void wait();
+
+    int descriptor() const
+    {
+	return notify_[0];
+    }
+
+    bool busy() const;
+
+    static void tear_down(reaper_job &job);
+
+private:
+#ifndef RTI_WIN32
+    static void *run(void *arg);
+    void notify();
+
+    mutable pthread_mutex_t lock_;
+    pthread_cond_t wanted_;
+    pthread_cond_t idle_;
+    pthread_t thread_;
+    bool started_;
+    bool stopping_;
+    bool working_;
+#endif
+    int notify_[2];
+    std::vector<reaper_job> pending_;
+    std::vector<reaper_job> done_;
+};
+
+#endif //PLUGIN_REAPER_HPP
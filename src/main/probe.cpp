@@ -0,0 +1,273 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+extern "C" {
+#include <sigar.h>
+}
+
+#include "probe.hpp"
+#include "self_telemetry.hpp"
+
+using namespace std;
+
+latency_probe::latency_probe()
+    : type_code_(NULL),
+      type_support_(NULL),
+      writer_(NULL),
+      data_(NULL)
+{
+}
+
+/**
+ * @brief Destructor of the latency_probe class.
+ *
+ * Releases the sample, the type support and the type code. The topic and
+ * the DataWriter are deleted along with the rest of the participant's
+ * entities.
+ */
+latency_probe::~latency_probe()
+{
+    if(data_ != NULL)
+	type_support_->delete_data(data_);
+    delete type_support_;
+    if(type_code_ != NULL) {
+	DDS_ExceptionCode_t ex;
+	DDS_TypeCodeFactory::get_instance()->delete_tc(type_code_, ex);
+    }
+}
+
+/**
+ * @brief Builds the type code of the cavecanem_probe topic.
+ *
+ * @return The type code (to be deleted with the type code factory), or NULL
+ * on error.
+ */
+DDS_TypeCode *latency_probe::create_type_code()
+{
+    DDS_TypeCodeFactory *factory = DDS_TypeCodeFactory::get_instance();
+    DDS_ExceptionCode_t ex;
+    DDS_StructMemberSeq members;
+
+    DDS_TypeCode *type_code = factory->create_struct_tc(PROBE_TOPIC_NAME, members, ex);
+    if(ex != DDS_NO_EXCEPTION_CODE)
+	return NULL;
+
+    struct {
+	const char *name;
+	DDS_UnsignedLong string_length; //0 for primitives
+	DDS_TCKind kind;
+	bool key;
+    } layout[] = {
+	{"hostname", PROBE_MAX_HOSTNAME_LENGTH, DDS_TK_STRING, true},
+	{"plugin", PROBE_MAX_PLUGIN_LENGTH, DDS_TK_STRING, true},
+	{"tick", 0, DDS_TK_ULONGLONG, false},
+	{"samples", 0, DDS_TK_LONG, false},
+	{"collect_epoch_ns", 0, DDS_TK_LONGLONG, false},
+	{"collect_ns", 0, DDS_TK_LONGLONG, false},
+	{"write_ns", 0, DDS_TK_LONGLONG, false}
+    };
+
+    for(size_t i = 0; i < sizeof(layout) / sizeof(layout[0]); i++) {
+	DDS_TypeCode *string_tc = NULL;
+	const DDS_TypeCode *member_tc;
+	if(layout[i].string_length > 0) {
+	    string_tc = factory->create_string_tc(layout[i].string_length, ex);
+	    member_tc = string_tc;
+	}
+	else {
+	    member_tc = factory->get_primitive_tc(layout[i].kind);
+	}
+
+	type_code->add_member(layout[i].name,
+			      DDS_TYPECODE_MEMBER_ID_INVALID,
+			      member_tc,
+			      layout[i].key ? DDS_TYPECODE_KEY_MEMBER : DDS_TYPECODE_NONKEY_MEMBER,
+			      ex);
+
+	if(string_tc != NULL) {
+	    DDS_ExceptionCode_t delete_ex;
+	    factory->delete_tc(string_tc, delete_ex);
+	}
+	if(ex != DDS_NO_EXCEPTION_CODE) {
+	    cerr << "error adding member " << layout[i].name
+		 << " to the " << PROBE_TOPIC_NAME << " type" << endl;
+	    factory->delete_tc(type_code, ex);
+	    return NULL;
+	}
+    }
+
+    return type_code;
+}
+
+/**
+ * @brief Creates the topic and the DataWriter of the probes.
+ *
+ * @param participant DDS Domain Participant of the agent.
+ * @param publisher DDS Publisher of the agent.
+ * @param qos_library Name of the QoS library.
+ * @param qos_profile Name of the QoS profile (if "default" the default RTI DDS QoS settings will be loaded).
+ * @param enabled Whether the probes are enabled; nothing is created if not.
+ *
+ * @return True if everything was created correctly (or the probes are
+ * disabled).
+ */
+bool latency_probe::initialize(DDSDomainParticipant *participant,
+			       DDSPublisher *publisher,
+			       string qos_library,
+			       string qos_profile,
+			       bool enabled)
+{
+    if(!enabled)
+	return true;
+
+    sigar_t *sig;
+    if(sigar_open(&sig) == 0) {
+	sigar_net_info_t net_info;
+	if(sigar_net_info_get(sig, &net_info) == 0)
+	    hostname_ = net_info.host_name;
+	sigar_close(sig);
+    }
+    if(hostname_.size() > PROBE_MAX_HOSTNAME_LENGTH)
+	hostname_.resize(PROBE_MAX_HOSTNAME_LENGTH);
+
+    type_code_ = create_type_code();
+    if(type_code_ == NULL) {
+	cerr << "error creating " << PROBE_TOPIC_NAME << " typecode" << endl;
+	return false;
+    }
+
+    type_support_ = new DDSDynamicDataTypeSupport(type_code_,
+						  DDS_DYNAMIC_DATA_TYPE_PROPERTY_DEFAULT);
+    const char *type_name = type_support_->get_type_name();
+    if(type_support_->register_type(participant, type_name) != DDS_RETCODE_OK) {
+	cerr << PROBE_TOPIC_NAME << " register_type error" << endl;
+	return false;
+    }
+
+    DDSTopic *topic = participant->create_topic(PROBE_TOPIC_NAME,
+						type_name,
+						DDS_TOPIC_QOS_DEFAULT,
+						NULL /* listener */,
+						DDS_STATUS_MASK_NONE);
+    if(topic == NULL) {
+	cerr << PROBE_TOPIC_NAME << " create_topic error" << endl;
+	return false;
+    }
+
+    DDSDataWriter *writer;
+    if(qos_profile == "default")
+	writer = publisher->create_datawriter(topic,
+					      DDS_DATAWRITER_QOS_DEFAULT,
+					      NULL /* listener */,
+					      DDS_STATUS_MASK_NONE);
+    else
+	writer = publisher->create_datawriter_with_profile(topic,
+							   qos_library.c_str(),
+							   qos_profile.c_str(),
+							   NULL /* listener */,
+							   DDS_STATUS_MASK_NONE);
+    if(writer == NULL) {
+	cerr << PROBE_TOPIC_NAME << " create_datawriter error" << endl;
+	return false;
+    }
+
+    DDSDynamicDataWriter *dynamic_writer = DDSDynamicDataWriter::narrow(writer);
+    if(dynamic_writer == NULL) {
+	cerr << PROBE_TOPIC_NAME << " DataWriter narrow error" << endl;
+	return false;
+    }
+
+    data_ = type_support_->create_data();
+    if(data_ == NULL) {
+	cerr << PROBE_TOPIC_NAME << " create_data error" << endl;
+	return false;
+    }
+
+    writer_ = dynamic_writer;
+    return true;
+}
+
+/**
+ * @brief Publishes the probe of a plugin run.
+ *
+ * @param plugin_name Name of the plugin.
+ * @param tick Tick sequence of the run (as stamped in its samples).
+ * @param samples Samples the run wrote.
+ * @param collect_epoch_ns Wall-clock time the run started at.
+ * @param collect_ns Monotonic time the run started at.
+ * @param write_ns Monotonic time of the last write of the run.
+ *
+ * @return True if the probe was written.
+ */
+bool latency_probe::publish(const string &plugin_name,
+			    unsigned long long tick,
+			    long samples,
+			    long long collect_epoch_ns,
+			    long long collect_ns,
+			    long long write_ns)
+{
+    if(writer_ == NULL)
+	return false;
+
+    data_->set_string("hostname",
+		      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      hostname_.c_str());
+
+    if(plugin_name.size() <= PROBE_MAX_PLUGIN_LENGTH)
+	data_->set_string("plugin",
+			  DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			  plugin_name.c_str());
+    else
+	data_->set_string("plugin",
+			  DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			  plugin_name.substr(0, PROBE_MAX_PLUGIN_LENGTH).c_str());
+
+    data_->set_ulonglong("tick",
+			 DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			 tick);
+
+    data_->set_long("samples",
+		    DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		    samples);
+
+    data_->set_longlong("collect_epoch_ns",
+			DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			collect_epoch_ns);
+
+    data_->set_longlong("collect_ns",
+			DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			collect_ns);
+
+    data_->set_longlong("write_ns",
+			DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			write_ns);
+
+    long long now = self_telemetry::epoch_ns();
+    DDS_Time_t source_time;
+    source_time.sec = (DDS_Long) (now / 1000000000LL);
+    source_time.nanosec = (DDS_UnsignedLong) (now % 1000000000LL);
+    if(writer_->write_w_timestamp(*data_, DDS_HANDLE_NIL, source_time) != DDS_RETCODE_OK) {
+	cerr << "Error writing " << PROBE_TOPIC_NAME << " sample" << endl;
+	return false;
+    }
+    return true;
+}
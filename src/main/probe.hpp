@@ -0,0 +1,79 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROBE_HPP
+#define PROBE_HPP
+
+#include <string>
+#include <ndds/ndds_cpp.h>
+
+#define PROBE_TOPIC_NAME "cavecanem_probe"
+
+//Bounds of the cavecanem_probe type
+#define PROBE_MAX_HOSTNAME_LENGTH 50
+#define PROBE_MAX_PLUGIN_LENGTH 64
+
+/**
+ * @class latency_probe
+ * Owns the <code>cavecanem_probe</code> topic. When the latency probes are
+ * enabled, the agent publishes one probe after every plugin run that wrote
+ * samples: the tick of the run, when it started collecting (on the wall
+ * clock and on the monotonic clock), when it wrote its last sample and how
+ * many it wrote. Probes are written with the wall-clock time of their write
+ * as source timestamp.
+ *
+ * Samples carry the tick they were collected in, so a subscriber joining
+ * them with the probe of the same host, plugin and tick knows how long
+ * each one took from collection to reception (see cavecanem_latency).
+ */
+class latency_probe {
+public:
+    latency_probe();
+    ~latency_probe();
+
+    bool initialize(DDSDomainParticipant *participant,
+		    DDSPublisher *publisher,
+		    std::string qos_library,
+		    std::string qos_profile,
+		    bool enabled);
+
+    bool enabled() const
+    {
+	return writer_ != NULL;
+    }
+
+    bool publish(const std::string &plugin_name,
+		 unsigned long long tick,
+		 long samples,
+		 long long collect_epoch_ns,
+		 long long collect_ns,
+		 long long write_ns);
+
+    static DDS_TypeCode *create_type_code();
+
+private:
+    DDS_TypeCode *type_code_;
+    DDSDynamicDataTypeSupport *type_support_;
+    DDSDynamicDataWriter *writer_;
+    DDS_DynamicData *data_;
+    std::string hostname_;
+};
+
+#endif //PROBE_HPP
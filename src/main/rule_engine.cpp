@@ -0,0 +1,823 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <set>
+
+#include "rule_engine.hpp"
+#include "dynamic_data_utils.hpp"
+
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+//Instances not seen for this long (e.g. processes gone) lose their state
+#define RULE_STATE_TIMEOUT_SEC 60.0
+
+using namespace std;
+
+namespace {
+
+enum token_kind {
+    TOKEN_END,
+    TOKEN_NUMBER,
+    TOKEN_STRING,
+    TOKEN_IDENT,
+    TOKEN_OP
+};
+
+/**
+ * @class rule_parser
+ * Recursive descent compiler of rule expressions into rule_program bytecode.
+ *
+ *   rule    := expr ['for' duration] ['clear' expr]
+ *   expr    := and (('||' | 'or') and)*
+ *   and     := not (('&&' | 'and') not)*
+ *   not     := ('!' | 'not') not | compare
+ *   compare := sum [('==' | '!=' | '<' | '<=' | '>' | '>=') sum]
+ *   sum     := term (('+' | '-') term)*
+ *   term    := unary (('*' | '/') unary)*
+ *   unary   := '-' unary | number | string | identifier | '(' expr ')'
+ */
+class rule_parser {
+public:
+    rule_parser(const string &text)
+	: text_(text), pos_(0), depth_(0), max_depth_(0)
+    {
+	next();
+    }
+
+    bool parse(rule_program &condition, double &for_sec, rule_program &clear)
+    {
+	for_sec = 0;
+	if(!expr(condition))
+	    return false;
+	condition.max_stack = max_depth_reset();
+
+	if(keyword("for")) {
+	    if(kind_ != TOKEN_NUMBER)
+		return fail("expected a duration after 'for'");
+	    for_sec = number_;
+	    next();
+	    if(kind_ == TOKEN_IDENT) {
+		if(text_token_ == "ms")
+		    for_sec /= 1000.0;
+		else if(text_token_ == "m")
+		    for_sec *= 60.0;
+		else if(text_token_ == "h")
+		    for_sec *= 3600.0;
+		else if(text_token_ != "s")
+		    return fail("unknown duration unit '" + text_token_ + "'");
+		next();
+	    }
+	}
+
+	if(keyword("clear")) {
+	    if(!expr(clear))
+		return false;
+	    clear.max_stack = max_depth_reset();
+	}
+
+	if(kind_ != TOKEN_END)
+	    return fail("unexpected '" + text_token_ + "'");
+	return true;
+    }
+
+    //Identifiers in order of first use; OP_LOAD arguments index this vector
+    vector<string> identifiers;
+    string error;
+
+private:
+    bool fail(const string &message)
+    {
+	if(error.empty()) {
+	    ostringstream where;
+	    where << message << " at column " << token_start_ + 1;
+	    error = where.str();
+	}
+	return false;
+    }
+
+    void next()
+    {
+	while(pos_ < text_.size() && isspace((unsigned char) text_[pos_]))
+	    pos_++;
+	token_start_ = pos_;
+	text_token_.clear();
+
+	if(pos_ >= text_.size()) {
+	    kind_ = TOKEN_END;
+	    return;
+	}
+
+	char c = text_[pos_];
+	if(isdigit((unsigned char) c) || (c == '.' && pos_ + 1 < text_.size() &&
+					  isdigit((unsigned char) text_[pos_ + 1]))) {
+	    const char *start = text_.c_str() + pos_;
+	    char *end;
+	    number_ = strtod(start, &end);
+	    pos_ += end - start;
+	    kind_ = TOKEN_NUMBER;
+	    text_token_.assign(start, end - start);
+	}
+	else if(isalpha((unsigned char) c) || c == '_') {
+	    size_t start = pos_;
+	    while(pos_ < text_.size() &&
+		  (isalnum((unsigned char) text_[pos_]) || text_[pos_] == '_' || text_[pos_] == '.'))
+		pos_++;
+	    kind_ = TOKEN_IDENT;
+	    text_token_ = text_.substr(start, pos_ - start);
+	}
+	else if(c == '"' || c == '\'') {
+	    size_t end = text_.find(c, pos_ + 1);
+	    if(end == string::npos) {
+		kind_ = TOKEN_OP; //Reported as unexpected
+		text_token_ = c;
+		pos_ = text_.size();
+		return;
+	    }
+	    kind_ = TOKEN_STRING;
+	    text_token_ = text_.substr(pos_ + 1, end - pos_ - 1);
+	    pos_ = end + 1;
+	}
+	else {
+	    static const char *operators[] = {
+		"==", "!=", "<=", ">=", "&&", "||", "<", ">", "!", "+", "-", "*", "/", "(", ")", NULL
+	    };
+	    kind_ = TOKEN_OP;
+	    for(int i = 0; operators[i] != NULL; i++) {
+		size_t len = strlen(operators[i]);
+		if(text_.compare(pos_, len, operators[i]) == 0) {
+		    text_token_ = operators[i];
+		    pos_ += len;
+		    return;
+		}
+	    }
+	    text_token_ = c;
+	    pos_++;
+	}
+    }
+
+    bool op(const char *symbol)
+    {
+	if(kind_ == TOKEN_OP && text_token_ == symbol) {
+	    next();
+	    return true;
+	}
+	return false;
+    }
+
+    bool keyword(const char *word)
+    {
+	if(kind_ == TOKEN_IDENT && text_token_ == word) {
+	    next();
+	    return true;
+	}
+	return false;
+    }
+
+    void emit(rule_program &program, rule_program::opcode code, int delta,
+	      int arg = 0, double number = 0)
+    {
+	rule_program::instruction instruction;
+	instruction.op = code;
+	instruction.arg = arg;
+	instruction.number = number;
+	program.code.push_back(instruction);
+	depth_ += delta;
+	if(depth_ > max_depth_)
+	    max_depth_ = depth_;
+    }
+
+    size_t max_depth_reset()
+    {
+	size_t result = max_depth_;
+	depth_ = 0;
+	max_depth_ = 0;
+	return result;
+    }
+
+    bool expr(rule_program &program)
+    {
+	if(!and_expr(program))
+	    return false;
+	while(op("||") || keyword("or")) {
+	    size_t jump = program.code.size();
+	    emit(program, rule_program::OP_JUMP_IF_TRUE, -1);
+	    if(!and_expr(program))
+		return false;
+	    program.code[jump].arg = (int) program.code.size();
+	}
+	return true;
+    }
+
+    bool and_expr(rule_program &program)
+    {
+	if(!not_expr(program))
+	    return false;
+	while(op("&&") || keyword("and")) {
+	    size_t jump = program.code.size();
+	    emit(program, rule_program::OP_JUMP_IF_FALSE, -1);
+	    if(!not_expr(program))
+		return false;
+	    program.code[jump].arg = (int) program.code.size();
+	}
+	return true;
+    }
+
+    bool not_expr(rule_program &program)
+    {
+	if(op("!") || keyword("not")) {
+	    if(!not_expr(program))
+		return false;
+	    emit(program, rule_program::OP_NOT, 0);
+	    return true;
+	}
+	return compare(program);
+    }
+
+    bool compare(rule_program &program)
+    {
+	if(!sum(program))
+	    return false;
+
+	static const struct {
+	    const char *symbol;
+	    rule_program::opcode code;
+	} comparisons[] = {
+	    {"==", rule_program::OP_EQ}, {"!=", rule_program::OP_NE},
+	    {"<=", rule_program::OP_LE}, {">=", rule_program::OP_GE},
+	    {"<", rule_program::OP_LT}, {">", rule_program::OP_GT}
+	};
+	for(size_t i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]); i++) {
+	    if(op(comparisons[i].symbol)) {
+		if(!sum(program))
+		    return false;
+		emit(program, comparisons[i].code, -1);
+		return true;
+	    }
+	}
+	return true;
+    }
+
+    bool sum(rule_program &program)
+    {
+	if(!term(program))
+	    return false;
+	for(;;) {
+	    rule_program::opcode code;
+	    if(op("+"))
+		code = rule_program::OP_ADD;
+	    else if(op("-"))
+		code = rule_program::OP_SUB;
+	    else
+		return true;
+	    if(!term(program))
+		return false;
+	    emit(program, code, -1);
+	}
+    }
+
+    bool term(rule_program &program)
+    {
+	if(!unary(program))
+	    return false;
+	for(;;) {
+	    rule_program::opcode code;
+	    if(op("*"))
+		code = rule_program::OP_MUL;
+	    else if(op("/"))
+		code = rule_program::OP_DIV;
+	    else
+		return true;
+	    if(!unary(program))
+		return false;
+	    emit(program, code, -1);
+	}
+    }
+
+    bool unary(rule_program &program)
+    {
+	if(op("-")) {
+	    if(!unary(program))
+		return false;
+	    emit(program, rule_program::OP_NEG, 0);
+	    return true;
+	}
+	if(op("(")) {
+	    if(!expr(program))
+		return false;
+	    if(!op(")"))
+		return fail("expected ')'");
+	    return true;
+	}
+
+	switch(kind_) {
+	case TOKEN_NUMBER:
+	    emit(program, rule_program::OP_NUMBER, 1, 0, number_);
+	    next();
+	    return true;
+
+	case TOKEN_STRING:
+	    program.strings.push_back(text_token_);
+	    emit(program, rule_program::OP_STRING, 1, (int) program.strings.size() - 1);
+	    next();
+	    return true;
+
+	case TOKEN_IDENT: {
+	    if(text_token_ == "and" || text_token_ == "or" || text_token_ == "not" ||
+	       text_token_ == "for" || text_token_ == "clear")
+		return fail("unexpected '" + text_token_ + "'");
+	    size_t index = 0;
+	    while(index < identifiers.size() && identifiers[index] != text_token_)
+		index++;
+	    if(index == identifiers.size())
+		identifiers.push_back(text_token_);
+	    emit(program, rule_program::OP_LOAD, 1, (int) index);
+	    next();
+	    return true;
+	}
+
+	case TOKEN_END:
+	    return fail("unexpected end of rule");
+
+	default:
+	    return fail("unexpected '" + text_token_ + "'");
+	}
+    }
+
+    const string &text_;
+    size_t pos_;
+    size_t token_start_;
+    token_kind kind_;
+    string text_token_;
+    double number_;
+    int depth_;
+    int max_depth_;
+};
+
+bool truth(const rule_value &value)
+{
+    return value.is_string ? value.len > 0 : (value.number != 0 && value.number == value.number);
+}
+
+void set_number(rule_value &value, double number)
+{
+    value.is_string = false;
+    value.number = number;
+}
+
+} //namespace
+
+
+/**
+ * @brief Runs the program.
+ *
+ * @param slots Values of the members referenced by the program.
+ * @param stack Evaluation stack, with room for at least max_stack values.
+ *
+ * @return The truth of the result. Numbers are true when non-zero, strings
+ * when not empty; comparisons between a number and a string are false.
+ */
+bool rule_program::evaluate(const vector<rule_value> &slots,
+			    vector<rule_value> &stack) const
+{
+    rule_value *s = &stack[0];
+    size_t sp = 0;
+
+    for(size_t pc = 0; pc < code.size(); pc++) {
+	const instruction &in = code[pc];
+	switch(in.op) {
+	case OP_NUMBER:
+	    set_number(s[sp++], in.number);
+	    break;
+
+	case OP_STRING:
+	    s[sp].is_string = true;
+	    s[sp].str = strings[in.arg].data();
+	    s[sp].len = strings[in.arg].size();
+	    sp++;
+	    break;
+
+	case OP_LOAD:
+	    s[sp++] = slots[in.arg];
+	    break;
+
+	case OP_NEG:
+	    set_number(s[sp - 1], s[sp - 1].is_string ? NAN : -s[sp - 1].number);
+	    break;
+
+	case OP_NOT:
+	    set_number(s[sp - 1], truth(s[sp - 1]) ? 0 : 1);
+	    break;
+
+	case OP_JUMP_IF_FALSE:
+	    if(!truth(s[sp - 1]))
+		pc = in.arg - 1;
+	    else
+		sp--;
+	    break;
+
+	case OP_JUMP_IF_TRUE:
+	    if(truth(s[sp - 1]))
+		pc = in.arg - 1;
+	    else
+		sp--;
+	    break;
+
+	default: {
+	    const rule_value b = s[--sp];
+	    rule_value &a = s[sp - 1];
+
+	    if(a.is_string || b.is_string) {
+		int order = 0;
+		bool comparable = a.is_string && b.is_string;
+		if(comparable) {
+		    order = memcmp(a.str, b.str, a.len < b.len ? a.len : b.len);
+		    if(order == 0)
+			order = (a.len < b.len) ? -1 : (a.len > b.len ? 1 : 0);
+		}
+		switch(in.op) {
+		case OP_EQ: set_number(a, comparable && order == 0); break;
+		case OP_NE: set_number(a, !comparable || order != 0); break;
+		case OP_LT: set_number(a, comparable && order < 0); break;
+		case OP_LE: set_number(a, comparable && order <= 0); break;
+		case OP_GT: set_number(a, comparable && order > 0); break;
+		case OP_GE: set_number(a, comparable && order >= 0); break;
+		default: set_number(a, NAN); break; //No string arithmetic
+		}
+		break;
+	    }
+
+	    double x = a.number, y = b.number;
+	    switch(in.op) {
+	    case OP_ADD: set_number(a, x + y); break;
+	    case OP_SUB: set_number(a, x - y); break;
+	    case OP_MUL: set_number(a, x * y); break;
+	    case OP_DIV: set_number(a, y != 0 ? x / y : NAN); break;
+	    case OP_EQ: set_number(a, x == y); break;
+	    case OP_NE: set_number(a, x != y); break;
+	    case OP_LT: set_number(a, x < y); break;
+	    case OP_LE: set_number(a, x <= y); break;
+	    case OP_GT: set_number(a, x > y); break;
+	    case OP_GE: set_number(a, x >= y); break;
+	    default: break;
+	    }
+	}
+	}
+    }
+
+    return sp > 0 && truth(s[sp - 1]);
+}
+
+
+rule_engine::rule_engine() : rule_count_(0)
+{
+}
+
+/**
+ * @brief Compiles a rule and adds it to the rules of its plugin.
+ *
+ * @param name Name of the rule (published in the alerts).
+ * @param severity Severity of the alerts raised by the rule.
+ * @param expression Text of the rule.
+ * @param error Set to a description of the problem when false is returned.
+ *
+ * @return True if the rule was compiled.
+ */
+bool rule_engine::add_rule(const string &name,
+			   int severity,
+			   const string &expression,
+			   string &error)
+{
+    compiled_rule rule;
+    rule.name = name;
+    rule.severity = severity;
+    rule.text = expression;
+
+    rule_parser parser(expression);
+    if(!parser.parse(rule.condition, rule.for_sec, rule.clear)) {
+	error = "rule " + name + ": " + parser.error;
+	return false;
+    }
+
+    //The plugin is given by the qualified identifiers
+    string plugin_name;
+    vector<string> members;
+    for(size_t i = 0; i < parser.identifiers.size(); i++) {
+	const string &identifier = parser.identifiers[i];
+	size_t dot = identifier.find('.');
+	if(dot == string::npos) {
+	    members.push_back(identifier);
+	    continue;
+	}
+	string qualifier = identifier.substr(0, dot);
+	if(!plugin_name.empty() && qualifier != plugin_name) {
+	    error = "rule " + name + ": refers to both " + plugin_name + " and " + qualifier;
+	    return false;
+	}
+	plugin_name = qualifier;
+	members.push_back(identifier.substr(dot + 1));
+    }
+    if(plugin_name.empty()) {
+	error = "rule " + name + ": no member is qualified with its plugin (e.g. cpu.cpu_user)";
+	return false;
+    }
+
+    plugin_rules &plugin = plugins_[plugin_name];
+    if(plugin.rules.empty()) {
+	plugin.resolved = false;
+	plugin.last_prune = 0;
+    }
+
+    vector<int> slots;
+    for(size_t i = 0; i < members.size(); i++)
+	slots.push_back(intern(plugin, members[i]));
+
+    rule_program *programs[] = {&rule.condition, &rule.clear};
+    for(int p = 0; p < 2; p++) {
+	vector<rule_program::instruction> &code = programs[p]->code;
+	for(size_t i = 0; i < code.size(); i++)
+	    if(code[i].op == rule_program::OP_LOAD)
+		code[i].arg = slots[code[i].arg];
+	if(plugin.stack.size() < programs[p]->max_stack)
+	    plugin.stack.resize(programs[p]->max_stack);
+    }
+    rule.slots = slots;
+
+    plugin.rules.push_back(rule);
+    rule_count_++;
+    return true;
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its rules, if it has any, so that its samples are evaluated without
+ * looking its name up.
+ */
+void rule_engine::bind_plugin(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    map<string, plugin_rules>::iterator it = plugins_.find(plugin_name);
+    bound_[index] = (it != plugins_.end()) ? &it->second : NULL;
+}
+
+/**
+ * @brief Evaluates the rules of a plugin over one of its samples.
+ *
+ * @param index Index the plugin publishing the sample is bound to (see
+ * bind_plugin()).
+ * @param data The sample.
+ * @param now Current (monotonic) time in seconds.
+ * @param alerts Vector the alerts of the rules firing or clearing are
+ * appended to.
+ */
+void rule_engine::evaluate(size_t index,
+			   const DDS_DynamicData &data,
+			   double now,
+			   vector<cc_alert> &alerts)
+{
+    if(!has_rules(index))
+	return;
+    plugin_rules &plugin = *bound_[index];
+
+    if(!plugin.resolved)
+	resolve(plugin, data);
+    load(plugin, data);
+
+    //Built in a member, so that a steady set of instances does not allocate
+    string &key = plugin.key;
+    key.clear();
+    for(size_t i = 0; i < plugin.keys.size(); i++) {
+	const rule_value &value = plugin.values[plugin.keys[i]];
+	if(value.is_string)
+	    key.append(value.str, value.len);
+	else {
+	    char number[32];
+	    snprintf(number, sizeof(number), "%.17g", value.number);
+	    key += number;
+	}
+	key += '\0';
+    }
+
+    map<string, rule_instance>::iterator instance_it = plugin.instances.find(key);
+    if(instance_it == plugin.instances.end()) {
+	rule_instance fresh;
+	instance_it = plugin.instances.insert(make_pair(key, fresh)).first;
+    }
+    rule_instance &instance = instance_it->second;
+    instance.last_seen = now;
+    if(instance.rules.size() != plugin.rules.size()) {
+	rule_state fresh;
+	fresh.active = false;
+	fresh.pending_since = -1;
+	instance.rules.resize(plugin.rules.size(), fresh);
+    }
+
+    for(size_t i = 0; i < plugin.rules.size(); i++) {
+	compiled_rule &rule = plugin.rules[i];
+	rule_state &state = instance.rules[i];
+	bool holds = rule.condition.evaluate(plugin.values, plugin.stack);
+
+	if(!state.active) {
+	    if(!holds) {
+		state.pending_since = -1;
+		continue;
+	    }
+	    if(state.pending_since < 0)
+		state.pending_since = now;
+	    if(now - state.pending_since < rule.for_sec)
+		continue;
+
+	    state.active = true;
+	    cc_alert alert;
+	    alert.rule = rule.name;
+	    alert.severity = rule.severity;
+	    alert.message = "rule " + rule.name + " fired: " + rule.text;
+	    alert.subject = describe(plugin, rule.slots);
+	    alerts.push_back(alert);
+	}
+	else {
+	    bool cleared = rule.clear.empty() ? !holds :
+		rule.clear.evaluate(plugin.values, plugin.stack);
+	    if(!cleared)
+		continue;
+
+	    state.active = false;
+	    state.pending_since = -1;
+	    cc_alert alert;
+	    alert.rule = rule.name;
+	    alert.severity = 0;
+	    alert.message = "rule " + rule.name + " cleared";
+	    alert.subject = describe(plugin, rule.slots);
+	    alerts.push_back(alert);
+	}
+    }
+
+    if(now - plugin.last_prune >= RULE_STATE_TIMEOUT_SEC) {
+	map<string, rule_instance> &instances = plugin.instances;
+	for(instance_it = instances.begin(); instance_it != instances.end(); ) {
+	    if(now - instance_it->second.last_seen >= RULE_STATE_TIMEOUT_SEC)
+		instances.erase(instance_it++);
+	    else
+		++instance_it;
+	}
+	plugin.last_prune = now;
+    }
+}
+
+/**
+ * @brief Returns the slot of a member of a plugin, adding it if needed.
+ */
+int rule_engine::intern(plugin_rules &plugin, const string &member)
+{
+    for(size_t i = 0; i < plugin.members.size(); i++)
+	if(plugin.members[i] == member)
+	    return (int) i;
+
+    plugin.members.push_back(member);
+    plugin.resolved = false;
+    return (int) plugin.members.size() - 1;
+}
+
+/**
+ * @brief Looks the members of a plugin up in the type of its samples.
+ *
+ * Done on the first sample: finds the kind of every referenced member and
+ * the key members, which identify the instances rules keep state for.
+ */
+void rule_engine::resolve(plugin_rules &plugin, const DDS_DynamicData &data)
+{
+    const DDS_TypeCode *type = data.get_type();
+    DDS_ExceptionCode_t ex;
+    map<string, int> kinds;
+
+    plugin.keys.clear();
+    DDS_UnsignedLong count = type->member_count(ex);
+    for(DDS_UnsignedLong i = 0; i < count; i++) {
+	string name = type->member_name(i, ex);
+	kinds[name] = type->member_type(i, ex)->kind(ex);
+	if(type->is_member_key(i, ex))
+	    plugin.keys.push_back(intern(plugin, name));
+    }
+
+    plugin.kinds.assign(plugin.members.size(), -1);
+    for(size_t i = 0; i < plugin.members.size(); i++) {
+	map<string, int>::iterator it = kinds.find(plugin.members[i]);
+	if(it != kinds.end())
+	    plugin.kinds[i] = it->second;
+	else
+	    cerr << "rule member " << plugin.members[i] << " is not a member of "
+		 << type->name(ex) << endl;
+    }
+
+    plugin.values.resize(plugin.members.size());
+    plugin.buffers.resize(plugin.members.size());
+    plugin.resolved = true;
+}
+
+/**
+ * @brief Reads the referenced members of a sample into their slots.
+ */
+void rule_engine::load(plugin_rules &plugin, const DDS_DynamicData &data)
+{
+    for(size_t i = 0; i < plugin.members.size(); i++) {
+	const char *name = plugin.members[i].c_str();
+	rule_value &value = plugin.values[i];
+	DDS_ReturnCode_t retcode = DDS_RETCODE_OK;
+	set_number(value, NAN);
+
+	switch(plugin.kinds[i]) {
+	case DDS_TK_CHAR: {
+	    //Chars (e.g. process states) compare as one-character strings
+	    vector<char> &buffer = plugin.buffers[i];
+	    buffer.resize(1);
+	    DDS_Char v; retcode = data.get_char(v, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	    buffer[0] = v;
+	    value.is_string = true;
+	    value.str = &buffer[0];
+	    value.len = 1;
+	    break;
+	}
+	case DDS_TK_STRING: {
+	    vector<char> &buffer = plugin.buffers[i];
+	    if(buffer.size() < 256)
+		buffer.resize(256);
+	    char *str = &buffer[0];
+	    DDS_UnsignedLong size = buffer.size();
+	    retcode = data.get_string(str, &size, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	    if(retcode != DDS_RETCODE_OK && size >= buffer.size()) {
+		//Too small: size is now the required length
+		buffer.resize(size + 1);
+		str = &buffer[0];
+		size = buffer.size();
+		retcode = data.get_string(str, &size, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+	    }
+	    value.is_string = true;
+	    value.str = &buffer[0];
+	    value.len = (retcode == DDS_RETCODE_OK) ? strlen(&buffer[0]) : 0;
+	    break;
+	}
+	default:
+	    //Numeric, missing or unsupported member
+	    if(!get_numeric_member(data, name, plugin.kinds[i], value.number))
+		value.number = NAN;
+	    break;
+	}
+    }
+}
+
+/**
+ * @brief Describes an instance for an alert: its key members and the
+ * members the rule refers to, as name=value pairs.
+ */
+string rule_engine::describe(const plugin_rules &plugin, const vector<int> &slots)
+{
+    vector<int> shown(plugin.keys);
+    set<int> seen(plugin.keys.begin(), plugin.keys.end());
+    for(size_t i = 0; i < slots.size(); i++)
+	if(seen.insert(slots[i]).second)
+	    shown.push_back(slots[i]);
+
+    string description;
+    for(size_t i = 0; i < shown.size(); i++) {
+	const rule_value &value = plugin.values[shown[i]];
+	if(!description.empty())
+	    description += ' ';
+	description += plugin.members[shown[i]] + "=";
+	if(value.is_string) {
+	    description.append(value.str, value.len);
+	}
+	else {
+	    char number[32];
+	    snprintf(number, sizeof(number), "%g", value.number);
+	    description += number;
+	}
+    }
+    return description;
+}
@@ -0,0 +1,187 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RULE_ENGINE_HPP
+#define RULE_ENGINE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ndds/ndds_cpp.h>
+
+#include "plugin.hpp"
+
+/**
+ * @class rule_value
+ * A value on the evaluation stack: a number or a string. Strings point to
+ * the member buffers or to the constants of the program.
+ */
+struct rule_value {
+    bool is_string;
+    double number;
+    const char *str;
+    size_t len;
+};
+
+/**
+ * @class rule_program
+ * A compiled rule expression: flat bytecode for a stack machine. Members
+ * are referenced by slot, so evaluating a program does no name lookups and
+ * no allocations.
+ */
+class rule_program {
+public:
+    enum opcode {
+	OP_NUMBER,        //push number
+	OP_STRING,        //push strings[arg]
+	OP_LOAD,          //push slots[arg]
+	OP_NEG, OP_NOT,
+	OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+	OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE,
+	OP_JUMP_IF_FALSE, //short-circuit &&: keep the value and jump, or pop it
+	OP_JUMP_IF_TRUE   //short-circuit ||
+    };
+
+    struct instruction {
+	opcode op;
+	int arg;
+	double number;
+    };
+
+    rule_program() : max_stack(0) {}
+
+    bool empty() const
+    {
+	return code.empty();
+    }
+
+    bool evaluate(const std::vector<rule_value> &slots,
+		  std::vector<rule_value> &stack) const;
+
+    std::vector<instruction> code;
+    std::vector<std::string> strings;
+    size_t max_stack;
+};
+
+/**
+ * @class rule_state
+ * State of a rule for one instance (key) of its plugin's topic.
+ */
+struct rule_state {
+    bool active;
+    double pending_since; //When the condition started holding (-1 if it does not)
+};
+
+/**
+ * @class rule_instance
+ * State of all the rules of a plugin for one instance of its topic, created
+ * at once when the instance is first seen.
+ */
+struct rule_instance {
+    double last_seen;
+    std::vector<rule_state> rules; //Indexed like plugin_rules::rules
+};
+
+/**
+ * @class compiled_rule
+ * A rule of the <code>rules</code> section of the configuration file.
+ */
+struct compiled_rule {
+    std::string name;
+    int severity;
+    std::string text;
+    rule_program condition;
+    rule_program clear;       //Empty: the rule clears when the condition stops holding
+    double for_sec;           //How long the condition must hold before firing
+    std::vector<int> slots;   //Members referenced by the rule
+};
+
+/**
+ * @class rule_engine
+ * Evaluates threshold rules over the samples plugins publish, so that
+ * detections do not need to wait for a downstream consumer.
+ *
+ * Rules refer to the members of one plugin's topic, the first of them
+ * qualified with the plugin name:
+ * <pre>
+ *   cpu.cpu_user > 90 for 5s clear cpu_user < 80
+ *   proc.name == "nc" && uid == 0
+ * </pre>
+ * Expressions support arithmetic, comparisons, <code>&&</code>/<code>and</code>,
+ * <code>||</code>/<code>or</code>, <code>!</code>/<code>not</code>, numbers and
+ * quoted strings. They are compiled once into bytecode.
+ *
+ * Rules are evaluated for each instance (key) of the topic independently.
+ * A rule fires once when its condition has held for the <code>for</code>
+ * duration, and is re-armed when its <code>clear</code> expression holds
+ * (by default, when the condition stops holding).
+ */
+class rule_engine {
+public:
+    rule_engine();
+
+    bool add_rule(const std::string &name,
+		  int severity,
+		  const std::string &expression,
+		  std::string &error);
+
+    void bind_plugin(size_t index, const std::string &plugin_name);
+
+    bool has_rules(size_t index) const
+    {
+	return index < bound_.size() && bound_[index] != NULL;
+    }
+
+    size_t size() const
+    {
+	return rule_count_;
+    }
+
+    void evaluate(size_t index,
+		  const DDS_DynamicData &data,
+		  double now,
+		  std::vector<cc_alert> &alerts);
+
+private:
+    struct plugin_rules {
+	std::vector<std::string> members;     //slot -> member name
+	std::vector<int> kinds;               //slot -> DDS_TCKind, -1 if missing
+	std::vector<int> keys;                //slots of the key members
+	bool resolved;
+	std::vector<compiled_rule> rules;
+	std::vector<rule_value> values;
+	std::vector<std::vector<char> > buffers;
+	std::vector<rule_value> stack;
+	std::map<std::string, rule_instance> instances;
+	std::string key;                      //Scratch key of the sample evaluated
+	double last_prune;
+    };
+
+    int intern(plugin_rules &plugin, const std::string &member);
+    void resolve(plugin_rules &plugin, const DDS_DynamicData &data);
+    void load(plugin_rules &plugin, const DDS_DynamicData &data);
+    std::string describe(const plugin_rules &plugin, const std::vector<int> &slots);
+
+    std::map<std::string, plugin_rules> plugins_;
+    std::vector<plugin_rules *> bound_;   //plugin index -> rules, NULL if unbound
+    size_t rule_count_;
+};
+
+#endif //RULE_ENGINE_HPP
@@ -0,0 +1,670 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "sample_codec.hpp"
+
+using namespace std;
+
+void put_uint16(vector<char> &out, unsigned int value)
+{
+    out.push_back((char) (value & 0xff));
+    out.push_back((char) ((value >> 8) & 0xff));
+}
+
+void put_uint32(vector<char> &out, unsigned long value)
+{
+    for(int i = 0; i < 4; i++)
+	out.push_back((char) ((value >> (8 * i)) & 0xff));
+}
+
+void put_uint64(vector<char> &out, unsigned long long value)
+{
+    for(int i = 0; i < 8; i++)
+	out.push_back((char) ((value >> (8 * i)) & 0xff));
+}
+
+/**
+ * @brief Appends a string with a 2-byte length (for names in headers).
+ */
+void put_string16(vector<char> &out, const string &value)
+{
+    size_t length = value.size() > 0xffff ? 0xffff : value.size();
+    put_uint16(out, length);
+    out.insert(out.end(), value.data(), value.data() + length);
+}
+
+bool get_uint16(const char *&p, const char *end, unsigned int &value)
+{
+    if(end - p < 2)
+	return false;
+    value = (unsigned char) p[0] | (unsigned int) (unsigned char) p[1] << 8;
+    p += 2;
+    return true;
+}
+
+bool get_uint32(const char *&p, const char *end, unsigned long &value)
+{
+    if(end - p < 4)
+	return false;
+    value = 0;
+    for(int i = 0; i < 4; i++)
+	value |= (unsigned long) (unsigned char) p[i] << (8 * i);
+    p += 4;
+    return true;
+}
+
+bool get_uint64(const char *&p, const char *end, unsigned long long &value)
+{
+    if(end - p < 8)
+	return false;
+    value = 0;
+    for(int i = 0; i < 8; i++)
+	value |= (unsigned long long) (unsigned char) p[i] << (8 * i);
+    p += 8;
+    return true;
+}
+
+bool get_string16(const char *&p, const char *end, string &value)
+{
+    unsigned int length;
+    if(!get_uint16(p, end, length) || end - p < (long) length)
+	return false;
+    value.assign(p, length);
+    p += length;
+    return true;
+}
+
+/**
+ * @brief Returns the number of elements of an array type (the product of
+ * its dimensions).
+ */
+DDS_UnsignedLong array_element_count(const DDS_TypeCode *type)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_UnsignedLong dimensions = type->array_dimension_count(ex);
+    DDS_UnsignedLong count = 1;
+    for(DDS_UnsignedLong i = 0; i < dimensions && ex == DDS_NO_EXCEPTION_CODE; i++)
+	count *= type->array_dimension(i, ex);
+    return ex == DDS_NO_EXCEPTION_CODE ? count : 0;
+}
+
+static void put_float(vector<char> &out, float value)
+{
+    DDS_UnsignedLong bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_uint32(out, bits);
+}
+
+static void put_double(vector<char> &out, double value)
+{
+    DDS_UnsignedLongLong bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_uint64(out, bits);
+}
+
+/**
+ * @brief Appends the encoding of a sample to a buffer.
+ *
+ * @param data The sample.
+ * @param out Buffer the encoding is appended to.
+ *
+ * @return False if the type has members that cannot be encoded (unions,
+ * wide characters...); the buffer is then left as it was.
+ */
+bool sample_encoder::encode(const DDS_DynamicData &data, vector<char> &out)
+{
+    size_t start = out.size();
+    //Binding nested members needs a non-const sample, but it is not modified
+    DDS_DynamicData &sample = const_cast<DDS_DynamicData &>(data);
+    if(!encode_members(sample, data.get_type(), out)) {
+	out.resize(start);
+	return false;
+    }
+    return true;
+}
+
+bool sample_encoder::encode_members(DDS_DynamicData &data,
+				    const DDS_TypeCode *type,
+				    vector<char> &out)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_UnsignedLong count = type->member_count(ex);
+    if(ex != DDS_NO_EXCEPTION_CODE)
+	return false;
+
+    for(DDS_UnsignedLong i = 0; i < count; i++) {
+	const char *name = type->member_name(i, ex);
+	const DDS_TypeCode *member_type = type->member_type(i, ex);
+	if(ex != DDS_NO_EXCEPTION_CODE)
+	    return false;
+	if(!encode_value(data, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, member_type, out))
+	    return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Appends one member (given by name) or element (given by id).
+ */
+bool sample_encoder::encode_value(DDS_DynamicData &data,
+				  const char *name,
+				  DDS_DynamicDataMemberId id,
+				  const DDS_TypeCode *type,
+				  vector<char> &out)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_TCKind kind = type->kind(ex);
+    while(kind == DDS_TK_ALIAS) {
+	type = type->content_type(ex);
+	kind = type->kind(ex);
+    }
+
+    DDS_ReturnCode_t retcode;
+    switch(kind) {
+    case DDS_TK_BOOLEAN: {
+	DDS_Boolean v = DDS_BOOLEAN_FALSE; retcode = data.get_boolean(v, name, id);
+	out.push_back(v ? 1 : 0); break;
+    }
+    case DDS_TK_OCTET: {
+	DDS_Octet v = 0; retcode = data.get_octet(v, name, id);
+	out.push_back((char) v); break;
+    }
+    case DDS_TK_CHAR: {
+	DDS_Char v = 0; retcode = data.get_char(v, name, id);
+	out.push_back(v); break;
+    }
+    case DDS_TK_SHORT: {
+	DDS_Short v = 0; retcode = data.get_short(v, name, id);
+	put_uint16(out, (DDS_UnsignedShort) v); break;
+    }
+    case DDS_TK_USHORT: {
+	DDS_UnsignedShort v = 0; retcode = data.get_ushort(v, name, id);
+	put_uint16(out, v); break;
+    }
+    case DDS_TK_LONG:
+    case DDS_TK_ENUM: {
+	DDS_Long v = 0; retcode = data.get_long(v, name, id);
+	put_uint32(out, (DDS_UnsignedLong) v); break;
+    }
+    case DDS_TK_ULONG: {
+	DDS_UnsignedLong v = 0; retcode = data.get_ulong(v, name, id);
+	put_uint32(out, v); break;
+    }
+    case DDS_TK_LONGLONG: {
+	DDS_LongLong v = 0; retcode = data.get_longlong(v, name, id);
+	put_uint64(out, (DDS_UnsignedLongLong) v); break;
+    }
+    case DDS_TK_ULONGLONG: {
+	DDS_UnsignedLongLong v = 0; retcode = data.get_ulonglong(v, name, id);
+	put_uint64(out, v); break;
+    }
+    case DDS_TK_FLOAT: {
+	DDS_Float v = 0; retcode = data.get_float(v, name, id);
+	put_float(out, v); break;
+    }
+    case DDS_TK_DOUBLE: {
+	DDS_Double v = 0; retcode = data.get_double(v, name, id);
+	put_double(out, v); break;
+    }
+    case DDS_TK_STRING:
+	return encode_string(data, name, id, out);
+    case DDS_TK_STRUCT:
+    case DDS_TK_SEQUENCE:
+    case DDS_TK_ARRAY: {
+	DDS_DynamicData nested(NULL, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+	if(data.bind_complex_member(nested, name, id) != DDS_RETCODE_OK) {
+	    //Unset sequence: no elements
+	    if(kind != DDS_TK_SEQUENCE)
+		return false;
+	    put_uint32(out, 0);
+	    return true;
+	}
+
+	bool ok = true;
+	if(kind == DDS_TK_STRUCT) {
+	    ok = encode_members(nested, type, out);
+	}
+	else {
+	    const DDS_TypeCode *element_type = type->content_type(ex);
+	    DDS_UnsignedLong count = (kind == DDS_TK_SEQUENCE) ?
+		nested.get_member_count() : array_element_count(type);
+	    if(kind == DDS_TK_SEQUENCE)
+		put_uint32(out, count);
+	    for(DDS_UnsignedLong i = 0; i < count && ok; i++)
+		ok = encode_value(nested, NULL, i + 1, element_type, out);
+	}
+	data.unbind_complex_member(nested);
+	return ok;
+    }
+    default:
+	return false;
+    }
+
+    //Unset optional members are encoded as zero
+    return retcode == DDS_RETCODE_OK || retcode == DDS_RETCODE_NO_DATA;
+}
+
+bool sample_encoder::encode_string(DDS_DynamicData &data,
+				   const char *name,
+				   DDS_DynamicDataMemberId id,
+				   vector<char> &out)
+{
+    if(string_buffer_.size() < 256)
+	string_buffer_.resize(256);
+    char *str = &string_buffer_[0];
+    DDS_UnsignedLong size = string_buffer_.size();
+    DDS_ReturnCode_t retcode = data.get_string(str, &size, name, id);
+    if(retcode != DDS_RETCODE_OK && size >= string_buffer_.size()) {
+	//Too small: size is now the required length
+	string_buffer_.resize(size + 1);
+	str = &string_buffer_[0];
+	size = string_buffer_.size();
+	retcode = data.get_string(str, &size, name, id);
+    }
+    if(retcode != DDS_RETCODE_OK)
+	string_buffer_[0] = '\0';
+
+    size_t length = strlen(&string_buffer_[0]);
+    put_uint32(out, length);
+    out.insert(out.end(), &string_buffer_[0], &string_buffer_[0] + length);
+    return true;
+}
+
+
+/**
+ * @brief Decodes a sample into a DynamicData of its type.
+ *
+ * The members of the sample are cleared first, so that sequences do not
+ * keep elements of a previous (longer) sample.
+ * @param buffer The encoding, as written by sample_encoder::encode().
+ * @param length Size of the encoding.
+ * @param data The sample.
+ *
+ * @return False if the encoding is truncated or does not match the type.
+ */
+bool sample_decoder::decode(const char *buffer, size_t length, DDS_DynamicData &data)
+{
+    const char *p = buffer;
+    data.clear_all_members();
+    return decode_members(data, data.get_type(), p, buffer + length);
+}
+
+bool sample_decoder::decode_members(DDS_DynamicData &data,
+				    const DDS_TypeCode *type,
+				    const char *&p,
+				    const char *end)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_UnsignedLong count = type->member_count(ex);
+    if(ex != DDS_NO_EXCEPTION_CODE)
+	return false;
+
+    for(DDS_UnsignedLong i = 0; i < count; i++) {
+	const char *name = type->member_name(i, ex);
+	const DDS_TypeCode *member_type = type->member_type(i, ex);
+	if(ex != DDS_NO_EXCEPTION_CODE)
+	    return false;
+	if(!decode_value(data, name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, member_type, p, end))
+	    return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Decodes one member (given by name) or element (given by id).
+ */
+bool sample_decoder::decode_value(DDS_DynamicData &data,
+				  const char *name,
+				  DDS_DynamicDataMemberId id,
+				  const DDS_TypeCode *type,
+				  const char *&p,
+				  const char *end)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_TCKind kind = type->kind(ex);
+    while(kind == DDS_TK_ALIAS) {
+	type = type->content_type(ex);
+	kind = type->kind(ex);
+    }
+
+    unsigned int u16;
+    unsigned long u32;
+    unsigned long long u64;
+    DDS_ReturnCode_t retcode;
+    switch(kind) {
+    case DDS_TK_BOOLEAN:
+    case DDS_TK_OCTET:
+    case DDS_TK_CHAR:
+	if(p >= end)
+	    return false;
+	if(kind == DDS_TK_BOOLEAN)
+	    retcode = data.set_boolean(name, id, *p ? DDS_BOOLEAN_TRUE : DDS_BOOLEAN_FALSE);
+	else if(kind == DDS_TK_OCTET)
+	    retcode = data.set_octet(name, id, (DDS_Octet) *p);
+	else
+	    retcode = data.set_char(name, id, *p);
+	p++;
+	break;
+    case DDS_TK_SHORT:
+	if(!get_uint16(p, end, u16))
+	    return false;
+	retcode = data.set_short(name, id, (DDS_Short) u16);
+	break;
+    case DDS_TK_USHORT:
+	if(!get_uint16(p, end, u16))
+	    return false;
+	retcode = data.set_ushort(name, id, u16);
+	break;
+    case DDS_TK_LONG:
+    case DDS_TK_ENUM:
+	if(!get_uint32(p, end, u32))
+	    return false;
+	retcode = data.set_long(name, id, (DDS_Long) u32);
+	break;
+    case DDS_TK_ULONG:
+	if(!get_uint32(p, end, u32))
+	    return false;
+	retcode = data.set_ulong(name, id, u32);
+	break;
+    case DDS_TK_LONGLONG:
+	if(!get_uint64(p, end, u64))
+	    return false;
+	retcode = data.set_longlong(name, id, (DDS_LongLong) u64);
+	break;
+    case DDS_TK_ULONGLONG:
+	if(!get_uint64(p, end, u64))
+	    return false;
+	retcode = data.set_ulonglong(name, id, u64);
+	break;
+    case DDS_TK_FLOAT: {
+	if(!get_uint32(p, end, u32))
+	    return false;
+	DDS_UnsignedLong bits = u32;
+	DDS_Float v;
+	memcpy(&v, &bits, sizeof(v));
+	retcode = data.set_float(name, id, v);
+	break;
+    }
+    case DDS_TK_DOUBLE: {
+	if(!get_uint64(p, end, u64))
+	    return false;
+	DDS_UnsignedLongLong bits = u64;
+	DDS_Double v;
+	memcpy(&v, &bits, sizeof(v));
+	retcode = data.set_double(name, id, v);
+	break;
+    }
+    case DDS_TK_STRING:
+	if(!get_uint32(p, end, u32) || (unsigned long) (end - p) < u32)
+	    return false;
+	string_.assign(p, u32);
+	p += u32;
+	retcode = data.set_string(name, id, string_.c_str());
+	break;
+    case DDS_TK_STRUCT:
+    case DDS_TK_SEQUENCE:
+    case DDS_TK_ARRAY: {
+	DDS_UnsignedLong count = 0;
+	if(kind == DDS_TK_SEQUENCE) {
+	    if(!get_uint32(p, end, u32))
+		return false;
+	    count = u32;
+	    if(count == 0)
+		return true;
+	}
+	else if(kind == DDS_TK_ARRAY) {
+	    count = array_element_count(type);
+	}
+
+	DDS_DynamicData nested(NULL, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+	if(data.bind_complex_member(nested, name, id) != DDS_RETCODE_OK)
+	    return false;
+
+	bool ok = true;
+	if(kind == DDS_TK_STRUCT) {
+	    ok = decode_members(nested, type, p, end);
+	}
+	else {
+	    const DDS_TypeCode *element_type = type->content_type(ex);
+	    for(DDS_UnsignedLong i = 0; i < count && ok; i++)
+		ok = decode_value(nested, NULL, i + 1, element_type, p, end);
+	}
+	data.unbind_complex_member(nested);
+	return ok;
+    }
+    default:
+	return false;
+    }
+
+    return retcode == DDS_RETCODE_OK;
+}
+
+
+/**
+ * @brief Appends the description of a type, so that it can be rebuilt
+ * without the XML of its plugin.
+ *
+ * Every type starts with its kind (one byte, the DDS_TCKind value).
+ * Structures follow with their name, member count and members (name, a
+ * byte with 1 for key members, type); enumerations with their name and
+ * enumerators (name, ordinal); aliases with their name and type; strings
+ * with their bound; sequences with their bound and element type; arrays
+ * with their dimensions and element type. Primitive types have nothing else.
+ *
+ * @return False if the type has members that cannot be described (unions,
+ * wide characters...); the buffer is then left as it was.
+ */
+bool encode_type(const DDS_TypeCode *type, vector<char> &out)
+{
+    size_t start = out.size();
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_TCKind kind = type->kind(ex);
+    out.push_back((char) kind);
+
+    bool ok = true;
+    switch(kind) {
+    case DDS_TK_BOOLEAN: case DDS_TK_OCTET: case DDS_TK_CHAR:
+    case DDS_TK_SHORT: case DDS_TK_USHORT: case DDS_TK_LONG: case DDS_TK_ULONG:
+    case DDS_TK_LONGLONG: case DDS_TK_ULONGLONG: case DDS_TK_FLOAT: case DDS_TK_DOUBLE:
+	break;
+    case DDS_TK_STRUCT: {
+	DDS_UnsignedLong count = type->member_count(ex);
+	put_string16(out, type->name(ex));
+	put_uint32(out, count);
+	for(DDS_UnsignedLong i = 0; i < count && ok; i++) {
+	    put_string16(out, type->member_name(i, ex));
+	    out.push_back(type->is_member_key(i, ex) ? 1 : 0);
+	    ok = encode_type(type->member_type(i, ex), out);
+	}
+	break;
+    }
+    case DDS_TK_ENUM: {
+	DDS_UnsignedLong count = type->member_count(ex);
+	put_string16(out, type->name(ex));
+	put_uint32(out, count);
+	for(DDS_UnsignedLong i = 0; i < count; i++) {
+	    put_string16(out, type->member_name(i, ex));
+	    put_uint32(out, (DDS_UnsignedLong) type->member_ordinal(i, ex));
+	}
+	break;
+    }
+    case DDS_TK_ALIAS:
+	put_string16(out, type->name(ex));
+	ok = encode_type(type->content_type(ex), out);
+	break;
+    case DDS_TK_STRING:
+	put_uint32(out, type->length(ex));
+	break;
+    case DDS_TK_SEQUENCE:
+	put_uint32(out, type->length(ex));
+	ok = encode_type(type->content_type(ex), out);
+	break;
+    case DDS_TK_ARRAY: {
+	DDS_UnsignedLong dimensions = type->array_dimension_count(ex);
+	put_uint32(out, dimensions);
+	for(DDS_UnsignedLong i = 0; i < dimensions; i++)
+	    put_uint32(out, type->array_dimension(i, ex));
+	ok = encode_type(type->content_type(ex), out);
+	break;
+    }
+    default:
+	ok = false;
+    }
+
+    if(!ok || ex != DDS_NO_EXCEPTION_CODE) {
+	out.resize(start);
+	return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Rebuilds a type described by encode_type().
+ *
+ * @param owned Set to false for primitive types, which belong to the
+ * factory and must not be deleted.
+ */
+static DDS_TypeCode *decode_type(const char *&p, const char *end, bool &owned)
+{
+    DDS_TypeCodeFactory *factory = DDS_TypeCodeFactory::get_instance();
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    if(p >= end)
+	return NULL;
+    DDS_TCKind kind = (DDS_TCKind) (unsigned char) *p++;
+    owned = true;
+
+    string name;
+    unsigned long count, bound;
+    DDS_TypeCode *type = NULL;
+    switch(kind) {
+    case DDS_TK_BOOLEAN: case DDS_TK_OCTET: case DDS_TK_CHAR:
+    case DDS_TK_SHORT: case DDS_TK_USHORT: case DDS_TK_LONG: case DDS_TK_ULONG:
+    case DDS_TK_LONGLONG: case DDS_TK_ULONGLONG: case DDS_TK_FLOAT: case DDS_TK_DOUBLE:
+	owned = false;
+	return (DDS_TypeCode *) factory->get_primitive_tc(kind);
+    case DDS_TK_STRUCT: {
+	if(!get_string16(p, end, name) || !get_uint32(p, end, count))
+	    return NULL;
+	DDS_StructMemberSeq members;
+	type = factory->create_struct_tc(name.c_str(), members, ex);
+	for(unsigned long i = 0; i < count && type != NULL; i++) {
+	    string member;
+	    bool member_owned;
+	    if(!get_string16(p, end, member) || p >= end) {
+		factory->delete_tc(type, ex);
+		return NULL;
+	    }
+	    bool key = *p++ != 0;
+	    DDS_TypeCode *member_type = decode_type(p, end, member_owned);
+	    if(member_type != NULL)
+		type->add_member(member.c_str(), DDS_TYPECODE_MEMBER_ID_INVALID, member_type,
+				 key ? DDS_TYPECODE_KEY_MEMBER : DDS_TYPECODE_NONKEY_MEMBER, ex);
+	    if(member_type != NULL && member_owned)
+		factory->delete_tc(member_type, ex);
+	    if(member_type == NULL || ex != DDS_NO_EXCEPTION_CODE) {
+		factory->delete_tc(type, ex);
+		return NULL;
+	    }
+	}
+	return type;
+    }
+    case DDS_TK_ENUM: {
+	if(!get_string16(p, end, name) || !get_uint32(p, end, count))
+	    return NULL;
+	DDS_EnumMemberSeq members;
+	type = factory->create_enum_tc(name.c_str(), members, ex);
+	for(unsigned long i = 0; i < count && type != NULL; i++) {
+	    string enumerator;
+	    unsigned long ordinal;
+	    if(!get_string16(p, end, enumerator) || !get_uint32(p, end, ordinal)) {
+		factory->delete_tc(type, ex);
+		return NULL;
+	    }
+	    type->add_member_to_enum(enumerator.c_str(), (DDS_Long) ordinal, ex);
+	}
+	return type;
+    }
+    case DDS_TK_STRING:
+	if(!get_uint32(p, end, bound))
+	    return NULL;
+	return factory->create_string_tc(bound, ex);
+    case DDS_TK_ALIAS:
+    case DDS_TK_SEQUENCE:
+    case DDS_TK_ARRAY: {
+	DDS_UnsignedLongSeq dimensions;
+	if(kind == DDS_TK_ALIAS) {
+	    if(!get_string16(p, end, name))
+		return NULL;
+	}
+	else if(kind == DDS_TK_SEQUENCE) {
+	    if(!get_uint32(p, end, bound))
+		return NULL;
+	}
+	else {
+	    if(!get_uint32(p, end, count) || count == 0 || count > 32 ||
+	       !dimensions.ensure_length(count, count))
+		return NULL;
+	    for(unsigned long i = 0; i < count; i++) {
+		unsigned long dimension;
+		if(!get_uint32(p, end, dimension))
+		    return NULL;
+		dimensions[i] = dimension;
+	    }
+	}
+
+	bool content_owned;
+	DDS_TypeCode *content = decode_type(p, end, content_owned);
+	if(content == NULL)
+	    return NULL;
+	if(kind == DDS_TK_ALIAS)
+	    type = factory->create_alias_tc(name.c_str(), content, DDS_BOOLEAN_FALSE, ex);
+	else if(kind == DDS_TK_SEQUENCE)
+	    type = factory->create_sequence_tc(bound, content, ex);
+	else
+	    type = factory->create_array_tc(dimensions, content, ex);
+	if(content_owned)
+	    factory->delete_tc(content, ex);
+	return type;
+    }
+    default:
+	return NULL;
+    }
+}
+
+/**
+ * @brief Rebuilds the (structure) type of a stream described by
+ * encode_type().
+ *
+ * @param p Start of the description; left after it.
+ * @param end End of the buffer.
+ *
+ * @return A new type code (to be deleted with the DDS_TypeCodeFactory), or
+ * NULL if the description is invalid or not a structure.
+ */
+DDS_TypeCode *decode_type(const char *&p, const char *end)
+{
+    bool owned;
+    DDS_TypeCode *type = decode_type(p, end, owned);
+    if(type != NULL && !owned)
+	return NULL;
+    return type;
+}
@@ -0,0 +1,102 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLE_CODEC_HPP
+#define SAMPLE_CODEC_HPP
+
+#include <string>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+/**
+ * @class sample_encoder
+ * Encodes DynamicData samples in a compact binary form for the non-DDS
+ * sinks. Members are written in the order of the type code, with no names
+ * or padding, in little-endian order:
+ *  - boolean, octet and char: 1 byte; short: 2; long, enum and float: 4;
+ *    long long and double: 8;
+ *  - strings: a 4-byte length followed by the characters (no NUL);
+ *  - sequences: a 4-byte element count followed by the elements; arrays:
+ *    their elements;
+ *  - nested structures: their members.
+ * The type code of the stream is needed to decode a sample; encode_type()
+ * writes it in a compact form that decode_type() turns back into a type
+ * code.
+ */
+class sample_encoder {
+public:
+    bool encode(const DDS_DynamicData &data, std::vector<char> &out);
+
+private:
+    bool encode_members(DDS_DynamicData &data,
+			const DDS_TypeCode *type,
+			std::vector<char> &out);
+    bool encode_value(DDS_DynamicData &data,
+		      const char *name,
+		      DDS_DynamicDataMemberId id,
+		      const DDS_TypeCode *type,
+		      std::vector<char> &out);
+    bool encode_string(DDS_DynamicData &data,
+		       const char *name,
+		       DDS_DynamicDataMemberId id,
+		       std::vector<char> &out);
+
+    std::vector<char> string_buffer_;
+};
+
+/**
+ * @class sample_decoder
+ * Decodes the samples written by sample_encoder into DynamicData of the
+ * same type.
+ */
+class sample_decoder {
+public:
+    bool decode(const char *buffer, size_t length, DDS_DynamicData &data);
+
+private:
+    bool decode_members(DDS_DynamicData &data,
+			const DDS_TypeCode *type,
+			const char *&p,
+			const char *end);
+    bool decode_value(DDS_DynamicData &data,
+		      const char *name,
+		      DDS_DynamicDataMemberId id,
+		      const DDS_TypeCode *type,
+		      const char *&p,
+		      const char *end);
+
+    std::string string_;
+};
+
+bool encode_type(const DDS_TypeCode *type, std::vector<char> &out);
+DDS_TypeCode *decode_type(const char *&p, const char *end);
+DDS_UnsignedLong array_element_count(const DDS_TypeCode *type);
+
+void put_uint16(std::vector<char> &out, unsigned int value);
+void put_uint32(std::vector<char> &out, unsigned long value);
+void put_uint64(std::vector<char> &out, unsigned long long value);
+void put_string16(std::vector<char> &out, const std::string &value);
+
+bool get_uint16(const char *&p, const char *end, unsigned int &value);
+bool get_uint32(const char *&p, const char *end, unsigned long &value);
+bool get_uint64(const char *&p, const char *end, unsigned long long &value);
+bool get_string16(const char *&p, const char *end, std::string &value);
+
+#endif //SAMPLE_CODEC_HPP
@@ -0,0 +1,497 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <ctime>
+
+#ifdef RTI_WIN32
+#include <windows.h>
+#endif
+
+extern "C" {
+#include <sigar.h>
+}
+
+#include "self_telemetry.hpp"
+
+using namespace std;
+
+self_telemetry::self_telemetry()
+    : type_code_(NULL),
+      type_support_(NULL),
+      writer_(NULL),
+      data_(NULL),
+      recording_(false),
+      period_ns_(0),
+      last_report_ns_(0)
+{
+}
+
+/**
+ * @brief Destructor of the self_telemetry class.
+ *
+ * Releases the sample, the type support and the type code. The topic and
+ * the DataWriter are deleted along with the rest of the participant's
+ * entities.
+ */
+self_telemetry::~self_telemetry()
+{
+    if(data_ != NULL)
+	type_support_->delete_data(data_);
+    delete type_support_;
+    if(type_code_ != NULL) {
+	DDS_ExceptionCode_t ex;
+	DDS_TypeCodeFactory::get_instance()->delete_tc(type_code_, ex);
+    }
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+long long self_telemetry::now_ns()
+{
+#ifndef RTI_WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (long long) ((double) counter.QuadPart * 1e9 / frequency.QuadPart);
+#endif
+}
+
+/**
+ * @brief Returns the wall-clock time in nanoseconds since the epoch.
+ */
+long long self_telemetry::epoch_ns()
+{
+#ifndef RTI_WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+    return (long long) time(NULL) * 1000000000LL;
+#endif
+}
+
+/**
+ * @brief Builds the type code of the cavecanem_self topic.
+ *
+ * @return The type code (to be deleted with the type code factory), or NULL
+ * on error.
+ */
+DDS_TypeCode *self_telemetry::create_type_code()
+{
+    DDS_TypeCodeFactory *factory = DDS_TypeCodeFactory::get_instance();
+    DDS_ExceptionCode_t ex;
+    DDS_StructMemberSeq members;
+
+    DDS_TypeCode *type_code = factory->create_struct_tc(SELF_TOPIC_NAME, members, ex);
+    if(ex != DDS_NO_EXCEPTION_CODE)
+	return NULL;
+
+    struct {
+	const char *name;
+	DDS_UnsignedLong string_length; //0 for numbers
+	DDS_TCKind kind;
+	bool key;
+    } layout[] = {
+	{"hostname", SELF_MAX_HOSTNAME_LENGTH, DDS_TK_STRING, true},
+	{"plugin", SELF_MAX_PLUGIN_LENGTH, DDS_TK_STRING, true},
+	{"ts", 0, DDS_TK_LONG, false},
+	{"period_sec", 0, DDS_TK_DOUBLE, false},
+	{"runs", 0, DDS_TK_LONGLONG, false},
+	{"cpu_share", 0, DDS_TK_DOUBLE, false},
+	{"collect_p50_ns", 0, DDS_TK_LONGLONG, false},
+	{"collect_p99_ns", 0, DDS_TK_LONGLONG, false},
+	{"collect_max_ns", 0, DDS_TK_LONGLONG, false},
+	{"samples", 0, DDS_TK_LONGLONG, false},
+	{"bytes", 0, DDS_TK_LONGLONG, false},
+	{"write_errors", 0, DDS_TK_LONGLONG, false},
+	{"write_p50_ns", 0, DDS_TK_LONGLONG, false},
+	{"write_p99_ns", 0, DDS_TK_LONGLONG, false},
+	{"write_p999_ns", 0, DDS_TK_LONGLONG, false},
+	{"write_max_ns", 0, DDS_TK_LONGLONG, false},
+	{"egress_wait_p50_ns", 0, DDS_TK_LONGLONG, false},
+	{"egress_wait_p99_ns", 0, DDS_TK_LONGLONG, false},
+	{"egress_wait_max_ns", 0, DDS_TK_LONGLONG, false},
+	{"cpu_ns", 0, DDS_TK_LONGLONG, false},
+	{"effective_period_sec", 0, DDS_TK_DOUBLE, false},
+	{"period_change", SELF_MAX_REASON_LENGTH, DDS_TK_STRING, false}
+    };
+
+    for(size_t i = 0; i < sizeof(layout) / sizeof(layout[0]); i++) {
+	DDS_TypeCode *string_tc = NULL;
+	const DDS_TypeCode *member_tc;
+	if(layout[i].string_length > 0) {
+	    string_tc = factory->create_string_tc(layout[i].string_length, ex);
+	    member_tc = string_tc;
+	}
+	else {
+	    member_tc = factory->get_primitive_tc(layout[i].kind);
+	}
+
+	type_code->add_member(layout[i].name,
+			      DDS_TYPECODE_MEMBER_ID_INVALID,
+			      member_tc,
+			      layout[i].key ? DDS_TYPECODE_KEY_MEMBER : DDS_TYPECODE_NONKEY_MEMBER,
+			      ex);
+
+	if(string_tc != NULL) {
+	    DDS_ExceptionCode_t delete_ex;
+	    factory->delete_tc(string_tc, delete_ex);
+	}
+	if(ex != DDS_NO_EXCEPTION_CODE) {
+	    cerr << "error adding member " << layout[i].name
+		 << " to the " << SELF_TOPIC_NAME << " type" << endl;
+	    factory->delete_tc(type_code, ex);
+	    return NULL;
+	}
+    }
+
+    return type_code;
+}
+
+/**
+ * @brief Creates the topic and the DataWriter of the self telemetry.
+ *
+ * @param participant DDS Domain Participant of the agent.
+ * @param publisher DDS Publisher of the agent.
+ * @param qos_library Name of the QoS library.
+ * @param qos_profile Name of the QoS profile (if "default" the default RTI DDS QoS settings will be loaded).
+ * @param period_sec Report period; 0 disables the telemetry.
+ *
+ * With a NULL participant the measures are recorded but never published,
+ * which is how cavecanem_bench runs the agent's accounting without DDS.
+ *
+ * @return True if everything was created correctly (or the telemetry is
+ * disabled).
+ */
+bool self_telemetry::initialize(DDSDomainParticipant *participant,
+				DDSPublisher *publisher,
+				string qos_library,
+				string qos_profile,
+				int period_sec)
+{
+    if(period_sec <= 0)
+	return true;
+    period_ns_ = period_sec * 1000000000LL;
+    last_report_ns_ = now_ns();
+    if(participant == NULL) {
+	recording_ = true;
+	return true;
+    }
+
+    sigar_t *sig;
+    if(sigar_open(&sig) == 0) {
+	sigar_net_info_t net_info;
+	if(sigar_net_info_get(sig, &net_info) == 0)
+	    hostname_ = net_info.host_name;
+	sigar_close(sig);
+    }
+    if(hostname_.size() > SELF_MAX_HOSTNAME_LENGTH)
+	hostname_.resize(SELF_MAX_HOSTNAME_LENGTH);
+
+    type_code_ = create_type_code();
+    if(type_code_ == NULL) {
+	cerr << "error creating " << SELF_TOPIC_NAME << " typecode" << endl;
+	return false;
+    }
+
+    type_support_ = new DDSDynamicDataTypeSupport(type_code_,
+						  DDS_DYNAMIC_DATA_TYPE_PROPERTY_DEFAULT);
+    const char *type_name = type_support_->get_type_name();
+    if(type_support_->register_type(participant, type_name) != DDS_RETCODE_OK) {
+	cerr << SELF_TOPIC_NAME << " register_type error" << endl;
+	return false;
+    }
+
+    DDSTopic *topic = participant->create_topic(SELF_TOPIC_NAME,
+						type_name,
+						DDS_TOPIC_QOS_DEFAULT,
+						NULL /* listener */,
+						DDS_STATUS_MASK_NONE);
+    if(topic == NULL) {
+	cerr << SELF_TOPIC_NAME << " create_topic error" << endl;
+	return false;
+    }
+
+    DDSDataWriter *writer;
+    if(qos_profile == "default")
+	writer = publisher->create_datawriter(topic,
+					      DDS_DATAWRITER_QOS_DEFAULT,
+					      NULL /* listener */,
+					      DDS_STATUS_MASK_NONE);
+    else
+	writer = publisher->create_datawriter_with_profile(topic,
+							   qos_library.c_str(),
+							   qos_profile.c_str(),
+							   NULL /* listener */,
+							   DDS_STATUS_MASK_NONE);
+    if(writer == NULL) {
+	cerr << SELF_TOPIC_NAME << " create_datawriter error" << endl;
+	return false;
+    }
+
+    DDSDynamicDataWriter *dynamic_writer = DDSDynamicDataWriter::narrow(writer);
+    if(dynamic_writer == NULL) {
+	cerr << SELF_TOPIC_NAME << " DataWriter narrow error" << endl;
+	return false;
+    }
+
+    data_ = type_support_->create_data();
+    if(data_ == NULL) {
+	cerr << SELF_TOPIC_NAME << " create_data error" << endl;
+	return false;
+    }
+
+    writer_ = dynamic_writer;
+    recording_ = true;
+    return true;
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its entry, so that recording its runs and writes does not look its
+ * name up.
+ *
+ * @param index Index of the plugin in the schedule.
+ * @param plugin_name Name of the plugin.
+ */
+void self_telemetry::bind_plugin(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    bound_[index] = &plugins_[plugin_name];
+}
+
+/**
+ * @brief Records a run of generate_and_publish_information().
+ *
+ * The time spent in the writes of the run (see record_write()) is
+ * subtracted, so that the collect histogram only measures the plugin.
+ * Plugins not bound (see bind_plugin()), e.g. removed ones, are ignored.
+ * @param index Index the plugin is bound to.
+ * @param elapsed_ns Duration of the whole run.
+ * @param cpu_ns CPU time of the whole run.
+ */
+void self_telemetry::record_run(size_t index,
+				long long elapsed_ns,
+				long long cpu_ns)
+{
+    if(!recording_ || index >= bound_.size() || bound_[index] == NULL)
+	return;
+    plugin_telemetry &telemetry = *bound_[index];
+    telemetry.collect.record(elapsed_ns - telemetry.pending_write_ns);
+    telemetry.pending_write_ns = 0;
+    telemetry.cpu_ns += cpu_ns;
+}
+
+/**
+ * @brief Records a DataWriter write of a plugin.
+ *
+ * @param index Index the plugin is bound to.
+ * @param elapsed_ns Duration of the write.
+ * @param bytes Size of the sample.
+ * @param ok False if the write failed.
+ */
+void self_telemetry::record_write(size_t index,
+				  long long elapsed_ns,
+				  long long bytes,
+				  bool ok)
+{
+    if(!recording_ || index >= bound_.size() || bound_[index] == NULL)
+	return;
+    plugin_telemetry &telemetry = *bound_[index];
+    telemetry.write.record(elapsed_ns);
+    telemetry.pending_write_ns += elapsed_ns;
+    if(ok) {
+	telemetry.samples++;
+	telemetry.bytes += bytes;
+    }
+    else {
+	telemetry.write_errors++;
+    }
+}
+
+/**
+ * @brief Records the write of a sample released by the egress shaper.
+ *
+ * Releases happen outside the runs of the plugin, so unlike record_write()
+ * their time is not subtracted from the next run.
+ * @param index Index the plugin is bound to.
+ * @param waited_ns Time the sample spent queued.
+ * @param elapsed_ns Duration of the write.
+ * @param bytes Size of the sample.
+ * @param ok False if the write failed.
+ */
+void self_telemetry::record_release(size_t index,
+				    long long waited_ns,
+				    long long elapsed_ns,
+				    long long bytes,
+				    bool ok)
+{
+    if(!recording_ || index >= bound_.size() || bound_[index] == NULL)
+	return;
+    record_write(index, elapsed_ns, bytes, ok);
+    plugin_telemetry &telemetry = *bound_[index];
+    telemetry.pending_write_ns -= elapsed_ns;
+    telemetry.wait.record(waited_ns);
+}
+
+/**
+ * @brief Records a whole iteration of the publishing loop.
+ */
+void self_telemetry::record_tick(long long elapsed_ns)
+{
+    if(!recording_)
+	return;
+    plugins_[SELF_AGENT_ENTRY].collect.record(elapsed_ns);
+}
+
+/**
+ * @brief Records the period a plugin runs at.
+ *
+ * @param plugin_name Name of the plugin.
+ * @param period_sec Effective period.
+ * @param reason Why it changed; empty if it did not.
+ */
+void self_telemetry::record_period(const string &plugin_name,
+				   double period_sec,
+				   const string &reason)
+{
+    if(!recording_)
+	return;
+    plugin_telemetry &telemetry = plugins_[plugin_name];
+    telemetry.effective_period_sec = period_sec;
+    if(!reason.empty())
+	telemetry.period_change = reason;
+}
+
+/**
+ * @brief Stops reporting a plugin (e.g. when it is unloaded).
+ */
+void self_telemetry::remove_plugin(const string &plugin_name)
+{
+    map<string, plugin_telemetry>::iterator it = plugins_.find(plugin_name);
+    if(it == plugins_.end())
+	return;
+    for(size_t i = 0; i < bound_.size(); i++)
+	if(bound_[i] == &it->second)
+	    bound_[i] = NULL;
+    plugins_.erase(it);
+}
+
+/**
+ * @brief Publishes and resets the telemetry if the report period expired.
+ *
+ * @param now_ns Current time, as returned by now_ns().
+ *
+ * @return True if a report was published.
+ */
+bool self_telemetry::publish_if_due(long long now_ns)
+{
+    if(writer_ == NULL || now_ns - last_report_ns_ < period_ns_)
+	return false;
+
+    long long elapsed_ns = now_ns - last_report_ns_;
+    last_report_ns_ = now_ns;
+
+    for(map<string, plugin_telemetry>::iterator it = plugins_.begin();
+	it != plugins_.end(); ++it) {
+	publish(it->first, it->second, elapsed_ns);
+	it->second.collect.reset();
+	it->second.write.reset();
+	it->second.wait.reset();
+	it->second.samples = 0;
+	it->second.bytes = 0;
+	it->second.write_errors = 0;
+	it->second.cpu_ns = 0;
+	it->second.period_change.clear();
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the sample of a plugin.
+ */
+bool self_telemetry::publish(const string &plugin_name,
+			     const plugin_telemetry &telemetry,
+			     long long period_ns)
+{
+    const latency_histogram &collect = telemetry.collect;
+    const latency_histogram &write = telemetry.write;
+
+    data_->clear_all_members();
+
+    data_->set_string("hostname", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      hostname_.c_str());
+    data_->set_string("plugin", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      plugin_name.substr(0, SELF_MAX_PLUGIN_LENGTH).c_str());
+    data_->set_long("ts", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		    (DDS_Long) time(NULL));
+    data_->set_double("period_sec", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      period_ns / 1e9);
+    data_->set_longlong("runs", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			(DDS_LongLong) collect.count());
+    data_->set_double("cpu_share", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      (double) (collect.total() + write.total()) / period_ns);
+    data_->set_longlong("collect_p50_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			collect.percentile(50));
+    data_->set_longlong("collect_p99_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			collect.percentile(99));
+    data_->set_longlong("collect_max_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			collect.max());
+    data_->set_longlong("samples", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			(DDS_LongLong) telemetry.samples);
+    data_->set_longlong("bytes", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			(DDS_LongLong) telemetry.bytes);
+    data_->set_longlong("write_errors", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			(DDS_LongLong) telemetry.write_errors);
+    data_->set_longlong("write_p50_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			write.percentile(50));
+    data_->set_longlong("write_p99_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			write.percentile(99));
+    data_->set_longlong("write_p999_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			write.percentile(99.9));
+    data_->set_longlong("write_max_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			write.max());
+    data_->set_longlong("egress_wait_p50_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			telemetry.wait.percentile(50));
+    data_->set_longlong("egress_wait_p99_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			telemetry.wait.percentile(99));
+    data_->set_longlong("egress_wait_max_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			telemetry.wait.max());
+    data_->set_longlong("cpu_ns", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			telemetry.cpu_ns);
+    data_->set_double("effective_period_sec", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      telemetry.effective_period_sec);
+    data_->set_string("period_change", DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      telemetry.period_change.substr(0, SELF_MAX_REASON_LENGTH).c_str());
+
+    DDS_InstanceHandle_t instance_handle = DDS_HANDLE_NIL;
+    if(writer_->write(*data_, instance_handle) != DDS_RETCODE_OK) {
+	cerr << "Error writing " << SELF_TOPIC_NAME << " sample" << endl;
+	return false;
+    }
+    return true;
+}
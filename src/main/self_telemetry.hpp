@@ -0,0 +1,131 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SELF_TELEMETRY_HPP
+#define SELF_TELEMETRY_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+#include "latency_histogram.hpp"
+
+#define SELF_TOPIC_NAME "cavecanem_self"
+
+//Name under which the publishing loop itself is reported
+#define SELF_AGENT_ENTRY "cavecanem"
+
+//Bounds of the cavecanem_self type
+#define SELF_MAX_HOSTNAME_LENGTH 50
+#define SELF_MAX_PLUGIN_LENGTH 64
+#define SELF_MAX_REASON_LENGTH 128
+
+/**
+ * @class plugin_telemetry
+ * What a plugin has cost since the last report.
+ */
+struct plugin_telemetry {
+    latency_histogram collect;      //generate_and_publish_information() minus its writes
+    latency_histogram write;        //each DataWriter write
+    latency_histogram wait;         //time samples spent in the egress queue
+    long long pending_write_ns;     //write time of the run in progress
+    long long cpu_ns;               //CPU time of the runs
+    unsigned long long samples;
+    unsigned long long bytes;
+    unsigned long long write_errors;
+    double effective_period_sec;    //period the plugin runs at (0 if unknown)
+    std::string period_change;      //why it last changed, if it did
+
+    plugin_telemetry()
+	: pending_write_ns(0), cpu_ns(0), samples(0), bytes(0), write_errors(0),
+	  effective_period_sec(0) {}
+};
+
+/**
+ * @class self_telemetry
+ * Measures what the agent itself costs and publishes it on the
+ * <code>cavecanem_self</code> topic: one sample per plugin (and one for the
+ * publishing loop, as "cavecanem") every report period, with the
+ * percentiles of its collect and write times, the samples and bytes it
+ * wrote, its write errors, how long its samples waited to be released
+ * by the egress shaper, its CPU time and the period it runs at (with the
+ * reason of the last change the CPU governor or a burst made to it).
+ */
+class self_telemetry {
+public:
+    self_telemetry();
+    ~self_telemetry();
+
+    bool initialize(DDSDomainParticipant *participant,
+		    DDSPublisher *publisher,
+		    std::string qos_library,
+		    std::string qos_profile,
+		    int period_sec);
+
+    bool enabled() const
+    {
+	return recording_;
+    }
+
+    void bind_plugin(size_t index, const std::string &plugin_name);
+    void record_run(size_t index,
+		    long long elapsed_ns,
+		    long long cpu_ns);
+    void record_write(size_t index,
+		      long long elapsed_ns,
+		      long long bytes,
+		      bool ok);
+    void record_release(size_t index,
+			long long waited_ns,
+			long long elapsed_ns,
+			long long bytes,
+			bool ok);
+    void record_tick(long long elapsed_ns);
+    void record_period(const std::string &plugin_name,
+		       double period_sec,
+		       const std::string &reason);
+    void remove_plugin(const std::string &plugin_name);
+
+    bool publish_if_due(long long now_ns);
+
+    static long long now_ns();
+    static long long epoch_ns();
+    static DDS_TypeCode *create_type_code();
+
+private:
+    bool publish(const std::string &plugin_name,
+		 const plugin_telemetry &telemetry,
+		 long long period_ns);
+
+    DDS_TypeCode *type_code_;
+    DDSDynamicDataTypeSupport *type_support_;
+    DDSDynamicDataWriter *writer_;
+    DDS_DynamicData *data_;
+    bool recording_;
+    std::string hostname_;
+
+    long long period_ns_;
+    long long last_report_ns_;
+    std::map<std::string, plugin_telemetry> plugins_;
+    std::vector<plugin_telemetry *> bound_;   //plugin index -> entry, NULL if unbound
+};
+
+#endif //SELF_TELEMETRY_HPP
@@ -0,0 +1,389 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#ifndef RTI_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "sink.hpp"
+
+using namespace std;
+
+//stdio buffer of the file sink
+#define FILE_SINK_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief Creates a sink given its kind.
+ *
+ * @param kind "dds", "file" or "shm".
+ * @param path File of the file sink, or name of the shared-memory object
+ * (e.g. "/cavecanem") of the shm sink.
+ * @param size_kb Size of the data area of the shm ring.
+ * @param error Set to a description of the problem when NULL is returned.
+ *
+ * @return A new sink, or NULL if it could not be created.
+ */
+cc_sink *cc_sink::create(const string &kind,
+			 const string &path,
+			 int size_kb,
+			 string &error)
+{
+    if(kind.empty() || kind == "dds")
+	return new dds_sink();
+
+    if(kind == "file") {
+	file_sink *sink = new file_sink();
+	if(!sink->open(path, error)) {
+	    delete sink;
+	    return NULL;
+	}
+	return sink;
+    }
+
+    if(kind == "shm") {
+	shm_sink *sink = new shm_sink();
+	if(!sink->open(path, (size_t) size_kb * 1024, error)) {
+	    delete sink;
+	    return NULL;
+	}
+	return sink;
+    }
+
+    error = "unknown sink '" + kind + "'";
+    return NULL;
+}
+
+
+bool dds_sink::write(const string &plugin_name,
+		     size_t index,
+		     DDSDynamicDataWriter *writer,
+		     const DDS_DynamicData &data,
+		     unsigned long long timestamp)
+{
+    DDS_Time_t source_time;
+    source_time.sec = (DDS_Long) (timestamp / 1000000000ULL);
+    source_time.nanosec = (DDS_UnsignedLong) (timestamp % 1000000000ULL);
+    return writer->write_w_timestamp(data, DDS_HANDLE_NIL, source_time) == DDS_RETCODE_OK;
+}
+
+
+record_sink::record_sink()
+{
+    record_.reserve(4096);
+}
+
+void record_sink::begin_record(char kind, unsigned int stream_id)
+{
+    record_.clear();
+    put_uint32(record_, 0); //Filled by end_record()
+    record_.push_back(kind);
+    put_uint16(record_, stream_id);
+}
+
+void record_sink::end_record()
+{
+    size_t length = record_.size() - 4;
+    for(int i = 0; i < 4; i++)
+	record_[i] = (char) ((length >> (8 * i)) & 0xff);
+}
+
+/**
+ * @brief Assigns the next stream id to a plugin and writes its stream
+ * and type records.
+ */
+bool record_sink::add_stream(const string &plugin_name,
+			     const string &topic_name,
+			     const DDS_TypeCode *type_code)
+{
+    if(streams_.find(plugin_name) != streams_.end())
+	return true;
+
+    unsigned int id = streams_.size();
+    if(id > 0xffff)
+	return false;
+    streams_[plugin_name] = id;
+
+    DDS_ExceptionCode_t ex;
+    const char *type_name = type_code != NULL ? type_code->name(ex) : NULL;
+
+    begin_record(SINK_RECORD_STREAM, id);
+    put_string16(record_, plugin_name);
+    put_string16(record_, topic_name);
+    put_string16(record_, type_name != NULL ? type_name : "");
+    end_record();
+    if(!append(record_))
+	return false;
+
+    if(type_code == NULL)
+	return true;
+    begin_record(SINK_RECORD_TYPE, id);
+    if(!encode_type(type_code, record_)) {
+	cerr << "Type of " << plugin_name << " cannot be described in the sink" << endl;
+	return true;
+    }
+    end_record();
+    return append(record_);
+}
+
+void record_sink::bind_stream(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, -1);
+    map<string, unsigned int>::iterator it = streams_.find(plugin_name);
+    bound_[index] = (it != streams_.end()) ? (int) it->second : -1;
+}
+
+/**
+ * @brief Writes a data record; the stream of a plugin not bound yet is
+ * looked up by name (and added if needed), and then bound.
+ */
+bool record_sink::write(const string &plugin_name,
+			size_t index,
+			DDSDynamicDataWriter *writer,
+			const DDS_DynamicData &data,
+			unsigned long long timestamp)
+{
+    int id = index < bound_.size() ? bound_[index] : -1;
+    if(id < 0) {
+	if(!add_stream(plugin_name, plugin_name, data.get_type()))
+	    return false;
+	id = streams_[plugin_name];
+	if(index < bound_.size())
+	    bound_[index] = id;
+    }
+
+    begin_record(SINK_RECORD_DATA, id);
+    put_uint64(record_, timestamp);
+    if(!encoder_.encode(data, record_)) {
+	cerr << "Sample of " << plugin_name << " cannot be encoded" << endl;
+	return false;
+    }
+    end_record();
+    return append(record_);
+}
+
+
+file_sink::file_sink() : file_(NULL), buffer_(FILE_SINK_BUFFER_SIZE)
+{
+}
+
+file_sink::~file_sink()
+{
+    if(file_ != NULL)
+	fclose(file_);
+}
+
+/**
+ * @brief Opens (or creates) the file the records are appended to.
+ *
+ * @return False if the file could not be opened or is not a sample file.
+ */
+bool file_sink::open(const string &path, string &error)
+{
+    if(path.empty()) {
+	error = "the file sink requires a path";
+	return false;
+    }
+
+    FILE *existing = fopen(path.c_str(), "rb");
+    if(existing != NULL) {
+	char header[12];
+	size_t length = fread(header, 1, sizeof(header), existing);
+	fclose(existing);
+	const char *p = header + 8;
+	unsigned long version = 0;
+	if(length > 0 && (length < sizeof(header) || memcmp(header, SINK_MAGIC, 8) != 0 ||
+			  !get_uint32(p, header + sizeof(header), version) ||
+			  version != SINK_VERSION)) {
+	    error = path + " is not a sample file of this version";
+	    return false;
+	}
+    }
+
+    file_ = fopen(path.c_str(), "ab");
+    if(file_ == NULL) {
+	error = "cannot open " + path + ": " + strerror(errno);
+	return false;
+    }
+    setvbuf(file_, &buffer_[0], _IOFBF, buffer_.size());
+
+    fseek(file_, 0, SEEK_END);
+    if(ftell(file_) == 0) {
+	vector<char> header(SINK_MAGIC, SINK_MAGIC + 8);
+	put_uint32(header, SINK_VERSION);
+	if(fwrite(&header[0], 1, header.size(), file_) != header.size()) {
+	    error = "cannot write " + path + ": " + strerror(errno);
+	    return false;
+	}
+    }
+    return true;
+}
+
+bool file_sink::append(const vector<char> &record)
+{
+    if(fwrite(&record[0], 1, record.size(), file_) != record.size()) {
+	cerr << "File sink write error: " << strerror(errno) << endl;
+	return false;
+    }
+    return true;
+}
+
+void file_sink::flush()
+{
+    fflush(file_);
+}
+
+
+shm_sink::shm_sink() : header_(NULL), ring_(NULL), mapped_size_(0)
+{
+}
+
+shm_sink::~shm_sink()
+{
+#ifndef RTI_WIN32
+    if(header_ != NULL)
+	munmap(header_, mapped_size_);
+#endif
+}
+
+/**
+ * @brief Creates (or reuses) and maps the shared-memory object.
+ *
+ * The ring is reset, so readers attached to a previous run start over.
+ * @param name Name of the object (e.g. "/cavecanem", i.e. /dev/shm/cavecanem
+ * on Linux).
+ * @param size Size of the data area in bytes (rounded down to 8).
+ */
+bool shm_sink::open(const string &name, size_t size, string &error)
+{
+#ifndef RTI_WIN32
+    if(name.empty() || name[0] != '/') {
+	error = "the shm sink requires a name starting with '/'";
+	return false;
+    }
+    size &= ~(size_t) 7;
+    if(size < 4096) {
+	error = "the shm sink requires at least 4 KB";
+	return false;
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if(fd < 0) {
+	error = "cannot open shared memory " + name + ": " + strerror(errno);
+	return false;
+    }
+    mapped_size_ = sizeof(shm_ring_header) + size;
+    if(ftruncate(fd, mapped_size_) != 0) {
+	error = "cannot size shared memory " + name + ": " + strerror(errno);
+	close(fd);
+	return false;
+    }
+    void *address = mmap(NULL, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED) {
+	error = "cannot map shared memory " + name + ": " + strerror(errno);
+	return false;
+    }
+
+    name_ = name;
+    header_ = (shm_ring_header *) address;
+    ring_ = (char *) address + sizeof(shm_ring_header);
+
+    //Invalidate the magic while the header is rewritten
+    memset(header_->magic, 0, sizeof(header_->magic));
+    __sync_synchronize();
+    header_->version = SINK_VERSION;
+    header_->header_size = sizeof(shm_ring_header);
+    header_->capacity = size;
+    header_->head = 0;
+    header_->stream_count = 0;
+    header_->reserved = 0;
+    memset(header_->streams, 0, sizeof(header_->streams));
+    __sync_synchronize();
+    memcpy(header_->magic, SINK_MAGIC, sizeof(header_->magic));
+    return true;
+#else
+    error = "the shm sink is not available on Windows";
+    return false;
+#endif
+}
+
+/**
+ * @brief Declares a stream, also in the stream table of the header.
+ */
+bool shm_sink::add_stream(const string &plugin_name,
+			  const string &topic_name,
+			  const DDS_TypeCode *type_code)
+{
+    if(streams_.find(plugin_name) != streams_.end())
+	return true;
+    if(streams_.size() >= SHM_SINK_MAX_STREAMS) {
+	cerr << "Too many streams for the shm sink: " << plugin_name << " ignored" << endl;
+	return false;
+    }
+
+    unsigned int id = streams_.size();
+    DDS_ExceptionCode_t ex;
+    const char *type_name = type_code != NULL ? type_code->name(ex) : NULL;
+    strncpy(header_->streams[id].plugin, plugin_name.c_str(), SHM_SINK_NAME_LENGTH - 1);
+    strncpy(header_->streams[id].topic, topic_name.c_str(), SHM_SINK_NAME_LENGTH - 1);
+    strncpy(header_->streams[id].type, type_name != NULL ? type_name : "", SHM_SINK_NAME_LENGTH - 1);
+    __sync_synchronize();
+    header_->stream_count = id + 1;
+
+    return record_sink::add_stream(plugin_name, topic_name, type_code);
+}
+
+/**
+ * @brief Copies a record at the head of the ring and then publishes the
+ * new head.
+ */
+bool shm_sink::append(const vector<char> &record)
+{
+    DDS_UnsignedLongLong capacity = header_->capacity;
+    DDS_UnsignedLongLong size = (record.size() + 7) & ~7ULL;
+    if(size > capacity / 2) {
+	cerr << "Record of " << record.size() << " bytes does not fit in the shm sink" << endl;
+	return false;
+    }
+
+    DDS_UnsignedLongLong head = header_->head;
+    DDS_UnsignedLongLong offset = head % capacity;
+    if(offset + size > capacity) {
+	//Mark the rest of the ring as unused and start over
+	DDS_UnsignedLong wrap = SHM_SINK_WRAP;
+	memcpy(ring_ + offset, &wrap, sizeof(wrap));
+	head += capacity - offset;
+	offset = 0;
+    }
+
+    memcpy(ring_ + offset, &record[0], record.size());
+    __sync_synchronize();
+    header_->head = head + size;
+    return true;
+}
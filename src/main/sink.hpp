@@ -0,0 +1,242 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SINK_HPP
+#define SINK_HPP
+
+#include <cstdio>
+#include <string>
+#include <map>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+#include "sample_codec.hpp"
+
+//Format of the file and shm sinks
+#define SINK_MAGIC "CCSAMPLE"
+#define SINK_VERSION 2
+#define SINK_RECORD_STREAM 'S'
+#define SINK_RECORD_TYPE 'T'
+#define SINK_RECORD_DATA 'D'
+
+//Shared-memory ring
+#define SHM_SINK_MAX_STREAMS 64
+#define SHM_SINK_NAME_LENGTH 64
+#define SHM_SINK_WRAP 0xffffffffUL
+
+/**
+ * @class cc_sink
+ * Where the plugin manager writes the samples of the plugins. The DDS sink
+ * writes them with the DataWriter of the plugin; the others write them
+ * locally without any DDS entity, to run the agent in test rigs or on
+ * hosts without DDS, or to measure collection apart from the middleware.
+ */
+class cc_sink {
+public:
+    virtual ~cc_sink() {}
+
+    static cc_sink *create(const std::string &kind,
+			   const std::string &path,
+			   int size_kb,
+			   std::string &error);
+
+    /**
+     * @brief Tells whether the sink needs the DDS participant and the
+     * DataWriters of the plugins.
+     */
+    virtual bool needs_dds() const
+    {
+	return false;
+    }
+
+    /**
+     * @brief Declares the stream of samples of a plugin, before its first
+     * write.
+     */
+    virtual bool add_stream(const std::string &plugin_name,
+			    const std::string &topic_name,
+			    const DDS_TypeCode *type_code)
+    {
+	return true;
+    }
+
+    /**
+     * @brief Binds the dense index the plugin manager gave a scheduled
+     * plugin to its stream, so that writes do not look its name up.
+     */
+    virtual void bind_stream(size_t index, const std::string &plugin_name) {}
+
+    /**
+     * @brief Writes a sample of a plugin.
+     *
+     * @param index Index the plugin is bound to (see bind_stream()).
+     * @param writer DataWriter of the plugin (NULL for non-DDS sinks).
+     * @param timestamp Source timestamp (nanoseconds since the epoch): the
+     * time the run of the plugin that took the sample started.
+     */
+    virtual bool write(const std::string &plugin_name,
+		       size_t index,
+		       DDSDynamicDataWriter *writer,
+		       const DDS_DynamicData &data,
+		       unsigned long long timestamp) = 0;
+
+    /**
+     * @brief Pushes buffered samples out; called after every publishing tick.
+     */
+    virtual void flush() {}
+};
+
+/**
+ * @class dds_sink
+ * Writes the samples with the DataWriters of the plugins (the default).
+ */
+class dds_sink : public cc_sink {
+public:
+    bool needs_dds() const
+    {
+	return true;
+    }
+
+    bool write(const std::string &plugin_name,
+	       size_t index,
+	       DDSDynamicDataWriter *writer,
+	       const DDS_DynamicData &data,
+	       unsigned long long timestamp);
+};
+
+/**
+ * @class record_sink
+ * Base of the sinks writing encoded records. Every plugin gets a stream id
+ * and a stream record (plugin, topic and type names) before its first
+ * sample. Records are framed as
+ *
+ *   u32 length of the rest | u8 kind | u16 stream id | payload
+ *
+ * where the payload of a stream record is the three names (u16 length and
+ * characters each), that of the type record following it the type as
+ * described by encode_type(), and that of a data record the u64 source
+ * timestamp (nanoseconds since the epoch) followed by the sample as
+ * encoded by sample_encoder.
+ */
+class record_sink : public cc_sink {
+public:
+    record_sink();
+
+    bool add_stream(const std::string &plugin_name,
+		    const std::string &topic_name,
+		    const DDS_TypeCode *type_code);
+    void bind_stream(size_t index, const std::string &plugin_name);
+    bool write(const std::string &plugin_name,
+	       size_t index,
+	       DDSDynamicDataWriter *writer,
+	       const DDS_DynamicData &data,
+	       unsigned long long timestamp);
+
+protected:
+    virtual bool append(const std::vector<char> &record) = 0;
+
+    void begin_record(char kind, unsigned int stream_id);
+    void end_record();
+
+    std::map<std::string, unsigned int> streams_;
+    std::vector<int> bound_;   //plugin index -> stream id, -1 if unbound
+    std::vector<char> record_;
+    sample_encoder encoder_;
+};
+
+/**
+ * @class file_sink
+ * Appends the records to a file (through a large stdio buffer), after an
+ * 8-byte magic and a u32 version when the file is new. Files written by
+ * another version are refused. Stream ids start over on every run, so a
+ * stream record redefines its id.
+ */
+class file_sink : public record_sink {
+public:
+    file_sink();
+    ~file_sink();
+
+    bool open(const std::string &path, std::string &error);
+    void flush();
+
+protected:
+    bool append(const std::vector<char> &record);
+
+private:
+    FILE *file_;
+    std::vector<char> buffer_;
+};
+
+/**
+ * @class shm_ring_header
+ * Header of the shared-memory ring. <code>head</code> is the number of
+ * bytes ever written: the record at position p is at offset p % capacity
+ * of the data area (right after the header). Records are 8-byte aligned;
+ * a length of SHM_SINK_WRAP means the rest of the ring is unused and the
+ * next record is at the beginning.
+ *
+ * Readers keep their own position. After copying a record they must check
+ * that head - position is still at most capacity; otherwise the writer
+ * overwrote it and they must resume from head.
+ */
+struct shm_ring_header {
+    char magic[8];
+    DDS_UnsignedLong version;
+    DDS_UnsignedLong header_size;
+    DDS_UnsignedLongLong capacity;
+    volatile DDS_UnsignedLongLong head;
+    DDS_UnsignedLong stream_count;
+    DDS_UnsignedLong reserved;
+    struct {
+	char plugin[SHM_SINK_NAME_LENGTH];
+	char topic[SHM_SINK_NAME_LENGTH];
+	char type[SHM_SINK_NAME_LENGTH];
+    } streams[SHM_SINK_MAX_STREAMS];
+};
+
+/**
+ * @class shm_sink
+ * Writes the records to a ring in a POSIX shared-memory object, which
+ * local readers follow without system calls. The stream records are also
+ * kept in the header, so that readers attaching late know every stream.
+ * The oldest records are overwritten when the readers fall behind.
+ */
+class shm_sink : public record_sink {
+public:
+    shm_sink();
+    ~shm_sink();
+
+    bool open(const std::string &name, size_t size, std::string &error);
+
+    bool add_stream(const std::string &plugin_name,
+		    const std::string &topic_name,
+		    const DDS_TypeCode *type_code);
+
+protected:
+    bool append(const std::vector<char> &record);
+
+private:
+    std::string name_;
+    shm_ring_header *header_;
+    char *ring_;
+    size_t mapped_size_;
+};
+
+#endif //SINK_HPP
@@ -0,0 +1,454 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#ifndef RTI_WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "spool.hpp"
+
+using namespace std;
+
+/**
+ * @brief FNV-1a hash of the description of a type.
+ */
+static unsigned long long type_hash(const vector<char> &description)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < description.size(); i++)
+	hash = (hash ^ (unsigned char) description[i]) * 1099511628211ULL;
+    return hash;
+}
+
+
+spool_ring::spool_ring() : header_(NULL), data_(NULL), mapped_size_(0)
+{
+}
+
+spool_ring::~spool_ring()
+{
+#ifndef RTI_WIN32
+    if(header_ != NULL) {
+	msync(header_, mapped_size_, MS_ASYNC);
+	munmap(header_, mapped_size_);
+    }
+#endif
+}
+
+/**
+ * @brief Opens (or creates) a spool file.
+ *
+ * Samples left by a previous run are kept if the file has the same capacity
+ * and type; otherwise the spool starts empty.
+ * @param path The file.
+ * @param capacity Size of the data area in bytes (rounded down to 8).
+ * @param type_hash Hash of the type of the topic.
+ * @param error Set to a description of the problem when false is returned.
+ */
+bool spool_ring::open(const string &path,
+		      size_t capacity,
+		      unsigned long long type_hash,
+		      string &error)
+{
+#ifndef RTI_WIN32
+    capacity &= ~(size_t) 7;
+    int fd = ::open(path.c_str(), O_CREAT | O_RDWR, 0600);
+    if(fd < 0) {
+	error = "cannot open " + path + ": " + strerror(errno);
+	return false;
+    }
+    mapped_size_ = SPOOL_HEADER_SIZE + capacity;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size != mapped_size_) {
+	if(ftruncate(fd, mapped_size_) != 0) {
+	    error = "cannot size " + path + ": " + strerror(errno);
+	    close(fd);
+	    return false;
+	}
+    }
+    void *address = mmap(NULL, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED) {
+	error = "cannot map " + path + ": " + strerror(errno);
+	return false;
+    }
+    header_ = (spool_header *) address;
+    data_ = (char *) address + SPOOL_HEADER_SIZE;
+
+    if(memcmp(header_->magic, SPOOL_MAGIC, sizeof(header_->magic)) != 0 ||
+       header_->version != SPOOL_VERSION ||
+       header_->capacity != capacity ||
+       header_->type_hash != type_hash ||
+       header_->head < header_->tail ||
+       header_->head - header_->tail > capacity) {
+	if(memcmp(header_->magic, SPOOL_MAGIC, sizeof(header_->magic)) == 0 &&
+	   header_->head != header_->tail)
+	    cerr << "Spool " << path << " does not match the topic anymore: discarded" << endl;
+	memcpy(header_->magic, SPOOL_MAGIC, sizeof(header_->magic));
+	header_->version = SPOOL_VERSION;
+	header_->header_size = SPOOL_HEADER_SIZE;
+	header_->capacity = capacity;
+	header_->head = 0;
+	header_->tail = 0;
+	header_->type_hash = type_hash;
+	header_->dropped = 0;
+    }
+    return true;
+#else
+    error = "the spool is not available on Windows";
+    return false;
+#endif
+}
+
+/**
+ * @brief Appends a sample, dropping the oldest ones if there is no room.
+ *
+ * @return False if the sample is too large for the ring.
+ */
+bool spool_ring::push(unsigned long long timestamp, const vector<char> &sample)
+{
+    DDS_UnsignedLongLong capacity = header_->capacity;
+    DDS_UnsignedLongLong size = (12 + sample.size() + 7) & ~7ULL;
+    if(size > capacity / 2) {
+	header_->dropped++;
+	return false;
+    }
+
+    DDS_UnsignedLongLong head = header_->head;
+    DDS_UnsignedLongLong offset = head % capacity;
+    DDS_UnsignedLongLong needed = size + (offset + size > capacity ? capacity - offset : 0);
+    while(capacity - (header_->head - header_->tail) < needed) {
+	pop();
+	header_->dropped++;
+    }
+
+    if(offset + size > capacity) {
+	DDS_UnsignedLong wrap = SPOOL_WRAP;
+	memcpy(data_ + offset, &wrap, 4);
+	head += capacity - offset;
+	offset = 0;
+    }
+
+    DDS_UnsignedLong length = 8 + sample.size();
+    memcpy(data_ + offset, &length, 4);
+    memcpy(data_ + offset + 4, &timestamp, 8);
+    if(!sample.empty())
+	memcpy(data_ + offset + 12, &sample[0], sample.size());
+
+    release(header_->head, head + size);
+    header_->head = head + size;
+    return true;
+}
+
+/**
+ * @brief Returns the oldest sample without consuming it.
+ *
+ * @return False if the ring is empty.
+ */
+bool spool_ring::front(unsigned long long &timestamp, const char *&sample, size_t &length)
+{
+    skip_wrap();
+    if(empty())
+	return false;
+
+    const char *record = data_ + header_->tail % header_->capacity;
+    DDS_UnsignedLong record_length;
+    memcpy(&record_length, record, 4);
+    memcpy(&timestamp, record + 4, 8);
+    sample = record + 12;
+    length = record_length - 8;
+    return true;
+}
+
+/**
+ * @brief Consumes the oldest sample.
+ */
+void spool_ring::pop()
+{
+    skip_wrap();
+    if(empty())
+	return;
+
+    DDS_UnsignedLong record_length;
+    memcpy(&record_length, data_ + header_->tail % header_->capacity, 4);
+    DDS_UnsignedLongLong tail = header_->tail + ((4 + record_length + 7) & ~7ULL);
+    release(header_->tail, tail);
+    header_->tail = tail;
+}
+
+void spool_ring::skip_wrap()
+{
+    if(empty())
+	return;
+    DDS_UnsignedLongLong offset = header_->tail % header_->capacity;
+    DDS_UnsignedLong record_length;
+    memcpy(&record_length, data_ + offset, 4);
+    if(record_length == SPOOL_WRAP)
+	header_->tail += header_->capacity - offset;
+}
+
+/**
+ * @brief Releases the segment left when a position moves from
+ * <code>from</code> to <code>to</code>: its pages are synced to the file
+ * and dropped from memory (they are read back from the file if needed).
+ */
+void spool_ring::release(unsigned long long from, unsigned long long to)
+{
+#ifndef RTI_WIN32
+    DDS_UnsignedLongLong capacity = header_->capacity;
+    DDS_UnsignedLongLong segment = (from % capacity) / SPOOL_SEGMENT_SIZE;
+    if(to - from < capacity && (to % capacity) / SPOOL_SEGMENT_SIZE == segment &&
+       to % capacity >= from % capacity)
+	return;
+
+    size_t start = segment * SPOOL_SEGMENT_SIZE;
+    size_t length = capacity - start < SPOOL_SEGMENT_SIZE ? capacity - start : SPOOL_SEGMENT_SIZE;
+    msync(data_ + start, length, MS_ASYNC);
+    madvise(data_ + start, length, MADV_DONTNEED);
+#endif
+}
+
+
+dds_spool::dds_spool()
+    : capacity_(0),
+      drain_per_sec_(0),
+      tokens_(0),
+      last_drain_ns_(0)
+{
+}
+
+dds_spool::~dds_spool()
+{
+    for(map<string, spool_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it) {
+	delete it->second.ring;
+	delete it->second.data;
+    }
+}
+
+/**
+ * @brief Enables the spool.
+ *
+ * @param dir Directory of the spool files (created if missing).
+ * @param size_mb Size of the ring of every topic.
+ * @param drain_per_sec Samples per second written when draining (0 or
+ * less: no limit).
+ * @param error Set to a description of the problem when false is returned.
+ */
+bool dds_spool::open(const string &dir,
+		     int size_mb,
+		     int drain_per_sec,
+		     string &error)
+{
+#ifndef RTI_WIN32
+    struct stat st;
+    if(dir.empty()) {
+	error = "the spool requires a directory";
+	return false;
+    }
+    if(stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str(), 0700) != 0) {
+	error = "cannot create " + dir + ": " + strerror(errno);
+	return false;
+    }
+    if(size_mb <= 0) {
+	error = "the spool requires a size of at least 1 MB";
+	return false;
+    }
+
+    dir_ = dir;
+    capacity_ = (size_t) size_mb << 20;
+    drain_per_sec_ = drain_per_sec;
+    return true;
+#else
+    error = "the spool is not available on Windows";
+    return false;
+#endif
+}
+
+/**
+ * @brief Opens the spool file of a topic. Samples spooled for it by a
+ * previous run are drained once it has readers.
+ */
+bool dds_spool::add_topic(const string &plugin_name,
+			  DDSDynamicDataWriter *writer,
+			  const DDS_TypeCode *type_code,
+			  string &error)
+{
+    vector<char> description;
+    if(!encode_type(type_code, description)) {
+	error = "the type of " + plugin_name + " cannot be spooled";
+	return false;
+    }
+
+    spool_topic topic;
+    topic.ring = new spool_ring();
+    if(!topic.ring->open(dir_ + "/" + plugin_name + ".spool", capacity_,
+			 type_hash(description), error)) {
+	delete topic.ring;
+	return false;
+    }
+    topic.writer = writer;
+    topic.data = new DDS_DynamicData(type_code, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+    DDS_PublicationMatchedStatus status;
+    topic.matched = writer->get_publication_matched_status(status) == DDS_RETCODE_OK &&
+	status.current_count > 0;
+    if(!topic.ring->empty())
+	cerr << plugin_name << ": " << topic.ring->pending_bytes()
+	     << " bytes spooled by a previous run" << endl;
+
+    topics_[plugin_name] = topic;
+    return true;
+}
+
+/**
+ * @brief Closes the spool file of a topic (e.g. before its DataWriter is
+ * deleted). The samples in it are kept for the next add_topic().
+ */
+void dds_spool::remove_topic(const string &plugin_name)
+{
+    map<string, spool_topic>::iterator it = topics_.find(plugin_name);
+    if(it == topics_.end())
+	return;
+    for(size_t i = 0; i < bound_.size(); i++)
+	if(bound_[i] == &it->second)
+	    bound_[i] = NULL;
+    delete it->second.ring;
+    delete it->second.data;
+    topics_.erase(it);
+}
+
+/**
+ * @brief Binds the dense index the plugin manager gave a scheduled plugin
+ * to its topic, if it has one, so that its samples are spooled without
+ * looking its name up.
+ */
+void dds_spool::bind_topic(size_t index, const string &plugin_name)
+{
+    if(index >= bound_.size())
+	bound_.resize(index + 1, NULL);
+    map<string, spool_topic>::iterator it = topics_.find(plugin_name);
+    bound_[index] = (it != topics_.end()) ? &it->second : NULL;
+}
+
+/**
+ * @brief Tells whether the samples of a plugin go to the spool because its
+ * DataWriter has no matched readers (as of the last drain()).
+ *
+ * @param index Index the plugin is bound to (see bind_topic()).
+ */
+bool dds_spool::diverts(size_t index) const
+{
+    return index < bound_.size() && bound_[index] != NULL && !bound_[index]->matched;
+}
+
+/**
+ * @brief Appends a sample to the spool of its plugin.
+ *
+ * @param index Index the plugin is bound to (see bind_topic()).
+ * @param timestamp Source timestamp it is written with once drained.
+ *
+ * @return False if the plugin has no spool or the sample cannot be encoded.
+ */
+bool dds_spool::store(const string &plugin_name,
+		      size_t index,
+		      const DDS_DynamicData &data,
+		      unsigned long long timestamp)
+{
+    if(index >= bound_.size() || bound_[index] == NULL)
+	return false;
+    spool_topic &topic = *bound_[index];
+
+    buffer_.clear();
+    if(!encoder_.encode(data, buffer_))
+	return false;
+
+    if(topic.ring->empty())
+	cerr << plugin_name << ": spooling samples ("
+	     << (topic.matched ? "write failed" : "no matched readers") << ")" << endl;
+    return topic.ring->push(timestamp, buffer_);
+}
+
+/**
+ * @brief Refreshes the matched state of every topic and writes spooled
+ * samples of the topics with readers. Called once per publishing tick.
+ *
+ * Topics are drained in turns, one sample each, while the rate allows it.
+ */
+void dds_spool::drain()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long now = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    if(last_drain_ns_ > 0 && drain_per_sec_ > 0) {
+	double elapsed = (now - last_drain_ns_) / 1e9;
+	double burst = drain_per_sec_ * (elapsed > 1 ? elapsed : 1);
+	tokens_ += drain_per_sec_ * elapsed;
+	if(tokens_ > burst)
+	    tokens_ = burst;
+    }
+    last_drain_ns_ = now;
+
+    for(map<string, spool_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it) {
+	DDS_PublicationMatchedStatus status;
+	it->second.matched =
+	    it->second.writer->get_publication_matched_status(status) == DDS_RETCODE_OK &&
+	    status.current_count > 0;
+    }
+
+    bool progress = true;
+    while(progress && (drain_per_sec_ <= 0 || tokens_ >= 1)) {
+	progress = false;
+	for(map<string, spool_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it) {
+	    spool_topic &topic = it->second;
+	    unsigned long long timestamp;
+	    const char *sample;
+	    size_t length;
+	    if(!topic.matched || !topic.ring->front(timestamp, sample, length))
+		continue;
+	    if(drain_per_sec_ > 0 && tokens_ < 1)
+		break;
+
+	    if(decoder_.decode(sample, length, *topic.data)) {
+		DDS_Time_t source_time;
+		source_time.sec = (DDS_Long) (timestamp / 1000000000ULL);
+		source_time.nanosec = (DDS_UnsignedLong) (timestamp % 1000000000ULL);
+		if(topic.writer->write_w_timestamp(*topic.data, DDS_HANDLE_NIL, source_time) !=
+		   DDS_RETCODE_OK)
+		    continue; //Retried on the next tick
+	    }
+	    topic.ring->pop();
+	    tokens_ -= 1;
+	    progress = true;
+
+	    if(topic.ring->empty()) {
+		cerr << it->first << ": spool drained (" << topic.ring->dropped()
+		     << " samples dropped while spooling)" << endl;
+		topic.ring->clear_dropped();
+	    }
+	}
+    }
+}
@@ -0,0 +1,171 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPOOL_HPP
+#define SPOOL_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <ndds/ndds_cpp.h>
+
+#include "sample_codec.hpp"
+
+#define SPOOL_MAGIC "CCSPOOL1"
+#define SPOOL_VERSION 1
+//Data area starts one page into the file
+#define SPOOL_HEADER_SIZE 4096
+//Granularity at which spooled pages are released from memory
+#define SPOOL_SEGMENT_SIZE (1 << 20)
+#define SPOOL_WRAP 0xffffffffUL
+
+/**
+ * @class spool_header
+ * Header of a spool file. <code>head</code> and <code>tail</code> are the
+ * number of bytes ever written and consumed: the record at position p is at
+ * offset p % capacity of the data area. Records are
+ *
+ *   u32 length of the rest | u64 timestamp (ns since the epoch) | sample
+ *
+ * 8-byte aligned, with SPOOL_WRAP as length when the rest of the area is
+ * unused. The hash of the type of the topic tells whether the spool left
+ * by a previous run can still be decoded.
+ */
+struct spool_header {
+    char magic[8];
+    DDS_UnsignedLong version;
+    DDS_UnsignedLong header_size;
+    DDS_UnsignedLongLong capacity;
+    DDS_UnsignedLongLong head;
+    DDS_UnsignedLongLong tail;
+    DDS_UnsignedLongLong type_hash;
+    DDS_UnsignedLongLong dropped;
+};
+
+/**
+ * @class spool_ring
+ * A bounded ring of encoded samples in a memory-mapped file. When it is full
+ * the oldest samples are dropped. Only the segments being written and read
+ * stay resident: the others are synced and released, so memory does not
+ * grow with the backlog.
+ */
+class spool_ring {
+public:
+    spool_ring();
+    ~spool_ring();
+
+    bool open(const std::string &path,
+	      size_t capacity,
+	      unsigned long long type_hash,
+	      std::string &error);
+
+    bool push(unsigned long long timestamp, const std::vector<char> &sample);
+    bool front(unsigned long long &timestamp, const char *&sample, size_t &length);
+    void pop();
+
+    bool empty() const
+    {
+	return header_->head == header_->tail;
+    }
+
+    unsigned long long pending_bytes() const
+    {
+	return header_->head - header_->tail;
+    }
+
+    unsigned long long dropped() const
+    {
+	return header_->dropped;
+    }
+
+    void clear_dropped()
+    {
+	header_->dropped = 0;
+    }
+
+private:
+    void skip_wrap();
+    void release(unsigned long long from, unsigned long long to);
+
+    spool_header *header_;
+    char *data_;
+    size_t mapped_size_;
+};
+
+/**
+ * @class dds_spool
+ * Store-and-forward of the samples of the DDS sink. Samples of a topic whose
+ * DataWriter has no matched readers, or whose write fails (e.g. it would
+ * block), are appended to the spool ring of the topic instead of growing
+ * the history of the DataWriter. Once readers are matched again the rings
+ * are drained, oldest first and at most at the configured rate, with the
+ * original source timestamps; new samples are written straight away
+ * meanwhile.
+ */
+class dds_spool {
+public:
+    dds_spool();
+    ~dds_spool();
+
+    bool open(const std::string &dir,
+	      int size_mb,
+	      int drain_per_sec,
+	      std::string &error);
+
+    bool enabled() const
+    {
+	return !dir_.empty();
+    }
+
+    bool add_topic(const std::string &plugin_name,
+		   DDSDynamicDataWriter *writer,
+		   const DDS_TypeCode *type_code,
+		   std::string &error);
+    void remove_topic(const std::string &plugin_name);
+    void bind_topic(size_t index, const std::string &plugin_name);
+    bool diverts(size_t index) const;
+    bool store(const std::string &plugin_name,
+	       size_t index,
+	       const DDS_DynamicData &data,
+	       unsigned long long timestamp);
+    void drain();
+
+private:
+    struct spool_topic {
+	spool_ring *ring;
+	DDSDynamicDataWriter *writer;
+	DDS_DynamicData *data;
+	bool matched;
+    };
+
+    std::string dir_;
+    size_t capacity_;
+    double drain_per_sec_;
+    double tokens_;
+    long long last_drain_ns_;
+
+    std::map<std::string, spool_topic> topics_;
+    std::vector<spool_topic *> bound_;   //plugin index -> topic, NULL if unbound
+    sample_encoder encoder_;
+    sample_decoder decoder_;
+    std::vector<char> buffer_;
+};
+
+#endif //SPOOL_HPP
@@ -30,11 +30,108 @@ XML_parser *XML_parser::the_singleton_ = 0;
 /** 
  * @brief Constructor of the XML_parser class.
  * 
- * The constructor of the XML_parser class is empty.
+ * The constructor of the XML_parser class sets the defaults of the optional
+ * general properties.
  */
 XML_parser::XML_parser()
 {
-    
+    set_default_general_properties();
+}
+
+/** 
+ * @brief Destructor of the class XML_parser.
+ * 
+ * Deletes the copies of the types and QoS of the plugins.
+ */
+XML_parser::~XML_parser()
+{
+    DDS_ExceptionCode_t ex;
+    for(size_t i = 0; i < type_codes_.size(); i++)
+	DDS_TypeCodeFactory::get_instance()->delete_tc(type_codes_[i], ex);
+    for(size_t i = 0; i < datawriter_qos_.size(); i++) {
+	DDS_DataWriterQos_finalize(datawriter_qos_[i]);
+	delete datawriter_qos_[i];
+    }
+}
+
+/** 
+ * @brief Copies a type out of the DOM of the file being parsed.
+ * 
+ * @return The copy of an equal type if there is one already, or a new copy;
+ * NULL if it cannot be copied.
+ */
+DDS_TypeCode *XML_parser::keep_type_code(const DDS_TypeCode *type_code)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    for(size_t i = 0; i < type_codes_.size(); i++) {
+	if(type_codes_[i]->equal(type_code, ex) && ex == DDS_NO_EXCEPTION_CODE)
+	    return type_codes_[i];
+	ex = DDS_NO_EXCEPTION_CODE;
+    }
+
+    DDS_TypeCode *copy = DDS_TypeCodeFactory::get_instance()->clone_tc(type_code, ex);
+    if(ex != DDS_NO_EXCEPTION_CODE || copy == NULL) {
+	cerr << "Error copying a type definition" << endl;
+	return NULL;
+    }
+    type_codes_.push_back(copy);
+    return copy;
+}
+
+/** 
+ * @brief Copies a DataWriter QoS out of the DOM of the file being parsed.
+ * 
+ * @return The copy of an equal QoS if there is one already, or a new copy;
+ * NULL if it cannot be copied.
+ */
+const DDS_DataWriterQos *XML_parser::keep_datawriter_qos(const DDS_DataWriterQos *datawriter_qos)
+{
+    for(size_t i = 0; i < datawriter_qos_.size(); i++)
+	if(DDS_DataWriterQos_equals(datawriter_qos_[i], datawriter_qos))
+	    return datawriter_qos_[i];
+
+    DDS_DataWriterQos *copy = new DDS_DataWriterQos();
+    if(DDS_DataWriterQos_copy(copy, datawriter_qos) != DDS_RETCODE_OK) {
+	cerr << "Error copying a datawriter_qos definition" << endl;
+	DDS_DataWriterQos_finalize(copy);
+	delete copy;
+	return NULL;
+    }
+    datawriter_qos_.push_back(copy);
+    return copy;
+}
+
+/** 
+ * @brief Sets the general properties to their defaults.
+ * 
+ * Called before parsing a general configuration file, so that a file parsed
+ * again (on a reload) does not keep the sections and lists of the previous
+ * one.
+ */
+void XML_parser::set_default_general_properties()
+{
+    general_properties_ = cc_general_properties();
+    general_properties_.publishing_period = 0;
+    general_properties_.domain_id = 0;
+    general_properties_.self_telemetry_period = DEFAULT_SELF_TELEMETRY_PERIOD_SEC;
+    general_properties_.sink.kind = "dds";
+    general_properties_.sink.size_kb = DEFAULT_SINK_SIZE_KB;
+    general_properties_.latest_values.slots = DEFAULT_LATEST_SLOTS;
+    general_properties_.latest_values.slot_size = DEFAULT_LATEST_SLOT_SIZE;
+    general_properties_.latest_values.expire_sec = DEFAULT_LATEST_EXPIRE_SEC;
+    general_properties_.spool.size_mb = DEFAULT_SPOOL_SIZE_MB;
+    general_properties_.spool.drain_per_sec = DEFAULT_SPOOL_DRAIN_PER_SEC;
+    general_properties_.egress.enabled = false;
+    general_properties_.egress.samples_per_sec = 0;
+    general_properties_.egress.bytes_per_sec = 0;
+    general_properties_.egress.burst_ms = DEFAULT_EGRESS_BURST_MS;
+    general_properties_.egress.spread = DEFAULT_EGRESS_SPREAD;
+    general_properties_.egress.max_queue = DEFAULT_EGRESS_MAX_QUEUE;
+    general_properties_.cpu_budget.percent = 0;
+    general_properties_.cpu_budget.window_sec = DEFAULT_CPU_BUDGET_WINDOW_SEC;
+    general_properties_.cpu_budget.max_stretch = DEFAULT_CPU_BUDGET_MAX_STRETCH;
+    general_properties_.startup_threads = DEFAULT_STARTUP_THREADS;
+    general_properties_.latency_probe = false;
 
 }
 
@@ -52,27 +149,68 @@ bool XML_parser::parse_general_configuration_file(string cfg_file)
 {
     struct DDS_XMLParser *parser     = NULL;
     struct DDS_XMLObject *root       = NULL;
-    cc_general_properties general_properties;
     
     struct DDS_XMLExtensionClass *user_extensions[DTD_CAVECANEM_EXTENSION_NUMBER] = 
-	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
     
     const char * CAVECANEM_DTD[DTD_CAVECANEM_LINE_NUMBER] = {
-	"<!ELEMENT cavecanem (general,dds_properties,plugins)>\n",
-	"<!ELEMENT general (publishing_period_sec)>\n",
+	"<!ELEMENT cavecanem (general,dds_properties,plugins,rules?,bursts?)>\n",
+	"<!ELEMENT general (publishing_period_sec,self_telemetry_period_sec?,sink?,latest_values?,spool?,egress?,cpu_budget?,control_socket?,startup_threads?,latency_probe?)>\n",
 	"<!ELEMENT publishing_period_sec (#PCDATA)>\n",
-	"<!ELEMENT dds_properties (dds_domain_id,dds_qos_file,dds_qos_default_library,dds_qos_default_profile)>\n",
+	"<!ELEMENT self_telemetry_period_sec (#PCDATA)>\n",
+	"<!ELEMENT sink (#PCDATA)>\n",
+	"<!ATTLIST sink kind CDATA #REQUIRED>\n",
+	"<!ATTLIST sink size_kb CDATA #IMPLIED>\n",
+	"<!ELEMENT latest_values (#PCDATA)>\n",
+	"<!ATTLIST latest_values slots CDATA #IMPLIED>\n",
+	"<!ATTLIST latest_values slot_size CDATA #IMPLIED>\n",
+	"<!ATTLIST latest_values expire_sec CDATA #IMPLIED>\n",
+	"<!ELEMENT spool (#PCDATA)>\n",
+	"<!ATTLIST spool size_mb CDATA #IMPLIED>\n",
+	"<!ATTLIST spool drain_per_sec CDATA #IMPLIED>\n",
+	"<!ELEMENT egress (limit*)>\n",
+	"<!ATTLIST egress samples_per_sec CDATA #IMPLIED>\n",
+	"<!ATTLIST egress bytes_per_sec CDATA #IMPLIED>\n",
+	"<!ATTLIST egress burst_ms CDATA #IMPLIED>\n",
+	"<!ATTLIST egress spread CDATA #IMPLIED>\n",
+	"<!ATTLIST egress max_queue CDATA #IMPLIED>\n",
+	"<!ELEMENT limit (#PCDATA)>\n",
+	"<!ATTLIST limit plugin CDATA #REQUIRED>\n",
+	"<!ATTLIST limit samples_per_sec CDATA #IMPLIED>\n",
+	"<!ATTLIST limit bytes_per_sec CDATA #IMPLIED>\n",
+	"<!ATTLIST limit spread CDATA #IMPLIED>\n",
+	"<!ELEMENT cpu_budget (#PCDATA)>\n",
+	"<!ATTLIST cpu_budget window_sec CDATA #IMPLIED>\n",
+	"<!ATTLIST cpu_budget max_stretch CDATA #IMPLIED>\n",
+	"<!ELEMENT control_socket (#PCDATA)>\n",
+	"<!ELEMENT startup_threads (#PCDATA)>\n",
+	"<!ELEMENT latency_probe (#PCDATA)>\n",
+	"<!ELEMENT dds_properties (dds_domain_id,dds_qos_file,dds_qos_default_library,dds_qos_default_profile,dds_qos_alert_profile?)>\n",
 	"<!ELEMENT dds_domain_id (#PCDATA)>\n",
 	"<!ELEMENT dds_qos_file (#PCDATA)>\n",
 	"<!ELEMENT dds_qos_default_library (#PCDATA)>\n",
 	"<!ELEMENT dds_qos_default_profile (#PCDATA)>\n",
+	"<!ELEMENT dds_qos_alert_profile (#PCDATA)>\n",
 	"<!ELEMENT plugins (plugin_library*)>\n",
 	"<!ELEMENT plugin_library (plugin+|plugin_regex)>\n",
 	"<!ATTLIST plugin_library dir CDATA #REQUIRED>",
 	"<!ELEMENT plugin_regex (#PCDATA)>\n",
-	"<!ELEMENT plugin (#PCDATA)>\n"
+	"<!ELEMENT plugin (#PCDATA)>\n",
+	"<!ELEMENT rules (rule*)>\n",
+	"<!ELEMENT rule (#PCDATA)>\n",
+	"<!ATTLIST rule name CDATA #REQUIRED>\n",
+	"<!ATTLIST rule severity CDATA #IMPLIED>\n",
+	"<!ELEMENT bursts (burst*)>\n",
+	"<!ELEMENT burst (#PCDATA)>\n",
+	"<!ATTLIST burst alert CDATA #IMPLIED>\n",
+	"<!ATTLIST burst source CDATA #IMPLIED>\n",
+	"<!ATTLIST burst severity CDATA #IMPLIED>\n",
+	"<!ATTLIST burst period_ms CDATA #IMPLIED>\n",
+	"<!ATTLIST burst duration_sec CDATA #IMPLIED>\n"
     };
     
+    set_default_general_properties();
+
     parser = DDS_XMLParser_new();
     if(parser == NULL) {
 	cerr << "Error creating XML parser" << endl;
@@ -96,6 +234,8 @@ bool XML_parser::parse_general_configuration_file(string cfg_file)
 	return false;
     }
 
+    //Everything was copied out of the DOM while parsing
+    DDS_XMLParser_delete_dom(parser, root);
     DDS_XMLParser_delete(parser);
     return true;
 
@@ -120,10 +260,10 @@ bool XML_parser::parse_plugin_configuration_file(string cfg_file)
     struct DDS_XMLObject *root       = NULL;
     
     struct DDS_XMLExtensionClass *user_extensions[DTD_CAVECANEM_PLUGIN_EXTENSION_NUMBER] = 
-	{NULL, NULL, NULL, NULL,NULL, NULL, NULL, NULL, NULL, NULL};
+	{NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
     
     const char * CAVECANEM_PLUGIN_DTD[DTD_CAVECANEM_PLUGIN_LINE_NUMBER] = {
-	"<!ELEMENT plugin (dll,create_function,publishing_period_sec,dds_properties,plugin_config,type_definition)>\n",
+	"<!ELEMENT plugin (dll,create_function,publishing_period_sec,dds_properties,plugin_config,anomaly_detection?,type_definition)>\n",
 	"<!ATTLIST plugin name CDATA #REQUIRED>\n",
 	"<!ELEMENT dll (#PCDATA)>\n",
 	"<!ELEMENT create_function (#PCDATA)>\n",
@@ -416,6 +556,15 @@ bool XML_parser::parse_plugin_configuration_file(string cfg_file)
 	"<!ELEMENT plugin_config (plugin_element*)>\n",
 	"<!ELEMENT plugin_element (#PCDATA)>\n",
 	"<!ATTLIST plugin_element name CDATA #REQUIRED>\n",
+	"<!ELEMENT anomaly_detection (detector*)>\n",
+	"<!ELEMENT detector (#PCDATA)>\n",
+	"<!ATTLIST detector member CDATA #REQUIRED>\n",
+	"<!ATTLIST detector method CDATA #IMPLIED>\n",
+	"<!ATTLIST detector alpha CDATA #IMPLIED>\n",
+	"<!ATTLIST detector window CDATA #IMPLIED>\n",
+	"<!ATTLIST detector threshold CDATA #IMPLIED>\n",
+	"<!ATTLIST detector warmup CDATA #IMPLIED>\n",
+	"<!ATTLIST detector severity CDATA #IMPLIED>\n",
 	"<!ELEMENT type_definition (include|const|directive|struct|valuetype|union|typedef|module|enum|forward_dcl)+>\n",
 	"<!ATTLIST type_definition type_name CDATA #REQUIRED>\n",
 	"<!ELEMENT module (include|const|directive|struct|union|typedef|module|enum|valuetype|forward_dcl)+>\n",
@@ -503,7 +652,8 @@ bool XML_parser::parse_plugin_configuration_file(string cfg_file)
 	return false;
     }
     
-        
+    //The type and QoS were copied out of the DOM while parsing
+    DDS_XMLParser_delete_dom(parser, root);
     DDS_XMLParser_delete(parser);
     return true; 
 	
@@ -574,6 +724,163 @@ bool XML_parser::register_general_extensions(struct DDS_XMLParser *parser,
     }
 
 
+    user_extensions[i++] = DDS_XMLExtensionClass_new("self_telemetry_period_sec",
+						     NULL,
+						     DDS_BOOLEAN_FALSE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'self_telemetry_period_sec'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("sink",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'sink'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("latest_values",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'latest_values'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("spool",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'spool'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("egress",
+						     NULL,
+						     DDS_BOOLEAN_FALSE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'egress'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("limit",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'limit'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("cpu_budget",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'cpu_budget'" << endl;
+    	return false;
+    }
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("control_socket",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'control_socket'" << endl;
+    	return false;
+    }
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("startup_threads",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'startup_threads'" << endl;
+    	return false;
+    }
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("latency_probe",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'latency_probe'" << endl;
+    	return false;
+    }
+
+
     user_extensions[i++] = DDS_XMLExtensionClass_new("dds_properties",
 						     NULL,
 						     DDS_BOOLEAN_FALSE,
@@ -651,6 +958,21 @@ bool XML_parser::register_general_extensions(struct DDS_XMLParser *parser,
     	return false;
     }
 
+    user_extensions[i++] = DDS_XMLExtensionClass_new("dds_qos_alert_profile",
+						     NULL,
+						     DDS_BOOLEAN_FALSE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+    
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'dds_qos_alert_profile'" << endl;
+    	return false;
+    }
+
     user_extensions[i++] = DDS_XMLExtensionClass_new("plugins",
 						     NULL,
 						     DDS_BOOLEAN_FALSE,
@@ -715,6 +1037,70 @@ bool XML_parser::register_general_extensions(struct DDS_XMLParser *parser,
     }
 
 
+    user_extensions[i++] = DDS_XMLExtensionClass_new("rules",
+						     NULL,
+						     DDS_BOOLEAN_FALSE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'rules'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("rule",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'rule'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("bursts",
+						     NULL,
+						     DDS_BOOLEAN_FALSE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'bursts'" << endl;
+    	return false;
+    }
+
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("burst",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_general_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+
+    if(user_extensions[i-1] == NULL) {
+    	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'burst'" << endl;
+    	return false;
+    }
+
+
 	
 
     for(int i=0; i<DTD_CAVECANEM_EXTENSION_NUMBER; i++)// {
@@ -892,6 +1278,34 @@ bool XML_parser::register_plugin_extensions(struct DDS_XMLParser *self,
 	return false;
     }
 
+    user_extensions[i++] = DDS_XMLExtensionClass_new("anomaly_detection",
+						     NULL,
+						     DDS_BOOLEAN_FALSE,
+						     DDS_BOOLEAN_TRUE,
+						     XML_parser_start,
+						     XML_parser_plugin_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+    if(user_extensions[i-1] == NULL) {
+	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'anomaly_detection'" << endl;
+	return false;
+    }
+
+    user_extensions[i++] = DDS_XMLExtensionClass_new("detector",
+						     NULL,
+						     DDS_BOOLEAN_TRUE,
+						     DDS_BOOLEAN_FALSE,
+						     XML_parser_start,
+						     XML_parser_plugin_end,
+						     XML_parser_new, 
+						     XML_parser_delete,
+						     NULL);
+    if(user_extensions[i-1] == NULL) {
+	cerr << "RTIXMLExtensionClass_new Error: could not install custom extension 'detector'" << endl;
+	return false;
+    }
+
     user_extensions[i++] = DDS_XMLExtensionClass_new("type_definition",
     						     NULL,
     						     DDS_BOOLEAN_TRUE,
@@ -934,6 +1348,180 @@ void XML_parser::set_publishing_period(int publishing_period)
 }
 
 
+/** 
+ * @brief Sets the period of the self telemetry reports.
+ * 
+ * @param period Seconds between two reports on the cavecanem_self topic;
+ * 0 disables them.
+ */
+void XML_parser::set_self_telemetry_period(int period)
+{
+    general_properties_.self_telemetry_period = period < 0 ? 0 : period;
+}
+
+
+/** 
+ * @brief Sets where the samples of the plugins are written.
+ *
+ * @param kind "dds", "file" or "shm".
+ * @param path File (or shared-memory object) of the file and shm sinks.
+ * @param size_kb Size of the shm ring; 0 or less keeps the default.
+ */
+void XML_parser::set_sink(string kind, string path, int size_kb)
+{
+    general_properties_.sink.kind = kind;
+    general_properties_.sink.path = path;
+    if(size_kb > 0)
+	general_properties_.sink.size_kb = size_kb;
+}
+
+
+/** 
+ * @brief Enables the shared-memory region of latest values.
+ *
+ * @param name Name of the shared-memory object (e.g. "/cavecanem_latest").
+ * @param slots Rows of the region; 0 or less keeps the default.
+ * @param slot_size Bytes per row; 0 or less keeps the default.
+ * @param expire_sec Seconds after which rows not updated are removed; a
+ * negative value keeps the default and 0 never removes them.
+ */
+void XML_parser::set_latest_values(string name, int slots, int slot_size, int expire_sec)
+{
+    general_properties_.latest_values.name = name;
+    if(slots > 0)
+	general_properties_.latest_values.slots = slots;
+    if(slot_size > 0)
+	general_properties_.latest_values.slot_size = slot_size;
+    if(expire_sec >= 0)
+	general_properties_.latest_values.expire_sec = expire_sec;
+}
+
+
+/** 
+ * @brief Enables the spool of samples of topics without readers.
+ *
+ * @param dir Directory of the spool files.
+ * @param size_mb Size of the spool of every topic; 0 or less keeps the default.
+ * @param drain_per_sec Samples per second written when draining; a
+ * negative value keeps the default and 0 means no limit.
+ */
+void XML_parser::set_spool(string dir, int size_mb, int drain_per_sec)
+{
+    general_properties_.spool.dir = dir;
+    if(size_mb > 0)
+	general_properties_.spool.size_mb = size_mb;
+    if(drain_per_sec >= 0)
+	general_properties_.spool.drain_per_sec = drain_per_sec;
+}
+
+
+/** 
+ * @brief Enables the pacing of the samples written by the plugins.
+ *
+ * @param samples_per_sec Samples per second of all the plugins together;
+ * 0 or less means no limit.
+ * @param bytes_per_sec Bytes per second of all the plugins together; 0 or
+ * less means no limit.
+ * @param burst_ms Milliseconds worth of tokens of the buckets; 0 or less
+ * keeps the default.
+ * @param spread Share of the publishing period the burst of a run is spread
+ * over; a negative value keeps the default and 0 does not spread them.
+ * @param max_queue Samples queued per plugin at most; 0 or less keeps the
+ * default.
+ */
+void XML_parser::set_egress(double samples_per_sec, double bytes_per_sec,
+			    int burst_ms, double spread, int max_queue)
+{
+    general_properties_.egress.enabled = true;
+    general_properties_.egress.samples_per_sec = samples_per_sec;
+    general_properties_.egress.bytes_per_sec = bytes_per_sec;
+    if(burst_ms > 0)
+	general_properties_.egress.burst_ms = burst_ms;
+    if(spread >= 0)
+	general_properties_.egress.spread = spread;
+    if(max_queue > 0)
+	general_properties_.egress.max_queue = max_queue;
+}
+
+
+/** 
+ * @brief Stores a limit of the egress element.
+ *
+ * @param plugin Name of the plugin.
+ * @param samples_per_sec Samples per second of the plugin; 0 or less means
+ * no limit.
+ * @param bytes_per_sec Bytes per second of the plugin; 0 or less means no
+ * limit.
+ * @param spread Share of the period its bursts are spread over; negative to
+ * keep the one of the egress element.
+ */
+void XML_parser::add_egress_limit(string plugin, double samples_per_sec,
+				  double bytes_per_sec, double spread)
+{
+    cc_egress_limit limit;
+    limit.plugin = plugin;
+    limit.samples_per_sec = samples_per_sec;
+    limit.bytes_per_sec = bytes_per_sec;
+    limit.spread = spread;
+    general_properties_.egress.limits.push_back(limit);
+}
+
+
+/** 
+ * @brief Enables the CPU governor.
+ *
+ * @param percent Share of one core, in percent, the agent may use; 0 or
+ * less disables the governor.
+ * @param window_sec Seconds over which the usage is measured; 0 or less
+ * keeps the default.
+ * @param max_stretch Times the configured period a period can be
+ * stretched; 0 or less keeps the default.
+ */
+void XML_parser::set_cpu_budget(double percent, int window_sec, int max_stretch)
+{
+    general_properties_.cpu_budget.percent = percent > 0 ? percent : 0;
+    if(window_sec > 0)
+	general_properties_.cpu_budget.window_sec = window_sec;
+    if(max_stretch > 0)
+	general_properties_.cpu_budget.max_stretch = max_stretch;
+}
+
+
+/** 
+ * @brief Sets the path of the UNIX socket plugins are loaded and unloaded
+ * through while running (empty: no control socket).
+ *
+ * @param path Path of the socket.
+ */
+void XML_parser::set_control_socket(string path)
+{
+    general_properties_.control_socket = path;
+}
+
+
+/** 
+ * @brief Sets how many plugins are constructed at the same time at startup
+ * (1: one after another).
+ *
+ * @param threads Number of loader threads.
+ */
+void XML_parser::set_startup_threads(int threads)
+{
+    general_properties_.startup_threads = threads > 0 ? threads : 1;
+}
+
+
+/** 
+ * @brief Enables or disables the latency probes.
+ *
+ * @param enabled Whether a probe is published after every plugin run.
+ */
+void XML_parser::set_latency_probe(bool enabled)
+{
+    general_properties_.latency_probe = enabled;
+}
+
+
 /** 
  * @brief Sets the DDS Domain.
  *
@@ -983,6 +1571,72 @@ void XML_parser::set_qos_default_profile(string qos_profile)
 }
 
 
+/** 
+ * @brief Sets the QoS profile of the alert topic.
+ * 
+ * Sets the QoS profile (within the default QoS library) used by the
+ * DataWriter of the cavecanem_alert topic.
+ * @param qos_profile Name of the QoS profile.
+ */
+void XML_parser::set_qos_alert_profile(string qos_profile)
+{
+    general_properties_.alert_qos_profile = qos_profile;
+}
+
+
+/** 
+ * @brief Stores a rule of the rules section.
+ * 
+ * @param name Name of the rule.
+ * @param severity Severity of the alerts raised by the rule.
+ * @param expression Text of the rule.
+ */
+void XML_parser::add_rule(string name, int severity, string expression)
+{
+    cc_rule_definition rule;
+    rule.name = name;
+    rule.severity = severity;
+    rule.expression = expression;
+    general_properties_.rules.push_back(rule);
+}
+
+
+/** 
+ * @brief Stores a burst of the bursts section.
+ *
+ * @param alert Rule or signature of the alerts triggering it; empty for any.
+ * @param source Plugin raising the alerts; empty for any.
+ * @param severity Minimum severity of the alerts.
+ * @param period_ms Period of the plugins during the burst; 0 or less keeps
+ * the default.
+ * @param duration_sec Duration of the burst; 0 or less keeps the default.
+ * @param plugins Comma-separated plugins switched to the fast period.
+ */
+void XML_parser::add_burst(string alert, string source, int severity,
+			   int period_ms, int duration_sec, string plugins)
+{
+    cc_burst_definition burst;
+    burst.alert = alert;
+    burst.source = source;
+    burst.severity = severity;
+    burst.period_ms = period_ms > 0 ? period_ms : DEFAULT_BURST_PERIOD_MS;
+    burst.duration_sec = duration_sec > 0 ? duration_sec : DEFAULT_BURST_DURATION_SEC;
+
+    size_t start = 0;
+    while(start < plugins.size()) {
+	size_t end = plugins.find(',', start);
+	if(end == string::npos)
+	    end = plugins.size();
+	size_t first = plugins.find_first_not_of(" \t\n", start);
+	size_t last = plugins.find_last_not_of(" \t\n", end - 1);
+	if(first != string::npos && first < end && last >= first)
+	    burst.plugins.push_back(plugins.substr(first, last - first + 1));
+	start = end + 1;
+    }
+    general_properties_.bursts.push_back(burst);
+}
+
+
 
 /** 
  * @brief Stores a new plugin library in the plugin_library_map_.
@@ -1113,16 +1767,30 @@ void XML_parser::set_tmp_plugin_properties_add_element(string name,string value)
 }
 
 
+/** 
+ * @brief Adds an anomaly detector to the plugin.
+ * 
+ * Adds a detector of the <code>anomaly_detection</code> section in the temporal
+ * structure that stores the information of a plugin while it is being created.
+ * @param detector The detector.
+ */
+void XML_parser::set_tmp_plugin_properties_add_detector(cc_anomaly_definition detector)
+{
+    tmp_plugin_properties_.anomaly_detectors.push_back(detector);
+}
+
+
 /** 
  * @brief Sets the typecode of the plugin.
  * 
  * Sets the typecode of the plugin in the temporal structure
- * that stores the information of a plugin while it is being created.
+ * that stores the information of a plugin while it is being created. It
+ * keeps a copy, as the DOM it comes from is deleted after parsing.
  * @param type_code Type Code of the plugin's data type.
  */
 void XML_parser::set_tmp_plugin_properties_type_code(struct DDS_TypeCode* type_code)
 {
-    tmp_plugin_properties_.type_code = type_code;
+    tmp_plugin_properties_.type_code = type_code != NULL ? keep_type_code(type_code) : NULL;
 }
 
 
@@ -1131,12 +1799,14 @@ void XML_parser::set_tmp_plugin_properties_type_code(struct DDS_TypeCode* type_c
  * 
  * Sets the QoS for the DDS DataWriter that the plugin will use if it is 
  * defined. If it is not defined, the qos_library and qos_profile parameters 
- * will decide the QoS of it.
+ * will decide the QoS of it. It keeps a copy, as the DOM it comes from is
+ * deleted after parsing.
  * @param datawriter_qos DDS DataWriter QoS for the plugin's datawriter.
  */
 void XML_parser::set_tmp_plugin_properties_datawriter_qos(const struct DDS_DataWriterQos *datawriter_qos)
 {
-    tmp_plugin_properties_.datawriter_qos = datawriter_qos;
+    tmp_plugin_properties_.datawriter_qos =
+	datawriter_qos != NULL ? keep_datawriter_qos(datawriter_qos) : NULL;
 }
 
 
@@ -1192,6 +1862,7 @@ void XML_parser::set_plugin_properties(string plugin_name)
     tmp_plugin_properties_.datawriter_qos = NULL;
     tmp_plugin_properties_.topic_name = "";
     tmp_plugin_properties_.plugin_config.clear();
+    tmp_plugin_properties_.anomaly_detectors.clear();
 
 }
 
@@ -1345,6 +2016,72 @@ void XML_parser_general_end(struct DDS_XMLObject *self,
 	// aux_general_properties.publishing_period = atoi(element_text);
 	XML_parser::get_singleton()->set_publishing_period(atoi(element_text));
     }
+    else if(!strcmp(tag_name,"self_telemetry_period_sec")) {
+	XML_parser::get_singleton()->set_self_telemetry_period(atoi(element_text));
+    }
+    else if(!strcmp(tag_name,"sink")) {
+	string kind(RTIXMLHelper_getAttribute((const char**)object->attr, "kind"));
+	const char *size_kb = RTIXMLHelper_getAttribute((const char**)object->attr, "size_kb");
+	XML_parser::get_singleton()->set_sink(kind,
+					      element_text != NULL ? string(element_text) : "",
+					      size_kb != NULL ? atoi(size_kb) : 0);
+    }
+    else if(!strcmp(tag_name,"latest_values")) {
+	const char *slots = RTIXMLHelper_getAttribute((const char**)object->attr, "slots");
+	const char *slot_size = RTIXMLHelper_getAttribute((const char**)object->attr, "slot_size");
+	const char *expire_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "expire_sec");
+	XML_parser::get_singleton()->set_latest_values(element_text != NULL ? string(element_text) : "",
+						       slots != NULL ? atoi(slots) : 0,
+						       slot_size != NULL ? atoi(slot_size) : 0,
+						       expire_sec != NULL ? atoi(expire_sec) : -1);
+    }
+    else if(!strcmp(tag_name,"spool")) {
+	const char *size_mb = RTIXMLHelper_getAttribute((const char**)object->attr, "size_mb");
+	const char *drain_per_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "drain_per_sec");
+	XML_parser::get_singleton()->set_spool(element_text != NULL ? string(element_text) : "",
+					       size_mb != NULL ? atoi(size_mb) : 0,
+					       drain_per_sec != NULL ? atoi(drain_per_sec) : -1);
+    }
+    else if(!strcmp(tag_name,"egress")) {
+	const char *samples_per_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "samples_per_sec");
+	const char *bytes_per_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "bytes_per_sec");
+	const char *burst_ms = RTIXMLHelper_getAttribute((const char**)object->attr, "burst_ms");
+	const char *spread = RTIXMLHelper_getAttribute((const char**)object->attr, "spread");
+	const char *max_queue = RTIXMLHelper_getAttribute((const char**)object->attr, "max_queue");
+	XML_parser::get_singleton()->set_egress(samples_per_sec != NULL ? atof(samples_per_sec) : 0,
+						bytes_per_sec != NULL ? atof(bytes_per_sec) : 0,
+						burst_ms != NULL ? atoi(burst_ms) : 0,
+						spread != NULL ? atof(spread) : -1,
+						max_queue != NULL ? atoi(max_queue) : 0);
+    }
+    else if(!strcmp(tag_name,"limit")) {
+	string plugin(RTIXMLHelper_getAttribute((const char**)object->attr, "plugin"));
+	const char *samples_per_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "samples_per_sec");
+	const char *bytes_per_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "bytes_per_sec");
+	const char *spread = RTIXMLHelper_getAttribute((const char**)object->attr, "spread");
+	XML_parser::get_singleton()->add_egress_limit(plugin,
+						      samples_per_sec != NULL ? atof(samples_per_sec) : 0,
+						      bytes_per_sec != NULL ? atof(bytes_per_sec) : 0,
+						      spread != NULL ? atof(spread) : -1);
+    }
+    else if(!strcmp(tag_name,"cpu_budget")) {
+	const char *window_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "window_sec");
+	const char *max_stretch = RTIXMLHelper_getAttribute((const char**)object->attr, "max_stretch");
+	XML_parser::get_singleton()->set_cpu_budget(element_text != NULL ? atof(element_text) : 0,
+						    window_sec != NULL ? atoi(window_sec) : 0,
+						    max_stretch != NULL ? atoi(max_stretch) : 0);
+    }
+    else if(!strcmp(tag_name,"control_socket")) {
+	XML_parser::get_singleton()->set_control_socket(element_text != NULL ? string(element_text) : "");
+    }
+    else if(!strcmp(tag_name,"startup_threads")) {
+	XML_parser::get_singleton()->set_startup_threads(element_text != NULL ? atoi(element_text) : 0);
+    }
+    else if(!strcmp(tag_name,"latency_probe")) {
+	XML_parser::get_singleton()->set_latency_probe(element_text != NULL &&
+						       (!strcmp(element_text, "true") ||
+							!strcmp(element_text, "1")));
+    }
     else if(!strcmp(tag_name,"dds_domain_id")) {
 	// aux_general_properties.domain_id = atoi(element_text);
 	XML_parser::get_singleton()->set_domain_id(atoi(element_text));
@@ -1359,6 +2096,9 @@ void XML_parser_general_end(struct DDS_XMLObject *self,
     else if(!strcmp(tag_name,"dds_qos_default_profile")) {
 	XML_parser::get_singleton()->set_qos_default_profile(string(element_text));
     }
+    else if(!strcmp(tag_name,"dds_qos_alert_profile")) {
+	XML_parser::get_singleton()->set_qos_alert_profile(string(element_text));
+    }
     else if(!strcmp(tag_name,"plugin_library")) {
 	string dir(RTIXMLHelper_getAttribute((const char**)object->attr, "dir"));
 
@@ -1374,6 +2114,26 @@ void XML_parser_general_end(struct DDS_XMLObject *self,
     }
     else if(!strcmp(tag_name,"plugin_regex")) {
     }
+    else if(!strcmp(tag_name,"burst")) {
+	const char *alert = RTIXMLHelper_getAttribute((const char**)object->attr, "alert");
+	const char *source = RTIXMLHelper_getAttribute((const char**)object->attr, "source");
+	const char *severity = RTIXMLHelper_getAttribute((const char**)object->attr, "severity");
+	const char *period_ms = RTIXMLHelper_getAttribute((const char**)object->attr, "period_ms");
+	const char *duration_sec = RTIXMLHelper_getAttribute((const char**)object->attr, "duration_sec");
+	XML_parser::get_singleton()->add_burst(alert != NULL ? string(alert) : "",
+					       source != NULL ? string(source) : "",
+					       severity != NULL ? atoi(severity) : 1,
+					       period_ms != NULL ? atoi(period_ms) : 0,
+					       duration_sec != NULL ? atoi(duration_sec) : 0,
+					       element_text != NULL ? string(element_text) : "");
+    }
+    else if(!strcmp(tag_name,"rule")) {
+	string name(RTIXMLHelper_getAttribute((const char**)object->attr, "name"));
+	const char *severity = RTIXMLHelper_getAttribute((const char**)object->attr, "severity");
+	XML_parser::get_singleton()->add_rule(name,
+					      severity != NULL ? atoi(severity) : 1,
+					      string(element_text));
+    }
    
 }
 
@@ -1466,6 +2226,29 @@ void XML_parser_plugin_end(struct DDS_XMLObject *self,
 						  string(element_text));
     }
 
+    //Anomaly detectors------------------------------------
+    else if(!strcmp(tag_name, "detector")) {
+	const char **attr = (const char**)object->attr;
+	const char *value;
+	cc_anomaly_definition detector;
+
+	detector.member = string(RTIXMLHelper_getAttribute(attr, "member"));
+	value = RTIXMLHelper_getAttribute(attr, "method");
+	detector.method = (value != NULL) ? value : "ewma";
+	value = RTIXMLHelper_getAttribute(attr, "alpha");
+	detector.alpha = (value != NULL) ? atof(value) : -1;
+	value = RTIXMLHelper_getAttribute(attr, "window");
+	detector.window = (value != NULL) ? atoi(value) : -1;
+	value = RTIXMLHelper_getAttribute(attr, "threshold");
+	detector.threshold = (value != NULL) ? atof(value) : -1;
+	value = RTIXMLHelper_getAttribute(attr, "warmup");
+	detector.warmup = (value != NULL) ? atoi(value) : -1;
+	value = RTIXMLHelper_getAttribute(attr, "severity");
+	detector.severity = (value != NULL) ? atoi(value) : 1;
+
+	XML_parser::get_singleton()->set_tmp_plugin_properties_add_detector(detector);
+    }
+
     //Type definition-------------------------------------
     else if(!strcmp(tag_name, "type_definition")) {
 
@@ -27,6 +27,7 @@
 #include <list>
 #include <cstdlib>
 #include <map>
+#include <vector>
 #include <string.h>
 
 #include <ndds/ndds_cpp.h>
@@ -38,10 +39,36 @@
 #include <log/log_common.h>
 
 #define XML_CAVECANEM_MAX_NUMBER_OF_NON_EXTENSION_TAGS 1000
-#define DTD_CAVECANEM_LINE_NUMBER 13
-#define DTD_CAVECANEM_EXTENSION_NUMBER 12
-#define DTD_CAVECANEM_PLUGIN_LINE_NUMBER 354
-#define DTD_CAVECANEM_PLUGIN_EXTENSION_NUMBER 11
+#define DTD_CAVECANEM_LINE_NUMBER 53
+#define DTD_CAVECANEM_EXTENSION_NUMBER 27
+
+//Period of the cavecanem_self reports when not configured
+#define DEFAULT_SELF_TELEMETRY_PERIOD_SEC 60
+//Size of the shared-memory sink when not configured
+#define DEFAULT_SINK_SIZE_KB 4096
+//Rows, bytes per row and expiry of the latest values region when not configured
+#define DEFAULT_LATEST_SLOTS 4096
+#define DEFAULT_LATEST_SLOT_SIZE 512
+#define DEFAULT_LATEST_EXPIRE_SEC 300
+//Ring size per topic and drain rate of the spool when not configured
+#define DEFAULT_SPOOL_SIZE_MB 64
+#define DEFAULT_SPOOL_DRAIN_PER_SEC 1000
+//Bucket depth, share of the period bursts are spread over and queue bound
+//of the egress shaper when not configured
+#define DEFAULT_EGRESS_BURST_MS 10
+#define DEFAULT_EGRESS_SPREAD 0.8
+#define DEFAULT_EGRESS_MAX_QUEUE 100000
+//Measurement window and largest stretch of the periods of the CPU governor
+//when not configured
+#define DEFAULT_CPU_BUDGET_WINDOW_SEC 10
+#define DEFAULT_CPU_BUDGET_MAX_STRETCH 16
+//Plugins constructed at the same time at startup when not configured
+#define DEFAULT_STARTUP_THREADS 4
+//Period and duration of a burst when not configured
+#define DEFAULT_BURST_PERIOD_MS 100
+#define DEFAULT_BURST_DURATION_SEC 60
+#define DTD_CAVECANEM_PLUGIN_LINE_NUMBER 363
+#define DTD_CAVECANEM_PLUGIN_EXTENSION_NUMBER 13
 
 #ifndef CAVECANEM_DIR
 #define CAVECANEM_DIR ""
@@ -83,6 +110,107 @@ struct RTIXMLCaveCanemExtensionObject{
     struct RTIXMLCaveCanemExtensionObjectElement * tag_elements[XML_CAVECANEM_MAX_NUMBER_OF_NON_EXTENSION_TAGS];
 };
 
+/** 
+ * @class cc_rule_definition 
+ * A rule of the <code>rules</code> section of the general configuration file.
+ */
+struct cc_rule_definition {
+    std::string name;
+    int severity;
+    std::string expression;
+};
+
+/** 
+ * @class cc_burst_definition 
+ * A burst of the <code>bursts</code> section of the general configuration
+ * file: which alerts trigger it (empty strings match anything) and which
+ * plugins it switches to a fast period.
+ */
+struct cc_burst_definition {
+    std::string alert;
+    std::string source;
+    int severity;
+    int period_ms;
+    int duration_sec;
+    std::list<std::string> plugins;
+};
+
+/** 
+ * @class cc_sink_definition 
+ * The <code>sink</code> of the general configuration file: where the
+ * samples of the plugins are written ("dds", "file" or "shm").
+ */
+struct cc_sink_definition {
+    std::string kind;
+    std::string path;
+    int size_kb;
+};
+
+/** 
+ * @class cc_latest_definition 
+ * The <code>latest_values</code> element of the general configuration file:
+ * the shared-memory region keeping the latest sample of every instance
+ * (disabled when <code>name</code> is empty).
+ */
+struct cc_latest_definition {
+    std::string name;
+    int slots;
+    int slot_size;
+    int expire_sec;
+};
+
+/** 
+ * @class cc_spool_definition 
+ * The <code>spool</code> element of the general configuration file: the
+ * directory where samples of topics without readers are kept (disabled
+ * when <code>dir</code> is empty).
+ */
+struct cc_spool_definition {
+    std::string dir;
+    int size_mb;
+    int drain_per_sec;
+};
+
+/** 
+ * @class cc_egress_limit 
+ * A <code>limit</code> of the <code>egress</code> element: the rates of a
+ * plugin (0 for no limit) and the share of the period its bursts are spread
+ * over (negative to keep the one of <code>egress</code>).
+ */
+struct cc_egress_limit {
+    std::string plugin;
+    double samples_per_sec;
+    double bytes_per_sec;
+    double spread;
+};
+
+/** 
+ * @class cc_egress_definition 
+ * The <code>egress</code> element of the general configuration file: the
+ * pacing of the samples written by the plugins (disabled unless
+ * <code>enabled</code>).
+ */
+struct cc_egress_definition {
+    bool enabled;
+    double samples_per_sec;
+    double bytes_per_sec;
+    int burst_ms;
+    double spread;
+    int max_queue;
+    std::list<cc_egress_limit> limits;
+};
+
+/** 
+ * @class cc_cpu_budget_definition 
+ * The <code>cpu_budget</code> element of the general configuration file:
+ * the share of one core (in percent) the agent may use (disabled when 0).
+ */
+struct cc_cpu_budget_definition {
+    double percent;
+    int window_sec;
+    int max_stretch;
+};
+
 /** 
  * @class cc_general_properties 
  * This structure stores the general properties of Cave Canem
@@ -90,14 +218,42 @@ struct RTIXMLCaveCanemExtensionObject{
  */
 struct cc_general_properties {
     int publishing_period;
+    int self_telemetry_period;
     int domain_id;
     std::string qos_file;
     std::string qos_library;
     std::string qos_profile;
+    std::string alert_qos_profile;
+    cc_sink_definition sink;
+    cc_latest_definition latest_values;
+    cc_spool_definition spool;
+    cc_egress_definition egress;
+    cc_cpu_budget_definition cpu_budget;
+    std::string control_socket;
+    int startup_threads;
+    bool latency_probe;
     std::map<std::string, std::list<std::string> > plugin_list_map;
+    std::list<cc_rule_definition> rules;
+    std::list<cc_burst_definition> bursts;
 };
 
 
+/** 
+ * @class cc_anomaly_definition
+ * A detector of the <code>anomaly_detection</code> section of a plugin
+ * configuration file. Unset numeric attributes are negative, so that the
+ * defaults of the method apply.
+ */
+struct cc_anomaly_definition {
+    std::string member;
+    std::string method;
+    double alpha;
+    int window;
+    double threshold;
+    int warmup;
+    int severity;
+};
+
 /** 
  * @class cc_plugin_properties
  * This structure stores the properties of a plugin got from a 
@@ -112,6 +268,7 @@ struct cc_plugin_properties {
     std::string qos_library;
     std::string topic_name;
     std::map<std::string, std::string> plugin_config;
+    std::list<cc_anomaly_definition> anomaly_detectors;
     const struct DDS_DataWriterQos *datawriter_qos;
     struct DDS_TypeCode *type_code;
 };
@@ -163,6 +320,7 @@ private:
     static XML_parser *the_singleton_;
     XML_parser();
 
+    void set_default_general_properties();
     bool register_general_extensions(struct DDS_XMLParser *self,
     				     struct DDS_XMLExtensionClass **user_extensions);
     bool register_plugin_extensions(struct DDS_XMLParser *self,
@@ -175,6 +333,14 @@ private:
     std::list<std::string> tmp_plugin_list_;
     cc_plugin_properties tmp_plugin_properties_;
 
+    //Copies of the types and QoS of the plugins, which outlive the DOM they
+    //were parsed from. Equal ones are shared, so parsing the same files
+    //again (on every reload) does not add any.
+    std::vector<DDS_TypeCode *> type_codes_;
+    std::vector<DDS_DataWriterQos *> datawriter_qos_;
+    DDS_TypeCode *keep_type_code(const DDS_TypeCode *type_code);
+    const DDS_DataWriterQos *keep_datawriter_qos(const DDS_DataWriterQos *datawriter_qos);
+
 public:
     /** 
      * @brief Provides access to the XML_parser singleton class.
@@ -189,11 +355,7 @@ public:
 	return the_singleton_;
     }
     
-    /** 
-     * @brief Destructor of the class XML_parser.
-     *  Destructor of the class XML_parser.
-     */
-    ~XML_parser() {}
+    ~XML_parser();
 
     bool parse_general_configuration_file(std::string cfg_file);
     bool parse_plugin_configuration_file(std::string cfg_file);
@@ -203,6 +365,22 @@ public:
     void set_qos_file(std::string qos_file);
     void set_qos_default_library(std::string qos_library);
     void set_qos_default_profile(std::string qos_profile);
+    void set_qos_alert_profile(std::string qos_profile);
+    void set_self_telemetry_period(int period);
+    void set_sink(std::string kind, std::string path, int size_kb);
+    void set_latest_values(std::string name, int slots, int slot_size, int expire_sec);
+    void set_spool(std::string dir, int size_mb, int drain_per_sec);
+    void set_egress(double samples_per_sec, double bytes_per_sec,
+		    int burst_ms, double spread, int max_queue);
+    void add_egress_limit(std::string plugin, double samples_per_sec,
+			  double bytes_per_sec, double spread);
+    void set_cpu_budget(double percent, int window_sec, int max_stretch);
+    void set_control_socket(std::string path);
+    void set_startup_threads(int threads);
+    void set_latency_probe(bool enabled);
+    void add_burst(std::string alert, std::string source, int severity,
+		   int period_ms, int duration_sec, std::string plugins);
+    void add_rule(std::string name, int severity, std::string expression);
     void set_plugin_library(std::string dir, std::list<std::string> plugin_list);
     
     //Temporal setting methods for general properties
@@ -219,6 +397,7 @@ public:
     void set_tmp_plugin_properties_qos_profile(std::string qos_profile);
     void set_tmp_plugin_properties_topic_name(std::string topic_name);
     void set_tmp_plugin_properties_add_element(std::string name,std::string value);
+    void set_tmp_plugin_properties_add_detector(cc_anomaly_definition detector);
     void set_tmp_plugin_properties_type_code(struct DDS_TypeCode *type_code);
     void set_tmp_plugin_properties_datawriter_qos(const struct DDS_DataWriterQos *datawriter_qos);
     void set_tmp_plugin_properties_publishing_period(int publishing_period);
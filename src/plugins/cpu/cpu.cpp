@@ -140,11 +140,8 @@ bool cpu::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		     DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 		     loadavg_.loadavg[2]);
     
-    //Timestamp (time_t)
-    timestamp_ = time(NULL);
-    data->set_long("ts",
-		   DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
-		   timestamp_);
+    //Tick (sequence number and time)
+    stamp_tick(data);
     
     // Then let the base class do the job of publising-----------------------------
     if(!publish_information(writer, data))
@@ -61,7 +61,6 @@ class DLL_EXPORTS cpu : public cc_plugin {
     sigar_t *sig_;
     sigar_cpu_t cpu_info_;
     sigar_loadavg_t loadavg_;
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
 };
 
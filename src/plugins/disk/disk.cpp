@@ -44,6 +44,9 @@ disk::disk(string plugin_id,map<string,string> properties )
 disk::~disk(void)
 {
     // Customize if needed
+#ifdef CAVECANEM_PROCFS
+    delete procfs_;
+#endif
     sigar_close(sig_);
 
 }
@@ -52,7 +55,8 @@ disk::~disk(void)
  * @brief Initializes the requirements of the plugin.
  * 
  * Initializes all the stuff required by the plugin.
- * @param properties Map of properties (will be empty in this plugin).
+ * @param properties Map of properties. The optional <code>procfs_root</code>
+ * property names a procfs tree to read instead of /proc (Linux only).
  */
 bool disk::initialize_plugin(map<string,string> properties) 
 {
@@ -63,6 +67,12 @@ bool disk::initialize_plugin(map<string,string> properties)
     sigar_net_info_get(sig_, &net_info);
     
     strcpy(hostname_,net_info.host_name);
+
+#ifdef CAVECANEM_PROCFS
+    procfs_ = NULL;
+    if(!properties["procfs_root"].empty())
+	procfs_ = new procfs_reader(properties["procfs_root"]);
+#endif
     
     return true;
 }
@@ -86,12 +96,22 @@ bool disk::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		     DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 		     hostname_);
     
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ != NULL)
+	procfs_->file_system_list_get(&fslist_);
+    else
+#endif
     sigar_file_system_list_get(sig_,&fslist_);
     
     for(unsigned int i = 0; i < fslist_.number; i++) {
 	if(fslist_.data[i].type == SIGAR_FSTYPE_LOCAL_DISK ||
 	   fslist_.data[i].type == SIGAR_FSTYPE_NETWORK) {
 	    sigar_file_system_usage_t fsusage;
+#ifdef CAVECANEM_PROCFS
+	    if(procfs_ != NULL)
+		procfs_->file_system_usage_get(fslist_.data[i].dir_name,&fsusage);
+	    else
+#endif
 	    sigar_file_system_usage_get(sig_,fslist_.data[i].dir_name,&fsusage);
 
 	    data->set_string("name",
@@ -128,10 +148,7 @@ bool disk::generate_and_publish_information(DDSDynamicDataWriter *writer,
 			     DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 			     100.0-fsusage.use_percent*100);
 
-	    timestamp_ = time(NULL);
-	    data->set_long("ts",
-			   DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
-			   timestamp_);
+	    stamp_tick(data);
 
 	    
 	    if(!publish_information(writer, data))
@@ -142,6 +159,9 @@ bool disk::generate_and_publish_information(DDSDynamicDataWriter *writer,
     }
     
     
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ == NULL)
+#endif
     sigar_file_system_list_destroy(sig_,&fslist_);
     return true;
 }
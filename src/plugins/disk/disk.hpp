@@ -36,6 +36,9 @@ extern "C" {
 }
 
 #include <plugin.hpp>
+#ifdef CAVECANEM_PROCFS
+#include "procfs_reader.hpp"
+#endif
 
 /** 
  * @class disk 
@@ -58,9 +61,11 @@ class DLL_EXPORTS disk : public cc_plugin {
     
  private:
     bool initialize_plugin(std::map<std::string, std::string> properties);  
+#ifdef CAVECANEM_PROCFS
+    procfs_reader *procfs_;
+#endif
     sigar_t *sig_;
     sigar_file_system_list_t fslist_;
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
 };
 
@@ -61,7 +61,6 @@ class DLL_EXPORTS host_info : public cc_plugin {
     sigar_t *sig_;
     sigar_sys_info_t sysinfo_;
     sigar_uptime_t uptime_;
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
 
 };
@@ -0,0 +1,348 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "file_tailer.hpp"
+
+using namespace std;
+
+/**
+ * @brief Constructor of the file_tailer class.
+ *
+ * Creates the (non-blocking) inotify instance. If inotify is not available
+ * the tailer still works, but only when read_all() is called periodically.
+ */
+file_tailer::file_tailer()
+    : started_(false),
+      buffer_(FILE_TAILER_BUFFER_SIZE),
+      events_(4096)
+{
+    inotify_fd_ = inotify_init();
+    if(inotify_fd_ >= 0)
+	fcntl(inotify_fd_, F_SETFL, fcntl(inotify_fd_, F_GETFL) | O_NONBLOCK);
+    else
+	cerr << "log_tail: inotify unavailable (" << strerror(errno)
+	     << "), falling back to periodic reads" << endl;
+}
+
+/**
+ * @brief Destructor of the file_tailer class.
+ *
+ * Closes all the followed files and the inotify instance.
+ */
+file_tailer::~file_tailer()
+{
+    for(size_t i = 0; i < files_.size(); i++)
+	close_file(files_[i]);
+    if(inotify_fd_ >= 0)
+	close(inotify_fd_);
+}
+
+/**
+ * @brief Registers a glob to follow.
+ *
+ * Watches the directory of the glob so that new, rotated and truncated
+ * files wake the tailer up. Directories containing wildcards cannot be
+ * watched and are only rescanned periodically.
+ * @param pattern Glob of the files (e.g. /var/log/auth.log*).
+ * @param source Identifier of the log source the files belong to.
+ *
+ * @return False if the directory could not be watched.
+ */
+bool file_tailer::add_glob(const string &pattern, int source)
+{
+    watched_glob entry;
+    entry.pattern = pattern;
+    entry.source = source;
+    globs_.push_back(entry);
+
+    if(inotify_fd_ < 0)
+	return true;
+
+    size_t slash = pattern.rfind('/');
+    string dir = (slash == string::npos) ? "." :
+	(slash == 0 ? "/" : pattern.substr(0, slash));
+    if(dir.find_first_of("*?[") != string::npos)
+	return true;
+    if(find(watched_dirs_.begin(), watched_dirs_.end(), dir) != watched_dirs_.end())
+	return true;
+
+    if(inotify_add_watch(inotify_fd_, dir.c_str(),
+			 IN_MODIFY | IN_CREATE | IN_DELETE |
+			 IN_MOVED_FROM | IN_MOVED_TO) < 0) {
+	cerr << "log_tail: cannot watch " << dir << ": " << strerror(errno) << endl;
+	return false;
+    }
+    watched_dirs_.push_back(dir);
+    return true;
+}
+
+/**
+ * @brief Opens the files matching the globs for the first time.
+ *
+ * @param from_end If true, existing files are followed from their current
+ * end (like <code>tail -F</code>); otherwise they are read from the beginning.
+ * Files appearing afterwards are always read from the beginning.
+ *
+ * @return True.
+ */
+bool file_tailer::start(bool from_end)
+{
+    for(size_t i = 0; i < globs_.size(); i++) {
+	glob_t matches;
+	if(glob(globs_[i].pattern.c_str(), 0, NULL, &matches) == 0) {
+	    for(size_t j = 0; j < matches.gl_pathc; j++)
+		open_file(matches.gl_pathv[j], globs_[i].source, from_end);
+	}
+	globfree(&matches);
+    }
+    started_ = true;
+    return true;
+}
+
+/**
+ * @brief Returns the inotify descriptor (or -1 if inotify is unavailable).
+ */
+int file_tailer::descriptor() const
+{
+    return inotify_fd_;
+}
+
+/**
+ * @brief Consumes the pending inotify events.
+ *
+ * @return True if some event changed the set of files (creation, deletion
+ * or renaming), so that rescan() must be called before reading.
+ */
+bool file_tailer::drain_events()
+{
+    bool structural = false;
+    if(inotify_fd_ < 0)
+	return true;
+
+    for(;;) {
+	ssize_t length = read(inotify_fd_, &events_[0], events_.size());
+	if(length <= 0)
+	    break;
+	for(char *ptr = &events_[0]; ptr < &events_[0] + length; ) {
+	    struct inotify_event *event = (struct inotify_event *) ptr;
+	    if(event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+			      IN_MOVED_TO | IN_Q_OVERFLOW))
+		structural = true;
+	    ptr += sizeof(struct inotify_event) + event->len;
+	}
+    }
+    return structural;
+}
+
+/**
+ * @brief Matches the globs again and detects rotations.
+ *
+ * Matches are looked up by device and inode, not by path: a followed file
+ * renamed to another matching path (auth.log to auth.log.1) keeps its
+ * position, and the new file taking its old path is followed from its
+ * beginning. Files no longer matched by any glob are marked as rotated: their
+ * descriptor is kept until read_all() reaches their end, then closed.
+ */
+void file_tailer::rescan()
+{
+    for(size_t i = 0; i < files_.size(); i++)
+	files_[i].seen = false;
+
+    for(size_t i = 0; i < globs_.size(); i++) {
+	glob_t matches;
+	if(glob(globs_[i].pattern.c_str(), 0, NULL, &matches) != 0) {
+	    globfree(&matches);
+	    continue;
+	}
+
+	for(size_t j = 0; j < matches.gl_pathc; j++) {
+	    const char *path = matches.gl_pathv[j];
+	    struct stat st;
+	    if(stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		continue;
+
+	    bool known = false;
+	    for(size_t k = 0; k < files_.size(); k++) {
+		tailed_file &file = files_[k];
+		if(file.rotated || file.dev != st.st_dev || file.ino != st.st_ino)
+		    continue;
+		if(file.path != path && !file.seen)
+		    file.path = path; //Renamed (e.g. by logrotate)
+		file.seen = true;
+		known = true;
+		break;
+	    }
+
+	    if(!known)
+		open_file(path, globs_[i].source, false);
+	}
+	globfree(&matches);
+    }
+
+    for(size_t i = 0; i < files_.size(); i++)
+	if(!files_[i].seen)
+	    files_[i].rotated = true;
+}
+
+/**
+ * @brief Reads the new lines of every followed file.
+ *
+ * Rotated files are read to their end and then closed.
+ * @param handler Handler receiving the lines.
+ *
+ * @return The number of lines read.
+ */
+size_t file_tailer::read_all(tail_handler &handler)
+{
+    size_t lines = 0;
+
+    for(size_t i = 0; i < files_.size(); i++)
+	lines += read_file(files_[i], handler);
+
+    for(size_t i = 0; i < files_.size(); ) {
+	if(files_[i].rotated) {
+	    close_file(files_[i]);
+	    files_.erase(files_.begin() + i);
+	}
+	else {
+	    i++;
+	}
+    }
+
+    return lines;
+}
+
+void file_tailer::open_file(const string &path, int source, bool from_end)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+	cerr << "log_tail: cannot open " << path << ": " << strerror(errno) << endl;
+	return;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+	close(fd);
+	return;
+    }
+
+    tailed_file file;
+    file.path = path;
+    file.source = source;
+    file.fd = fd;
+    file.dev = st.st_dev;
+    file.ino = st.st_ino;
+    file.offset = from_end ? st.st_size : 0;
+    file.rotated = false;
+    file.seen = true;
+    lseek(fd, file.offset, SEEK_SET);
+
+    files_.push_back(file);
+}
+
+/**
+ * @brief Reads a file from its last position to its current end.
+ *
+ * Complete lines are handed to the handler straight from the read buffer;
+ * only a line spanning two reads is copied into the partial buffer. Lines
+ * longer than FILE_TAILER_MAX_LINE_LENGTH are split.
+ */
+size_t file_tailer::read_file(tailed_file &file, tail_handler &handler)
+{
+    size_t lines = 0;
+    struct stat st;
+
+    if(fstat(file.fd, &st) == 0 && st.st_size < file.offset) {
+	//Truncated (copytruncate or > redirection): start over
+	file.offset = 0;
+	file.partial.clear();
+	lseek(file.fd, 0, SEEK_SET);
+    }
+
+    bool begun = false;
+    for(;;) {
+	ssize_t length = read(file.fd, &buffer_[0], buffer_.size());
+	if(length < 0 && errno == EINTR)
+	    continue;
+	if(length <= 0)
+	    break;
+
+	if(!begun) {
+	    handler.begin_file(file);
+	    begun = true;
+	}
+
+	const char *ptr = &buffer_[0];
+	const char *end = ptr + length;
+	off_t line_offset = file.offset - (off_t) file.partial.size();
+
+	while(ptr < end) {
+	    const char *newline = (const char *) memchr(ptr, '\n', end - ptr);
+	    if(newline == NULL) {
+		file.partial.append(ptr, end - ptr);
+		if(file.partial.size() >= FILE_TAILER_MAX_LINE_LENGTH) {
+		    handler.line(file, file.partial.data(), file.partial.size(), line_offset);
+		    line_offset += file.partial.size();
+		    file.partial.clear();
+		    lines++;
+		}
+		break;
+	    }
+
+	    size_t chunk = newline - ptr;
+	    if(file.partial.empty()) {
+		handler.line(file, ptr, chunk, line_offset);
+	    }
+	    else {
+		file.partial.append(ptr, chunk);
+		handler.line(file, file.partial.data(), file.partial.size(), line_offset);
+		file.partial.clear();
+	    }
+	    line_offset = file.offset + (newline + 1 - &buffer_[0]);
+	    ptr = newline + 1;
+	    lines++;
+	}
+
+	file.offset += length;
+    }
+
+    if(begun)
+	handler.end_file(file);
+
+    return lines;
+}
+
+void file_tailer::close_file(tailed_file &file)
+{
+    if(file.fd >= 0)
+	close(file.fd);
+    file.fd = -1;
+}
@@ -0,0 +1,109 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILE_TAILER_HPP
+#define FILE_TAILER_HPP
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#define FILE_TAILER_BUFFER_SIZE 65536
+#define FILE_TAILER_MAX_LINE_LENGTH 65536
+
+/**
+ * @class tailed_file
+ * State of a file being followed: its identity (device and inode), the
+ * position up to which it has been read and the incomplete line at its end.
+ */
+struct tailed_file {
+    std::string path;
+    int source;
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    off_t offset;
+    bool rotated;      //No longer matched by the globs: drain and close
+    bool seen;         //Still matched by the glob in the last scan
+    std::string partial;
+};
+
+/**
+ * @class tail_handler
+ * Receives the lines read by file_tailer::read_all().
+ */
+class tail_handler {
+public:
+    virtual ~tail_handler() {}
+    virtual void begin_file(const tailed_file &file) = 0;
+    virtual void line(const tailed_file &file,
+		      const char *line, size_t len, off_t offset) = 0;
+    virtual void end_file(const tailed_file &file) = 0;
+};
+
+/**
+ * @class file_tailer
+ * Follows the files matching a set of globs, like <code>tail -F</code>.
+ *
+ * The directories of the globs are watched with inotify, so the owner can
+ * poll descriptor() and only call read_all() when something changed. Files
+ * are identified by device and inode: a file renamed by a rotation is still
+ * followed from where it was if its new name matches a glob, and read to
+ * its end and closed otherwise; the new file taking its place is read from
+ * the beginning. When a file shrinks below the read position (truncation)
+ * it is read again from the beginning.
+ */
+class file_tailer {
+public:
+    file_tailer();
+    ~file_tailer();
+
+    bool add_glob(const std::string &pattern, int source);
+    bool start(bool from_end);
+    int descriptor() const;
+    bool drain_events();
+    void rescan();
+    size_t read_all(tail_handler &handler);
+
+    const std::vector<tailed_file> &files() const
+    {
+	return files_;
+    }
+
+private:
+    struct watched_glob {
+	std::string pattern;
+	int source;
+    };
+
+    void open_file(const std::string &path, int source, bool from_end);
+    size_t read_file(tailed_file &file, tail_handler &handler);
+    void close_file(tailed_file &file);
+
+    int inotify_fd_;
+    bool started_;
+    std::vector<watched_glob> globs_;
+    std::vector<std::string> watched_dirs_;
+    std::vector<tailed_file> files_;
+    std::vector<char> buffer_;
+    std::vector<char> events_;
+};
+
+#endif //FILE_TAILER_HPP
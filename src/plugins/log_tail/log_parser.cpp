@@ -0,0 +1,313 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cstdio>
+
+#include "log_parser.hpp"
+
+using namespace std;
+
+/**
+ * @brief Splits a list of names.
+ *
+ * Splits <code>list</code> by <code>separator</code> trimming blanks around
+ * each element. Empty elements are kept, so that a regex subexpression can be
+ * left unnamed (e.g. "time,,pid"); an empty list has no elements.
+ * @param list The list to split.
+ * @param separator The separator character.
+ *
+ * @return The elements of the list.
+ */
+vector<string> split_list(const string &list, char separator)
+{
+    vector<string> result;
+    if(list.find_first_not_of(" \t\n") == string::npos)
+	return result;
+
+    size_t start = 0;
+    for(;;) {
+	size_t end = list.find(separator, start);
+	string element = list.substr(start, end == string::npos ? string::npos : end - start);
+	size_t first = element.find_first_not_of(" \t\n");
+	size_t last = element.find_last_not_of(" \t\n");
+	result.push_back(first == string::npos ? "" : element.substr(first, last - first + 1));
+	if(end == string::npos)
+	    break;
+	start = end + 1;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Creates a parser given its kind.
+ *
+ * Creates a parser of the given kind ("raw", "csv", "kv" or "regex") configured
+ * with the source options (<code>fields</code>, <code>delimiter</code> and
+ * <code>pattern</code>).
+ * @param kind Kind of parser.
+ * @param options Options of the log source.
+ * @param error Set to a description of the problem when NULL is returned.
+ *
+ * @return A new parser, or NULL if it could not be created.
+ */
+log_parser *log_parser::create(const string &kind,
+			       map<string, string> &options,
+			       string &error)
+{
+    vector<string> names = split_list(options["fields"], ',');
+
+    if(kind.empty() || kind == "raw") {
+	return new raw_parser();
+    }
+    else if(kind == "csv") {
+	string delimiter = options["delimiter"];
+	if(delimiter == "\\t" || delimiter == "tab")
+	    delimiter = "\t";
+	return new csv_parser(delimiter.empty() ? ',' : delimiter[0], names);
+    }
+    else if(kind == "kv") {
+	return new kv_parser();
+    }
+    else if(kind == "regex") {
+	regex_parser *parser = new regex_parser();
+	if(!parser->compile(options["pattern"], names, error)) {
+	    delete parser;
+	    return NULL;
+	}
+	return parser;
+    }
+
+    error = "unknown parser '" + kind + "'";
+    return NULL;
+}
+
+
+size_t raw_parser::parse(const char *line, size_t len, vector<log_field> &fields)
+{
+    fields.clear();
+    return 0;
+}
+
+
+csv_parser::csv_parser(char delimiter, const vector<string> &names)
+    : delimiter_(delimiter), names_(names)
+{
+}
+
+/**
+ * @brief Splits a delimiter-separated line.
+ *
+ * Unquoted fields point into the line. Quoted fields are unescaped into the
+ * scratch buffer, which is sized to the line before parsing so that the
+ * pointers stay valid.
+ */
+size_t csv_parser::parse(const char *line, size_t len, vector<log_field> &fields)
+{
+    fields.clear();
+    if(scratch_.size() < len + 1)
+	scratch_.resize(len + 1);
+    char *out = &scratch_[0];
+
+    size_t i = 0;
+    size_t column = 0;
+    for(;;) {
+	log_field field;
+	if(i < len && line[i] == '"') {
+	    //Quoted field: copy it unescaped into the scratch buffer
+	    field.value = out;
+	    i++;
+	    while(i < len) {
+		if(line[i] == '"') {
+		    if(i + 1 < len && line[i + 1] == '"') {
+			*out++ = '"';
+			i += 2;
+			continue;
+		    }
+		    i++;
+		    break;
+		}
+		*out++ = line[i++];
+	    }
+	    field.value_len = out - field.value;
+	    //Skip anything between the closing quote and the delimiter
+	    while(i < len && line[i] != delimiter_)
+		i++;
+	}
+	else {
+	    const char *end = (const char *) memchr(line + i, delimiter_, len - i);
+	    size_t stop = end ? (size_t) (end - line) : len;
+	    field.value = line + i;
+	    field.value_len = stop - i;
+	    i = stop;
+	}
+
+	if(column < names_.size() && !names_[column].empty()) {
+	    field.name = names_[column].data();
+	    field.name_len = names_[column].size();
+	}
+	else {
+	    while(default_names_.size() <= column) {
+		char name[16];
+		snprintf(name, sizeof(name), "f%u", (unsigned) default_names_.size() + 1);
+		default_names_.push_back(name);
+	    }
+	    field.name = default_names_[column].data();
+	    field.name_len = default_names_[column].size();
+	}
+	fields.push_back(field);
+	column++;
+
+	if(i >= len)
+	    break;
+	i++; //Skip the delimiter
+    }
+
+    return fields.size();
+}
+
+
+/**
+ * @brief Splits whitespace-separated key=value pairs.
+ *
+ * Quoted values keep pointing into the line (without the quotes), so the
+ * kv parser does not need any scratch space.
+ */
+size_t kv_parser::parse(const char *line, size_t len, vector<log_field> &fields)
+{
+    fields.clear();
+    size_t i = 0;
+
+    while(i < len) {
+	while(i < len && (line[i] == ' ' || line[i] == '\t'))
+	    i++;
+	size_t key_start = i;
+	while(i < len && line[i] != '=' && line[i] != ' ' && line[i] != '\t')
+	    i++;
+	if(i >= len || line[i] != '=') //Token without a value
+	    continue;
+
+	log_field field;
+	field.name = line + key_start;
+	field.name_len = i - key_start;
+	i++; //Skip '='
+
+	if(i < len && line[i] == '"') {
+	    i++;
+	    field.value = line + i;
+	    const char *end = (const char *) memchr(line + i, '"', len - i);
+	    size_t stop = end ? (size_t) (end - line) : len;
+	    field.value_len = stop - i;
+	    i = end ? stop + 1 : len;
+	}
+	else {
+	    field.value = line + i;
+	    while(i < len && line[i] != ' ' && line[i] != '\t')
+		i++;
+	    field.value_len = (line + i) - field.value;
+	}
+
+	if(field.name_len > 0)
+	    fields.push_back(field);
+    }
+
+    return fields.size();
+}
+
+
+regex_parser::regex_parser() : compiled_(false)
+{
+}
+
+regex_parser::~regex_parser()
+{
+    if(compiled_)
+	regfree(&regex_);
+}
+
+/**
+ * @brief Compiles the regular expression of the parser.
+ *
+ * @param pattern POSIX extended regular expression.
+ * @param names Names of the subexpressions, in order. Subexpressions with an
+ * empty name are not published.
+ * @param error Set to the regcomp() error message on failure.
+ *
+ * @return True if the expression was compiled.
+ */
+bool regex_parser::compile(const string &pattern,
+			   const vector<string> &names,
+			   string &error)
+{
+    if(pattern.empty()) {
+	error = "regex parser requires a 'pattern'";
+	return false;
+    }
+
+    int retcode = regcomp(&regex_, pattern.c_str(), REG_EXTENDED);
+    if(retcode != 0) {
+	char buffer[256];
+	regerror(retcode, &regex_, buffer, sizeof(buffer));
+	error = string("invalid pattern '") + pattern + "': " + buffer;
+	return false;
+    }
+    compiled_ = true;
+
+    names_ = names;
+    matches_.resize(regex_.re_nsub + 1);
+    for(size_t i = names_.size(); i < regex_.re_nsub; i++) {
+	char name[16];
+	snprintf(name, sizeof(name), "g%u", (unsigned) i + 1);
+	names_.push_back(name);
+    }
+    return true;
+}
+
+/**
+ * @brief Matches a line against the expression.
+ *
+ * regexec() needs a NUL-terminated string, so the line is copied into the
+ * scratch buffer first. Lines that do not match produce no fields.
+ */
+size_t regex_parser::parse(const char *line, size_t len, vector<log_field> &fields)
+{
+    fields.clear();
+    if(scratch_.size() < len + 1)
+	scratch_.resize(len + 1);
+    memcpy(&scratch_[0], line, len);
+    scratch_[len] = '\0';
+
+    if(regexec(&regex_, scratch_.c_str(), matches_.size(), &matches_[0], 0) != 0)
+	return 0;
+
+    for(size_t i = 1; i < matches_.size(); i++) {
+	if(matches_[i].rm_so < 0 || names_[i - 1].empty())
+	    continue;
+	log_field field;
+	field.name = names_[i - 1].data();
+	field.name_len = names_[i - 1].size();
+	field.value = line + matches_[i].rm_so;
+	field.value_len = matches_[i].rm_eo - matches_[i].rm_so;
+	fields.push_back(field);
+    }
+
+    return fields.size();
+}
@@ -0,0 +1,132 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_PARSER_HPP
+#define LOG_PARSER_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstddef>
+#include <regex.h>
+
+/**
+ * @class log_field
+ * A parsed field of a log line. Both the name and the value point either to
+ * the line itself or to the parser's scratch buffer, so they are only valid
+ * until the next call to log_parser::parse().
+ */
+struct log_field {
+    const char *name;
+    size_t name_len;
+    const char *value;
+    size_t value_len;
+};
+
+/**
+ * @class log_parser
+ * Splits a log line into named fields. Parsers never allocate once they have
+ * seen a line of a given length, so they can sit in the hot ingestion path.
+ */
+class log_parser {
+public:
+    virtual ~log_parser() {}
+
+    /**
+     * @brief Parses a line.
+     *
+     * @param line Pointer to the line (not NUL-terminated, without the newline).
+     * @param len Length of the line.
+     * @param fields Vector the fields are stored into (cleared first).
+     *
+     * @return The number of fields found.
+     */
+    virtual size_t parse(const char *line, size_t len,
+			 std::vector<log_field> &fields) = 0;
+
+    static log_parser *create(const std::string &kind,
+			      std::map<std::string, std::string> &options,
+			      std::string &error);
+};
+
+/**
+ * @class raw_parser
+ * Does not split the line: it is published as-is.
+ */
+class raw_parser : public log_parser {
+public:
+    size_t parse(const char *line, size_t len, std::vector<log_field> &fields);
+};
+
+/**
+ * @class csv_parser
+ * Splits delimiter-separated lines. Double-quoted fields may contain the
+ * delimiter and escaped ("") quotes. Columns are named after the
+ * <code>fields</code> option, or <code>fN</code> when there are more
+ * columns than names.
+ */
+class csv_parser : public log_parser {
+public:
+    csv_parser(char delimiter, const std::vector<std::string> &names);
+    size_t parse(const char *line, size_t len, std::vector<log_field> &fields);
+
+private:
+    char delimiter_;
+    std::vector<std::string> names_;
+    std::deque<std::string> default_names_; //Grows without moving the names
+    std::string scratch_;
+};
+
+/**
+ * @class kv_parser
+ * Splits whitespace-separated <code>key=value</code> pairs, as found in
+ * audit.log. Values may be double-quoted; tokens without '=' are skipped.
+ */
+class kv_parser : public log_parser {
+public:
+    size_t parse(const char *line, size_t len, std::vector<log_field> &fields);
+};
+
+/**
+ * @class regex_parser
+ * Matches the line against a POSIX extended regular expression; every
+ * subexpression becomes a field named after the <code>fields</code> option.
+ */
+class regex_parser : public log_parser {
+public:
+    regex_parser();
+    ~regex_parser();
+    bool compile(const std::string &pattern,
+		 const std::vector<std::string> &names,
+		 std::string &error);
+    size_t parse(const char *line, size_t len, std::vector<log_field> &fields);
+
+private:
+    regex_t regex_;
+    bool compiled_;
+    std::vector<std::string> names_;
+    std::vector<regmatch_t> matches_;
+    std::string scratch_;
+};
+
+std::vector<std::string> split_list(const std::string &list, char separator);
+
+#endif //LOG_PARSER_HPP
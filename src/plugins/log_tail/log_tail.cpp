@@ -0,0 +1,368 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "log_tail.hpp"
+
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR ""
+#endif
+
+//Bounds of the log_tail type (see log_tail.xml)
+#define LOG_TAIL_MAX_RECORDS 256
+#define LOG_TAIL_MAX_FIELDS 32
+#define LOG_TAIL_MAX_RAW_LENGTH 2048
+#define LOG_TAIL_MAX_NAME_LENGTH 64
+#define LOG_TAIL_MAX_VALUE_LENGTH 1024
+#define LOG_TAIL_MAX_PATH_LENGTH 256
+
+using namespace std;
+
+/**
+ * @brief Constructor of the log_tail class.
+ *
+ * Constructor of the log_tail class.
+ * @param plugin_id Name of the plugin.
+ * @param properties Map of properties (log sources, batch size...).
+ */
+log_tail::log_tail(string plugin_id,
+		   map<string,string> properties)
+    : matcher_(NULL),
+      records_(NULL, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT),
+      records_bound_(false),
+      batch_count_(0),
+      batch_offset_(-1)
+{
+    if(!initialize_plugin(properties))
+	throw runtime_error("log_tail plugin could not be initialized");
+}
+
+/**
+ * @brief Destructor of the log_tail class.
+ *
+ * Destructor of the log_tail class.
+ */
+log_tail::~log_tail()
+{
+    for(size_t i = 0; i < sources_.size(); i++)
+	delete sources_[i].parser;
+    delete matcher_;
+    sigar_close(sig_);
+}
+
+
+/**
+ * @brief Initializes the requirements of the plugin.
+ *
+ * Builds a log source (glob and parser) for every
+ * <code>source.&lt;label&gt;.glob</code> property and starts following the
+ * matching files. Per-source options are <code>parser</code> (raw, csv, kv or
+ * regex), <code>fields</code>, <code>delimiter</code> and <code>pattern</code>.
+ * General options are <code>batch_lines</code>, <code>start_at</code>
+ * (end or beginning), <code>include_raw</code> and <code>signatures</code>
+ * (signature file, relative to the Cave Canem directory unless absolute).
+ * @param properties Map of properties.
+ */
+bool log_tail::initialize_plugin(map<string,string> properties)
+{
+    if(sigar_open(&sig_) != 0)
+	return false;
+
+    sigar_net_info_t net_info;
+    sigar_net_info_get(sig_, &net_info);
+    strcpy(hostname_,net_info.host_name);
+
+    batch_lines_ = 128;
+    if(!properties["batch_lines"].empty())
+	batch_lines_ = atoi(properties["batch_lines"].c_str());
+    if(batch_lines_ == 0 || batch_lines_ > LOG_TAIL_MAX_RECORDS)
+	batch_lines_ = LOG_TAIL_MAX_RECORDS;
+
+    include_raw_ = properties["include_raw"] != "false";
+    bool from_end = properties["start_at"] != "beginning";
+
+    //Gather the options of every source.<label>.<option> property
+    map<string, map<string, string> > source_options;
+    for(map<string,string>::iterator it = properties.begin();
+	it != properties.end(); ++it) {
+	if(it->first.compare(0, 7, "source.") != 0)
+	    continue;
+	size_t dot = it->first.find('.', 7);
+	if(dot == string::npos)
+	    continue;
+	source_options[it->first.substr(7, dot - 7)][it->first.substr(dot + 1)] = it->second;
+    }
+
+    for(map<string, map<string, string> >::iterator it = source_options.begin();
+	it != source_options.end(); ++it) {
+	log_source source;
+	source.label = it->first;
+	source.glob = it->second["glob"];
+	if(source.glob.empty()) {
+	    cerr << "log_tail: source " << source.label << " has no glob" << endl;
+	    return false;
+	}
+
+	string error;
+	source.parser = log_parser::create(it->second["parser"], it->second, error);
+	if(source.parser == NULL) {
+	    cerr << "log_tail: source " << source.label << ": " << error << endl;
+	    return false;
+	}
+
+	sources_.push_back(source);
+	tailer_.add_glob(source.glob, (int) sources_.size() - 1);
+    }
+
+    if(sources_.empty())
+	cerr << "log_tail: no log sources configured" << endl;
+
+    string signatures = properties["signatures"];
+    if(!signatures.empty()) {
+	if(signatures[0] != '/')
+	    signatures = string(CAVECANEM_DIR) + "/" + signatures;
+	string error;
+	matcher_ = new signature_matcher();
+	if(!matcher_->load_file(signatures, error)) {
+	    cerr << "log_tail: " << error << endl;
+	    return false;
+	}
+	matcher_->compile();
+	if(matcher_->unanchored_count() > 0)
+	    cerr << "log_tail: " << matcher_->unanchored_count()
+		 << " signatures have no literal and run on every line" << endl;
+    }
+
+    tailer_.start(from_end);
+    last_rescan_ = time(NULL);
+    return true;
+}
+
+/**
+ * @brief Returns the inotify descriptor so that the plugin manager wakes
+ * the plugin up as soon as a followed file changes.
+ */
+int log_tail::wakeup_descriptor()
+{
+    return tailer_.descriptor();
+}
+
+/**
+ * @brief Reads the new lines of the followed files and publishes them.
+ *
+ * Consumes the pending inotify events, looks for new or rotated files when
+ * needed (and at most once a second otherwise) and reads every file up to
+ * its end. Lines are published in batches of up to <code>batch_lines</code>
+ * lines of a single file using the method <code>publish_information</code>
+ * -- defined and implemented in the base class.
+ * @param writer DDS Dynamic DataWriter.
+ * @param data DDS Dynamic DataWriter to fill--using DDS Dynamic Data methods.
+ *
+ * @return True if everything was right.
+ */
+bool log_tail::generate_and_publish_information(DDSDynamicDataWriter *writer,
+						DDS_DynamicData *data)
+{
+    writer_ = writer;
+    data_ = data;
+    ok_ = true;
+
+    timestamp_ = time(NULL);
+    if(tailer_.drain_events() || timestamp_ != last_rescan_) {
+	tailer_.rescan();
+	last_rescan_ = timestamp_;
+    }
+
+    tailer_.read_all(*this);
+
+    return ok_;
+}
+
+/**
+ * @brief Starts a batch for a file that has new lines.
+ */
+void log_tail::begin_file(const tailed_file &file)
+{
+    data_->clear_all_members();
+
+    data_->set_string("hostname",
+		      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      hostname_);
+
+    data_->set_string("path",
+		      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      terminate(file.path.data(), file.path.size(), LOG_TAIL_MAX_PATH_LENGTH));
+
+    data_->set_string("source",
+		      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		      sources_[file.source].label.c_str());
+
+    data_->set_longlong("inode",
+			DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			(DDS_LongLong) file.ino);
+
+    if(data_->bind_complex_member(records_, "records",
+				  DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK) {
+	cerr << "log_tail: cannot bind records" << endl;
+	ok_ = false;
+	return;
+    }
+    records_bound_ = true;
+    batch_count_ = 0;
+    batch_offset_ = -1;
+}
+
+/**
+ * @brief Appends a line to the current batch, publishing it when it is full.
+ */
+void log_tail::line(const tailed_file &file, const char *line, size_t len, off_t offset)
+{
+    if(matcher_ != NULL)
+	match_signatures(file, line, len);
+
+    if(!records_bound_)
+	return;
+
+    if(batch_count_ == batch_lines_) {
+	flush_batch();
+	begin_file(file);
+	if(!records_bound_)
+	    return;
+    }
+
+    if(batch_offset_ < 0)
+	batch_offset_ = offset;
+
+    DDS_DynamicData record(NULL, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+    if(records_.bind_complex_member(record, NULL, batch_count_ + 1) != DDS_RETCODE_OK) {
+	ok_ = false;
+	return;
+    }
+
+    record.set_longlong("offset",
+			DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			offset);
+
+    if(include_raw_)
+	record.set_string("raw",
+			  DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			  terminate(line, len, LOG_TAIL_MAX_RAW_LENGTH));
+
+    size_t count = sources_[file.source].parser->parse(line, len, fields_);
+    if(count > 0) {
+	DDS_DynamicData fields(NULL, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+	if(record.bind_complex_member(fields, "fields",
+				      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) == DDS_RETCODE_OK) {
+	    for(size_t i = 0; i < count && i < LOG_TAIL_MAX_FIELDS; i++) {
+		DDS_DynamicData field(NULL, DDS_DYNAMIC_DATA_PROPERTY_DEFAULT);
+		if(fields.bind_complex_member(field, NULL, i + 1) != DDS_RETCODE_OK)
+		    break;
+		field.set_string("name",
+				 DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+				 terminate(fields_[i].name, fields_[i].name_len,
+					   LOG_TAIL_MAX_NAME_LENGTH));
+		field.set_string("value",
+				 DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+				 terminate(fields_[i].value, fields_[i].value_len,
+					   LOG_TAIL_MAX_VALUE_LENGTH));
+		fields.unbind_complex_member(field);
+	    }
+	    record.unbind_complex_member(fields);
+	}
+    }
+
+    records_.unbind_complex_member(record);
+    batch_count_++;
+}
+
+/**
+ * @brief Raises an alert for every signature found in a line.
+ */
+void log_tail::match_signatures(const tailed_file &file, const char *line, size_t len)
+{
+    if(matcher_->match(line, len, hits_) == 0)
+	return;
+
+    for(size_t i = 0; i < hits_.size(); i++) {
+	cc_alert alert;
+	alert.rule = hits_[i].sig->id;
+	alert.severity = hits_[i].sig->severity;
+	alert.message = "signature " + hits_[i].sig->id + " found in " + file.path;
+	alert.subject.assign(line, len);
+	raise_alert(alert);
+    }
+}
+
+/**
+ * @brief Publishes what is left of the batch of a file.
+ */
+void log_tail::end_file(const tailed_file &file)
+{
+    flush_batch();
+}
+
+/**
+ * @brief Publishes the current batch, if it has any line.
+ */
+void log_tail::flush_batch()
+{
+    if(!records_bound_)
+	return;
+
+    data_->unbind_complex_member(records_);
+    records_bound_ = false;
+
+    if(batch_count_ == 0)
+	return;
+
+    data_->set_longlong("first_offset",
+			DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			batch_offset_);
+
+    data_->set_long("line_count",
+		    DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+		    batch_count_);
+
+    stamp_tick(data_);
+
+    if(!publish_information(writer_, data_))
+	ok_ = false;
+
+    batch_count_ = 0;
+}
+
+/**
+ * @brief Returns a NUL-terminated copy of a string view, truncated to the
+ * bound of the member it is going to be stored in.
+ *
+ * The copy lives in a scratch buffer, so it is only valid until the next call.
+ */
+const char *log_tail::terminate(const char *value, size_t len, size_t max_len)
+{
+    if(len > max_len)
+	len = max_len;
+    if(scratch_.size() < len + 1)
+	scratch_.resize(len + 1);
+    memcpy(&scratch_[0], value, len);
+    scratch_[len] = '\0';
+    return &scratch_[0];
+}
@@ -0,0 +1,138 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOG_TAIL_HPP
+#define LOG_TAIL_HPP
+
+#ifdef WIN32
+#define DLL_EXPORTS __declspec(dllexport)
+#else
+#define DLL_EXPORTS
+#endif
+
+#include <ctime>
+#include <map>
+#include <vector>
+extern "C" {
+#include <sigar.h>
+}
+#include <plugin.hpp>
+
+#include "file_tailer.hpp"
+#include "log_parser.hpp"
+#include "signature_matcher.hpp"
+
+/**
+ * @class log_source
+ * A set of files (given by a glob) sharing the same line parser.
+ */
+struct log_source {
+    std::string label;
+    std::string glob;
+    log_parser *parser;
+};
+
+/**
+ * @class log_tail
+ * This class defines the log_tail plugin. The objective of this plugin is to
+ * follow log files (auth.log, audit.log, application logs...) and publish
+ * their new lines as structured samples. Each sample carries a batch of
+ * consecutive lines of one file, every line split into fields by the parser
+ * of its log source.
+ *
+ * The plugin is event-driven: it returns its inotify descriptor from
+ * wakeup_descriptor(), so new lines are published as soon as they are
+ * written instead of waiting for the publishing period.
+ *
+ * If a signature file is configured every line is also matched against it,
+ * and matching lines raise alerts.
+ */
+class DLL_EXPORTS log_tail : public cc_plugin, public tail_handler {
+ public:
+
+    log_tail(std::string plugin_id,
+	     std::map<std::string,std::string> properties);
+    virtual ~log_tail();
+
+    bool generate_and_publish_information(DDSDynamicDataWriter *writer,
+					  DDS_DynamicData *data);
+
+    int wakeup_descriptor();
+
+    virtual std::string plugin_class()
+    {
+	return "log_tail";
+    }
+
+    //tail_handler
+    void begin_file(const tailed_file &file);
+    void line(const tailed_file &file, const char *line, size_t len, off_t offset);
+    void end_file(const tailed_file &file);
+
+ private:
+    bool initialize_plugin(std::map<std::string, std::string> properties);
+    void flush_batch();
+    void match_signatures(const tailed_file &file, const char *line, size_t len);
+    const char *terminate(const char *value, size_t len, size_t max_len);
+
+    sigar_t *sig_;
+    file_tailer tailer_;
+    std::vector<log_source> sources_;
+    std::vector<log_field> fields_;
+    std::vector<char> scratch_;
+
+    signature_matcher *matcher_;
+    std::vector<signature_hit> hits_;
+
+    unsigned int batch_lines_;
+    bool include_raw_;
+
+    //Batch being filled while read_all() runs
+    DDSDynamicDataWriter *writer_;
+    DDS_DynamicData *data_;
+    DDS_DynamicData records_;
+    bool records_bound_;
+    unsigned int batch_count_;
+    long long batch_offset_;
+    bool ok_;
+
+    long timestamp_;
+    time_t last_rescan_;
+    char hostname_[SIGAR_MAXHOSTNAMELEN];
+
+};
+
+/**
+ * @brief Defines the "C" create function of the plugin create_log_tail
+ * (class factory).
+ *
+ * Defines the "C" create function of the plugin log_tail. It returns a new
+ * object of the class <code>log_tail</code>.
+ * @param plugin_id The name of the plugin
+ * @param properties Map of the properties of the plugin.
+ *
+ * @return
+ */
+extern "C" DLL_EXPORTS cc_plugin* create_log_tail(std::string plugin_id,
+				     std::map<std::string,std::string> properties) {
+    return new log_tail(plugin_id,properties);
+}
+
+#endif //LOG_TAIL_HPP
@@ -62,7 +62,6 @@ private:
     sigar_t *sig_;
     sigar_mem_t mem_info_;
     sigar_swap_t swap_info_;
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
     
 };
@@ -47,6 +47,9 @@ net_load::net_load(string plugin_id,
 net_load::~net_load()
 {
     // Customize if needed
+#ifdef CAVECANEM_PROCFS
+    delete procfs_;
+#endif
     sigar_close(sig_);
 }
 
@@ -55,7 +58,8 @@ net_load::~net_load()
  * @brief Initializes the requirements of the plugin.
  * 
  * Initializes all the stuff required by the plugin.
- * @param properties Map of properties (will be empty in this plugin).
+ * @param properties Map of properties. The optional <code>procfs_root</code>
+ * property names a procfs tree to read instead of /proc (Linux only).
  */
 bool net_load::initialize_plugin(map<string,string> properties) 
 {
@@ -66,6 +70,12 @@ bool net_load::initialize_plugin(map<string,string> properties)
     sigar_net_info_get(sig_, &net_info);
     
     strcpy(hostname_,net_info.host_name);
+
+#ifdef CAVECANEM_PROCFS
+    procfs_ = NULL;
+    if(!properties["procfs_root"].empty())
+	procfs_ = new procfs_reader(properties["procfs_root"]);
+#endif
     
     return true;
 }
@@ -91,9 +101,19 @@ bool net_load::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		     hostname_);
 
 
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ != NULL)
+	procfs_->net_interface_list_get(&iflist_);
+    else
+#endif
     sigar_net_interface_list_get(sig_,&iflist_);
   
     for(unsigned int i = 0; i < iflist_.number; i++) {
+#ifdef CAVECANEM_PROCFS
+	if(procfs_ != NULL)
+	    procfs_->net_interface_config_get(iflist_.data[i],&ifconfig_);
+	else
+#endif
 	sigar_net_interface_config_get(sig_,iflist_.data[i],&ifconfig_);
 	
 	//Interface config
@@ -149,6 +169,11 @@ bool net_load::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		       ifconfig_.metric);
 
 	//Interface Stat	
+#ifdef CAVECANEM_PROCFS
+	if(procfs_ != NULL)
+	    procfs_->net_interface_stat_get(iflist_.data[i],&ifstat_);
+	else
+#endif
 	sigar_net_interface_stat_get(sig_,iflist_.data[i],&ifstat_);
 	
 	//received
@@ -202,16 +227,16 @@ bool net_load::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 		       ifstat_.tx_carrier);
 
-	timestamp_ = time(NULL);
-	data->set_long("ts",
-		       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
-		       timestamp_);
+	stamp_tick(data);
 	
 	if(!publish_information(writer, data))
 	    return false;
 	
     }
 
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ == NULL)
+#endif
     sigar_net_interface_list_destroy(sig_,&iflist_);
     return true;
     
@@ -34,6 +34,9 @@ extern "C" {
 #include <sigar_format.h>
 }
 #include <plugin.hpp>
+#ifdef CAVECANEM_PROCFS
+#include "procfs_reader.hpp"
+#endif
 
 /** 
  * @class net_load
@@ -58,11 +61,13 @@ class DLL_EXPORTS net_load : public cc_plugin {
 
  private:
     bool initialize_plugin(std::map<std::string, std::string> properties);  
+#ifdef CAVECANEM_PROCFS
+    procfs_reader *procfs_;
+#endif
     sigar_t *sig_;
     sigar_net_interface_list_t iflist_;
     sigar_net_interface_config_t ifconfig_;
     sigar_net_interface_stat_t ifstat_;
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
 
 };
@@ -18,8 +18,14 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>. 
  */
 
+#include <cstdio>
+#include <algorithm>
+
 #include "proc.hpp"
 
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR ""
+#endif
 
 using namespace std;
 
@@ -32,6 +38,9 @@ using namespace std;
  */
 proc::proc(string plugin_id,
 		   map<string,string> properties)
+#ifdef CAVECANEM_MATCHER
+    : matcher_(NULL)
+#endif
 {
     // Customize if needed
     if(!initialize_plugin(properties))
@@ -47,6 +56,12 @@ proc::proc(string plugin_id,
 proc::~proc()
 {
     // Customize if needed
+#ifdef CAVECANEM_MATCHER
+    delete matcher_;
+#endif
+#ifdef CAVECANEM_PROCFS
+    delete procfs_;
+#endif
     sigar_close(sig_);
 }
 
@@ -55,7 +70,11 @@ proc::~proc()
  * @brief Initializes the requirements of the plugin.
  * 
  * Initializes all the stuff required by the plugin.
- * @param properties Map of properties (will be empty in this plugin).
+ * @param properties Map of properties. The optional <code>signatures</code>
+ * property names a signature file (relative to the Cave Canem directory
+ * unless absolute) to match the command lines of new processes against. The
+ * optional <code>procfs_root</code> property names a procfs tree to read
+ * instead of /proc (Linux only).
  */
 bool proc::initialize_plugin(map<string,string> properties) 
 {
@@ -66,10 +85,76 @@ bool proc::initialize_plugin(map<string,string> properties)
     sigar_net_info_get(sig_, &net_info);
     
     strcpy(hostname_,net_info.host_name);
+
+#ifdef CAVECANEM_PROCFS
+    procfs_ = NULL;
+    if(!properties["procfs_root"].empty())
+	procfs_ = new procfs_reader(properties["procfs_root"]);
+#endif
+
+#ifdef CAVECANEM_MATCHER
+    string signatures = properties["signatures"];
+    if(!signatures.empty()) {
+	if(signatures[0] != '/')
+	    signatures = string(CAVECANEM_DIR) + "/" + signatures;
+	string error;
+	matcher_ = new signature_matcher();
+	if(!matcher_->load_file(signatures, error)) {
+	    cerr << "proc: " << error << endl;
+	    return false;
+	}
+	matcher_->compile();
+    }
+#endif
     
     return true;
 }
 
+#ifdef CAVECANEM_MATCHER
+/** 
+ * @brief Matches the command line of a process against the signatures.
+ * 
+ * The arguments are joined with spaces; if they cannot be read (e.g. kernel
+ * threads or processes of other users) the process name is matched instead.
+ * @param pid PID of the process.
+ * @param name Name of the process.
+ */
+void proc::match_signatures(sigar_pid_t pid, const char *name)
+{
+    string command_line;
+    sigar_proc_args_t procargs;
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ != NULL)
+	procfs_->proc_cmdline_get(pid, command_line);
+    else
+#endif
+    if(sigar_proc_args_get(sig_, pid, &procargs) == SIGAR_OK) {
+	for(unsigned long i = 0; i < procargs.number; i++) {
+	    if(i > 0)
+		command_line += ' ';
+	    command_line += procargs.data[i];
+	}
+	sigar_proc_args_destroy(sig_, &procargs);
+    }
+    if(command_line.empty())
+	command_line = name;
+
+    if(matcher_->match(command_line.data(), command_line.size(), hits_) == 0)
+	return;
+
+    char pid_string[32];
+    sprintf(pid_string, "%lu", (unsigned long) pid);
+    for(size_t i = 0; i < hits_.size(); i++) {
+	cc_alert alert;
+	alert.rule = hits_[i].sig->id;
+	alert.severity = hits_[i].sig->severity;
+	alert.message = "signature " + hits_[i].sig->id + " found in process " + pid_string;
+	alert.subject = command_line;
+	raise_alert(alert);
+    }
+}
+#endif
+
 /** 
  * @brief Gets the list of the processes of a machine and publishes their 
  * status.
@@ -91,11 +176,24 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		     hostname_);
 
 
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ != NULL)
+	procfs_->proc_list_get(&proclist_);
+    else
+#endif
     sigar_proc_list_get(sig_,&proclist_);
+#ifdef CAVECANEM_MATCHER
+    current_pids_.clear();
+#endif
   
     for(unsigned int i = 0; i < proclist_.number; i++) {
 	
 	//State
+#ifdef CAVECANEM_PROCFS
+	if(procfs_ != NULL)
+	    procfs_->proc_state_get(proclist_.data[i],&procstate_);
+	else
+#endif
 	sigar_proc_state_get(sig_,proclist_.data[i],&procstate_);
 		
 	data->set_long("pid",
@@ -106,6 +204,15 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 			 DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 			 procstate_.name);
 
+#ifdef CAVECANEM_MATCHER
+	//Only new processes are matched
+	if(matcher_ != NULL) {
+	    current_pids_.push_back(proclist_.data[i]);
+	    if(!binary_search(known_pids_.begin(), known_pids_.end(), proclist_.data[i]))
+		match_signatures(proclist_.data[i], procstate_.name);
+	}
+#endif
+
 	data->set_char("state",
 		       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 		       procstate_.state);
@@ -131,6 +238,11 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		       procstate_.nice);
 	
 	//Cred
+#ifdef CAVECANEM_PROCFS
+	if(procfs_ != NULL)
+	    procfs_->proc_cred_get(proclist_.data[i],&proccred_);
+	else
+#endif
 	sigar_proc_cred_get(sig_,proclist_.data[i],&proccred_);
 
 	data->set_long("uid",
@@ -149,8 +261,25 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 		       proccred_.egid);
 
-	//Cred name
-	sigar_proc_cred_name_get(sig_,proclist_.data[i],&proccredname_);
+	//Cred name, looked up once per uid and gid: sigar reads the user and
+	//group databases on every call
+	pair<sigar_uid_t, sigar_gid_t> ids(proccred_.uid, proccred_.gid);
+	map<pair<sigar_uid_t, sigar_gid_t>, sigar_proc_cred_name_t>::iterator names =
+	    cred_names_.find(ids);
+	if(names == cred_names_.end()) {
+	    int status;
+#ifdef CAVECANEM_PROCFS
+	    if(procfs_ != NULL)
+		status = procfs_->proc_cred_name_get(proclist_.data[i],&proccredname_);
+	    else
+#endif
+	    status = sigar_proc_cred_name_get(sig_,proclist_.data[i],&proccredname_);
+	    if(status == SIGAR_OK)
+		cred_names_[ids] = proccredname_;
+	}
+	else {
+	    proccredname_ = names->second;
+	}
 	data->set_string("user",
 			 DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
 			 proccredname_.user);
@@ -161,6 +290,11 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 			 
 	
 	//CPU
+#ifdef CAVECANEM_PROCFS
+	if(procfs_ != NULL)
+	    procfs_->proc_cpu_get(proclist_.data[i],&proccpu_);
+	else
+#endif
 	sigar_proc_cpu_get(sig_,proclist_.data[i],&proccpu_);
 
 	data->set_longlong("cpu_start_time",
@@ -189,6 +323,11 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 
 	
 	//Stat
+#ifdef CAVECANEM_PROCFS
+	if(procfs_ != NULL)
+	    procfs_->proc_mem_get(proclist_.data[i],&procmem_);
+	else
+#endif
 	sigar_proc_mem_get(sig_,proclist_.data[i],&procmem_);
 
 	data->set_long("mem_size",
@@ -216,17 +355,21 @@ bool proc::generate_and_publish_information(DDSDynamicDataWriter *writer,
 		       procmem_.page_faults);
 
 
-	timestamp_ = time(NULL);
-	data->set_long("ts",
-		       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
-		       timestamp_);
+	stamp_tick(data);
 	
 	if(!publish_information(writer, data))
 	    return false;
 	
     }
 
+#ifdef CAVECANEM_PROCFS
+    if(procfs_ == NULL)
+#endif
     sigar_proc_list_destroy(sig_,&proclist_);
+#ifdef CAVECANEM_MATCHER
+    sort(current_pids_.begin(), current_pids_.end());
+    known_pids_.swap(current_pids_);
+#endif
     return true;
     
 }
@@ -29,11 +29,19 @@
 
 #include <ctime>
 #include <map>
+#include <utility>
+#include <vector>
 extern "C" {
 #include <sigar.h>
 #include <sigar_format.h>
 }
 #include <plugin.hpp>
+#ifdef CAVECANEM_MATCHER
+#include "signature_matcher.hpp"
+#endif
+#ifdef CAVECANEM_PROCFS
+#include "procfs_reader.hpp"
+#endif
 
 
 /** 
@@ -41,6 +49,9 @@ extern "C" {
  * This class defines the proc plugin. The objective of this plugin is to 
  * get and publish the status of the processes running on a machine. To achieve
  * this objetive it uses the Hyperic Sigar library.
+ *
+ * If a signature file is configured, the command line of every new process
+ * is matched against it and matching processes raise alerts.
  */
 class DLL_EXPORTS proc : public cc_plugin {
  public:
@@ -59,15 +70,27 @@ class DLL_EXPORTS proc : public cc_plugin {
 
  private:
     bool initialize_plugin(std::map<std::string, std::string> properties);  
+#ifdef CAVECANEM_MATCHER
+    void match_signatures(sigar_pid_t pid, const char *name);
+
+    signature_matcher *matcher_;
+    std::vector<signature_hit> hits_;
+    //Sorted; swapped every run so that their memory is reused
+    std::vector<sigar_pid_t> known_pids_;
+    std::vector<sigar_pid_t> current_pids_;
+#endif
+#ifdef CAVECANEM_PROCFS
+    procfs_reader *procfs_;
+#endif
     sigar_t *sig_;
     sigar_proc_list_t proclist_;
     sigar_proc_state_t procstate_;
     sigar_proc_mem_t procmem_;
     sigar_proc_cred_t proccred_;
     sigar_proc_cred_name_t proccredname_;
+    std::map<std::pair<sigar_uid_t, sigar_gid_t>, sigar_proc_cred_name_t> cred_names_;
     sigar_proc_cpu_t proccpu_;
 
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
 
 };
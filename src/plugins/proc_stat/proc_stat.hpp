@@ -60,7 +60,6 @@ class DLL_EXPORTS proc_stat : public cc_plugin {
     bool initialize_plugin(std::map<std::string, std::string> properties);  
     sigar_t *sig_;
     sigar_proc_stat_t procstat_;
-    long timestamp_;
     char hostname_[SIGAR_MAXHOSTNAMELEN];
 
 };
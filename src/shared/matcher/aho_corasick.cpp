@@ -0,0 +1,348 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <queue>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AHO_CORASICK_SSE2
+#endif
+
+#include "aho_corasick.hpp"
+
+using namespace std;
+
+/**
+ * @brief Returns how common a (folded) byte is in log lines and command
+ * lines. The prefilter anchors every pattern on its least common byte.
+ */
+static int byte_frequency(unsigned char c)
+{
+    static const char letters[] = "etaoinsrhldcumfpgwybvkxjqz";
+    if(c == ' ')
+	return 100;
+    if(c >= '0' && c <= '9')
+	return 80;
+    const char *letter = (const char *) memchr(letters, c, sizeof(letters) - 1);
+    if(letter != NULL)
+	return 70 - (int) (letter - letters) * 2;
+    if(strchr(":./-=[]()_,\"'", c) != NULL && c != '\0')
+	return 40;
+    return 0;
+}
+
+
+aho_corasick::aho_corasick()
+    : compiled_(false),
+      class_count_(0),
+      state_count_(0),
+      prefilter_(false),
+      pair_prefilter_(false)
+{
+    memset(classes_, 0, sizeof(classes_));
+    memset(anchor_table_, 0, sizeof(anchor_table_));
+}
+
+/**
+ * @brief Adds a pattern to the automaton.
+ *
+ * Patterns must be added before compile(). Empty patterns never match.
+ * @param pattern The literal to look for.
+ *
+ * @return The identifier of the pattern, reported in the hits.
+ */
+unsigned int aho_corasick::add_pattern(const string &pattern)
+{
+    patterns_.push_back(pattern);
+    compiled_ = false;
+    return (unsigned int) patterns_.size() - 1;
+}
+
+/**
+ * @brief Builds the automaton and the prefilter.
+ *
+ * Builds the trie of the (folded) patterns, then fills the missing
+ * transitions breadth-first from the failure links so that scanning never
+ * follows a failure link. The outputs of every state include those of its
+ * failure state.
+ */
+void aho_corasick::compile()
+{
+    //Byte classes: 0 for bytes no pattern uses
+    memset(classes_, 0, sizeof(classes_));
+    class_count_ = 1;
+    for(size_t i = 0; i < patterns_.size(); i++) {
+	for(size_t j = 0; j < patterns_[i].size(); j++) {
+	    unsigned char c = fold((unsigned char) patterns_[i][j]);
+	    if(classes_[c] == 0)
+		classes_[c] = (unsigned char) class_count_++;
+	}
+    }
+    for(unsigned int c = 'A'; c <= 'Z'; c++)
+	classes_[c] = classes_[fold((unsigned char) c)];
+
+    //Trie
+    const unsigned int none = (unsigned int) -1;
+    vector<vector<unsigned int> > own(1);
+    next_.assign(class_count_, none);
+    state_count_ = 1;
+
+    for(size_t i = 0; i < patterns_.size(); i++) {
+	if(patterns_[i].empty())
+	    continue;
+	unsigned int state = 0;
+	for(size_t j = 0; j < patterns_[i].size(); j++) {
+	    unsigned int c = classes_[(unsigned char) patterns_[i][j]];
+	    if(next_[state * class_count_ + c] == none) {
+		next_[state * class_count_ + c] = state_count_++;
+		next_.resize(state_count_ * class_count_, none);
+		own.push_back(vector<unsigned int>());
+	    }
+	    state = next_[state * class_count_ + c];
+	}
+	own[state].push_back((unsigned int) i);
+    }
+
+    //Failure links, full transitions and flattened outputs (breadth-first,
+    //so a state's failure state is always complete before the state itself)
+    vector<unsigned int> fail(state_count_, 0);
+    vector<unsigned int> order;
+    queue<unsigned int> pending;
+
+    for(unsigned int c = 0; c < class_count_; c++) {
+	unsigned int child = next_[c];
+	if(child == none) {
+	    next_[c] = 0;
+	}
+	else {
+	    fail[child] = 0;
+	    pending.push(child);
+	}
+    }
+
+    order.push_back(0);
+    while(!pending.empty()) {
+	unsigned int state = pending.front();
+	pending.pop();
+	order.push_back(state);
+	for(unsigned int c = 0; c < class_count_; c++) {
+	    unsigned int child = next_[state * class_count_ + c];
+	    if(child == none) {
+		next_[state * class_count_ + c] = next_[fail[state] * class_count_ + c];
+	    }
+	    else {
+		fail[child] = next_[fail[state] * class_count_ + c];
+		pending.push(child);
+	    }
+	}
+    }
+
+    vector<unsigned int> start(state_count_), count(state_count_);
+    outputs_.clear();
+    for(size_t i = 0; i < order.size(); i++) {
+	unsigned int state = order[i];
+	start[state] = (unsigned int) outputs_.size();
+	outputs_.insert(outputs_.end(), own[state].begin(), own[state].end());
+	if(state != 0) {
+	    unsigned int f = fail[state];
+	    for(unsigned int k = 0; k < count[f]; k++) {
+		unsigned int inherited = outputs_[start[f] + k];
+		outputs_.push_back(inherited);
+	    }
+	}
+	count[state] = (unsigned int) outputs_.size() - start[state];
+    }
+
+    //Renumber the outputs by state so that scan() only needs one offset array
+    vector<unsigned int> flat;
+    flat.reserve(outputs_.size());
+    output_offset_.assign(state_count_ + 1, 0);
+    for(unsigned int state = 0; state < state_count_; state++) {
+	output_offset_[state] = (unsigned int) flat.size();
+	flat.insert(flat.end(), outputs_.begin() + start[state],
+		    outputs_.begin() + start[state] + count[state]);
+    }
+    output_offset_[state_count_] = (unsigned int) flat.size();
+    outputs_.swap(flat);
+
+    //Pre-scale the transitions to row offsets and flag the targets with
+    //outputs in the low bit, so scanning needs neither a multiplication
+    //nor an output lookup per byte
+    for(size_t i = 0; i < next_.size(); i++) {
+	unsigned int target = next_[i];
+	bool output = output_offset_[target + 1] != output_offset_[target];
+	next_[i] = (target * class_count_) << 1 | (output ? 1 : 0);
+    }
+
+    //Prefilter anchors: the rarest byte of every pattern
+    anchors_.clear();
+    memset(anchor_table_, 0, sizeof(anchor_table_));
+    for(size_t i = 0; i < patterns_.size(); i++) {
+	if(patterns_[i].empty())
+	    continue;
+	unsigned char anchor = fold((unsigned char) patterns_[i][0]);
+	for(size_t j = 1; j < patterns_[i].size(); j++) {
+	    unsigned char c = fold((unsigned char) patterns_[i][j]);
+	    if(byte_frequency(c) < byte_frequency(anchor))
+		anchor = c;
+	}
+	if(!anchor_table_[anchor]) {
+	    anchor_table_[anchor] = true;
+	    anchors_.push_back(anchor);
+	    if(anchor >= 'a' && anchor <= 'z')
+		anchor_table_[anchor - ('a' - 'A')] = true;
+	}
+    }
+    pair_prefilter_ = anchors_.size() > AHO_CORASICK_MAX_ANCHORS;
+
+    //Too many anchors: the rarest pair of every pattern instead, under
+    //every case of its letters. Single bytes stay anchors.
+    pair_bitmap_.clear();
+    if(pair_prefilter_) {
+	anchors_.clear();
+	memset(anchor_table_, 0, sizeof(anchor_table_));
+	pair_bitmap_.resize(65536 / 8, 0);
+	for(size_t i = 0; i < patterns_.size(); i++) {
+	    const string &pattern = patterns_[i];
+	    if(pattern.size() == 1) {
+		unsigned char c = fold((unsigned char) pattern[0]);
+		anchor_table_[c] = true;
+		if(c >= 'a' && c <= 'z')
+		    anchor_table_[c - ('a' - 'A')] = true;
+		continue;
+	    }
+
+	    size_t rarest = 0;
+	    int rarest_frequency = 0;
+	    for(size_t j = 0; j + 1 < pattern.size(); j++) {
+		int frequency = byte_frequency(fold((unsigned char) pattern[j])) +
+		    byte_frequency(fold((unsigned char) pattern[j + 1]));
+		if(j == 0 || frequency < rarest_frequency) {
+		    rarest = j;
+		    rarest_frequency = frequency;
+		}
+	    }
+
+	    unsigned char first = fold((unsigned char) pattern[rarest]);
+	    unsigned char second = fold((unsigned char) pattern[rarest + 1]);
+	    for(int variant = 0; variant < 4; variant++) {
+		unsigned char a = first, b = second;
+		if((variant & 1) && a >= 'a' && a <= 'z')
+		    a -= 'a' - 'A';
+		if((variant & 2) && b >= 'a' && b <= 'z')
+		    b -= 'a' - 'A';
+		unsigned int bit = (unsigned int) a << 8 | b;
+		pair_bitmap_[bit >> 3] |= (unsigned char) (1 << (bit & 7));
+	    }
+	}
+    }
+    prefilter_ = !patterns_.empty();
+
+    compiled_ = true;
+}
+
+/**
+ * @brief Checks whether a text may contain any pattern.
+ *
+ * False positives are possible, false negatives are not.
+ */
+bool aho_corasick::may_match(const char *text, size_t len) const
+{
+    size_t i = 0;
+
+    if(pair_prefilter_) {
+	const unsigned char *bytes = (const unsigned char *) text;
+	const unsigned char *bitmap = &pair_bitmap_[0];
+	for(; i + 1 < len; i++) {
+	    unsigned int bit = (unsigned int) bytes[i] << 8 | bytes[i + 1];
+	    if((bitmap[bit >> 3] & (1 << (bit & 7))) || anchor_table_[bytes[i]])
+		return true;
+	}
+	return len > 0 && anchor_table_[bytes[len - 1]];
+    }
+
+#ifdef AHO_CORASICK_SSE2
+    if(prefilter_ && !anchors_.empty()) {
+	__m128i lower = _mm_set1_epi8(0x20);
+	__m128i needles[AHO_CORASICK_MAX_ANCHORS];
+	bool letter[AHO_CORASICK_MAX_ANCHORS];
+	size_t count = anchors_.size();
+	for(size_t k = 0; k < count; k++) {
+	    needles[k] = _mm_set1_epi8((char) anchors_[k]);
+	    letter[k] = anchors_[k] >= 'a' && anchors_[k] <= 'z';
+	}
+
+	for(; i + 16 <= len; i += 16) {
+	    __m128i block = _mm_loadu_si128((const __m128i *) (text + i));
+	    //OR-ing 0x20 folds letters; other bytes are compared unfolded
+	    __m128i folded = _mm_or_si128(block, lower);
+	    __m128i found = _mm_setzero_si128();
+	    for(size_t k = 0; k < count; k++)
+		found = _mm_or_si128(found,
+				     _mm_cmpeq_epi8(letter[k] ? folded : block, needles[k]));
+	    if(_mm_movemask_epi8(found) != 0)
+		return true;
+	}
+    }
+#endif
+
+    for(; i < len; i++)
+	if(anchor_table_[(unsigned char) text[i]])
+	    return true;
+    return false;
+}
+
+/**
+ * @brief Finds every occurrence of the patterns in a text.
+ *
+ * @param text Text to scan (not necessarily NUL-terminated).
+ * @param len Length of the text.
+ * @param hits Vector the hits are appended to, in order of their end offset.
+ *
+ * @return The number of hits appended.
+ */
+size_t aho_corasick::scan(const char *text, size_t len, vector<ac_hit> &hits) const
+{
+    if(!compiled_ || state_count_ <= 1)
+	return 0;
+    if(prefilter_ && !may_match(text, len))
+	return 0;
+
+    size_t before = hits.size();
+    const unsigned int *next = &next_[0];
+    unsigned int row = 0;
+
+    for(size_t i = 0; i < len; i++) {
+	unsigned int entry = next[row + classes_[(unsigned char) text[i]]];
+	row = entry >> 1;
+	if(entry & 1) {
+	    unsigned int state = row / class_count_;
+	    for(unsigned int k = output_offset_[state]; k < output_offset_[state + 1]; k++) {
+		ac_hit hit;
+		hit.pattern = outputs_[k];
+		hit.end = i + 1;
+		hits.push_back(hit);
+	    }
+	}
+    }
+
+    return hits.size() - before;
+}
@@ -0,0 +1,117 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AHO_CORASICK_HPP
+#define AHO_CORASICK_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+//Beyond this number of distinct anchor bytes the SIMD prefilter would let
+//almost every line through, so the byte pair prefilter is used instead.
+#define AHO_CORASICK_MAX_ANCHORS 16
+
+/**
+ * @class ac_hit
+ * An occurrence of a pattern: its identifier and the offset right past its
+ * last byte.
+ */
+struct ac_hit {
+    unsigned int pattern;
+    size_t end;
+};
+
+/**
+ * @class aho_corasick
+ * Multi-literal matcher. All the patterns are found in a single pass over the
+ * text, whatever their number, by walking a deterministic Aho-Corasick
+ * automaton. Matching is ASCII case-insensitive: callers that need exact
+ * case verify the hits themselves.
+ *
+ * The transition table is dense over byte classes (the distinct bytes used by
+ * the patterns plus one class for every other byte), so each text byte costs a
+ * table lookup and no branching on failure links.
+ *
+ * Before walking the automaton the text goes through a prefilter, which lets
+ * clean lines through without walking it:
+ *  - with few patterns, each contributes its rarest byte (its anchor) and a
+ *    text containing no anchor cannot match. There are few distinct anchors,
+ *    so the check runs 16 bytes at a time with SSE2 compares;
+ *  - beyond AHO_CORASICK_MAX_ANCHORS anchors, each pattern contributes its
+ *    rarest pair of adjacent bytes instead, kept in a 64K-bit bitmap, and
+ *    the pairs of the text are looked up in it. Pairs are far more selective
+ *    than bytes, so this scales to thousands of patterns. Patterns of a
+ *    single byte remain anchors.
+ */
+class aho_corasick {
+public:
+    aho_corasick();
+
+    unsigned int add_pattern(const std::string &pattern);
+    void compile();
+
+    size_t scan(const char *text, size_t len, std::vector<ac_hit> &hits) const;
+    bool may_match(const char *text, size_t len) const;
+
+    size_t pattern_count() const
+    {
+	return patterns_.size();
+    }
+
+    size_t state_count() const
+    {
+	return state_count_;
+    }
+
+    bool prefilter_enabled() const
+    {
+	return prefilter_;
+    }
+
+    bool pair_prefilter_enabled() const
+    {
+	return prefilter_ && pair_prefilter_;
+    }
+
+private:
+    static unsigned char fold(unsigned char c)
+    {
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    std::vector<std::string> patterns_;
+    bool compiled_;
+
+    unsigned char classes_[256];
+    unsigned int class_count_;
+    unsigned int state_count_;
+    std::vector<unsigned int> next_;          //[state * class_count_ + class] = target row << 1 | has output
+    std::vector<unsigned int> output_offset_; //state -> first output (state_count_ + 1 entries)
+    std::vector<unsigned int> outputs_;       //pattern identifiers
+
+    bool prefilter_;
+    bool pair_prefilter_;
+    std::vector<unsigned char> anchors_;
+    bool anchor_table_[256];
+    std::vector<unsigned char> pair_bitmap_;  //bit [first << 8 | second] set for the pairs of the patterns
+};
+
+#endif //AHO_CORASICK_HPP
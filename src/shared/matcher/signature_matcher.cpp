@@ -0,0 +1,377 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#include "signature_matcher.hpp"
+
+using namespace std;
+
+signature_matcher::signature_matcher()
+    : generation_(0),
+      terminated_(false)
+{
+}
+
+signature_matcher::~signature_matcher()
+{
+    for(size_t i = 0; i < regexes_.size(); i++) {
+	if(regexes_[i] != NULL) {
+	    regfree(regexes_[i]);
+	    delete regexes_[i];
+	}
+    }
+}
+
+/**
+ * @brief Adds a signature.
+ *
+ * @param id Identifier of the signature (published in the alerts).
+ * @param severity Severity of the signature.
+ * @param kind <code>lit</code>, <code>ilit</code>, <code>re</code> or <code>ire</code>.
+ * @param pattern Literal or POSIX extended regular expression.
+ * @param error Set to a description of the problem when false is returned.
+ *
+ * @return True if the signature was added.
+ */
+bool signature_matcher::add(const string &id, int severity, const string &kind,
+			    const string &pattern, string &error)
+{
+    signature sig;
+    sig.id = id;
+    sig.severity = severity;
+    sig.pattern = pattern;
+
+    if(kind == "lit" || kind == "ilit")
+	sig.regex = false;
+    else if(kind == "re" || kind == "ire")
+	sig.regex = true;
+    else {
+	error = "signature " + id + ": unknown kind '" + kind + "'";
+	return false;
+    }
+    sig.icase = kind[0] == 'i';
+
+    if(pattern.empty()) {
+	error = "signature " + id + ": empty pattern";
+	return false;
+    }
+
+    regex_t *regex = NULL;
+    if(sig.regex) {
+	regex = new regex_t;
+	int retcode = regcomp(regex, pattern.c_str(),
+			      REG_EXTENDED | REG_NOSUB | (sig.icase ? REG_ICASE : 0));
+	if(retcode != 0) {
+	    char buffer[256];
+	    regerror(retcode, regex, buffer, sizeof(buffer));
+	    delete regex;
+	    error = "signature " + id + ": " + buffer;
+	    return false;
+	}
+    }
+
+    signatures_.push_back(sig);
+    regexes_.push_back(regex);
+    return true;
+}
+
+/**
+ * @brief Loads the signatures of a file (see the class description for the
+ * format). Empty lines and lines starting with '#' are ignored.
+ *
+ * @param path Path of the signature file.
+ * @param error Set to a description of the problem (with its line number)
+ * when false is returned.
+ *
+ * @return True if every signature was loaded.
+ */
+bool signature_matcher::load_file(const string &path, string &error)
+{
+    ifstream file(path.c_str());
+    if(!file) {
+	error = "cannot open signature file " + path;
+	return false;
+    }
+
+    string line;
+    unsigned int number = 0;
+    while(getline(file, line)) {
+	number++;
+	if(!line.empty() && line[line.size() - 1] == '\r')
+	    line.erase(line.size() - 1);
+	size_t first = line.find_first_not_of(" \t");
+	if(first == string::npos || line[first] == '#')
+	    continue;
+
+	istringstream fields(line);
+	string id, severity, kind;
+	fields >> id >> severity >> kind;
+
+	string pattern;
+	getline(fields, pattern);
+	size_t start = pattern.find_first_not_of(" \t");
+	pattern = (start == string::npos) ? "" : pattern.substr(start);
+
+	if(kind.empty() || !add(id, atoi(severity.c_str()), kind, pattern, error)) {
+	    ostringstream where;
+	    where << path << ":" << number << ": "
+		  << (kind.empty() ? "expected 'id severity kind pattern'" : error);
+	    error = where.str();
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+/**
+ * @brief Builds the automaton. Must be called after the last add() and
+ * before match().
+ */
+void signature_matcher::compile()
+{
+    automaton_ = aho_corasick();
+    literal_owner_.clear();
+    literal_length_.clear();
+    always_.clear();
+
+    for(size_t i = 0; i < signatures_.size(); i++) {
+	string literal = signatures_[i].regex ?
+	    required_literal(signatures_[i].pattern) : signatures_[i].pattern;
+	if(signatures_[i].regex && literal.size() < SIGNATURE_MIN_LITERAL_LENGTH) {
+	    always_.push_back((unsigned int) i);
+	    continue;
+	}
+	automaton_.add_pattern(literal);
+	literal_owner_.push_back((unsigned int) i);
+	literal_length_.push_back(literal.size());
+    }
+
+    automaton_.compile();
+    seen_.assign(signatures_.size(), 0);
+    generation_ = 0;
+}
+
+/**
+ * @brief Matches a text against every signature.
+ *
+ * Each signature is reported at most once per text.
+ * @param text Text to match (not necessarily NUL-terminated).
+ * @param len Length of the text.
+ * @param hits Vector the matching signatures are stored into (cleared first).
+ *
+ * @return The number of matching signatures.
+ */
+size_t signature_matcher::match(const char *text, size_t len, vector<signature_hit> &hits)
+{
+    hits.clear();
+    terminated_ = false;
+    if(++generation_ == 0) {
+	seen_.assign(seen_.size(), 0);
+	generation_ = 1;
+    }
+
+    ac_hits_.clear();
+    automaton_.scan(text, len, ac_hits_);
+    for(size_t i = 0; i < ac_hits_.size(); i++) {
+	unsigned int index = literal_owner_[ac_hits_[i].pattern];
+	if(seen_[index] == generation_)
+	    continue;
+
+	const signature &sig = signatures_[index];
+	size_t offset = ac_hits_[i].end - literal_length_[ac_hits_[i].pattern];
+	if(!sig.regex) {
+	    //The automaton ignores case
+	    if(!sig.icase && memcmp(text + offset, sig.pattern.data(), sig.pattern.size()) != 0)
+		continue;
+	}
+	else {
+	    seen_[index] = generation_; //Run each regex at most once
+	    if(!confirm(index, text, len))
+		continue;
+	}
+
+	seen_[index] = generation_;
+	signature_hit hit;
+	hit.sig = &sig;
+	hit.offset = offset;
+	hits.push_back(hit);
+    }
+
+    for(size_t i = 0; i < always_.size(); i++) {
+	if(confirm(always_[i], text, len)) {
+	    signature_hit hit;
+	    hit.sig = &signatures_[always_[i]];
+	    hit.offset = 0;
+	    hits.push_back(hit);
+	}
+    }
+
+    return hits.size();
+}
+
+/**
+ * @brief Runs the regex of a signature. The text is copied (once per
+ * match() call) to NUL-terminate it, as regexec() requires.
+ */
+bool signature_matcher::confirm(size_t index, const char *text, size_t len)
+{
+    if(!terminated_) {
+	scratch_.assign(text, len);
+	terminated_ = true;
+    }
+    return regexec(regexes_[index], scratch_.c_str(), 0, NULL, 0) == 0;
+}
+
+/**
+ * @brief Extracts the longest literal every match of a regex contains.
+ *
+ * Works on POSIX extended syntax conservatively: groups, bracket expressions
+ * and anything optional break literals, and a top-level alternation means
+ * there is no required literal at all.
+ * @param regex POSIX extended regular expression.
+ *
+ * @return The literal, or an empty string if none was found.
+ */
+string signature_matcher::required_literal(const string &regex)
+{
+    size_t n = regex.size();
+
+    //A top-level alternation has no literal common to all its branches
+    int depth = 0;
+    for(size_t i = 0; i < n; i++) {
+	char c = regex[i];
+	if(c == '\\') {
+	    i++;
+	}
+	else if(c == '[') {
+	    size_t j = i + 1;
+	    if(j < n && regex[j] == '^')
+		j++;
+	    if(j < n && regex[j] == ']')
+		j++;
+	    while(j < n && regex[j] != ']')
+		j++;
+	    i = j;
+	}
+	else if(c == '(') {
+	    depth++;
+	}
+	else if(c == ')') {
+	    depth--;
+	}
+	else if(c == '|' && depth == 0) {
+	    return "";
+	}
+    }
+
+    string best, current;
+    size_t i = 0;
+    while(i < n) {
+	char c = regex[i];
+	char literal;
+
+	if(c == '\\' && i + 1 < n) {
+	    literal = regex[i + 1];
+	    i += 2;
+	    if(isalnum((unsigned char) literal)) { //\w, \b, back-references...
+		if(current.size() > best.size())
+		    best = current;
+		current.clear();
+		continue;
+	    }
+	}
+	else if(c == '[' || c == '(') {
+	    //Skip the whole bracket expression or group
+	    if(c == '[') {
+		size_t j = i + 1;
+		if(j < n && regex[j] == '^')
+		    j++;
+		if(j < n && regex[j] == ']')
+		    j++;
+		while(j < n && regex[j] != ']')
+		    j++;
+		i = j + 1;
+	    }
+	    else {
+		int level = 0;
+		size_t j = i;
+		for(; j < n; j++) {
+		    if(regex[j] == '\\')
+			j++;
+		    else if(regex[j] == '(')
+			level++;
+		    else if(regex[j] == ')' && --level == 0)
+			break;
+		}
+		i = j + 1;
+	    }
+	    if(current.size() > best.size())
+		best = current;
+	    current.clear();
+	    continue;
+	}
+	else if(c == '{') {
+	    //Quantifier of a group, class or dot
+	    size_t close = regex.find('}', i);
+	    i = (close == string::npos) ? n : close + 1;
+	    continue;
+	}
+	else if(strchr(".^$*+?)", c) != NULL) {
+	    if(current.size() > best.size())
+		best = current;
+	    current.clear();
+	    i++;
+	    continue;
+	}
+	else {
+	    literal = c;
+	    i++;
+	}
+
+	//The quantifier following the literal decides whether it is required
+	char quantifier = i < n ? regex[i] : '\0';
+	bool optional = quantifier == '*' || quantifier == '?' ||
+	    (quantifier == '{' && i + 1 < n && regex[i + 1] == '0');
+	if(!optional)
+	    current += literal;
+	if(quantifier == '*' || quantifier == '?' || quantifier == '+' || quantifier == '{') {
+	    if(current.size() > best.size())
+		best = current;
+	    current.clear();
+	    if(quantifier == '{') {
+		size_t close = regex.find('}', i);
+		i = (close == string::npos) ? n : close + 1;
+	    }
+	    else {
+		i++;
+	    }
+	}
+    }
+    if(current.size() > best.size())
+	best = current;
+
+    return best;
+}
@@ -0,0 +1,121 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIGNATURE_MATCHER_HPP
+#define SIGNATURE_MATCHER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <regex.h>
+
+#include "aho_corasick.hpp"
+
+//Regexes whose required literal is shorter than this are run on every text
+#define SIGNATURE_MIN_LITERAL_LENGTH 2
+
+/**
+ * @class signature
+ * A detection signature: a literal or a POSIX extended regular expression,
+ * optionally case-insensitive.
+ */
+struct signature {
+    std::string id;
+    int severity;
+    bool regex;
+    bool icase;
+    std::string pattern;
+};
+
+/**
+ * @class signature_hit
+ * A signature found in a text, with the offset of its literal (or of the
+ * literal that triggered its regex).
+ */
+struct signature_hit {
+    const signature *sig;
+    size_t offset;
+};
+
+/**
+ * @class signature_matcher
+ * Matches texts (log lines, command lines...) against a set of signatures in
+ * a single pass.
+ *
+ * Literal signatures go straight into an Aho-Corasick automaton. For every
+ * regex the longest literal any match must contain is extracted and added to
+ * the automaton too, so a regex only runs when its literal shows up in the
+ * text. Regexes without such a literal (top-level alternations, patterns made
+ * only of classes...) have to run on every text, so load time reports them.
+ *
+ * Signature files have one signature per line:
+ * <pre>
+ *   # id            severity  kind  pattern (rest of the line)
+ *   ssh-root-login  3         re    Accepted [a-z]+ for root from
+ *   netcat-listen   4         ilit  nc -l
+ * </pre>
+ * where kind is <code>lit</code>, <code>ilit</code> (case-insensitive),
+ * <code>re</code> or <code>ire</code>.
+ */
+class signature_matcher {
+public:
+    signature_matcher();
+    ~signature_matcher();
+
+    bool add(const std::string &id, int severity, const std::string &kind,
+	     const std::string &pattern, std::string &error);
+    bool load_file(const std::string &path, std::string &error);
+    void compile();
+
+    size_t match(const char *text, size_t len, std::vector<signature_hit> &hits);
+
+    size_t size() const
+    {
+	return signatures_.size();
+    }
+
+    size_t unanchored_count() const
+    {
+	return always_.size();
+    }
+
+    static std::string required_literal(const std::string &regex);
+
+private:
+    signature_matcher(const signature_matcher &);
+    signature_matcher &operator=(const signature_matcher &);
+
+    bool confirm(size_t index, const char *text, size_t len);
+
+    std::vector<signature> signatures_;
+    std::vector<regex_t *> regexes_;          //NULL for literals
+    std::vector<unsigned int> literal_owner_; //automaton pattern -> signature
+    std::vector<size_t> literal_length_;      //automaton pattern -> length
+    std::vector<unsigned int> always_;        //regexes without a literal
+
+    aho_corasick automaton_;
+    std::vector<ac_hit> ac_hits_;
+    std::vector<unsigned int> seen_;          //generation of the last hit
+    unsigned int generation_;
+    std::string scratch_;
+    bool terminated_;
+};
+
+#endif //SIGNATURE_MATCHER_HPP
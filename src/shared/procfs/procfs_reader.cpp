@@ -0,0 +1,708 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#include "procfs_reader.hpp"
+
+using namespace std;
+
+/**
+ * Entry returned by the getdents64 system call (glibc has no wrapper).
+ */
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+/**
+ * @brief Constructor of the procfs_reader class.
+ *
+ * Reads the boot time from the <code>stat</code> file of the tree, needed to
+ * turn process start times into epoch milliseconds.
+ * @param root Directory taking the place of /proc.
+ */
+procfs_reader::procfs_reader(const string &root)
+    : root_(root),
+      buffer_(8192),
+      length_(0),
+      boot_time_(0)
+{
+    while(root_.size() > 1 && root_[root_.size() - 1] == '/')
+	root_.erase(root_.size() - 1);
+
+    size_t slash = root_.rfind('/');
+    sys_net_ = (slash == string::npos ? string(".") : root_.substr(0, slash))
+	+ "/sys/class/net/";
+
+    ticks_per_second_ = sysconf(_SC_CLK_TCK);
+    if(ticks_per_second_ <= 0)
+	ticks_per_second_ = 100;
+    page_size_ = sysconf(_SC_PAGESIZE);
+
+    memset(&stat_, 0, sizeof(stat_));
+    stat_.pid = -1;
+
+    if(read_file(root_path("/stat")) == SIGAR_OK) {
+	const char *btime = strstr(&buffer_[0], "btime ");
+	if(btime != NULL)
+	    boot_time_ = strtoull(btime + 6, NULL, 10);
+    }
+}
+
+/**
+ * @brief Reads a whole file into the buffer, NUL-terminated.
+ *
+ * procfs files report a size of zero, so the file is read until EOF and the
+ * buffer grown as needed.
+ *
+ * @return SIGAR_OK or the errno of the failure.
+ */
+int procfs_reader::read_file(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+	return errno;
+
+    length_ = 0;
+    for(;;) {
+	if(length_ + 1 >= buffer_.size())
+	    buffer_.resize(buffer_.size() * 2);
+	ssize_t length = read(fd, &buffer_[length_], buffer_.size() - length_ - 1);
+	if(length < 0 && errno == EINTR)
+	    continue;
+	if(length < 0) {
+	    int error = errno;
+	    close(fd);
+	    return error;
+	}
+	if(length == 0)
+	    break;
+	length_ += length;
+    }
+    buffer_[length_] = '\0';
+    close(fd);
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Returns the path of a file of the tree.
+ *
+ * The path is built in a buffer kept across calls, so that reading the
+ * same files every period does not allocate; it is valid until the next
+ * call.
+ * @param file Path of the file relative to the root, starting with '/'.
+ */
+const char *procfs_reader::root_path(const char *file)
+{
+    path_.assign(root_);
+    path_.append(file);
+    return path_.c_str();
+}
+
+int procfs_reader::read_pid_file(sigar_pid_t pid, const char *file)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/%lu/%s", (unsigned long) pid, file);
+    return read_file(root_path(path));
+}
+
+/**
+ * @brief Parses /proc/[pid]/stat, unless it is the last pid parsed.
+ *
+ * The name is between the first '(' and the last ')', since it may contain
+ * both spaces and parentheses.
+ */
+int procfs_reader::pid_stat_get(sigar_pid_t pid)
+{
+    if(stat_.pid == pid)
+	return SIGAR_OK;
+
+    int status = read_pid_file(pid, "stat");
+    if(status != SIGAR_OK)
+	return status;
+
+    char *open_paren = strchr(&buffer_[0], '(');
+    char *close_paren = strrchr(&buffer_[0], ')');
+    if(open_paren == NULL || close_paren == NULL || close_paren < open_paren)
+	return EINVAL;
+
+    pid_stat fields;
+    memset(&fields, 0, sizeof(fields));
+    fields.pid = pid;
+    size_t name_len = close_paren - open_paren - 1;
+    if(name_len >= sizeof(fields.name))
+	name_len = sizeof(fields.name) - 1;
+    memcpy(fields.name, open_paren + 1, name_len);
+    fields.name[name_len] = '\0';
+
+    //Fields after the name, numbered as in proc(5) starting at 3 (state)
+    char *ptr = close_paren + 1;
+    while(*ptr == ' ')
+	ptr++;
+    fields.state = *ptr++;
+    for(int field = 4; field <= 39 && *ptr != '\0'; field++) {
+	char *end;
+	long long value = strtoll(ptr, &end, 10);
+	if(end == ptr)
+	    break;
+	ptr = end;
+	switch(field) {
+	case 4:  fields.ppid = value; break;
+	case 7:  fields.tty = (int) value; break;
+	case 10: fields.minor_faults = value; break;
+	case 12: fields.major_faults = value; break;
+	case 14: fields.utime = value; break;
+	case 15: fields.stime = value; break;
+	case 18: fields.priority = (int) value; break;
+	case 19: fields.nice = (int) value; break;
+	case 20: fields.threads = value; break;
+	case 22: fields.start_time = value; break;
+	case 23: fields.vsize = value; break;
+	case 24: fields.rss = value; break;
+	case 39: fields.processor = (int) value; break;
+	}
+    }
+
+    stat_ = fields;
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Lists the numeric entries of the root.
+ *
+ * Also forgets the cpu samples of the processes that are gone.
+ */
+int procfs_reader::proc_list_get(sigar_proc_list_t *proclist)
+{
+    //getdents64() into the read buffer: opendir() would allocate a DIR
+    int fd = open(root_.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd < 0)
+	return errno;
+
+    pids_.clear();
+    for(;;) {
+	long length = syscall(SYS_getdents64, fd, &buffer_[0], buffer_.size());
+	if(length < 0 && errno == EINTR)
+	    continue;
+	if(length < 0) {
+	    int error = errno;
+	    close(fd);
+	    return error;
+	}
+	if(length == 0)
+	    break;
+
+	for(long offset = 0; offset < length; ) {
+	    const linux_dirent64 *entry = (const linux_dirent64 *) &buffer_[offset];
+	    offset += entry->d_reclen;
+	    const char *name = entry->d_name;
+	    if(*name < '1' || *name > '9')
+		continue;
+	    char *end;
+	    unsigned long pid = strtoul(name, &end, 10);
+	    if(*end == '\0')
+		pids_.push_back(pid);
+	}
+    }
+    close(fd);
+
+    for(map<sigar_pid_t, cpu_sample>::iterator it = cpu_.begin(); it != cpu_.end(); ++it)
+	it->second.seen = false;
+    for(size_t i = 0; i < pids_.size(); i++) {
+	map<sigar_pid_t, cpu_sample>::iterator it = cpu_.find(pids_[i]);
+	if(it != cpu_.end())
+	    it->second.seen = true;
+    }
+    for(map<sigar_pid_t, cpu_sample>::iterator it = cpu_.begin(); it != cpu_.end(); ) {
+	if(it->second.seen)
+	    ++it;
+	else
+	    cpu_.erase(it++);
+    }
+
+    stat_.pid = -1;
+    proclist->number = pids_.size();
+    proclist->size = pids_.size();
+    proclist->data = pids_.empty() ? NULL : &pids_[0];
+    return SIGAR_OK;
+}
+
+int procfs_reader::proc_state_get(sigar_pid_t pid, sigar_proc_state_t *procstate)
+{
+    int status = pid_stat_get(pid);
+    if(status != SIGAR_OK)
+	return status;
+
+    strcpy(procstate->name, stat_.name);
+    procstate->state = stat_.state;
+    procstate->ppid = stat_.ppid;
+    procstate->tty = stat_.tty;
+    procstate->priority = stat_.priority;
+    procstate->nice = stat_.nice;
+    procstate->processor = stat_.processor;
+    procstate->threads = stat_.threads;
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Reads the real and effective ids from the Uid: and Gid: lines of
+ * /proc/[pid]/status.
+ */
+int procfs_reader::proc_cred_get(sigar_pid_t pid, sigar_proc_cred_t *proccred)
+{
+    int status = read_pid_file(pid, "status");
+    if(status != SIGAR_OK)
+	return status;
+
+    const char *uid = strstr(&buffer_[0], "\nUid:");
+    const char *gid = strstr(&buffer_[0], "\nGid:");
+    if(uid == NULL || gid == NULL)
+	return EINVAL;
+
+    char *end;
+    proccred->uid = strtoul(uid + 5, &end, 10);
+    proccred->euid = strtoul(end, NULL, 10);
+    proccred->gid = strtoul(gid + 5, &end, 10);
+    proccred->egid = strtoul(end, NULL, 10);
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Gets the names of the real user and group of a process.
+ *
+ * Names are looked up once per id; ids without an entry are given as
+ * numbers, like sigar does.
+ */
+int procfs_reader::proc_cred_name_get(sigar_pid_t pid,
+				      sigar_proc_cred_name_t *proccredname)
+{
+    sigar_proc_cred_t proccred;
+    int status = proc_cred_get(pid, &proccred);
+    if(status != SIGAR_OK)
+	return status;
+
+    const string &user = user_name(proccred.uid);
+    const string &group = group_name(proccred.gid);
+    snprintf(proccredname->user, sizeof(proccredname->user), "%s", user.c_str());
+    snprintf(proccredname->group, sizeof(proccredname->group), "%s", group.c_str());
+    return SIGAR_OK;
+}
+
+const string &procfs_reader::user_name(sigar_uid_t uid)
+{
+    map<sigar_uid_t, string>::iterator it = users_.find(uid);
+    if(it != users_.end())
+	return it->second;
+
+    char name[32];
+    struct passwd pwd, *result = NULL;
+    char buffer[1024];
+    if(getpwuid_r(uid, &pwd, buffer, sizeof(buffer), &result) == 0 && result != NULL)
+	return users_[uid] = result->pw_name;
+    snprintf(name, sizeof(name), "%lu", (unsigned long) uid);
+    return users_[uid] = name;
+}
+
+const string &procfs_reader::group_name(sigar_gid_t gid)
+{
+    map<sigar_gid_t, string>::iterator it = groups_.find(gid);
+    if(it != groups_.end())
+	return it->second;
+
+    char name[32];
+    struct group grp, *result = NULL;
+    char buffer[1024];
+    if(getgrgid_r(gid, &grp, buffer, sizeof(buffer), &result) == 0 && result != NULL)
+	return groups_[gid] = result->gr_name;
+    snprintf(name, sizeof(name), "%lu", (unsigned long) gid);
+    return groups_[gid] = name;
+}
+
+/**
+ * @brief Gets the cpu times of a process, in milliseconds.
+ *
+ * As in sigar, the percentage is the cpu time used since the previous call
+ * for the same process divided by the wall time elapsed; it is 0 the first
+ * time a process is seen.
+ */
+int procfs_reader::proc_cpu_get(sigar_pid_t pid, sigar_proc_cpu_t *proccpu)
+{
+    int status = pid_stat_get(pid);
+    if(status != SIGAR_OK)
+	return status;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    sigar_uint64_t now_ms = (sigar_uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+
+    proccpu->start_time = boot_time_ * 1000 + stat_.start_time * 1000 / ticks_per_second_;
+    proccpu->user = stat_.utime * 1000 / ticks_per_second_;
+    proccpu->sys = stat_.stime * 1000 / ticks_per_second_;
+    proccpu->total = proccpu->user + proccpu->sys;
+    proccpu->last_time = now_ms;
+    proccpu->percent = 0.0;
+
+    cpu_sample &sample = cpu_[pid];
+    if(sample.last_time != 0 && now_ms > sample.last_time && proccpu->total >= sample.total)
+	proccpu->percent = (double) (proccpu->total - sample.total) / (now_ms - sample.last_time);
+    sample.total = proccpu->total;
+    sample.last_time = now_ms;
+    sample.seen = true;
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Gets the memory of a process (in bytes) and its page faults.
+ *
+ * Size and resident set come from the parsed stat file; only the shared
+ * pages need /proc/[pid]/statm.
+ */
+int procfs_reader::proc_mem_get(sigar_pid_t pid, sigar_proc_mem_t *procmem)
+{
+    int status = pid_stat_get(pid);
+    if(status != SIGAR_OK)
+	return status;
+
+    procmem->size = stat_.vsize;
+    procmem->resident = stat_.rss * page_size_;
+    procmem->minor_faults = stat_.minor_faults;
+    procmem->major_faults = stat_.major_faults;
+    procmem->page_faults = stat_.minor_faults + stat_.major_faults;
+    procmem->share = 0;
+
+    if(read_pid_file(pid, "statm") == SIGAR_OK) {
+	char *end;
+	strtoull(&buffer_[0], &end, 10);
+	strtoull(end, &end, 10);
+	procmem->share = strtoull(end, NULL, 10) * page_size_;
+    }
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Gets the arguments of a process joined with spaces.
+ */
+int procfs_reader::proc_cmdline_get(sigar_pid_t pid, string &command_line)
+{
+    command_line.clear();
+    int status = read_pid_file(pid, "cmdline");
+    if(status != SIGAR_OK)
+	return status;
+
+    size_t length = length_;
+    while(length > 0 && buffer_[length - 1] == '\0')
+	length--;
+    command_line.assign(&buffer_[0], length);
+    for(size_t i = 0; i < command_line.size(); i++)
+	if(command_line[i] == '\0')
+	    command_line[i] = ' ';
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Lists the interfaces of net/dev, keeping their counters for
+ * net_interface_stat_get().
+ */
+int procfs_reader::net_interface_list_get(sigar_net_interface_list_t *iflist)
+{
+    int status = read_file(root_path("/net/dev"));
+    if(status != SIGAR_OK)
+	return status;
+
+    //The names are assigned over those of the last call, reusing their memory
+    size_t count = 0;
+
+    //Two header lines, then "name: rx(8 counters) tx(8 counters)"
+    char *line = &buffer_[0];
+    for(int header = 0; header < 2 && line != NULL; header++) {
+	line = strchr(line, '\n');
+	if(line != NULL)
+	    line++;
+    }
+
+    while(line != NULL && *line != '\0') {
+	char *next = strchr(line, '\n');
+	if(next != NULL)
+	    *next++ = '\0';
+
+	char *colon = strchr(line, ':');
+	if(colon != NULL) {
+	    char *name = line;
+	    while(*name == ' ')
+		name++;
+	    *colon = '\0';
+
+	    sigar_uint64_t counters[16];
+	    char *ptr = colon + 1;
+	    for(int i = 0; i < 16; i++)
+		counters[i] = strtoull(ptr, &ptr, 10);
+
+	    sigar_net_interface_stat_t ifstat;
+	    ifstat.rx_bytes = counters[0];
+	    ifstat.rx_packets = counters[1];
+	    ifstat.rx_errors = counters[2];
+	    ifstat.rx_dropped = counters[3];
+	    ifstat.rx_overruns = counters[4];
+	    ifstat.rx_frame = counters[5];
+	    ifstat.tx_bytes = counters[8];
+	    ifstat.tx_packets = counters[9];
+	    ifstat.tx_errors = counters[10];
+	    ifstat.tx_dropped = counters[11];
+	    ifstat.tx_overruns = counters[12];
+	    ifstat.tx_collisions = counters[13];
+	    ifstat.tx_carrier = counters[14];
+	    ifstat.speed = SIGAR_FIELD_NOTIMPL;
+
+	    if(count < ifnames_.size()) {
+		ifnames_[count] = name;
+		ifstats_[count] = ifstat;
+	    }
+	    else {
+		ifnames_.push_back(name);
+		ifstats_.push_back(ifstat);
+	    }
+	    count++;
+	}
+	line = next;
+    }
+    ifnames_.resize(count);
+    ifstats_.resize(count);
+
+    ifname_ptrs_.resize(count);
+    for(size_t i = 0; i < count; i++)
+	ifname_ptrs_[i] = const_cast<char *>(ifnames_[i].c_str());
+    iflist->number = count;
+    iflist->size = count;
+    iflist->data = ifname_ptrs_.empty() ? NULL : &ifname_ptrs_[0];
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Gets the configuration of an interface.
+ *
+ * procfs has no addresses, so only the link-level attributes found in the
+ * sys/class/net directory next to the root (mtu, address, flags) are
+ * filled; the IP addresses are left unset.
+ */
+int procfs_reader::net_interface_config_get(const char *name,
+					    sigar_net_interface_config_t *ifconfig)
+{
+    memset(ifconfig, 0, sizeof(*ifconfig));
+    snprintf(ifconfig->name, sizeof(ifconfig->name), "%s", name);
+    snprintf(ifconfig->description, sizeof(ifconfig->description), "%s", name);
+    ifconfig->hwaddr.family = sigar_net_address_t::SIGAR_AF_LINK;
+    ifconfig->address.family = sigar_net_address_t::SIGAR_AF_INET;
+    ifconfig->destination.family = sigar_net_address_t::SIGAR_AF_INET;
+    ifconfig->broadcast.family = sigar_net_address_t::SIGAR_AF_INET;
+    ifconfig->netmask.family = sigar_net_address_t::SIGAR_AF_INET;
+    ifconfig->metric = 1;
+
+    path_.assign(sys_net_);
+    path_.append(name);
+    path_.append("/mtu");
+    size_t file = path_.size() - 3;
+    if(read_file(path_.c_str()) == SIGAR_OK)
+	ifconfig->mtu = strtoull(&buffer_[0], NULL, 10);
+    path_.replace(file, string::npos, "flags");
+    if(read_file(path_.c_str()) == SIGAR_OK) {
+	//Linux IFF_* values: the low ten bits are the same as sigar's
+	unsigned long flags = strtoul(&buffer_[0], NULL, 16);
+	ifconfig->flags = flags & 0x3ff;
+	if(flags & 0x400)
+	    ifconfig->flags |= SIGAR_IFF_MASTER;
+	if(flags & 0x800)
+	    ifconfig->flags |= SIGAR_IFF_SLAVE;
+	if(flags & 0x1000)
+	    ifconfig->flags |= SIGAR_IFF_MULTICAST;
+    }
+    path_.replace(file, string::npos, "address");
+    if(read_file(path_.c_str()) == SIGAR_OK) {
+	unsigned int mac[6];
+	if(sscanf(&buffer_[0], "%x:%x:%x:%x:%x:%x",
+		  &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6) {
+	    for(int i = 0; i < 6; i++)
+		ifconfig->hwaddr.addr.mac[i] = (unsigned char) mac[i];
+	}
+    }
+
+    if(ifconfig->flags & SIGAR_IFF_LOOPBACK)
+	strcpy(ifconfig->type, "Local Loopback");
+    else
+	strcpy(ifconfig->type, "Ethernet");
+    return SIGAR_OK;
+}
+
+int procfs_reader::net_interface_stat_get(const char *name,
+					  sigar_net_interface_stat_t *ifstat)
+{
+    for(int pass = 0; pass < 2; pass++) {
+	for(size_t i = 0; i < ifnames_.size(); i++) {
+	    if(ifnames_[i] == name) {
+		*ifstat = ifstats_[i];
+		return SIGAR_OK;
+	    }
+	}
+	if(pass == 0) {
+	    //Not listed yet: read net/dev again
+	    sigar_net_interface_list_t iflist;
+	    int status = net_interface_list_get(&iflist);
+	    if(status != SIGAR_OK)
+		return status;
+	}
+    }
+    return ENXIO;
+}
+
+/**
+ * @brief Classifies a file system by its type name, like sigar's Linux
+ * table.
+ */
+static sigar_file_system_type_e file_system_type(const char *type)
+{
+    static const char *local[] = {"ext2", "ext3", "ext4", "xfs", "btrfs", "jfs",
+				  "reiserfs", "vfat", "msdos", "ntfs", "zfs",
+				  "hfs", "ufs", "f2fs", NULL};
+    static const char *network[] = {"nfs", "nfs4", "cifs", "smbfs", "afs",
+				    "ceph", "glusterfs", NULL};
+    static const char *ram[] = {"tmpfs", "ramfs", "devtmpfs", NULL};
+
+    for(int i = 0; local[i] != NULL; i++)
+	if(strcmp(type, local[i]) == 0)
+	    return SIGAR_FSTYPE_LOCAL_DISK;
+    for(int i = 0; network[i] != NULL; i++)
+	if(strcmp(type, network[i]) == 0)
+	    return SIGAR_FSTYPE_NETWORK;
+    for(int i = 0; ram[i] != NULL; i++)
+	if(strcmp(type, ram[i]) == 0)
+	    return SIGAR_FSTYPE_RAM_DISK;
+    if(strcmp(type, "iso9660") == 0)
+	return SIGAR_FSTYPE_CDROM;
+    if(strcmp(type, "swap") == 0)
+	return SIGAR_FSTYPE_SWAP;
+    return SIGAR_FSTYPE_NONE;
+}
+
+/**
+ * @brief Copies a field of the mounts file, decoding the octal escapes
+ * (e.g. \\040 for a space) used by the kernel.
+ */
+static void copy_mount_field(char *dest, size_t size, const char *src)
+{
+    size_t i = 0;
+    while(*src != '\0' && i + 1 < size) {
+	if(src[0] == '\\' && src[1] >= '0' && src[1] <= '7' &&
+	   src[2] >= '0' && src[2] <= '7' && src[3] >= '0' && src[3] <= '7') {
+	    dest[i++] = (char) ((src[1] - '0') * 64 + (src[2] - '0') * 8 + (src[3] - '0'));
+	    src += 4;
+	}
+	else {
+	    dest[i++] = *src++;
+	}
+    }
+    dest[i] = '\0';
+}
+
+int procfs_reader::file_system_list_get(sigar_file_system_list_t *fslist)
+{
+    int status = read_file(root_path("/mounts"));
+    if(status != SIGAR_OK)
+	return status;
+
+    filesystems_.clear();
+    char *line = &buffer_[0];
+    while(line != NULL && *line != '\0') {
+	char *next = strchr(line, '\n');
+	if(next != NULL)
+	    *next++ = '\0';
+
+	//device directory type options dump pass
+	char *fields[4];
+	int count = 0;
+	char *save = NULL;
+	for(char *token = strtok_r(line, " \t", &save);
+	    token != NULL && count < 4;
+	    token = strtok_r(NULL, " \t", &save))
+	    fields[count++] = token;
+
+	if(count == 4) {
+	    sigar_file_system_t fs;
+	    memset(&fs, 0, sizeof(fs));
+	    copy_mount_field(fs.dev_name, sizeof(fs.dev_name), fields[0]);
+	    copy_mount_field(fs.dir_name, sizeof(fs.dir_name), fields[1]);
+	    snprintf(fs.sys_type_name, sizeof(fs.sys_type_name), "%s", fields[2]);
+	    snprintf(fs.options, sizeof(fs.options), "%s", fields[3]);
+	    fs.type = file_system_type(fields[2]);
+	    const char *type_names[] = {"unknown", "none", "local", "remote",
+					"ram", "cdrom", "swap"};
+	    strcpy(fs.type_name, type_names[fs.type]);
+	    filesystems_.push_back(fs);
+	}
+	line = next;
+    }
+
+    fslist->number = filesystems_.size();
+    fslist->size = filesystems_.size();
+    fslist->data = filesystems_.empty() ? NULL : &filesystems_[0];
+    return SIGAR_OK;
+}
+
+/**
+ * @brief Gets the usage of a mounted file system, in KB as sigar does.
+ *
+ * The disk I/O counters are not filled. On failure the usage is zeroed.
+ */
+int procfs_reader::file_system_usage_get(const char *dirname,
+					 sigar_file_system_usage_t *fsusage)
+{
+    memset(fsusage, 0, sizeof(*fsusage));
+
+    struct statvfs buf;
+    if(statvfs(dirname, &buf) != 0)
+	return errno;
+
+    sigar_uint64_t block_kb = buf.f_frsize / 1024;
+    if(block_kb == 0)
+	block_kb = 1;
+    fsusage->total = buf.f_blocks * block_kb;
+    fsusage->free = buf.f_bfree * block_kb;
+    fsusage->avail = buf.f_bavail * block_kb;
+    fsusage->used = fsusage->total - fsusage->free;
+    fsusage->files = buf.f_files;
+    fsusage->free_files = buf.f_ffree;
+
+    sigar_uint64_t usable = fsusage->used + fsusage->avail;
+    fsusage->use_percent = usable ? (double) fsusage->used / usable : 0.0;
+    return SIGAR_OK;
+}
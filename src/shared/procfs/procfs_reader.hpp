@@ -0,0 +1,136 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROCFS_READER_HPP
+#define PROCFS_READER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+extern "C" {
+#include <sigar.h>
+}
+
+/**
+ * @class procfs_reader
+ * Reads processes, network interfaces and mounts from a procfs tree rooted
+ * anywhere, filling the same structures Hyperic Sigar does.
+ *
+ * Sigar has the path of procfs ("/proc/") compiled in, so plugins use this
+ * reader instead when their <code>procfs_root</code> property is set, e.g. to
+ * collect from a synthetic tree made by procfs_fixture. Given the root R:
+ *  - processes are read from R/[pid]/stat, statm, status and cmdline;
+ *  - interfaces from R/net/dev, and their mtu, address and flags from
+ *    R/../sys/class/net/[name] when present;
+ *  - file systems from R/mounts, their usage with statvfs() of the mount
+ *    directory.
+ *
+ * Buffers returned through the sigar lists belong to the reader and stay
+ * valid until the next call of the same method; they must not be passed to
+ * the sigar_*_destroy functions.
+ */
+class procfs_reader {
+public:
+    procfs_reader(const std::string &root);
+
+    const std::string &root() const
+    {
+	return root_;
+    }
+
+    int proc_list_get(sigar_proc_list_t *proclist);
+    int proc_state_get(sigar_pid_t pid, sigar_proc_state_t *procstate);
+    int proc_cred_get(sigar_pid_t pid, sigar_proc_cred_t *proccred);
+    int proc_cred_name_get(sigar_pid_t pid, sigar_proc_cred_name_t *proccredname);
+    int proc_cpu_get(sigar_pid_t pid, sigar_proc_cpu_t *proccpu);
+    int proc_mem_get(sigar_pid_t pid, sigar_proc_mem_t *procmem);
+    int proc_cmdline_get(sigar_pid_t pid, std::string &command_line);
+
+    int net_interface_list_get(sigar_net_interface_list_t *iflist);
+    int net_interface_config_get(const char *name,
+				 sigar_net_interface_config_t *ifconfig);
+    int net_interface_stat_get(const char *name,
+			       sigar_net_interface_stat_t *ifstat);
+
+    int file_system_list_get(sigar_file_system_list_t *fslist);
+    int file_system_usage_get(const char *dirname,
+			      sigar_file_system_usage_t *fsusage);
+
+private:
+    /**
+     * Fields of /proc/[pid]/stat. The last parsed pid is kept, so the
+     * state, cpu and memory of a process cost a single read.
+     */
+    struct pid_stat {
+	sigar_pid_t pid;
+	char name[SIGAR_PROC_NAME_LEN];
+	char state;
+	sigar_pid_t ppid;
+	int tty;
+	int priority;
+	int nice;
+	int processor;
+	sigar_uint64_t threads;
+	sigar_uint64_t minor_faults;
+	sigar_uint64_t major_faults;
+	sigar_uint64_t utime;
+	sigar_uint64_t stime;
+	sigar_uint64_t start_time;
+	sigar_uint64_t vsize;
+	sigar_uint64_t rss;
+    };
+
+    struct cpu_sample {
+	sigar_uint64_t total;
+	sigar_uint64_t last_time;
+	bool seen;
+    };
+
+    int read_file(const char *path);
+    const char *root_path(const char *file);
+    int read_pid_file(sigar_pid_t pid, const char *file);
+    int pid_stat_get(sigar_pid_t pid);
+    const std::string &user_name(sigar_uid_t uid);
+    const std::string &group_name(sigar_gid_t gid);
+
+    std::string root_;
+    std::string sys_net_;
+    std::string path_;
+    std::vector<char> buffer_;
+    size_t length_;
+
+    sigar_uint64_t boot_time_;
+    long ticks_per_second_;
+    long page_size_;
+
+    pid_stat stat_;
+    std::vector<sigar_pid_t> pids_;
+    std::map<sigar_pid_t, cpu_sample> cpu_;
+    std::map<sigar_uid_t, std::string> users_;
+    std::map<sigar_gid_t, std::string> groups_;
+
+    std::vector<std::string> ifnames_;
+    std::vector<char *> ifname_ptrs_;
+    std::vector<sigar_net_interface_stat_t> ifstats_;
+
+    std::vector<sigar_file_system_t> filesystems_;
+};
+
+#endif //PROCFS_READER_HPP
@@ -0,0 +1,599 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how stale the samples of the agents are by the time they reach a
+ * collector, using the cavecanem_probe topic (see <latency_probe> in the
+ * general configuration file).
+ *
+ *   cavecanem_latency [--interval SEC] [--domain ID] [--config FILE] [TOPIC...]
+ *
+ * Subscribes to the topics of the plugins of the general configuration file
+ * (or only to the given ones) and to cavecanem_probe, and every --interval
+ * seconds (10 by default) prints, per topic:
+ *  - tick->rcv: reception time minus source timestamp (the wall-clock time
+ *    the plugin run that wrote the sample started at);
+ *  - collect->rcv: reception time minus the wall-clock time the plugin run
+ *    that wrote the sample started at, as told by the probe of its host,
+ *    plugin and tick;
+ *  - agent: from the start of the run to its last write, on the monotonic
+ *    clock of the agent (exact, no clock skew involved);
+ * and, per host pair (agent -> this host), the reception time of probes
+ * minus their source timestamp, which is transport latency plus the skew of
+ * the two clocks. Negative values can only be skew and are counted apart.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <algorithm>
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ndds/ndds_cpp.h>
+
+#include "latency_histogram.hpp"
+#include "probe.hpp"
+#include "xml_parser.hpp"
+
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR "."
+#endif
+
+using namespace std;
+
+static volatile bool quit = false;
+
+static void signal_handler(int signal)
+{
+    quit = true;
+}
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long time_ns(const DDS_Time_t &time)
+{
+    return (long long) time.sec * 1000000000LL + time.nanosec;
+}
+
+/**
+ * @class skewed_histogram
+ * A latency histogram that counts negative values (clock skew between the
+ * hosts) apart.
+ */
+struct skewed_histogram {
+    latency_histogram histogram;
+    unsigned long long negative;
+
+    skewed_histogram() : negative(0) {}
+
+    void record(long long value)
+    {
+	if(value < 0)
+	    negative++;
+	else
+	    histogram.record(value);
+    }
+
+    void reset()
+    {
+	histogram.reset();
+	negative = 0;
+    }
+};
+
+/**
+ * @class pending_tick
+ * Reception times of the samples of a host on a topic in its latest tick,
+ * waiting for the probe of that tick.
+ */
+struct pending_tick {
+    unsigned long long tick;
+    vector<long long> receptions;
+
+    pending_tick() : tick(0) {}
+};
+
+/**
+ * @class latency_topic
+ * A topic being measured: its reader and histograms.
+ */
+struct latency_topic {
+    DDSDynamicDataReader *reader;
+    skewed_histogram source;   //tick->rcv
+    skewed_histogram collect;  //collect->rcv
+    latency_histogram agent;   //collection to last write, in the agent
+    unsigned long long samples;
+    unsigned long long unmatched;
+    map<string, pending_tick> pending; //by hostname
+
+    latency_topic() : reader(NULL), samples(0), unmatched(0) {}
+};
+
+/**
+ * @class latency_monitor
+ * Takes the samples of the plugin topics and the probes, and joins them.
+ */
+class latency_monitor {
+public:
+    latency_monitor();
+    ~latency_monitor();
+
+    bool initialize_dds(int domain_id,
+			const string &qos_file,
+			const string &qos_library,
+			const string &qos_profile);
+    bool add_topic(const string &plugin, const string &topic_name, DDS_TypeCode *type);
+    bool add_probe();
+
+    void poll();
+    void report(double elapsed_sec);
+
+private:
+    DDSDynamicDataReader *create_reader(const string &topic_name, DDS_TypeCode *type);
+    void take_samples(latency_topic &topic);
+    void take_probes();
+    const char *get_hostname(const DDS_DynamicData &data);
+
+    DDSDomainParticipant *participant_;
+    DDSSubscriber *subscriber_;
+    string qos_library_;
+    string qos_profile_;
+    vector<DDSDynamicDataTypeSupport *> type_supports_;
+
+    map<string, latency_topic> topics_;            //by topic name
+    map<string, latency_topic *> plugin_topics_;   //by plugin name
+    DDSDynamicDataReader *probe_reader_;
+    DDS_TypeCode *probe_type_;
+    unsigned long long probes_;
+    map<string, skewed_histogram> host_pairs_;     //by "agent -> this host"
+    string local_host_;
+
+    DDS_DynamicDataSeq data_seq_;
+    DDS_SampleInfoSeq info_seq_;
+    vector<char> hostname_;
+    string key_;
+};
+
+latency_monitor::latency_monitor()
+    : participant_(NULL),
+      subscriber_(NULL),
+      probe_reader_(NULL),
+      probe_type_(NULL),
+      probes_(0),
+      hostname_(PROBE_MAX_HOSTNAME_LENGTH + 1)
+{
+    char host[256];
+    if(gethostname(host, sizeof(host)) == 0) {
+	host[sizeof(host) - 1] = '\0';
+	local_host_ = host;
+    }
+}
+
+latency_monitor::~latency_monitor()
+{
+    if(participant_ != NULL) {
+	participant_->delete_contained_entities();
+	DDSTheParticipantFactory->delete_participant(participant_);
+    }
+    for(size_t i = 0; i < type_supports_.size(); i++)
+	delete type_supports_[i];
+    if(probe_type_ != NULL) {
+	DDS_ExceptionCode_t ex;
+	DDS_TypeCodeFactory::get_instance()->delete_tc(probe_type_, ex);
+    }
+}
+
+/**
+ * @brief Creates the participant and subscriber, like the plugin manager
+ * creates its participant and publisher.
+ */
+bool latency_monitor::initialize_dds(int domain_id,
+				     const string &qos_file,
+				     const string &qos_library,
+				     const string &qos_profile)
+{
+    qos_library_ = qos_library;
+    qos_profile_ = qos_profile;
+
+    DDS_DomainParticipantFactoryQos factory_qos;
+    DDSTheParticipantFactory->get_qos(factory_qos);
+    factory_qos.profile.url_profile.ensure_length(1,1);
+    factory_qos.profile.url_profile[0] = DDS_String_dup(qos_file.c_str());
+    DDSTheParticipantFactory->set_qos(factory_qos);
+
+    if(qos_profile == "default") {
+	participant_ = DDSTheParticipantFactory->
+	    create_participant(domain_id, DDS_PARTICIPANT_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+	if(participant_ != NULL)
+	    subscriber_ = participant_->create_subscriber(DDS_SUBSCRIBER_QOS_DEFAULT,
+							  NULL, DDS_STATUS_MASK_NONE);
+    }
+    else {
+	participant_ = DDSTheParticipantFactory->
+	    create_participant_with_profile(domain_id, qos_library.c_str(), qos_profile.c_str(),
+					    NULL, DDS_STATUS_MASK_NONE);
+	if(participant_ != NULL)
+	    subscriber_ = participant_->
+		create_subscriber_with_profile(qos_library.c_str(), qos_profile.c_str(),
+					       NULL, DDS_STATUS_MASK_NONE);
+    }
+
+    if(participant_ == NULL || subscriber_ == NULL) {
+	cerr << "cannot create the DDS participant and subscriber" << endl;
+	return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Registers a type and creates its topic and a DataReader.
+ */
+DDSDynamicDataReader *latency_monitor::create_reader(const string &topic_name,
+						     DDS_TypeCode *type)
+{
+    DDSDynamicDataTypeSupport *type_support =
+	new DDSDynamicDataTypeSupport(type, DDS_DYNAMIC_DATA_TYPE_PROPERTY_DEFAULT);
+    type_supports_.push_back(type_support);
+    const char *type_name = type_support->get_type_name();
+
+    DDSTopic *topic = NULL;
+    DDSDataReader *reader = NULL;
+    if(type_support->register_type(participant_, type_name) == DDS_RETCODE_OK)
+	topic = participant_->create_topic(topic_name.c_str(), type_name,
+					   DDS_TOPIC_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+    if(topic != NULL) {
+	if(qos_profile_ == "default")
+	    reader = subscriber_->create_datareader(topic, DDS_DATAREADER_QOS_DEFAULT,
+						    NULL, DDS_STATUS_MASK_NONE);
+	else
+	    reader = subscriber_->create_datareader_with_profile(topic, qos_library_.c_str(),
+								 qos_profile_.c_str(),
+								 NULL, DDS_STATUS_MASK_NONE);
+    }
+    DDSDynamicDataReader *dynamic_reader =
+	reader != NULL ? DDSDynamicDataReader::narrow(reader) : NULL;
+    if(dynamic_reader == NULL)
+	cerr << topic_name << ": cannot create the topic and DataReader" << endl;
+    return dynamic_reader;
+}
+
+/**
+ * @brief Subscribes to the topic of a plugin (once per topic, when several
+ * plugins share it).
+ */
+bool latency_monitor::add_topic(const string &plugin,
+				const string &topic_name,
+				DDS_TypeCode *type)
+{
+    map<string, latency_topic>::iterator it = topics_.find(topic_name);
+    if(it == topics_.end()) {
+	DDSDynamicDataReader *reader = create_reader(topic_name, type);
+	if(reader == NULL)
+	    return false;
+	it = topics_.insert(make_pair(topic_name, latency_topic())).first;
+	it->second.reader = reader;
+    }
+    plugin_topics_[plugin] = &it->second;
+    return true;
+}
+
+/**
+ * @brief Subscribes to the probes.
+ */
+bool latency_monitor::add_probe()
+{
+    probe_type_ = latency_probe::create_type_code();
+    if(probe_type_ == NULL)
+	return false;
+    probe_reader_ = create_reader(PROBE_TOPIC_NAME, probe_type_);
+    return probe_reader_ != NULL;
+}
+
+/**
+ * @brief Reads the hostname of a sample into a buffer reused between calls.
+ *
+ * @return The hostname, or NULL if the sample has none.
+ */
+const char *latency_monitor::get_hostname(const DDS_DynamicData &data)
+{
+    char *buffer = &hostname_[0];
+    DDS_UnsignedLong size = hostname_.size();
+    DDS_ReturnCode_t retcode = data.get_string(buffer, &size, "hostname",
+					       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+    if(retcode == DDS_RETCODE_OUT_OF_RESOURCES) {
+	hostname_.resize(size);
+	buffer = &hostname_[0];
+	retcode = data.get_string(buffer, &size, "hostname",
+				  DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED);
+    }
+    return retcode == DDS_RETCODE_OK ? buffer : NULL;
+}
+
+/**
+ * @brief Takes the samples of a plugin topic, recording their tick->rcv
+ * latency and keeping their reception time until the probe of their tick
+ * arrives.
+ */
+void latency_monitor::take_samples(latency_topic &topic)
+{
+    if(topic.reader->take(data_seq_, info_seq_, DDS_LENGTH_UNLIMITED,
+			  DDS_ANY_SAMPLE_STATE, DDS_ANY_VIEW_STATE,
+			  DDS_ANY_INSTANCE_STATE) != DDS_RETCODE_OK)
+	return;
+
+    for(DDS_Long i = 0; i < data_seq_.length(); i++) {
+	if(!info_seq_[i].valid_data)
+	    continue;
+	long long reception = time_ns(info_seq_[i].reception_timestamp);
+	topic.samples++;
+	topic.source.record(reception - time_ns(info_seq_[i].source_timestamp));
+
+	DDS_UnsignedLongLong tick;
+	const char *hostname = get_hostname(data_seq_[i]);
+	if(hostname == NULL ||
+	   data_seq_[i].get_ulonglong(tick, "tick",
+				      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK)
+	    continue;
+
+	key_ = hostname;
+	pending_tick &pending = topic.pending[key_];
+	if(pending.tick != tick) {
+	    topic.unmatched += pending.receptions.size();
+	    pending.receptions.clear();
+	    pending.tick = tick;
+	}
+	pending.receptions.push_back(reception);
+    }
+    topic.reader->return_loan(data_seq_, info_seq_);
+}
+
+/**
+ * @brief Takes the probes, joining each with the samples of its host,
+ * plugin and tick.
+ */
+void latency_monitor::take_probes()
+{
+    if(probe_reader_->take(data_seq_, info_seq_, DDS_LENGTH_UNLIMITED,
+			   DDS_ANY_SAMPLE_STATE, DDS_ANY_VIEW_STATE,
+			   DDS_ANY_INSTANCE_STATE) != DDS_RETCODE_OK)
+	return;
+
+    char plugin[PROBE_MAX_PLUGIN_LENGTH + 1];
+    for(DDS_Long i = 0; i < data_seq_.length(); i++) {
+	if(!info_seq_[i].valid_data)
+	    continue;
+	const DDS_DynamicData &probe = data_seq_[i];
+	long long reception = time_ns(info_seq_[i].reception_timestamp);
+	probes_++;
+
+	const char *hostname = get_hostname(probe);
+	if(hostname == NULL)
+	    continue;
+	key_ = hostname;
+	key_ += " -> ";
+	key_ += local_host_;
+	host_pairs_[key_].record(reception - time_ns(info_seq_[i].source_timestamp));
+
+	char *plugin_buffer = plugin;
+	DDS_UnsignedLong size = sizeof(plugin);
+	DDS_UnsignedLongLong tick;
+	DDS_LongLong collect_epoch_ns, collect_ns, write_ns;
+	if(probe.get_string(plugin_buffer, &size, "plugin",
+			    DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK ||
+	   probe.get_ulonglong(tick, "tick",
+			       DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK ||
+	   probe.get_longlong(collect_epoch_ns, "collect_epoch_ns",
+			      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK ||
+	   probe.get_longlong(collect_ns, "collect_ns",
+			      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK ||
+	   probe.get_longlong(write_ns, "write_ns",
+			      DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED) != DDS_RETCODE_OK)
+	    continue;
+
+	map<string, latency_topic *>::iterator it = plugin_topics_.find(plugin);
+	if(it == plugin_topics_.end())
+	    continue;
+	latency_topic &topic = *it->second;
+	topic.agent.record(write_ns - collect_ns);
+
+	key_ = hostname;
+	map<string, pending_tick>::iterator pending = topic.pending.find(key_);
+	if(pending == topic.pending.end() || pending->second.tick != tick)
+	    continue;
+	vector<long long> &receptions = pending->second.receptions;
+	for(size_t j = 0; j < receptions.size(); j++)
+	    topic.collect.record(receptions[j] - collect_epoch_ns);
+	receptions.clear();
+    }
+    probe_reader_->return_loan(data_seq_, info_seq_);
+}
+
+/**
+ * @brief Takes what every reader has received.
+ */
+void latency_monitor::poll()
+{
+    for(map<string, latency_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it)
+	take_samples(it->second);
+    if(probe_reader_ != NULL)
+	take_probes();
+}
+
+static void print_histogram(const latency_histogram &histogram)
+{
+    if(histogram.count() == 0)
+	printf(" %26s", "-");
+    else
+	printf(" %8.3f %8.3f %8.3f",
+	       histogram.percentile(50) / 1e6,
+	       histogram.percentile(99) / 1e6,
+	       histogram.max() / 1e6);
+}
+
+/**
+ * @brief Prints the latencies measured since the previous report, in
+ * milliseconds, and starts over.
+ */
+void latency_monitor::report(double elapsed_sec)
+{
+    printf("\n%-24s %9s %26s %26s %26s\n", "topic (ms: p50 p99 max)", "samples/s",
+	   "tick->rcv", "collect->rcv", "agent");
+    for(map<string, latency_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it) {
+	latency_topic &topic = it->second;
+	printf("%-24s %9.1f", it->first.c_str(), topic.samples / elapsed_sec);
+	print_histogram(topic.source.histogram);
+	print_histogram(topic.collect.histogram);
+	print_histogram(topic.agent);
+	if(topic.source.negative > 0 || topic.collect.negative > 0)
+	    printf("  (%llu negative: clock skew)", topic.source.negative + topic.collect.negative);
+	if(topic.unmatched > 0)
+	    printf("  (%llu without probe)", topic.unmatched);
+	printf("\n");
+
+	topic.source.reset();
+	topic.collect.reset();
+	topic.agent.reset();
+	topic.samples = 0;
+	topic.unmatched = 0;
+    }
+
+    if(host_pairs_.empty()) {
+	if(probes_ == 0)
+	    printf("no probes received: is <latency_probe> enabled on the agents?\n");
+	return;
+    }
+    printf("%-36s %26s\n", "host pair (ms: p50 p99 max)", "probe source->rcv");
+    for(map<string, skewed_histogram>::iterator it = host_pairs_.begin();
+	it != host_pairs_.end(); ++it) {
+	printf("%-36s", it->first.c_str());
+	print_histogram(it->second.histogram);
+	if(it->second.negative > 0)
+	    printf("  (%llu negative: clock skew)", it->second.negative);
+	printf("\n");
+	it->second.reset();
+    }
+    probes_ = 0;
+}
+
+
+static void usage()
+{
+    cerr << "Usage: cavecanem_latency [--interval SEC] [--domain ID] [--config FILE] [TOPIC...]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string cfg_file(string(CAVECANEM_DIR) + "/config/cavecanem.xml");
+    int domain_id = -1;
+    double interval = 10;
+    vector<string> only;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--interval" && i + 1 < argc)
+	    interval = atof(argv[++i]);
+	else if(arg == "--domain" && i + 1 < argc)
+	    domain_id = atoi(argv[++i]);
+	else if(arg == "--config" && i + 1 < argc)
+	    cfg_file = argv[++i];
+	else if(arg[0] == '-') {
+	    usage();
+	    return 2;
+	}
+	else
+	    only.push_back(arg);
+    }
+    if(interval <= 0) {
+	usage();
+	return 2;
+    }
+
+    XML_parser *parser = XML_parser::get_singleton();
+    if(!parser->parse_general_configuration_file(cfg_file)) {
+	cerr << "cannot parse " << cfg_file << endl;
+	return 1;
+    }
+    cc_general_properties general = parser->get_general_properties();
+
+    latency_monitor monitor;
+    if(!monitor.initialize_dds(domain_id >= 0 ? domain_id : general.domain_id,
+			       general.qos_file, general.qos_library, general.qos_profile) ||
+       !monitor.add_probe())
+	return 1;
+
+    //The topics and types of the plugins, from their configuration files
+    size_t topics = 0;
+    for(map<string, list<string> >::iterator it = general.plugin_list_map.begin();
+	it != general.plugin_list_map.end(); ++it)
+	for(list<string>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+	    string file = string(CAVECANEM_DIR) + "/" + it->first + "/" + *it2 + "/" + *it2 + ".xml";
+	    if(!parser->parse_plugin_configuration_file(file)) {
+		cerr << "cannot parse " << file << endl;
+		continue;
+	    }
+	    cc_plugin_properties properties = parser->get_plugin_properties(*it2);
+	    if(properties.type_code == NULL)
+		continue;
+	    if(!only.empty() &&
+	       find(only.begin(), only.end(), properties.topic_name) == only.end())
+		continue;
+	    if(monitor.add_topic(*it2, properties.topic_name, properties.type_code))
+		topics++;
+	}
+    if(topics == 0) {
+	cerr << "no topic to subscribe to" << endl;
+	return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    //reception_timestamp is set by DDS when a sample arrives, so polling
+    //does not add to the measured latencies
+    long long interval_ns = (long long) (interval * 1e9);
+    long long last_report = now_ns();
+    struct timespec pause = {0, 10000000};
+    while(!quit) {
+	monitor.poll();
+	long long now = now_ns();
+	if(now - last_report >= interval_ns) {
+	    monitor.report((now - last_report) / 1e9);
+	    fflush(stdout);
+	    last_report = now;
+	}
+	nanosleep(&pause, NULL);
+    }
+
+    return 0;
+}
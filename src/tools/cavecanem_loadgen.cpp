@@ -0,0 +1,671 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Publishes the traffic of a fleet of agents from a single box, to size the
+ * collectors without that many hosts.
+ *
+ *   cavecanem_loadgen [--hosts N] [--rate SAMPLES_PER_SEC] [--threads N]
+ *                     [--instances N] [--churn P] [--duration SEC]
+ *                     [--domain ID] [--config FILE] [PLUGIN...]
+ *
+ * The topics and types are those of the plugins of the general
+ * configuration file (or only of the given plugins), read from their XML
+ * files like the agent does, and the DataWriters are created in its domain
+ * and with its QoS profile (the domain is overridable with --domain).
+ *
+ * Every virtual host ("loadgen-000001", ...) publishes one round of samples
+ * after another: one sample per plugin, or --instances samples (8 by
+ * default) for types keyed by more than the hostname (processes, disks,
+ * interfaces). Values evolve with random walks: doubles stay within 0-100,
+ * other longs stay positive and long longs only grow, like counters.
+ * Instances with an integer key (processes) are replaced by new ones with
+ * probability --churn (0.02 by default) every round. Members that are not
+ * primitives or strings (log_tail records) are left empty.
+ *
+ * Hosts are spread over --threads threads (4 by default), each owning its
+ * hosts and samples and writing at its share of --rate (samples per
+ * second, all threads together; 0 means as fast as possible). The rate
+ * actually achieved is printed every second, and the totals when the
+ * generator stops (after --duration seconds, or on SIGINT).
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <algorithm>
+
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <ndds/ndds_cpp.h>
+
+#include "xml_parser.hpp"
+
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR "."
+#endif
+
+using namespace std;
+
+static volatile bool quit = false;
+
+static void signal_handler(int signal)
+{
+    quit = true;
+}
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ns(long long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR && !quit)
+	;
+}
+
+//Words string members are made of
+static const char *words[] = {
+    "sshd", "nginx", "postgres", "java", "python3", "cron", "bash", "systemd",
+    "rsyslogd", "dockerd", "containerd", "redis", "node", "chronyd", "kworker", "sda",
+    "eth", "root", "www-data", "daemon"
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+/**
+ * @class random_source
+ * xorshift64* generator: one per thread, no locks.
+ */
+class random_source {
+public:
+    random_source(unsigned long long seed) : state_(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    unsigned long long next()
+    {
+	state_ ^= state_ >> 12;
+	state_ ^= state_ << 25;
+	state_ ^= state_ >> 27;
+	return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    //Uniform in [0, 1)
+    double uniform()
+    {
+	return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    unsigned long long state_;
+};
+
+/**
+ * @class member_layout
+ * How a top-level member of a plugin type is generated.
+ */
+struct member_layout {
+    enum role_t { HOSTNAME, TS, TICK, ID_KEY, NAME_KEY, VALUE, SKIPPED };
+
+    const char *name;
+    DDS_TCKind kind;
+    role_t role;
+};
+
+/**
+ * @class loadgen_topic
+ * A plugin being simulated: its DataWriter and how its samples are built.
+ */
+struct loadgen_topic {
+    string plugin;
+    DDS_TypeCode *type;
+    DDSDynamicDataTypeSupport *type_support;
+    DDSDynamicDataWriter *writer;
+    vector<member_layout> members;
+    size_t instances;   //samples per round
+    bool churns;        //has an integer key
+};
+
+/**
+ * @class loadgen_instance
+ * A keyed instance of a virtual host (the host itself for types keyed only
+ * by hostname): its id and the current value of every member.
+ */
+struct loadgen_instance {
+    long id;
+    vector<double> values;
+    vector<double> rates; //growth per round of counters
+};
+
+/**
+ * @class virtual_host
+ * A simulated agent.
+ */
+struct virtual_host {
+    char hostname[32];
+    unsigned long long tick;
+    long next_id;
+    vector<vector<loadgen_instance> > topics; //instances, by topic
+};
+
+/**
+ * @class loadgen_thread
+ * A thread of the pool: its hosts, samples and counters.
+ */
+struct loadgen_thread {
+    pthread_t thread;
+    vector<virtual_host> hosts;
+    vector<DDS_DynamicData *> data; //one per topic
+    vector<loadgen_topic> *topics;
+    double rate;                    //0: as fast as possible
+    double churn;
+    random_source random;
+    volatile unsigned long long written;
+    volatile unsigned long long failed;
+
+    loadgen_thread() : topics(NULL), rate(0), churn(0), random(0), written(0), failed(0) {}
+};
+
+/**
+ * @brief Tells how every member of a type is generated.
+ *
+ * @return False if the type is not a structure.
+ */
+static bool build_layout(loadgen_topic &topic)
+{
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_UnsignedLong count = topic.type->member_count(ex);
+    if(ex != DDS_NO_EXCEPTION_CODE)
+	return false;
+
+    topic.churns = false;
+    bool keyed = false;
+    for(DDS_UnsignedLong i = 0; i < count; i++) {
+	member_layout member;
+	member.name = topic.type->member_name(i, ex);
+	member.kind = topic.type->member_type(i, ex)->kind(ex);
+	bool key = topic.type->is_member_key(i, ex);
+	bool numeric = member.kind == DDS_TK_LONG || member.kind == DDS_TK_LONGLONG ||
+	    member.kind == DDS_TK_ULONGLONG || member.kind == DDS_TK_DOUBLE;
+
+	if(!strcmp(member.name, "hostname") && member.kind == DDS_TK_STRING)
+	    member.role = member_layout::HOSTNAME;
+	else if(!strcmp(member.name, "ts") && member.kind == DDS_TK_LONG)
+	    member.role = member_layout::TS;
+	else if(!strcmp(member.name, "tick") && member.kind == DDS_TK_ULONGLONG)
+	    member.role = member_layout::TICK;
+	else if(key && member.kind == DDS_TK_LONG)
+	    member.role = member_layout::ID_KEY;
+	else if(key && member.kind == DDS_TK_STRING)
+	    member.role = member_layout::NAME_KEY;
+	else if(numeric || member.kind == DDS_TK_STRING || member.kind == DDS_TK_CHAR)
+	    member.role = member_layout::VALUE;
+	else
+	    member.role = member_layout::SKIPPED;
+
+	if(member.role == member_layout::ID_KEY)
+	    topic.churns = true;
+	if(member.role == member_layout::ID_KEY || member.role == member_layout::NAME_KEY)
+	    keyed = true;
+	topic.members.push_back(member);
+    }
+    if(!keyed)
+	topic.instances = 1;
+    return true;
+}
+
+/**
+ * @brief Gives an instance a new id and starting values.
+ */
+static void spawn_instance(const loadgen_topic &topic, virtual_host &host,
+			   loadgen_instance &instance, random_source &random)
+{
+    instance.id = host.next_id++;
+    instance.values.resize(topic.members.size());
+    instance.rates.resize(topic.members.size());
+    for(size_t i = 0; i < topic.members.size(); i++) {
+	const member_layout &member = topic.members[i];
+	instance.rates[i] = 0;
+	if(member.role != member_layout::VALUE)
+	    instance.values[i] = 0;
+	else if(member.kind == DDS_TK_DOUBLE)
+	    instance.values[i] = random.uniform() * 100;
+	else if(member.kind == DDS_TK_LONGLONG || member.kind == DDS_TK_ULONGLONG) {
+	    instance.values[i] = random.uniform() * 1e9;
+	    instance.rates[i] = random.uniform() * 1e5;
+	}
+	else //longs, and the word or char of strings and chars
+	    instance.values[i] = (double) (random.next() % 100000);
+    }
+}
+
+/**
+ * @brief Moves the values of an instance one step of their random walks.
+ */
+static void evolve_instance(const loadgen_topic &topic, loadgen_instance &instance,
+			    random_source &random)
+{
+    for(size_t i = 0; i < topic.members.size(); i++) {
+	const member_layout &member = topic.members[i];
+	if(member.role != member_layout::VALUE ||
+	   member.kind == DDS_TK_STRING || member.kind == DDS_TK_CHAR)
+	    continue;
+	double step = random.uniform() * 2 - 1;
+	double &value = instance.values[i];
+	if(member.kind == DDS_TK_DOUBLE) {
+	    value += step * 2;
+	    value = value < 0 ? -value : (value > 100 ? 200 - value : value);
+	}
+	else if(member.kind == DDS_TK_LONGLONG || member.kind == DDS_TK_ULONGLONG) {
+	    instance.rates[i] *= 1 + step * 0.1;
+	    value += instance.rates[i];
+	}
+	else {
+	    value += step * (value * 0.02 + 1);
+	    if(value < 0)
+		value = -value;
+	}
+    }
+}
+
+/**
+ * @brief Fills a sample with an instance of a virtual host.
+ */
+static void fill_sample(const loadgen_topic &topic, const virtual_host &host,
+			const loadgen_instance &instance, size_t index,
+			long ts, DDS_DynamicData &data)
+{
+    char text[64];
+    for(size_t i = 0; i < topic.members.size(); i++) {
+	const member_layout &member = topic.members[i];
+	const double value = instance.values[i];
+	switch(member.role) {
+	case member_layout::HOSTNAME:
+	    data.set_string(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, host.hostname);
+	    break;
+	case member_layout::TS:
+	    data.set_long(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, ts);
+	    break;
+	case member_layout::TICK:
+	    data.set_ulonglong(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, host.tick);
+	    break;
+	case member_layout::ID_KEY:
+	    data.set_long(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, instance.id);
+	    break;
+	case member_layout::NAME_KEY:
+	    snprintf(text, sizeof(text), "%s%u", words[(index + i) % WORD_COUNT], (unsigned) index);
+	    data.set_string(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, text);
+	    break;
+	case member_layout::VALUE:
+	    if(member.kind == DDS_TK_STRING)
+		data.set_string(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+				words[(unsigned long) value % WORD_COUNT]);
+	    else if(member.kind == DDS_TK_CHAR)
+		data.set_char(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			      "RSSSD"[(unsigned long) value % 5]);
+	    else if(member.kind == DDS_TK_DOUBLE)
+		data.set_double(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED, value);
+	    else if(member.kind == DDS_TK_LONGLONG)
+		data.set_longlong(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+				  (DDS_LongLong) value);
+	    else if(member.kind == DDS_TK_ULONGLONG)
+		data.set_ulonglong(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+				   (DDS_UnsignedLongLong) value);
+	    else
+		data.set_long(member.name, DDS_DYNAMIC_DATA_MEMBER_ID_UNSPECIFIED,
+			      (DDS_Long) value);
+	    break;
+	case member_layout::SKIPPED:
+	    break;
+	}
+    }
+}
+
+/**
+ * @brief Body of the threads of the pool: publishes rounds of the hosts of
+ * the thread, paced to its share of the rate.
+ */
+static void *publish_hosts(void *arg)
+{
+    loadgen_thread &self = *(loadgen_thread *) arg;
+    vector<loadgen_topic> &topics = *self.topics;
+    long long start = now_ns();
+    unsigned long long sent = 0;
+    double interval_ns = self.rate > 0 ? 1e9 / self.rate : 0;
+
+    while(!quit) {
+	for(size_t h = 0; h < self.hosts.size() && !quit; h++) {
+	    virtual_host &host = self.hosts[h];
+	    long ts = (long) time(NULL);
+	    host.tick++;
+	    for(size_t t = 0; t < topics.size(); t++) {
+		loadgen_topic &topic = topics[t];
+		vector<loadgen_instance> &instances = host.topics[t];
+		DDS_DynamicData &data = *self.data[t];
+		for(size_t i = 0; i < instances.size(); i++) {
+		    if(topic.churns && self.random.uniform() < self.churn)
+			spawn_instance(topic, host, instances[i], self.random);
+		    else
+			evolve_instance(topic, instances[i], self.random);
+		    fill_sample(topic, host, instances[i], i, ts, data);
+
+		    if(topic.writer->write(data, DDS_HANDLE_NIL) == DDS_RETCODE_OK)
+			self.written++;
+		    else
+			self.failed++;
+		    sent++;
+
+		    //Sleep when ahead of the rate, checking the clock every
+		    //few samples
+		    if(interval_ns > 0 && (sent & 15) == 0) {
+			long long ahead = start + (long long) (sent * interval_ns) - now_ns();
+			if(ahead > 1000000)
+			    sleep_ns(ahead);
+		    }
+		}
+	    }
+	}
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates the participant and publisher, like the plugin manager.
+ */
+static bool create_participant(int domain_id, const cc_general_properties &general,
+			       DDSDomainParticipant *&participant, DDSPublisher *&publisher)
+{
+    DDS_DomainParticipantFactoryQos factory_qos;
+    DDSTheParticipantFactory->get_qos(factory_qos);
+    factory_qos.profile.url_profile.ensure_length(1,1);
+    factory_qos.profile.url_profile[0] = DDS_String_dup(general.qos_file.c_str());
+    DDSTheParticipantFactory->set_qos(factory_qos);
+
+    publisher = NULL;
+    if(general.qos_profile == "default") {
+	participant = DDSTheParticipantFactory->
+	    create_participant(domain_id, DDS_PARTICIPANT_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+	if(participant != NULL)
+	    publisher = participant->create_publisher(DDS_PUBLISHER_QOS_DEFAULT,
+						      NULL, DDS_STATUS_MASK_NONE);
+    }
+    else {
+	participant = DDSTheParticipantFactory->
+	    create_participant_with_profile(domain_id, general.qos_library.c_str(),
+					    general.qos_profile.c_str(),
+					    NULL, DDS_STATUS_MASK_NONE);
+	if(participant != NULL)
+	    publisher = participant->
+		create_publisher_with_profile(general.qos_library.c_str(),
+					      general.qos_profile.c_str(),
+					      NULL, DDS_STATUS_MASK_NONE);
+    }
+
+    if(participant == NULL || publisher == NULL) {
+	cerr << "cannot create the DDS participant and publisher" << endl;
+	return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Creates the topic and DataWriter of a plugin, with the QoS of the
+ * plugin.
+ */
+static bool create_writer(DDSDomainParticipant *participant, DDSPublisher *publisher,
+			  const cc_plugin_properties &properties, loadgen_topic &topic)
+{
+    topic.type_support = new DDSDynamicDataTypeSupport(topic.type,
+						       DDS_DYNAMIC_DATA_TYPE_PROPERTY_DEFAULT);
+    const char *type_name = topic.type_support->get_type_name();
+    DDSTopic *dds_topic = NULL;
+    DDSDataWriter *writer = NULL;
+    if(topic.type_support->register_type(participant, type_name) == DDS_RETCODE_OK) {
+	dds_topic = participant->create_topic(properties.topic_name.c_str(), type_name,
+					      DDS_TOPIC_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+	//Another plugin of the same topic
+	if(dds_topic == NULL)
+	    dds_topic = (DDSTopic *) participant->lookup_topicdescription(properties.topic_name.c_str());
+    }
+    if(dds_topic != NULL) {
+	if(properties.qos_profile == "default")
+	    writer = publisher->create_datawriter(dds_topic, DDS_DATAWRITER_QOS_DEFAULT,
+						  NULL, DDS_STATUS_MASK_NONE);
+	else
+	    writer = publisher->create_datawriter_with_profile(dds_topic,
+							       properties.qos_library.c_str(),
+							       properties.qos_profile.c_str(),
+							       NULL, DDS_STATUS_MASK_NONE);
+    }
+    topic.writer = writer != NULL ? DDSDynamicDataWriter::narrow(writer) : NULL;
+    if(topic.writer == NULL) {
+	cerr << properties.topic_name << ": cannot create the topic and DataWriter" << endl;
+	return false;
+    }
+    return true;
+}
+
+
+static void usage()
+{
+    cerr << "Usage: cavecanem_loadgen [--hosts N] [--rate SAMPLES_PER_SEC] [--threads N]" << endl
+	 << "                         [--instances N] [--churn P] [--duration SEC]" << endl
+	 << "                         [--domain ID] [--config FILE] [PLUGIN...]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string cfg_file(string(CAVECANEM_DIR) + "/config/cavecanem.xml");
+    int domain_id = -1;
+    int hosts = 1000;
+    double rate = 10000;
+    int threads = 4;
+    int instances = 8;
+    double churn = 0.02;
+    double duration = 0;
+    vector<string> only;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--hosts" && i + 1 < argc)
+	    hosts = atoi(argv[++i]);
+	else if(arg == "--rate" && i + 1 < argc)
+	    rate = atof(argv[++i]);
+	else if(arg == "--threads" && i + 1 < argc)
+	    threads = atoi(argv[++i]);
+	else if(arg == "--instances" && i + 1 < argc)
+	    instances = atoi(argv[++i]);
+	else if(arg == "--churn" && i + 1 < argc)
+	    churn = atof(argv[++i]);
+	else if(arg == "--duration" && i + 1 < argc)
+	    duration = atof(argv[++i]);
+	else if(arg == "--domain" && i + 1 < argc)
+	    domain_id = atoi(argv[++i]);
+	else if(arg == "--config" && i + 1 < argc)
+	    cfg_file = argv[++i];
+	else if(arg[0] == '-') {
+	    usage();
+	    return 2;
+	}
+	else
+	    only.push_back(arg);
+    }
+    if(hosts <= 0 || rate < 0 || threads <= 0 || instances <= 0 || churn < 0 || duration < 0) {
+	usage();
+	return 2;
+    }
+    if(threads > hosts)
+	threads = hosts;
+
+    XML_parser *parser = XML_parser::get_singleton();
+    if(!parser->parse_general_configuration_file(cfg_file)) {
+	cerr << "cannot parse " << cfg_file << endl;
+	return 1;
+    }
+    cc_general_properties general = parser->get_general_properties();
+
+    DDSDomainParticipant *participant;
+    DDSPublisher *publisher;
+    if(!create_participant(domain_id >= 0 ? domain_id : general.domain_id, general,
+			   participant, publisher))
+	return 1;
+
+    //The types of the plugins, from their configuration files
+    vector<loadgen_topic> topics;
+    for(map<string, list<string> >::iterator it = general.plugin_list_map.begin();
+	it != general.plugin_list_map.end(); ++it)
+	for(list<string>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+	    if(!only.empty() && find(only.begin(), only.end(), *it2) == only.end())
+		continue;
+	    string file = string(CAVECANEM_DIR) + "/" + it->first + "/" + *it2 + "/" + *it2 + ".xml";
+	    if(!parser->parse_plugin_configuration_file(file)) {
+		cerr << "cannot parse " << file << endl;
+		continue;
+	    }
+	    cc_plugin_properties properties = parser->get_plugin_properties(*it2);
+	    if(properties.type_code == NULL)
+		continue;
+
+	    loadgen_topic topic;
+	    topic.plugin = *it2;
+	    topic.type = properties.type_code;
+	    topic.instances = instances;
+	    if(!build_layout(topic) ||
+	       !create_writer(participant, publisher, properties, topic))
+		continue;
+	    topics.push_back(topic);
+	}
+    if(topics.empty()) {
+	cerr << "no plugin to simulate" << endl;
+	return 1;
+    }
+
+    //The hosts, dealt out to the threads
+    size_t round_samples = 0;
+    for(size_t t = 0; t < topics.size(); t++)
+	round_samples += topics[t].instances;
+    vector<loadgen_thread> pool(threads);
+    for(int i = 0; i < threads; i++) {
+	loadgen_thread &thread = pool[i];
+	thread.topics = &topics;
+	thread.rate = rate / threads;
+	thread.churn = churn;
+	thread.random = random_source(0x9E3779B97F4A7C15ULL * (i + 1));
+	for(size_t t = 0; t < topics.size(); t++)
+	    thread.data.push_back(topics[t].type_support->create_data());
+    }
+    for(int h = 0; h < hosts; h++) {
+	loadgen_thread &thread = pool[h % threads];
+	thread.hosts.push_back(virtual_host());
+	virtual_host &host = thread.hosts.back();
+	snprintf(host.hostname, sizeof(host.hostname), "loadgen-%06d", h + 1);
+	host.tick = 0;
+	host.next_id = 1000;
+	host.topics.resize(topics.size());
+	for(size_t t = 0; t < topics.size(); t++) {
+	    host.topics[t].resize(topics[t].instances);
+	    for(size_t i = 0; i < topics[t].instances; i++)
+		spawn_instance(topics[t], host, host.topics[t][i], thread.random);
+	}
+    }
+
+    printf("%d hosts, %u topics, %u samples per host round, %d threads",
+	   hosts, (unsigned) topics.size(), (unsigned) round_samples, threads);
+    if(rate > 0)
+	printf(", %.0f samples/s (a round every %.3f s per host)",
+	       rate, hosts * round_samples / rate);
+    printf("\n");
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    long long start = now_ns();
+    for(int i = 0; i < threads; i++)
+	if(pthread_create(&pool[i].thread, NULL, publish_hosts, &pool[i]) != 0) {
+	    cerr << "cannot create thread " << i << endl;
+	    quit = true;
+	    threads = i;
+	    break;
+	}
+
+    //Report the rate achieved every second
+    unsigned long long last_written = 0;
+    long long last = start;
+    while(!quit) {
+	sleep_ns(1000000000LL);
+	long long now = now_ns();
+	unsigned long long written = 0;
+	unsigned long long failed = 0;
+	for(int i = 0; i < threads; i++) {
+	    written += pool[i].written;
+	    failed += pool[i].failed;
+	}
+	printf("%8.1f s %12.0f samples/s", (now - start) / 1e9,
+	       (written - last_written) * 1e9 / (now - last));
+	if(failed > 0)
+	    printf(" (%llu failed writes)", failed);
+	printf("\n");
+	fflush(stdout);
+	last_written = written;
+	last = now;
+	if(duration > 0 && now - start >= duration * 1e9)
+	    quit = true;
+    }
+
+    for(int i = 0; i < threads; i++)
+	pthread_join(pool[i].thread, NULL);
+    double elapsed = (now_ns() - start) / 1e9;
+
+    unsigned long long written = 0;
+    unsigned long long failed = 0;
+    for(size_t i = 0; i < pool.size(); i++) {
+	written += pool[i].written;
+	failed += pool[i].failed;
+    }
+    printf("%llu samples written in %.3f s (%.0f/s", written, elapsed,
+	   elapsed > 0 ? written / elapsed : 0.0);
+    if(rate > 0)
+	printf(", %.1f%% of %.0f/s", elapsed > 0 ? 100 * written / elapsed / rate : 0.0, rate);
+    printf(")");
+    if(failed > 0)
+	printf(", %llu failed", failed);
+    printf("\n");
+
+    for(size_t i = 0; i < pool.size(); i++)
+	for(size_t t = 0; t < topics.size(); t++)
+	    topics[t].type_support->delete_data(pool[i].data[t]);
+    participant->delete_contained_entities();
+    DDSTheParticipantFactory->delete_participant(participant);
+    for(size_t t = 0; t < topics.size(); t++)
+	delete topics[t].type_support;
+    return 0;
+}
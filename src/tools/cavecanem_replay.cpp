@@ -0,0 +1,487 @@
+/*
+ *   This file is part of Cave Canem, an extensible DDS-based monitoring and
+ *   intrusion detection system.
+ *
+ *   Copyright (C) 2013 Fernando García Aranda
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Republishes onto DDS the samples recorded by "cavecanem --record FILE" (or
+ * written by the file sink), to load-test subscribers with real traffic or
+ * to reproduce an incident offline.
+ *
+ *   cavecanem_replay [--speed N | --max] [--loop] [--max-gap SEC]
+ *                    [--source-timestamps] [--domain ID] [--config FILE] FILE
+ *
+ * Every stream of the recording carries the type of its topic, so no plugin
+ * XML is needed: topics and DataWriters are created from the recorded types,
+ * in the domain and with the QoS profile of the general configuration file
+ * (overridable with --domain).
+ *
+ * Samples are written at the pace they were recorded (--speed 1, the
+ * default), N times faster (--speed N) or as fast as possible (--max).
+ * Pauses longer than --max-gap seconds (e.g. between two runs appended to
+ * the same file) are shortened to it. --source-timestamps writes every
+ * sample with its recorded time as source timestamp.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ndds/ndds_cpp.h>
+
+#include "sample_codec.hpp"
+#include "sink.hpp"
+#include "xml_parser.hpp"
+
+#ifndef CAVECANEM_DIR
+#define CAVECANEM_DIR "."
+#endif
+
+using namespace std;
+
+static volatile bool quit = false;
+
+static void signal_handler(int signal)
+{
+    quit = true;
+}
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ns(long long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR && !quit)
+	;
+}
+
+/**
+ * @class replay_topic
+ * A topic being republished: its type, DataWriter and sample.
+ */
+struct replay_topic {
+    DDS_TypeCode *type;
+    DDSDynamicDataTypeSupport *type_support;
+    DDSDynamicDataWriter *writer;
+    DDS_DynamicData *data;
+};
+
+/**
+ * @class replay_stream
+ * A stream of the recording, as declared by its stream record. Its topic is
+ * known once its type record has been read.
+ */
+struct replay_stream {
+    string plugin;
+    string topic_name;
+    replay_topic *topic;
+};
+
+/**
+ * @class replayer
+ * Reads a recording and writes its samples with one DataWriter per topic.
+ */
+class replayer {
+public:
+    replayer();
+    ~replayer();
+
+    bool initialize_dds(int domain_id,
+			const string &qos_file,
+			const string &qos_library,
+			const string &qos_profile);
+    bool replay(const char *begin, const char *end);
+
+    double speed;
+    long long max_gap_ns;
+    bool source_timestamps;
+
+    unsigned long long written;
+    unsigned long long failed;
+    unsigned long long skipped;
+    long long recorded_ns;
+
+private:
+    bool define_type(unsigned int id, const char *p, const char *end);
+    void write(unsigned int id, const char *p, const char *end);
+
+    DDSDomainParticipant *participant_;
+    DDSPublisher *publisher_;
+    string qos_library_;
+    string qos_profile_;
+
+    map<string, replay_topic> topics_;
+    vector<replay_stream> streams_;
+    sample_decoder decoder_;
+
+    //Pacing: recorded time <-> monotonic time
+    bool paced_;
+    unsigned long long last_timestamp_;
+    long long due_ns_;
+};
+
+replayer::replayer()
+    : speed(1.0),
+      max_gap_ns(0),
+      source_timestamps(false),
+      written(0),
+      failed(0),
+      skipped(0),
+      recorded_ns(0),
+      participant_(NULL),
+      publisher_(NULL),
+      paced_(false),
+      last_timestamp_(0),
+      due_ns_(0)
+{
+}
+
+replayer::~replayer()
+{
+    DDS_ExceptionCode_t ex;
+    for(map<string, replay_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it) {
+	it->second.type_support->delete_data(it->second.data);
+	DDS_TypeCodeFactory::get_instance()->delete_tc(it->second.type, ex);
+    }
+    if(participant_ != NULL) {
+	participant_->delete_contained_entities();
+	DDSTheParticipantFactory->delete_participant(participant_);
+    }
+    for(map<string, replay_topic>::iterator it = topics_.begin(); it != topics_.end(); ++it)
+	delete it->second.type_support;
+}
+
+/**
+ * @brief Creates the participant and publisher, like the plugin manager.
+ */
+bool replayer::initialize_dds(int domain_id,
+			      const string &qos_file,
+			      const string &qos_library,
+			      const string &qos_profile)
+{
+    qos_library_ = qos_library;
+    qos_profile_ = qos_profile;
+
+    DDS_DomainParticipantFactoryQos factory_qos;
+    DDSTheParticipantFactory->get_qos(factory_qos);
+    factory_qos.profile.url_profile.ensure_length(1,1);
+    factory_qos.profile.url_profile[0] = DDS_String_dup(qos_file.c_str());
+    DDSTheParticipantFactory->set_qos(factory_qos);
+
+    if(qos_profile == "default") {
+	participant_ = DDSTheParticipantFactory->
+	    create_participant(domain_id, DDS_PARTICIPANT_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+	if(participant_ != NULL)
+	    publisher_ = participant_->create_publisher(DDS_PUBLISHER_QOS_DEFAULT,
+							NULL, DDS_STATUS_MASK_NONE);
+    }
+    else {
+	participant_ = DDSTheParticipantFactory->
+	    create_participant_with_profile(domain_id, qos_library.c_str(), qos_profile.c_str(),
+					    NULL, DDS_STATUS_MASK_NONE);
+	if(participant_ != NULL)
+	    publisher_ = participant_->
+		create_publisher_with_profile(qos_library.c_str(), qos_profile.c_str(),
+					      NULL, DDS_STATUS_MASK_NONE);
+    }
+
+    if(participant_ == NULL || publisher_ == NULL) {
+	cerr << "cannot create the DDS participant and publisher" << endl;
+	return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Creates (or reuses) the topic of a stream given its type record.
+ */
+bool replayer::define_type(unsigned int id, const char *p, const char *end)
+{
+    if(id >= streams_.size())
+	return false;
+    replay_stream &stream = streams_[id];
+
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_TypeCode *type = decode_type(p, end);
+    if(type == NULL) {
+	cerr << stream.plugin << ": invalid type in the recording" << endl;
+	return false;
+    }
+
+    map<string, replay_topic>::iterator it = topics_.find(stream.topic_name);
+    if(it != topics_.end()) {
+	if(!it->second.type->equal(type, ex)) {
+	    cerr << stream.topic_name << ": type changed within the recording; "
+		 << "samples of " << stream.plugin << " with the new type are skipped" << endl;
+	    stream.topic = NULL;
+	}
+	else {
+	    stream.topic = &it->second;
+	}
+	DDS_TypeCodeFactory::get_instance()->delete_tc(type, ex);
+	return true;
+    }
+
+    replay_topic topic;
+    topic.type = type;
+    topic.type_support = new DDSDynamicDataTypeSupport(type, DDS_DYNAMIC_DATA_TYPE_PROPERTY_DEFAULT);
+    const char *type_name = topic.type_support->get_type_name();
+    DDSTopic *dds_topic = NULL;
+    DDSDataWriter *writer = NULL;
+    if(topic.type_support->register_type(participant_, type_name) == DDS_RETCODE_OK)
+	dds_topic = participant_->create_topic(stream.topic_name.c_str(), type_name,
+					       DDS_TOPIC_QOS_DEFAULT, NULL, DDS_STATUS_MASK_NONE);
+    if(dds_topic != NULL) {
+	if(qos_profile_ == "default")
+	    writer = publisher_->create_datawriter(dds_topic, DDS_DATAWRITER_QOS_DEFAULT,
+						   NULL, DDS_STATUS_MASK_NONE);
+	else
+	    writer = publisher_->create_datawriter_with_profile(dds_topic, qos_library_.c_str(),
+								qos_profile_.c_str(),
+								NULL, DDS_STATUS_MASK_NONE);
+    }
+    topic.writer = writer != NULL ? DDSDynamicDataWriter::narrow(writer) : NULL;
+    if(topic.writer == NULL) {
+	cerr << stream.topic_name << ": cannot create the topic and DataWriter" << endl;
+	delete topic.type_support;
+	DDS_TypeCodeFactory::get_instance()->delete_tc(type, ex);
+	return false;
+    }
+    topic.data = topic.type_support->create_data();
+
+    stream.topic = &(topics_[stream.topic_name] = topic);
+    return true;
+}
+
+/**
+ * @brief Waits until a sample is due and writes it.
+ */
+void replayer::write(unsigned int id, const char *p, const char *end)
+{
+    unsigned long long timestamp;
+    if(!get_uint64(p, end, timestamp) || id >= streams_.size() || streams_[id].topic == NULL) {
+	skipped++;
+	return;
+    }
+
+    //Recorded time elapsed since the previous sample; a step back means
+    //that another run starts
+    long long gap = 0;
+    if(paced_ && timestamp > last_timestamp_) {
+	gap = timestamp - last_timestamp_;
+	if(max_gap_ns > 0 && gap > max_gap_ns)
+	    gap = max_gap_ns;
+	recorded_ns += gap;
+    }
+    last_timestamp_ = timestamp;
+
+    if(speed > 0) {
+	if(!paced_)
+	    due_ns_ = now_ns();
+	due_ns_ += (long long) (gap / speed);
+	long long wait = due_ns_ - now_ns();
+	if(wait > 0)
+	    sleep_ns(wait);
+    }
+    paced_ = true;
+
+    replay_topic &topic = *streams_[id].topic;
+    if(!decoder_.decode(p, end - p, *topic.data)) {
+	failed++;
+	return;
+    }
+
+    DDS_ReturnCode_t retcode;
+    if(source_timestamps) {
+	DDS_Time_t source_time;
+	source_time.sec = (DDS_Long) (timestamp / 1000000000ULL);
+	source_time.nanosec = (DDS_UnsignedLong) (timestamp % 1000000000ULL);
+	retcode = topic.writer->write_w_timestamp(*topic.data, DDS_HANDLE_NIL, source_time);
+    }
+    else {
+	retcode = topic.writer->write(*topic.data, DDS_HANDLE_NIL);
+    }
+    if(retcode == DDS_RETCODE_OK)
+	written++;
+    else
+	failed++;
+}
+
+/**
+ * @brief Replays the records of a recording (after its header).
+ *
+ * @return False if the recording is corrupt.
+ */
+bool replayer::replay(const char *begin, const char *end)
+{
+    const char *p = begin;
+    while(p < end && !quit) {
+	unsigned long length;
+	unsigned int id;
+	if(!get_uint32(p, end, length) || length < 3 || (unsigned long) (end - p) < length) {
+	    cerr << "truncated record at offset " << (p - begin) << endl;
+	    return false;
+	}
+	const char *record_end = p + length;
+	char kind = *p++;
+	get_uint16(p, record_end, id);
+
+	if(kind == SINK_RECORD_STREAM) {
+	    replay_stream stream;
+	    string type_name;
+	    if(!get_string16(p, record_end, stream.plugin) ||
+	       !get_string16(p, record_end, stream.topic_name) ||
+	       !get_string16(p, record_end, type_name)) {
+		cerr << "invalid stream record" << endl;
+		return false;
+	    }
+	    stream.topic = NULL;
+	    if(streams_.size() <= id)
+		streams_.resize(id + 1);
+	    streams_[id] = stream;
+	}
+	else if(kind == SINK_RECORD_TYPE) {
+	    if(!define_type(id, p, record_end))
+		return false;
+	}
+	else if(kind == SINK_RECORD_DATA) {
+	    write(id, p, record_end);
+	}
+	p = record_end;
+    }
+    return true;
+}
+
+
+static void usage()
+{
+    cerr << "Usage: cavecanem_replay [--speed N | --max] [--loop] [--max-gap SEC]" << endl
+	 << "                        [--source-timestamps] [--domain ID] [--config FILE] FILE" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string cfg_file(string(CAVECANEM_DIR) + "/config/cavecanem.xml");
+    string file;
+    int domain_id = -1;
+    bool loop = false;
+    replayer replay;
+
+    for(int i = 1; i < argc; i++) {
+	string arg(argv[i]);
+	if(arg == "--speed" && i + 1 < argc)
+	    replay.speed = atof(argv[++i]);
+	else if(arg == "--max")
+	    replay.speed = 0;
+	else if(arg == "--loop")
+	    loop = true;
+	else if(arg == "--max-gap" && i + 1 < argc)
+	    replay.max_gap_ns = (long long) (atof(argv[++i]) * 1e9);
+	else if(arg == "--source-timestamps")
+	    replay.source_timestamps = true;
+	else if(arg == "--domain" && i + 1 < argc)
+	    domain_id = atoi(argv[++i]);
+	else if(arg == "--config" && i + 1 < argc)
+	    cfg_file = argv[++i];
+	else if(arg[0] == '-' || !file.empty()) {
+	    usage();
+	    return 2;
+	}
+	else
+	    file = arg;
+    }
+    if(file.empty() || replay.speed < 0) {
+	usage();
+	return 2;
+    }
+
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+	cerr << "cannot open " << file << ": " << strerror(errno) << endl;
+	return 1;
+    }
+    if(st.st_size < 12) {
+	cerr << file << " is not a sample file" << endl;
+	return 1;
+    }
+    void *address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED) {
+	cerr << "cannot map " << file << ": " << strerror(errno) << endl;
+	return 1;
+    }
+    madvise(address, st.st_size, MADV_SEQUENTIAL);
+    const char *begin = (const char *) address;
+    const char *end = begin + st.st_size;
+    const char *p = begin + 8;
+    unsigned long version;
+    if(memcmp(begin, SINK_MAGIC, 8) != 0 || !get_uint32(p, end, version) ||
+       version != SINK_VERSION) {
+	cerr << file << " is not a sample file of this version" << endl;
+	return 1;
+    }
+
+    if(!XML_parser::get_singleton()->parse_general_configuration_file(cfg_file)) {
+	cerr << "cannot parse " << cfg_file << endl;
+	return 1;
+    }
+    cc_general_properties general = XML_parser::get_singleton()->get_general_properties();
+    if(!replay.initialize_dds(domain_id >= 0 ? domain_id : general.domain_id,
+			      general.qos_file, general.qos_library, general.qos_profile))
+	return 1;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    long long start = now_ns();
+    bool ok = true;
+    do {
+	ok = replay.replay(p, end);
+    } while(ok && loop && !quit);
+    double elapsed = (now_ns() - start) / 1e9;
+
+    printf("%llu samples written in %.3f s (%.0f/s), %.3f s recorded",
+	   replay.written, elapsed, elapsed > 0 ? replay.written / elapsed : 0.0,
+	   replay.recorded_ns / 1e9);
+    if(replay.failed > 0 || replay.skipped > 0)
+	printf(", %llu failed, %llu skipped", replay.failed, replay.skipped);
+    printf("\n");
+
+    munmap(address, st.st_size);
+    return ok ? 0 : 1;
+}